@@ -0,0 +1,271 @@
+#include "AdminController.h"
+#include "AuditLogger.h"
+#include "AuthContext.h"
+#include "DbRouter.h"
+#include "InvalidationBus.h"
+#include "JsonStreamWriter.h"
+#include "LogPartitionManager.h"
+#include "UploadGarbageCollector.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <regex>
+
+using namespace drogon;
+using namespace drogon::orm;
+using namespace std;
+
+namespace {
+
+void writeDetails(JsonStreamWriter& writer, const Field& field) {
+    if (field.isNull()) {
+        writer.nullValue();
+        return;
+    }
+    writer.rawValue(field.as<string>());
+}
+
+const JsonRowLayout& logLayout() {
+    static const JsonRowLayout layout({
+        {"id", JsonColumnKind::String},
+        {"user_id", JsonColumnKind::NullableString},
+        {"action", JsonColumnKind::String},
+        {"resource_type", JsonColumnKind::NullableString},
+        {"resource_id", JsonColumnKind::NullableString},
+        {"details", "details", writeDetails},
+        {"ip_address", JsonColumnKind::NullableString},
+        {"user_agent", JsonColumnKind::NullableString},
+        {"created_at", JsonColumnKind::Timestamp},
+    });
+    return layout;
+}
+
+// Дата или дата-время ISO 8601, часовой пояс необязателен
+bool isValidTimestamp(const string& value) {
+    static const regex pattern(
+        R"(^\d{4}-\d{2}-\d{2}([ T]\d{2}:\d{2}(:\d{2}(\.\d{1,6})?)?)?(Z|[+-]\d{2}(:?\d{2})?)?$)");
+    return regex_match(value, pattern);
+}
+
+} // namespace
+
+string AdminController::adminId(const HttpRequestPtr& req) {
+    AuthContext::Identity identity;
+    if (auto attached = AuthContext::attached(req)) {
+        identity = *attached;
+    } else if (!AuthContext::verifyBearer(req->getHeader("Authorization"), identity)) {
+        return "";
+    }
+    if (identity.role != "основатель" && identity.role != "админ") {
+        return "";
+    }
+    return identity.userId;
+}
+
+Json::Value AdminController::createJsonResponse(const string& key, const string& value) {
+    Json::Value json;
+    json[key] = value;
+    return json;
+}
+
+void AdminController::getStorageGcStats(const HttpRequestPtr& req,
+                                        function<void(const HttpResponsePtr&)>&& callback) {
+    if (adminId(req).empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    callback(HttpResponse::newHttpJsonResponse(UploadGarbageCollector::instance().stats()));
+}
+
+void AdminController::runStorageGc(const HttpRequestPtr& req,
+                                   function<void(const HttpResponsePtr&)>&& callback) {
+    string userId = adminId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    bool dryRun = req->getParameter("dry_run") == "true";
+    if (!UploadGarbageCollector::instance().runNow(dryRun)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Garbage collection is already running"));
+        resp->setStatusCode(k409Conflict);
+        callback(resp);
+        return;
+    }
+
+    Json::Value details;
+    details["dry_run"] = dryRun;
+    AuditLogger::instance().record(req, userId, "storage_gc_started", "storage", "uploads", details);
+
+    // Проход идёт в фоне, итоги - в GET /admin/storage/gc
+    Json::Value response;
+    response["message"] = "Garbage collection started";
+    response["dry_run"] = dryRun;
+    auto resp = HttpResponse::newHttpJsonResponse(response);
+    resp->setStatusCode(k202Accepted);
+    callback(resp);
+}
+
+void AdminController::getAuditStats(const HttpRequestPtr& req,
+                                    function<void(const HttpResponsePtr&)>&& callback) {
+    if (adminId(req).empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    callback(HttpResponse::newHttpJsonResponse(AuditLogger::instance().stats()));
+}
+
+void AdminController::getLogs(const HttpRequestPtr& req,
+                              function<void(const HttpResponsePtr&)>&& callback) {
+    if (adminId(req).empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    string from = req->getParameter("from");
+    string to = req->getParameter("to");
+    string cursor = req->getParameter("cursor");
+    if ((!from.empty() && !isValidTimestamp(from)) || (!to.empty() && !isValidTimestamp(to))) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid from/to timestamp"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    int limit = 50;
+    int64_t cursorMicros = 0;
+    string cursorId;
+    try {
+        auto limitStr = req->getParameter("limit");
+        if (!limitStr.empty()) {
+            limit = stoi(limitStr);
+            if (limit < 1 || limit > 500) limit = 50;
+        }
+        // Курсор "<created_at в микросекундах>_<id>" последней строки страницы
+        if (!cursor.empty()) {
+            auto separator = cursor.find('_');
+            if (separator == string::npos || separator + 1 == cursor.size()) {
+                throw invalid_argument("cursor");
+            }
+            cursorMicros = stoll(cursor.substr(0, separator));
+            cursorId = cursor.substr(separator + 1);
+        }
+    } catch (const exception&) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid pagination parameters"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    // Границы по created_at - параметры запроса, поэтому лишние секции
+    // отбрасываются при выполнении; курсор тоже сужает верхнюю границу
+    vector<string> params;
+    string sql =
+        "SELECT id, user_id, action, resource_type, resource_id, details::text AS details, "
+        "host(ip_address) AS ip_address, user_agent, created_at, "
+        "(EXTRACT(EPOCH FROM created_at) * 1000000)::bigint AS created_us "
+        "FROM server_logs WHERE ";
+    if (from.empty()) {
+        static const int windowDays =
+            max(1, app().getCustomConfig()["logs"].get("default_window_days", 7).asInt());
+        params.push_back(to_string(windowDays));
+        sql += "created_at >= NOW() - $1::integer * INTERVAL '1 day'";
+    } else {
+        params.push_back(from);
+        sql += "created_at >= $1::timestamptz";
+    }
+    if (!to.empty()) {
+        params.push_back(to);
+        sql += " AND created_at < $" + to_string(params.size()) + "::timestamptz";
+    }
+    if (!cursor.empty()) {
+        params.push_back(to_string(cursorMicros));
+        string bound = "(TIMESTAMPTZ 'epoch' + $" + to_string(params.size()) + "::bigint * INTERVAL '1 microsecond')";
+        params.push_back(cursorId);
+        sql += " AND created_at <= " + bound +
+               " AND (created_at, id) < (" + bound + ", $" + to_string(params.size()) + ")";
+    }
+    for (const char* filter : {"user_id", "action", "resource_type", "resource_id"}) {
+        string value = req->getParameter(filter);
+        if (!value.empty()) {
+            params.push_back(value);
+            sql += string(" AND ") + filter + " = $" + to_string(params.size());
+        }
+    }
+    params.push_back(to_string(limit));
+    sql += " ORDER BY created_at DESC, id DESC LIMIT $" + to_string(params.size()) + "::integer";
+
+    // Число параметров зависит от фильтров, поэтому они привязываются по одному
+    auto binder = *app().getDbClient() << sql;
+    for (const auto& param : params) {
+        binder << param;
+    }
+    binder >> [callback, limit](const Result& result) {
+        const auto& layout = logLayout();
+        auto binding = layout.bind(result);
+
+        JsonStreamWriter writer(layout.estimateSize(result, binding) + 128);
+        writer.beginObject();
+        writer.key("logs");
+        layout.writeArray(writer, result, binding);
+        writer.key("next_cursor");
+        if (result.size() < static_cast<size_t>(limit)) {
+            writer.nullValue();
+        } else {
+            const auto& last = result[result.size() - 1];
+            writer.stringValue(last["created_us"].as<string>() + "_" + last["id"].as<string>());
+        }
+        writer.endObject();
+        callback(writer.toResponse());
+    } >> [callback, this](const DrogonDbException& e) {
+        LOG_ERROR << "Database error reading server logs: " << e.base().what();
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+        resp->setStatusCode(k500InternalServerError);
+        callback(resp);
+    };
+}
+
+void AdminController::getLogPartitions(const HttpRequestPtr& req,
+                                       function<void(const HttpResponsePtr&)>&& callback) {
+    if (adminId(req).empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    callback(HttpResponse::newHttpJsonResponse(LogPartitionManager::instance().stats()));
+}
+
+void AdminController::getInvalidationStats(const HttpRequestPtr& req,
+                                           function<void(const HttpResponsePtr&)>&& callback) {
+    if (adminId(req).empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    callback(HttpResponse::newHttpJsonResponse(InvalidationBus::instance().stats()));
+}
+
+void AdminController::getDbRouting(const HttpRequestPtr& req,
+                                   function<void(const HttpResponsePtr&)>&& callback) {
+    if (adminId(req).empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    callback(HttpResponse::newHttpJsonResponse(DbRouter::instance().stats()));
+}
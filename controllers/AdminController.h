@@ -0,0 +1,56 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+#include <json/json.h>
+
+using namespace drogon;
+
+// Служебные эндпоинты для ролей "основатель" и "админ"
+class AdminController : public drogon::HttpController<AdminController>
+{
+public:
+    METHOD_LIST_BEGIN
+        ADD_METHOD_TO(AdminController::getStorageGcStats, "/admin/storage/gc", Get);
+    ADD_METHOD_TO(AdminController::runStorageGc, "/admin/storage/gc", Post);
+    ADD_METHOD_TO(AdminController::getAuditStats, "/admin/audit/stats", Get);
+    ADD_METHOD_TO(AdminController::getLogs, "/admin/logs", Get);
+    ADD_METHOD_TO(AdminController::getLogPartitions, "/admin/logs/partitions", Get);
+    ADD_METHOD_TO(AdminController::getInvalidationStats, "/admin/cache/invalidation", Get);
+    ADD_METHOD_TO(AdminController::getDbRouting, "/admin/db/routing", Get);
+    METHOD_LIST_END
+
+        // Итоги сверки uploads/ с БД (UploadGarbageCollector)
+        void getStorageGcStats(const HttpRequestPtr& req,
+                           std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Внеочередной проход; ?dry_run=true - только посчитать сирот
+    void runStorageGc(const HttpRequestPtr& req,
+                      std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Счётчики журнала действий (AuditLogger): записано, отброшено, ошибки записи
+    void getAuditStats(const HttpRequestPtr& req,
+                       std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Журнал действий за период, новые первыми. ?from=&to= - границы (по умолчанию
+    // последние logs.default_window_days дней), user_id, action, resource_type,
+    // resource_id - фильтры, cursor - next_cursor предыдущей страницы
+    void getLogs(const HttpRequestPtr& req,
+                 std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Секции server_logs и итоги их обслуживания (LogPartitionManager)
+    void getLogPartitions(const HttpRequestPtr& req,
+                          std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Шина сброса кэшей (InvalidationBus): соединение, переподключения, задержка доставки
+    void getInvalidationStats(const HttpRequestPtr& req,
+                              std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Реплики: отставание, пригодность для чтения, счётчики маршрутизации (DbRouter)
+    void getDbRouting(const HttpRequestPtr& req,
+                      std::function<void(const HttpResponsePtr&)>&& callback);
+
+private:
+    // userId администратора, пусто - нет доступа
+    std::string adminId(const HttpRequestPtr& req);
+    Json::Value createJsonResponse(const std::string& key, const std::string& value);
+};
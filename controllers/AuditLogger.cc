@@ -0,0 +1,245 @@
+#include "AuditLogger.h"
+#include "PgArray.h"
+#include <arpa/inet.h>
+#include <algorithm>
+#include <chrono>
+#include <string_view>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+// В INET уходит только то, что разбирается как адрес: одна плохая строка
+// отменила бы вставку всей пачки
+bool isIpAddress(const std::string& ip) {
+    unsigned char buffer[sizeof(struct in6_addr)];
+    return inet_pton(AF_INET, ip.c_str(), buffer) == 1 || inet_pton(AF_INET6, ip.c_str(), buffer) == 1;
+}
+
+// Длина корректной UTF-8 последовательности в начале text, 0 - байт не начинает символ
+// (обрыв, лишние байты продолжения, избыточная запись, суррогаты, больше U+10FFFF)
+size_t utf8SequenceLength(std::string_view text) {
+    auto byte = [&text](size_t i) { return static_cast<unsigned char>(text[i]); };
+    auto continuation = [&](size_t i) { return i < text.size() && (byte(i) & 0xC0) == 0x80; };
+
+    unsigned char lead = byte(0);
+    if (lead < 0x80) {
+        return 1;
+    }
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        return continuation(1) ? 2 : 0;
+    }
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        if (!continuation(1) || !continuation(2)) {
+            return 0;
+        }
+        bool overlong = lead == 0xE0 && byte(1) < 0xA0;
+        bool surrogate = lead == 0xED && byte(1) >= 0xA0;
+        return overlong || surrogate ? 0 : 3;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        if (!continuation(1) || !continuation(2) || !continuation(3)) {
+            return 0;
+        }
+        bool overlong = lead == 0xF0 && byte(1) < 0x90;
+        bool tooLarge = lead == 0xF4 && byte(1) >= 0x90;
+        return overlong || tooLarge ? 0 : 4;
+    }
+    return 0;
+}
+
+// Удалённые пользователи не ломают вставку: user_id становится NULL
+const char* const kInsertSql = R"(
+    INSERT INTO server_logs (user_id, action, resource_type, resource_id, details,
+                             ip_address, user_agent, created_at)
+    SELECT u.id, t.action, NULLIF(t.resource_type, ''), NULLIF(t.resource_id, ''),
+           NULLIF(t.details, '')::jsonb, NULLIF(t.ip, '')::inet, NULLIF(t.user_agent, ''),
+           to_timestamp(t.created_at)
+    FROM unnest($1::text[], $2::text[], $3::text[], $4::text[], $5::text[], $6::text[],
+                $7::text[], $8::double precision[])
+        AS t(user_id, action, resource_type, resource_id, details, ip, user_agent, created_at)
+    LEFT JOIN users u ON u.id = NULLIF(t.user_id, '')
+)";
+
+} // namespace
+
+std::string AuditLogger::sanitizeText(std::string_view text, size_t maxBytes) {
+    static const std::string_view kReplacement = "\xEF\xBF\xBD";
+    std::string result;
+    result.reserve(std::min(text.size(), maxBytes));
+    while (!text.empty()) {
+        size_t length = utf8SequenceLength(text);
+        std::string_view symbol = length > 0 ? text.substr(0, length) : kReplacement;
+        if (result.size() + symbol.size() > maxBytes) {
+            break;
+        }
+        if (symbol.front() != '\0') {
+            result.append(symbol);
+        }
+        text.remove_prefix(std::max<size_t>(length, 1));
+    }
+    return result;
+}
+
+void AuditLogger::start() {
+    const auto& config = app().getCustomConfig()["audit"];
+    size_t capacity = std::max(1024u, config.get("queue_capacity", 65536).asUInt());
+    batchSize_ = std::max(1u, config.get("batch_size", 500).asUInt());
+    flushIntervalSeconds_ = std::max(0.1, config.get("flush_interval_ms", 1000).asDouble() / 1000.0);
+    maxUserAgent_ = config.get("max_user_agent", 512).asUInt();
+
+    ring_ = std::make_unique<MpmcQueue<Event>>(capacity);
+    flushThreshold_ = static_cast<int64_t>(ring_->capacity() / 2);
+    queue_ = std::make_unique<trantor::ConcurrentTaskQueue>(1, "AuditLogger");
+    accepting_ = true;
+
+    app().getLoop()->runEvery(flushIntervalSeconds_, [this]() {
+        scheduleFlush();
+    });
+}
+
+void AuditLogger::record(const HttpRequestPtr& req,
+                         const std::string& userId,
+                         std::string action,
+                         std::string resourceType,
+                         std::string resourceId,
+                         const Json::Value& details) {
+    if (!accepting_) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Event event;
+    event.userId = sanitizeText(userId);
+    event.action = sanitizeText(action);
+    event.resourceType = sanitizeText(resourceType);
+    event.resourceId = sanitizeText(resourceId);
+    if (!details.isNull()) {
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        // Неверные байты бывают только внутри строк JSON - после замены он остаётся корректным
+        event.details = sanitizeText(Json::writeString(builder, details));
+    }
+    if (req) {
+        event.ip = req->peerAddr().toIp();
+        if (!isIpAddress(event.ip)) {
+            event.ip.clear();
+        }
+        event.userAgent = sanitizeText(req->getHeader("User-Agent"), maxUserAgent_);
+    }
+    event.createdAt = std::chrono::duration<double>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    if (!ring_->tryPush(std::move(event))) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    recorded_.fetch_add(1, std::memory_order_relaxed);
+
+    // Кольцо заполнилось наполовину - не ждём таймера
+    if (pending_.fetch_add(1, std::memory_order_relaxed) + 1 == flushThreshold_) {
+        scheduleFlush();
+    }
+}
+
+void AuditLogger::scheduleFlush() {
+    // Сброс уже идёт и дочитает кольцо до конца
+    if (flushing_.exchange(true)) {
+        return;
+    }
+    queue_->runTaskInQueue([this]() {
+        drain();
+        flushing_ = false;
+    });
+}
+
+void AuditLogger::drain() {
+    std::vector<Event> batch;
+    batch.reserve(batchSize_);
+    for (;;) {
+        while (batch.size() < batchSize_) {
+            auto event = ring_->tryPop();
+            if (!event) {
+                break;
+            }
+            batch.push_back(std::move(*event));
+        }
+        if (batch.empty()) {
+            return;
+        }
+        pending_.fetch_sub(static_cast<int64_t>(batch.size()), std::memory_order_relaxed);
+
+        // Неудачная пачка не возвращается в кольцо: повтор занял бы место новых событий
+        if (write(batch)) {
+            written_.fetch_add(batch.size(), std::memory_order_relaxed);
+        } else {
+            failed_.fetch_add(batch.size(), std::memory_order_relaxed);
+        }
+        batches_.fetch_add(1, std::memory_order_relaxed);
+
+        bool more = batch.size() == batchSize_;
+        batch.clear();
+        if (!more) {
+            return;
+        }
+    }
+}
+
+bool AuditLogger::write(const std::vector<Event>& batch) {
+    std::vector<std::string> userIds, actions, resourceTypes, resourceIds, details, ips, userAgents;
+    std::vector<double> createdAt;
+    for (auto* column : {&userIds, &actions, &resourceTypes, &resourceIds, &details, &ips, &userAgents}) {
+        column->reserve(batch.size());
+    }
+    createdAt.reserve(batch.size());
+    for (const auto& event : batch) {
+        userIds.push_back(event.userId);
+        actions.push_back(event.action);
+        resourceTypes.push_back(event.resourceType);
+        resourceIds.push_back(event.resourceId);
+        details.push_back(event.details);
+        ips.push_back(event.ip);
+        userAgents.push_back(event.userAgent);
+        createdAt.push_back(event.createdAt);
+    }
+
+    try {
+        app().getDbClient()->execSqlSync(
+            kInsertSql,
+            pg::textArray(userIds), pg::textArray(actions), pg::textArray(resourceTypes),
+            pg::textArray(resourceIds), pg::textArray(details), pg::textArray(ips),
+            pg::textArray(userAgents), pg::doubleArray(createdAt));
+        return true;
+    } catch (const DrogonDbException& e) {
+        LOG_ERROR << "Audit log write failed, " << batch.size() << " events lost: " << e.base().what();
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Audit log write failed, " << batch.size() << " events lost: " << e.what();
+    }
+    return false;
+}
+
+void AuditLogger::shutdown() {
+    if (!ring_) {
+        return;
+    }
+    // Новые события больше не принимаются, очередь дописывается целиком
+    accepting_ = false;
+    queue_->waitAllTasksFinished();
+    drain();
+    LOG_INFO << "Audit log flushed on shutdown: " << written_.load() << " written, "
+             << dropped_.load() << " dropped, " << failed_.load() << " failed";
+}
+
+Json::Value AuditLogger::stats() const {
+    Json::Value json;
+    json["recorded"] = static_cast<Json::UInt64>(recorded_.load());
+    json["dropped"] = static_cast<Json::UInt64>(dropped_.load());
+    json["written"] = static_cast<Json::UInt64>(written_.load());
+    json["failed"] = static_cast<Json::UInt64>(failed_.load());
+    json["batches"] = static_cast<Json::UInt64>(batches_.load());
+    json["pending"] = static_cast<Json::Int64>(std::max<int64_t>(0, pending_.load()));
+    json["queue_capacity"] = static_cast<Json::UInt64>(ring_ ? ring_->capacity() : 0);
+    json["batch_size"] = static_cast<Json::UInt64>(batchSize_);
+    return json;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "MpmcQueue.h"
+#include <drogon/drogon.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Журнал действий пользователей в server_logs.
+// Обработчик только кладёт событие в кольцо фиксированной ёмкости и не ждёт БД;
+// поток сервиса раз в flush_interval_ms (или раньше, когда кольцо заполнено
+// наполовину) пишет накопленное пачками по batch_size строк одним INSERT.
+// Если кольцо полно, новое событие отбрасывается и учитывается в dropped:
+// журнал не должен ни тормозить запросы, ни расти в памяти без предела.
+class AuditLogger {
+public:
+    static AuditLogger& instance() {
+        static AuditLogger instance;
+        return instance;
+    }
+
+    // Кольцо и таймер записи по custom_config.audit (вызывается из main до app().run())
+    void start();
+
+    // Дописать очередь синхронно при остановке сервера
+    void shutdown();
+
+    // Событие от имени userId (пусто - системное). IP и User-Agent берутся из req,
+    // req может быть nullptr. details - JSON-объект или null
+    void record(const drogon::HttpRequestPtr& req,
+                const std::string& userId,
+                std::string action,
+                std::string resourceType,
+                std::string resourceId,
+                const Json::Value& details = Json::nullValue);
+
+    // Счётчики с момента запуска
+    Json::Value stats() const;
+
+    // PostgreSQL отклоняет text с неверным UTF-8 или нулевым байтом, и вместе с ним -
+    // всю пачку: неверные байты заменяются на U+FFFD, нулевые выбрасываются.
+    // Обрезка не длиннее maxBytes и только по границе символа
+    static std::string sanitizeText(std::string_view text,
+                                    size_t maxBytes = std::numeric_limits<size_t>::max());
+
+private:
+    AuditLogger() = default;
+
+    struct Event {
+        std::string userId;
+        std::string action;
+        std::string resourceType;
+        std::string resourceId;
+        std::string details;     // сериализованный JSON или пусто
+        std::string ip;          // проверенный адрес или пусто
+        std::string userAgent;
+        double createdAt = 0;    // секунды Unix-времени с долями
+    };
+
+    void scheduleFlush();
+    // Выполняется в потоке queue_ (или в main при остановке)
+    void drain();
+    bool write(const std::vector<Event>& batch);
+
+    std::unique_ptr<MpmcQueue<Event>> ring_;
+    std::unique_ptr<trantor::ConcurrentTaskQueue> queue_;
+    std::atomic<bool> accepting_{false};
+    std::atomic<bool> flushing_{false};
+    std::atomic<int64_t> pending_{0};  // может кратко уйти в минус: чтение обгоняет учёт записи
+
+    std::atomic<uint64_t> recorded_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> batches_{0};
+
+    size_t batchSize_ = 500;
+    int64_t flushThreshold_ = 0;
+    size_t maxUserAgent_ = 512;
+    double flushIntervalSeconds_ = 1.0;
+};
@@ -0,0 +1,51 @@
+#include "AuthContext.h"
+#include <drogon/drogon.h>
+#include <jwt-cpp/jwt.h>
+
+using namespace drogon;
+
+namespace {
+
+// Тот же ключ, что в AuthController и остальных контроллерах
+const std::string kJwtSecret = "your-super-secret-jwt-key-change-in-production";
+const std::string kIdentityAttribute = "auth.identity";
+
+} // namespace
+
+bool AuthContext::verifyBearer(const std::string& authHeader, Identity& identity) {
+    if (authHeader.size() <= 7 || authHeader.compare(0, 7, "Bearer ") != 0) {
+        return false;
+    }
+
+    try {
+        auto decoded = jwt::decode(authHeader.substr(7));
+        jwt::verify()
+            .allow_algorithm(jwt::algorithm::hs256{kJwtSecret})
+            .with_issuer("auth-server")
+            .verify(decoded);
+
+        identity.userId = decoded.get_payload_claim("user_id").as_string();
+        if (decoded.has_payload_claim("role")) {
+            identity.role = decoded.get_payload_claim("role").as_string();
+        }
+        if (decoded.has_expires_at()) {
+            identity.expiresAt = decoded.get_expires_at();
+        }
+        return !identity.userId.empty();
+    } catch (const std::exception& e) {
+        LOG_DEBUG << "JWT validation error: " << e.what();
+        return false;
+    }
+}
+
+void AuthContext::attach(const HttpRequestPtr& req, const Identity& identity) {
+    req->attributes()->insert(kIdentityAttribute, identity);
+}
+
+const AuthContext::Identity* AuthContext::attached(const HttpRequestPtr& req) {
+    const auto& attributes = req->attributes();
+    if (!attributes->find(kIdentityAttribute)) {
+        return nullptr;
+    }
+    return &attributes->get<Identity>(kIdentityAttribute);
+}
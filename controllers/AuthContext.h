@@ -0,0 +1,27 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <chrono>
+#include <string>
+
+// Проверенная личность пользователя, прикреплённая к запросу.
+// /batch проверяет JWT один раз и передаёт результат во внутренние
+// подзапросы через атрибуты запроса (их нельзя задать снаружи), поэтому
+// контроллеры сначала смотрят сюда и только потом разбирают Authorization.
+class AuthContext {
+public:
+    struct Identity {
+        std::string userId;
+        std::string role;
+        // Срок токена (exp); без exp - без ограничения
+        std::chrono::system_clock::time_point expiresAt = std::chrono::system_clock::time_point::max();
+    };
+
+    // Проверка заголовка "Bearer <jwt>" тем же ключом и издателем, что и в контроллерах
+    static bool verifyBearer(const std::string& authHeader, Identity& identity);
+
+    static void attach(const drogon::HttpRequestPtr& req, const Identity& identity);
+
+    // nullptr, если личность не прикреплена
+    static const Identity* attached(const drogon::HttpRequestPtr& req);
+};
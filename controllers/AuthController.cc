@@ -1,4 +1,5 @@
 #include "AuthController.h"
+#include "ProfileCache.h"
 #include <drogon/drogon.h>
 #include <bcrypt/BCrypt.hpp>
 #include <jwt-cpp/jwt.h>
@@ -260,6 +261,7 @@ void AuthController::handleLogin(const HttpRequestPtr &req,
         // Обновляем last_login_at
         client->execSqlSync("UPDATE users SET last_login_at = $1 WHERE id = $2",
                             trantor::Date::date(), user.getValueOfId());
+        ProfileCache::instance().invalidate(user.getValueOfId());
 
         auto userJson = getUserResponse(user);
         std::string token = generateJWT(userJson);
@@ -371,6 +373,7 @@ void AuthController::handleGoogleAuth(const HttpRequestPtr &req,
             // Обновляем last_login_at для существующего пользователя
             client->execSqlSync("UPDATE users SET last_login_at = $1 WHERE id = $2",
                                 trantor::Date::date(), user.getValueOfId());
+            ProfileCache::instance().invalidate(user.getValueOfId());
         }
 
         auto userJson = getUserResponse(user);
@@ -0,0 +1,263 @@
+#include "BatchController.h"
+#include "AuthContext.h"
+#include "JsonStreamWriter.h"
+#include <drogon/drogon.h>
+#include <drogon/utils/Utilities.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace drogon;
+using namespace std;
+
+namespace {
+
+// Заголовки, которые подзапрос может передать (условные GET) и получить обратно
+const char* const kForwardedHeaders[] = {"If-None-Match", "If-Modified-Since"};
+const char* const kReturnedHeaders[] = {"ETag", "Last-Modified", "Cache-Control", "Location"};
+
+struct BatchItem {
+    string id;
+    HttpRequestPtr request;             // nullptr, если элемент отклонён без выполнения
+    HttpStatusCode status = k200OK;
+    HttpResponsePtr response;
+    string error;
+};
+
+struct BatchState {
+    vector<BatchItem> items;
+    atomic<size_t> remaining{0};
+    function<void(const HttpResponsePtr&)> callback;
+};
+
+size_t maxRequests() {
+    static const size_t limit =
+        app().getCustomConfig()["batch"].get("max_requests", 10).asUInt();
+    return limit;
+}
+
+// "/users/me/progress?course_id=5&x" -> путь + параметры
+HttpRequestPtr buildSubRequest(const string& target) {
+    auto sub = HttpRequest::newHttpRequest();
+    sub->setMethod(Get);
+
+    auto question = target.find('?');
+    sub->setPath(target.substr(0, question));
+    if (question == string::npos) {
+        return sub;
+    }
+
+    string query = target.substr(question + 1);
+    size_t pos = 0;
+    while (pos <= query.size()) {
+        size_t end = query.find('&', pos);
+        if (end == string::npos) {
+            end = query.size();
+        }
+        string pair = query.substr(pos, end - pos);
+        pos = end + 1;
+        if (pair.empty()) {
+            continue;
+        }
+        auto eq = pair.find('=');
+        string key = utils::urlDecode(pair.substr(0, eq));
+        string value = eq == string::npos ? "" : utils::urlDecode(pair.substr(eq + 1));
+        sub->setParameter(key, value);
+    }
+    return sub;
+}
+
+bool isAllowedPath(const string& target) {
+    if (target.empty() || target[0] != '/' || target.size() > 2048) {
+        return false;
+    }
+    string path = target.substr(0, target.find('?'));
+    // Вложенные пакеты не поддерживаются
+    return path != "/batch" && path.rfind("/batch/", 0) != 0;
+}
+
+// Элемент без ответа подзапроса: статус и {"error": ...}
+void writeError(JsonStreamWriter& writer, int status, const string& error) {
+    writer.key("status");
+    writer.intValue(status);
+    writer.key("headers");
+    writer.beginObject();
+    writer.endObject();
+    writer.key("body");
+    writer.beginObject();
+    writer.key("error");
+    writer.stringValue(error);
+    writer.endObject();
+    writer.endObject();
+}
+
+void writeItem(JsonStreamWriter& writer, const BatchItem& item) {
+    writer.beginObject();
+    writer.key("id");
+    writer.stringValue(item.id);
+
+    if (!item.response) {
+        writeError(writer, item.status, item.error);
+        return;
+    }
+
+    // В пакет встраивается только JSON: двоичное тело (CBOR, файл) или текст
+    // в другой кодировке сделали бы ответ пакета неверным JSON
+    const auto& resp = item.response;
+    const auto body = resp->body();
+    if (!body.empty() && resp->contentType() != CT_APPLICATION_JSON) {
+        writeError(writer, k415UnsupportedMediaType, "Sub-response is not JSON");
+        return;
+    }
+
+    writer.key("status");
+    writer.intValue(resp->statusCode());
+
+    writer.key("headers");
+    writer.beginObject();
+    for (const char* name : kReturnedHeaders) {
+        const auto& value = resp->getHeader(name);
+        if (!value.empty()) {
+            writer.key(name);
+            writer.stringValue(value);
+        }
+    }
+    writer.endObject();
+
+    writer.key("body");
+    if (body.empty()) {
+        writer.nullValue();
+    } else {
+        // Тело уже JSON - вставляется как есть, без повторного разбора
+        writer.rawValue(body);
+    }
+    writer.endObject();
+}
+
+void finish(const shared_ptr<BatchState>& state) {
+    size_t estimate = 32;
+    for (const auto& item : state->items) {
+        estimate += 96 + item.id.size() + (item.response ? item.response->body().size() : item.error.size());
+    }
+
+    JsonStreamWriter writer(estimate);
+    writer.beginObject();
+    writer.key("responses");
+    writer.beginArray();
+    for (const auto& item : state->items) {
+        writeItem(writer, item);
+    }
+    writer.endArray();
+    writer.endObject();
+
+    auto resp = writer.toResponse();
+    // Тело собрано из персональных ответов
+    resp->addHeader("Cache-Control", "private, no-store");
+    state->callback(resp);
+}
+
+} // namespace
+
+Json::Value BatchController::createJsonResponse(const string& key, const string& value) {
+    Json::Value json;
+    json[key] = value;
+    return json;
+}
+
+void BatchController::handleBatch(const HttpRequestPtr& req,
+                                  function<void(const HttpResponsePtr&)>&& callback) {
+    auto json = req->getJsonObject();
+    if (!json || !(*json)["requests"].isArray()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid JSON"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    const auto& requests = (*json)["requests"];
+    if (requests.empty() || requests.size() > maxRequests()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error",
+            "Batch must contain 1.." + to_string(maxRequests()) + " requests"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    // Токен проверяется один раз; без заголовка подзапросы выполняются анонимно
+    AuthContext::Identity identity;
+    const auto& authHeader = req->getHeader("Authorization");
+    bool authenticated = false;
+    if (!authHeader.empty()) {
+        if (!AuthContext::verifyBearer(authHeader, identity)) {
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Unauthorized"));
+            resp->setStatusCode(k401Unauthorized);
+            callback(resp);
+            return;
+        }
+        authenticated = true;
+    }
+
+    auto state = make_shared<BatchState>();
+    state->callback = move(callback);
+    state->items.resize(requests.size());
+
+    size_t pending = 0;
+    for (Json::ArrayIndex i = 0; i < requests.size(); ++i) {
+        const auto& entry = requests[i];
+        auto& item = state->items[i];
+        item.id = entry.isObject() && entry.isMember("id") ? entry["id"].asString() : to_string(i);
+
+        if (!entry.isObject() || !entry["path"].isString()) {
+            item.status = k400BadRequest;
+            item.error = "Missing path";
+            continue;
+        }
+        string method = entry.get("method", "GET").asString();
+        if (method != "GET") {
+            // Изменяющие запросы не объединяются: их порядок и повтор при ошибке важны
+            item.status = k405MethodNotAllowed;
+            item.error = "Only GET is allowed in batch";
+            continue;
+        }
+        string target = entry["path"].asString();
+        if (!isAllowedPath(target)) {
+            item.status = k400BadRequest;
+            item.error = "Invalid path";
+            continue;
+        }
+
+        item.request = buildSubRequest(target);
+        const auto& headers = entry["headers"];
+        if (headers.isObject()) {
+            for (const char* name : kForwardedHeaders) {
+                if (headers[name].isString()) {
+                    item.request->addHeader(name, headers[name].asString());
+                }
+            }
+        }
+        if (authenticated) {
+            AuthContext::attach(item.request, identity);
+        }
+        ++pending;
+    }
+
+    if (pending == 0) {
+        finish(state);
+        return;
+    }
+
+    // Счётчик выставляется до первой отправки: forward может ответить синхронно
+    state->remaining = pending;
+    for (auto& item : state->items) {
+        if (!item.request) {
+            continue;
+        }
+        BatchItem* slot = &item;
+        app().forward(item.request, [state, slot](const HttpResponsePtr& resp) {
+            slot->response = resp;
+            if (state->remaining.fetch_sub(1) == 1) {
+                finish(state);
+            }
+        });
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+#include <json/json.h>
+
+using namespace drogon;
+
+// Несколько GET-запросов к API за один HTTP-запрос.
+// Клиент на мобильной сети платит задержку один раз вместо N: подзапросы
+// передаются в существующие контроллеры через app().forward и выполняются
+// параллельно, ответы собираются в одно тело в порядке запроса.
+// JWT проверяется один раз, подзапросы получают личность через AuthContext.
+class BatchController : public drogon::HttpController<BatchController>
+{
+public:
+    METHOD_LIST_BEGIN
+        ADD_METHOD_TO(BatchController::handleBatch, "/batch", Post);
+    METHOD_LIST_END
+
+        void handleBatch(const HttpRequestPtr& req,
+                     std::function<void(const HttpResponsePtr&)>&& callback);
+
+private:
+    Json::Value createJsonResponse(const std::string& key, const std::string& value);
+};
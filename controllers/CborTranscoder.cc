@@ -0,0 +1,592 @@
+#include "CborTranscoder.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr uint8_t kMajorUnsigned = 0;
+constexpr uint8_t kMajorNegative = 1;
+constexpr uint8_t kMajorText = 3;
+constexpr uint8_t kMajorArray = 4;
+constexpr uint8_t kMajorMap = 5;
+
+constexpr char kIndefiniteArray = static_cast<char>(0x9f);
+constexpr char kIndefiniteMap = static_cast<char>(0xbf);
+constexpr char kBreak = static_cast<char>(0xff);
+constexpr char kFalse = static_cast<char>(0xf4);
+constexpr char kTrue = static_cast<char>(0xf5);
+constexpr char kNull = static_cast<char>(0xf6);
+
+void appendBigEndian(std::string& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+    }
+}
+
+void appendUtf8(std::string& out, uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        out.push_back(static_cast<char>(codepoint));
+    } else if (codepoint < 0x800) {
+        out.push_back(static_cast<char>(0xc0 | (codepoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+    } else if (codepoint < 0x10000) {
+        out.push_back(static_cast<char>(0xe0 | (codepoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+    } else {
+        out.push_back(static_cast<char>(0xf0 | (codepoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f)));
+        out.push_back(static_cast<char>(0x80 | (codepoint & 0x3f)));
+    }
+}
+
+// Рекурсивный спуск по JSON с записью CBOR прямо в выходной буфер
+class JsonToCbor {
+public:
+    JsonToCbor(std::string_view json, std::string& out) : json_(json), out_(out) {}
+
+    bool run() {
+        skipSpace();
+        if (!value(0)) {
+            return false;
+        }
+        skipSpace();
+        return pos_ == json_.size();
+    }
+
+private:
+    void skipSpace() {
+        while (pos_ < json_.size()) {
+            char c = json_[pos_];
+            if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+                break;
+            }
+            ++pos_;
+        }
+    }
+
+    bool literal(std::string_view word, char encoded) {
+        if (json_.compare(pos_, word.size(), word) != 0) {
+            return false;
+        }
+        pos_ += word.size();
+        out_.push_back(encoded);
+        return true;
+    }
+
+    bool value(int depth) {
+        if (pos_ >= json_.size() || depth > CborTranscoder::kMaxDepth) {
+            return false;
+        }
+        switch (json_[pos_]) {
+        case '{':
+            return object(depth);
+        case '[':
+            return array(depth);
+        case '"':
+            return string();
+        case 't':
+            return literal("true", kTrue);
+        case 'f':
+            return literal("false", kFalse);
+        case 'n':
+            return literal("null", kNull);
+        default:
+            return number();
+        }
+    }
+
+    bool object(int depth) {
+        ++pos_;
+        out_.push_back(kIndefiniteMap);
+        skipSpace();
+        if (pos_ < json_.size() && json_[pos_] == '}') {
+            ++pos_;
+            out_.push_back(kBreak);
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            if (pos_ >= json_.size() || json_[pos_] != '"' || !string()) {
+                return false;
+            }
+            skipSpace();
+            if (pos_ >= json_.size() || json_[pos_] != ':') {
+                return false;
+            }
+            ++pos_;
+            skipSpace();
+            if (!value(depth + 1)) {
+                return false;
+            }
+            skipSpace();
+            if (pos_ >= json_.size()) {
+                return false;
+            }
+            if (json_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (json_[pos_] == '}') {
+                ++pos_;
+                out_.push_back(kBreak);
+                return true;
+            }
+            return false;
+        }
+    }
+
+    bool array(int depth) {
+        ++pos_;
+        out_.push_back(kIndefiniteArray);
+        skipSpace();
+        if (pos_ < json_.size() && json_[pos_] == ']') {
+            ++pos_;
+            out_.push_back(kBreak);
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            if (!value(depth + 1)) {
+                return false;
+            }
+            skipSpace();
+            if (pos_ >= json_.size()) {
+                return false;
+            }
+            if (json_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            if (json_[pos_] == ']') {
+                ++pos_;
+                out_.push_back(kBreak);
+                return true;
+            }
+            return false;
+        }
+    }
+
+    bool hex4(uint32_t& value) {
+        if (pos_ + 4 > json_.size()) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = json_[pos_++];
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool string() {
+        ++pos_;
+        size_t start = pos_;
+
+        // Быстрый путь: строка без экранирования копируется как есть
+        while (pos_ < json_.size() && json_[pos_] != '"' && json_[pos_] != '\\') {
+            ++pos_;
+        }
+        if (pos_ >= json_.size()) {
+            return false;
+        }
+        if (json_[pos_] == '"') {
+            CborTranscoder::writeText(out_, json_.substr(start, pos_ - start));
+            ++pos_;
+            return true;
+        }
+
+        // Есть экранирование: сначала раскрываем, длина нужна до байтов строки
+        scratch_.assign(json_.data() + start, pos_ - start);
+        while (pos_ < json_.size()) {
+            char c = json_[pos_++];
+            if (c == '"') {
+                CborTranscoder::writeText(out_, scratch_);
+                return true;
+            }
+            if (c != '\\') {
+                scratch_.push_back(c);
+                continue;
+            }
+            if (pos_ >= json_.size()) {
+                return false;
+            }
+            char escaped = json_[pos_++];
+            switch (escaped) {
+            case '"': scratch_.push_back('"'); break;
+            case '\\': scratch_.push_back('\\'); break;
+            case '/': scratch_.push_back('/'); break;
+            case 'b': scratch_.push_back('\b'); break;
+            case 'f': scratch_.push_back('\f'); break;
+            case 'n': scratch_.push_back('\n'); break;
+            case 'r': scratch_.push_back('\r'); break;
+            case 't': scratch_.push_back('\t'); break;
+            case 'u': {
+                uint32_t codepoint;
+                if (!hex4(codepoint)) {
+                    return false;
+                }
+                // Суррогатная пара (символы вне BMP)
+                if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
+                    uint32_t low;
+                    if (pos_ + 2 > json_.size() || json_[pos_] != '\\' || json_[pos_ + 1] != 'u') {
+                        return false;
+                    }
+                    pos_ += 2;
+                    if (!hex4(low) || low < 0xdc00 || low > 0xdfff) {
+                        return false;
+                    }
+                    codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                }
+                appendUtf8(scratch_, codepoint);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool number() {
+        size_t start = pos_;
+        bool integral = true;
+        if (pos_ < json_.size() && json_[pos_] == '-') {
+            ++pos_;
+        }
+        while (pos_ < json_.size()) {
+            char c = json_[pos_];
+            if (c >= '0' && c <= '9') {
+                ++pos_;
+            } else if (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                integral = false;
+                ++pos_;
+            } else {
+                break;
+            }
+        }
+        if (pos_ == start) {
+            return false;
+        }
+
+        const char* first = json_.data() + start;
+        const char* last = json_.data() + pos_;
+        if (integral) {
+            int64_t value;
+            auto result = std::from_chars(first, last, value);
+            if (result.ec == std::errc() && result.ptr == last) {
+                CborTranscoder::writeInteger(out_, value);
+                return true;
+            }
+            uint64_t unsignedValue;
+            result = std::from_chars(first, last, unsignedValue);
+            if (result.ec == std::errc() && result.ptr == last) {
+                CborTranscoder::writeHead(out_, kMajorUnsigned, unsignedValue);
+                return true;
+            }
+            // Не помещается в 64 бита - пишем как double
+        }
+
+        // from_chars для double есть не во всех стандартных библиотеках
+        std::string text(first, last);
+        char* end = nullptr;
+        double value = std::strtod(text.c_str(), &end);
+        if (end != text.c_str() + text.size()) {
+            return false;
+        }
+        CborTranscoder::writeDouble(out_, value);
+        return true;
+    }
+
+    std::string_view json_;
+    std::string& out_;
+    std::string scratch_;
+    size_t pos_ = 0;
+};
+
+// Разбор CBOR в Json::Value
+class CborToJson {
+public:
+    explicit CborToJson(std::string_view cbor) : cbor_(cbor) {}
+
+    bool run(Json::Value& out) {
+        return item(out, 0) && pos_ == cbor_.size();
+    }
+
+private:
+    bool byte(uint8_t& value) {
+        if (pos_ >= cbor_.size()) {
+            return false;
+        }
+        value = static_cast<uint8_t>(cbor_[pos_++]);
+        return true;
+    }
+
+    bool argument(uint8_t info, uint64_t& value) {
+        if (info < 24) {
+            value = info;
+            return true;
+        }
+        int bytes = info == 24 ? 1 : info == 25 ? 2 : info == 26 ? 4 : info == 27 ? 8 : 0;
+        if (bytes == 0 || pos_ + bytes > cbor_.size()) {
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | static_cast<uint8_t>(cbor_[pos_++]);
+        }
+        return true;
+    }
+
+    bool isBreak() const {
+        return pos_ < cbor_.size() && cbor_[pos_] == kBreak;
+    }
+
+    bool text(uint8_t info, std::string& out) {
+        if (info == 31) {
+            // Строка по частям: набор определённых кусков до 0xff
+            while (!isBreak()) {
+                uint8_t initial;
+                uint64_t length;
+                if (!byte(initial) || (initial >> 5) != kMajorText || !argument(initial & 0x1f, length) ||
+                    length > cbor_.size() - pos_) {
+                    return false;
+                }
+                out.append(cbor_.data() + pos_, length);
+                pos_ += length;
+            }
+            ++pos_;
+            return true;
+        }
+        uint64_t length;
+        if (!argument(info, length) || length > cbor_.size() - pos_) {
+            return false;
+        }
+        out.assign(cbor_.data() + pos_, length);
+        pos_ += length;
+        return true;
+    }
+
+    static double halfToDouble(uint16_t half) {
+        int exponent = (half >> 10) & 0x1f;
+        int mantissa = half & 0x3ff;
+        double value;
+        if (exponent == 0) {
+            value = std::ldexp(mantissa, -24);
+        } else if (exponent != 31) {
+            value = std::ldexp(mantissa + 1024, exponent - 25);
+        } else {
+            value = mantissa == 0 ? INFINITY : NAN;
+        }
+        return (half & 0x8000) ? -value : value;
+    }
+
+    bool item(Json::Value& out, int depth) {
+        if (depth > CborTranscoder::kMaxDepth) {
+            return false;
+        }
+        uint8_t initial;
+        if (!byte(initial)) {
+            return false;
+        }
+        uint8_t major = initial >> 5;
+        uint8_t info = initial & 0x1f;
+        uint64_t value = 0;
+
+        switch (major) {
+        case kMajorUnsigned:
+            if (!argument(info, value)) {
+                return false;
+            }
+            // Как в Json::Reader: знаковый тип, пока значение помещается
+            if (value <= static_cast<uint64_t>(INT64_MAX)) {
+                out = Json::Value(static_cast<Json::Int64>(value));
+            } else {
+                out = Json::Value(static_cast<Json::UInt64>(value));
+            }
+            return true;
+        case kMajorNegative:
+            if (!argument(info, value)) {
+                return false;
+            }
+            out = Json::Value(static_cast<Json::Int64>(-1 - static_cast<int64_t>(value)));
+            return true;
+        case 2:
+        case kMajorText: {
+            // Байтовые строки в наших ответах не встречаются, читаем как текст
+            std::string textValue;
+            if (!text(info, textValue)) {
+                return false;
+            }
+            out = Json::Value(textValue);
+            return true;
+        }
+        case kMajorArray: {
+            out = Json::Value(Json::arrayValue);
+            bool indefinite = info == 31;
+            if (!indefinite && !argument(info, value)) {
+                return false;
+            }
+            for (uint64_t i = 0; indefinite ? !isBreak() : i < value; ++i) {
+                Json::Value element;
+                if (!item(element, depth + 1)) {
+                    return false;
+                }
+                out.append(std::move(element));
+            }
+            if (indefinite) {
+                if (!isBreak()) {
+                    return false;
+                }
+                ++pos_;
+            }
+            return true;
+        }
+        case kMajorMap: {
+            out = Json::Value(Json::objectValue);
+            bool indefinite = info == 31;
+            if (!indefinite && !argument(info, value)) {
+                return false;
+            }
+            for (uint64_t i = 0; indefinite ? !isBreak() : i < value; ++i) {
+                Json::Value key;
+                Json::Value element;
+                if (!item(key, depth + 1) || !key.isString() || !item(element, depth + 1)) {
+                    return false;
+                }
+                out[key.asString()] = std::move(element);
+            }
+            if (indefinite) {
+                if (!isBreak()) {
+                    return false;
+                }
+                ++pos_;
+            }
+            return true;
+        }
+        case 6:
+            // Теги (дата и т.п.) пропускаем, значение берём как есть
+            return argument(info, value) && item(out, depth + 1);
+        default:
+            break;
+        }
+
+        // major 7: простые значения и числа с плавающей точкой
+        switch (info) {
+        case 20:
+            out = Json::Value(false);
+            return true;
+        case 21:
+            out = Json::Value(true);
+            return true;
+        case 22:
+        case 23:
+            out = Json::Value(Json::nullValue);
+            return true;
+        case 25: {
+            if (!argument(info, value)) {
+                return false;
+            }
+            out = Json::Value(halfToDouble(static_cast<uint16_t>(value)));
+            return true;
+        }
+        case 26: {
+            if (!argument(info, value)) {
+                return false;
+            }
+            uint32_t bits = static_cast<uint32_t>(value);
+            float number;
+            std::memcpy(&number, &bits, sizeof(number));
+            out = Json::Value(static_cast<double>(number));
+            return true;
+        }
+        case 27: {
+            if (!argument(info, value)) {
+                return false;
+            }
+            double number;
+            std::memcpy(&number, &value, sizeof(number));
+            out = Json::Value(number);
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    std::string_view cbor_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+void CborTranscoder::writeHead(std::string& out, uint8_t major, uint64_t value) {
+    uint8_t type = static_cast<uint8_t>(major << 5);
+    if (value < 24) {
+        out.push_back(static_cast<char>(type | value));
+    } else if (value <= 0xff) {
+        out.push_back(static_cast<char>(type | 24));
+        appendBigEndian(out, value, 1);
+    } else if (value <= 0xffff) {
+        out.push_back(static_cast<char>(type | 25));
+        appendBigEndian(out, value, 2);
+    } else if (value <= 0xffffffffULL) {
+        out.push_back(static_cast<char>(type | 26));
+        appendBigEndian(out, value, 4);
+    } else {
+        out.push_back(static_cast<char>(type | 27));
+        appendBigEndian(out, value, 8);
+    }
+}
+
+void CborTranscoder::writeText(std::string& out, std::string_view text) {
+    writeHead(out, kMajorText, text.size());
+    out.append(text.data(), text.size());
+}
+
+void CborTranscoder::writeInteger(std::string& out, int64_t value) {
+    if (value >= 0) {
+        writeHead(out, kMajorUnsigned, static_cast<uint64_t>(value));
+    } else {
+        // -1 - n без переполнения для INT64_MIN
+        writeHead(out, kMajorNegative, ~static_cast<uint64_t>(value));
+    }
+}
+
+void CborTranscoder::writeDouble(std::string& out, double value) {
+    // Рейтинги и цены обычно точно представимы во float32 - 5 байт вместо 9
+    float narrow = static_cast<float>(value);
+    if (static_cast<double>(narrow) == value || std::isnan(value)) {
+        uint32_t bits;
+        std::memcpy(&bits, &narrow, sizeof(bits));
+        out.push_back(static_cast<char>(0xfa));
+        appendBigEndian(out, bits, 4);
+        return;
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    out.push_back(static_cast<char>(0xfb));
+    appendBigEndian(out, bits, 8);
+}
+
+bool CborTranscoder::fromJson(std::string_view json, std::string& out) {
+    // CBOR обычно заметно короче исходного JSON
+    out.reserve(out.size() + json.size());
+    return JsonToCbor(json, out).run();
+}
+
+bool CborTranscoder::toJsonValue(std::string_view cbor, Json::Value& out) {
+    return CborToJson(cbor).run(out);
+}
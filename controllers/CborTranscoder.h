@@ -0,0 +1,28 @@
+#pragma once
+
+#include <json/json.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Перекодирование готового JSON-текста в CBOR (RFC 8949) за один проход без
+// промежуточного дерева: массивы и объекты пишутся с неопределённой длиной
+// (0x9f/0xbf ... 0xff), поэтому количество элементов заранее знать не нужно.
+// Целые числа - major type 0/1, дробные - float32, если представимы точно,
+// иначе float64. Обратное преобразование нужно для проверок и бенчмарка.
+class CborTranscoder {
+public:
+    // false при синтаксической ошибке JSON или слишком глубокой вложенности
+    static bool fromJson(std::string_view json, std::string& out);
+
+    // Разбор CBOR (определённые и неопределённые длины) в Json::Value
+    static bool toJsonValue(std::string_view cbor, Json::Value& out);
+
+    // Примитивы записи, чтобы CBOR можно было строить и без JSON
+    static void writeHead(std::string& out, uint8_t major, uint64_t value);
+    static void writeText(std::string& out, std::string_view text);
+    static void writeInteger(std::string& out, int64_t value);
+    static void writeDouble(std::string& out, double value);
+
+    static constexpr int kMaxDepth = 256;
+};
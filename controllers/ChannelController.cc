@@ -1,4 +1,12 @@
 #include "ChannelController.h"
+#include "AuthContext.h"
+#include "DbRouter.h"
+#include "ImageService.h"
+#include "JsonStreamWriter.h"
+#include "FieldSelection.h"
+#include "FeedService.h"
+#include "HttpCache.h"
+#include "ProfileCache.h"
 #include <drogon/HttpResponse.h>
 #include <drogon/utils/Utilities.h>
 #include <drogon/drogon.h>
@@ -9,6 +17,72 @@ using namespace drogon;
 using namespace drogon::orm;
 using namespace std;
 
+namespace {
+
+// Курс в списке канала: цена и рейтинг числами, без author_id
+const JsonRowLayout& channelCourseLayout() {
+    static const JsonRowLayout layout({
+        {"id", JsonColumnKind::String},
+        {"title", JsonColumnKind::String},
+        {"description", JsonColumnKind::String},
+        {"category", JsonColumnKind::String},
+        {"level", JsonColumnKind::String},
+        {"language", JsonColumnKind::String},
+        {"chapters_count", JsonColumnKind::Integer},
+        {"videos_count", JsonColumnKind::Integer},
+        {"total_views", JsonColumnKind::Integer},
+        {"total_likes", JsonColumnKind::Integer},
+        {"price", JsonColumnKind::DecimalNumber},
+        {"is_paid", JsonColumnKind::Boolean},
+        {"is_published", JsonColumnKind::Boolean},
+        {"is_public", JsonColumnKind::Boolean},
+        {"rating", JsonColumnKind::DecimalNumber},
+        {"cover_path", JsonColumnKind::NullableString},
+        {"cover_variants", "cover_path", ImageService::writeVariants},
+        {"icon_path", JsonColumnKind::NullableString},
+        {"tags", JsonColumnKind::JsonArray},
+        {"created_at", JsonColumnKind::Timestamp},
+        {"updated_at", JsonColumnKind::Timestamp},
+        {"last_accessed_at", JsonColumnKind::Timestamp},
+    });
+    return layout;
+}
+
+// Публичная карточка канала: contacts и information - уже отфильтрованные
+// триггером public_contacts и public_information
+const JsonRowLayout& channelProfileLayout() {
+    static const JsonRowLayout layout({
+        {"id", JsonColumnKind::String},
+        {"username", JsonColumnKind::String},
+        {"role", JsonColumnKind::String},
+        {"profile_is_public", JsonColumnKind::Boolean},
+        {"avatar_path", JsonColumnKind::NullableString},
+        {"avatar_variants", "avatar_path", ImageService::writeVariants},
+        {"cover_path", JsonColumnKind::NullableString},
+        {"cover_variants", "cover_path", ImageService::writeVariants},
+        {"contacts", JsonColumnKind::JsonArray},
+        {"information", JsonColumnKind::JsonArray},
+        {"created_at", JsonColumnKind::Timestamp},
+        {"last_login_at", JsonColumnKind::Timestamp},
+    });
+    return layout;
+}
+
+const JsonKey kStatsKey("stats");
+const char* const kStatsColumns[] = {
+    "subscribers_count", "completed_courses", "study_hours",
+    "created_courses", "total_likes", "total_views",
+};
+
+const JsonKey kCoursesKey("courses");
+
+const FieldSelection& channelCourseFields() {
+    static const auto selection = FieldSelection::forModel<Courses>(channelCourseLayout());
+    return selection;
+}
+
+} // namespace
+
 // Вспомогательная функция для создания JSON ответов
 Json::Value ChannelController::createJsonResponse(const string& key, const string& value) {
     Json::Value json;
@@ -24,6 +98,11 @@ bool ChannelController::isValidUUID(const string& uuid) {
 
 // JWT аутентификация
 string ChannelController::getCurrentUserId(const HttpRequestPtr& req) {
+    // Подзапрос /batch: токен уже проверен
+    if (auto identity = AuthContext::attached(req)) {
+        return identity->userId;
+    }
+
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
         return "";
@@ -108,6 +187,10 @@ string ChannelController::getRoleFromToken(const string& token) {
 }
 
 bool ChannelController::hasPermission(const HttpRequestPtr& req, const vector<string>& allowedRoles) {
+    if (auto identity = AuthContext::attached(req)) {
+        return find(allowedRoles.begin(), allowedRoles.end(), identity->role) != allowedRoles.end();
+    }
+
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
         return false;
@@ -119,220 +202,6 @@ bool ChannelController::hasPermission(const HttpRequestPtr& req, const vector<st
     return find(allowedRoles.begin(), allowedRoles.end(), userRole) != allowedRoles.end();
 }
 
-// Вспомогательный метод для создания JSON ответа пользователя
-Json::Value ChannelController::getUserJsonResponse(const Users& user) {
-    Json::Value userJson;
-
-    try {
-        userJson["id"] = user.getValueOfId();
-        userJson["username"] = user.getValueOfUsername();
-        userJson["role"] = user.getValueOfRole();
-        userJson["profile_is_public"] = user.getValueOfProfileIsPublic();
-
-        // Обработка nullable полей
-        try {
-            string avatarPath = user.getValueOfAvatarPath();
-            if (!avatarPath.empty()) {
-                userJson["avatar_path"] = avatarPath;
-            } else {
-                userJson["avatar_path"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            userJson["avatar_path"] = Json::nullValue;
-        }
-
-        try {
-            string coverPath = user.getValueOfCoverPath();
-            if (!coverPath.empty()) {
-                userJson["cover_path"] = coverPath;
-            } else {
-                userJson["cover_path"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            userJson["cover_path"] = Json::nullValue;
-        }
-
-        // Парсим JSON поля
-        try {
-            string contactsStr = user.getValueOfContacts();
-            if (!contactsStr.empty()) {
-                Json::Value contacts;
-                Json::Reader reader;
-                if (reader.parse(contactsStr, contacts)) {
-                    // Фильтруем только публичные контакты для канала
-                    Json::Value publicContacts(Json::arrayValue);
-                    for (const auto& contact : contacts) {
-                        if (contact.isMember("is_public") && contact["is_public"].asBool()) {
-                            Json::Value publicContact;
-                            publicContact["name"] = contact["name"];
-                            publicContact["url"] = contact["url"];
-                            if (contact.isMember("icon")) {
-                                publicContact["icon"] = contact["icon"];
-                            }
-                            publicContacts.append(publicContact);
-                        }
-                    }
-                    userJson["contacts"] = publicContacts;
-                } else {
-                    userJson["contacts"] = Json::arrayValue;
-                }
-            } else {
-                userJson["contacts"] = Json::arrayValue;
-            }
-        } catch (const exception& e) {
-            userJson["contacts"] = Json::arrayValue;
-        }
-
-        try {
-            string informationStr = user.getValueOfInformation();
-            if (!informationStr.empty()) {
-                Json::Value information;
-                Json::Reader reader;
-                if (reader.parse(informationStr, information)) {
-                    // Фильтруем только публичную информацию для канала
-                    Json::Value publicInformation(Json::arrayValue);
-                    for (const auto& info : information) {
-                        if (info.isMember("is_public") && info["is_public"].asBool()) {
-                            Json::Value publicInfo;
-                            publicInfo["label"] = info["label"];
-                            publicInfo["value"] = info["value"];
-                            publicInformation.append(publicInfo);
-                        }
-                    }
-                    userJson["information"] = publicInformation;
-                } else {
-                    userJson["information"] = Json::arrayValue;
-                }
-            } else {
-                userJson["information"] = Json::arrayValue;
-            }
-        } catch (const exception& e) {
-            userJson["information"] = Json::arrayValue;
-        }
-
-        userJson["created_at"] = user.getValueOfCreatedAt().toDbStringLocal();
-
-        try {
-            auto lastLogin = user.getValueOfLastLoginAt();
-            if (lastLogin != trantor::Date()) {
-                userJson["last_login_at"] = lastLogin.toDbStringLocal();
-            } else {
-                userJson["last_login_at"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            userJson["last_login_at"] = Json::nullValue;
-        }
-
-    } catch (const exception& e) {
-        LOG_ERROR << "Error creating user JSON response: " << e.what();
-    }
-
-    return userJson;
-}
-
-// Вспомогательный метод для создания JSON ответа курса
-Json::Value ChannelController::getCourseJsonResponse(const Courses& course) {
-    Json::Value courseJson;
-
-    try {
-        courseJson["id"] = course.getValueOfId();
-        courseJson["title"] = course.getValueOfTitle();
-
-        // Исправлено: проверяем описание на пустоту
-        string description = course.getValueOfDescription();
-        courseJson["description"] = description.empty() ? "" : description;
-
-        courseJson["category"] = course.getValueOfCategory();
-        courseJson["level"] = course.getValueOfLevel();
-        courseJson["language"] = course.getValueOfLanguage();
-
-        courseJson["chapters_count"] = course.getValueOfChaptersCount();
-        courseJson["videos_count"] = course.getValueOfVideosCount();
-        courseJson["total_views"] = course.getValueOfTotalViews();
-        courseJson["total_likes"] = course.getValueOfTotalLikes();
-
-        // Исправлено: преобразуем цену и рейтинг
-        try {
-            string priceStr = course.getValueOfPrice();
-            courseJson["price"] = priceStr.empty() ? 0.0 : stod(priceStr);
-        } catch (const exception& e) {
-            courseJson["price"] = 0.0;
-        }
-
-        courseJson["is_paid"] = course.getValueOfIsPaid();
-        courseJson["is_published"] = course.getValueOfIsPublished();
-        courseJson["is_public"] = course.getValueOfIsPublic();
-
-        // Исправлено: преобразуем рейтинг
-        try {
-            string ratingStr = course.getValueOfRating();
-            courseJson["rating"] = ratingStr.empty() ? 0.0 : stod(ratingStr);
-        } catch (const exception& e) {
-            courseJson["rating"] = 0.0;
-        }
-
-        // Обработка nullable полей
-        try {
-            string coverPath = course.getValueOfCoverPath();
-            if (!coverPath.empty()) {
-                courseJson["cover_path"] = coverPath;
-            } else {
-                courseJson["cover_path"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            courseJson["cover_path"] = Json::nullValue;
-        }
-
-        try {
-            string iconPath = course.getValueOfIconPath();
-            if (!iconPath.empty()) {
-                courseJson["icon_path"] = iconPath;
-            } else {
-                courseJson["icon_path"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            courseJson["icon_path"] = Json::nullValue;
-        }
-
-        // Парсим теги
-        try {
-            string tagsStr = course.getValueOfTags();
-            if (!tagsStr.empty()) {
-                Json::Value tags;
-                Json::Reader reader;
-                if (reader.parse(tagsStr, tags)) {
-                    courseJson["tags"] = tags;
-                } else {
-                    courseJson["tags"] = Json::arrayValue;
-                }
-            } else {
-                courseJson["tags"] = Json::arrayValue;
-            }
-        } catch (const exception& e) {
-            courseJson["tags"] = Json::arrayValue;
-        }
-
-        courseJson["created_at"] = course.getValueOfCreatedAt().toDbStringLocal();
-        courseJson["updated_at"] = course.getValueOfUpdatedAt().toDbStringLocal();
-
-        try {
-            auto lastAccessed = course.getValueOfLastAccessedAt();
-            if (lastAccessed != trantor::Date()) {
-                courseJson["last_accessed_at"] = lastAccessed.toDbStringLocal();
-            } else {
-                courseJson["last_accessed_at"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            courseJson["last_accessed_at"] = Json::nullValue;
-        }
-
-    } catch (const exception& e) {
-        LOG_ERROR << "Error creating course JSON response: " << e.what();
-    }
-
-    return courseJson;
-}
-
 // Получить информацию о канале
 void ChannelController::getChannelInfo(const HttpRequestPtr& req,
                                        function<void(const HttpResponsePtr&)>&& callback,
@@ -346,18 +215,38 @@ void ChannelController::getChannelInfo(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
     string currentUserId = getCurrentUserId(req);
     bool isOwner = (currentUserId == channelId);
     bool hasAdminAccess = hasPermission(req, {"основатель", "админ"});
 
+    auto& cache = ProfileCache::instance();
+    if (auto cached = cache.find(ProfileCache::View::Channel, channelId)) {
+        if (!cached->isPublic && !isOwner && !hasAdminAccess) {
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Channel is private"));
+            resp->setStatusCode(k403Forbidden);
+            callback(resp);
+            return;
+        }
+        callback(ProfileCache::respond(req, *cached, "channel", currentUserId));
+        return;
+    }
+
+    auto ticket = cache.ticket(channelId);
+    auto dbClient = app().getDbClient();
+
+    // Версия канала - время изменения профиля и его статистики (оба обновляются триггерами)
     dbClient->execSqlAsync(
-        "SELECT u.*, us.subscribers_count, us.completed_courses, us.study_hours, "
-        "us.created_courses, us.total_likes, us.total_views "
+        "SELECT u.id, u.username, u.role, u.profile_is_public, u.avatar_path, u.cover_path, "
+        "u.public_contacts AS contacts, u.public_information AS information, u.created_at, u.last_login_at, "
+        "us.subscribers_count, us.completed_courses, us.study_hours, "
+        "us.created_courses, us.total_likes, us.total_views, "
+        "(EXTRACT(EPOCH FROM u.updated_at) * 1000000)::bigint AS etag_user_version, "
+        "COALESCE((EXTRACT(EPOCH FROM us.updated_at) * 1000000)::bigint, 0) AS etag_stats_version, "
+        "EXTRACT(EPOCH FROM GREATEST(u.updated_at, us.updated_at))::bigint AS etag_modified_at "
         "FROM users u "
         "LEFT JOIN user_stats us ON u.id = us.user_id "
         "WHERE u.id = $1",
-        [callback, isOwner, hasAdminAccess, this](const Result& result) {
+        [req, callback, channelId, currentUserId, isOwner, hasAdminAccess, ticket, this](const Result& result) {
             if (result.empty()) {
                 auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Channel not found"));
                 resp->setStatusCode(k404NotFound);
@@ -366,32 +255,40 @@ void ChannelController::getChannelInfo(const HttpRequestPtr& req,
             }
 
             try {
-                auto user = Users(result[0]);
-
-                // Проверяем доступ к каналу
-                bool isPublic = user.getValueOfProfileIsPublic();
-                if (!isPublic && !isOwner && !hasAdminAccess) {
-                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Channel is private"));
-                    resp->setStatusCode(k403Forbidden);
-                    callback(resp);
-                    return;
+                const auto& row = result[0];
+                const auto& layout = channelProfileLayout();
+                auto binding = layout.bind(result);
+
+                // Создаем ответ с информацией о канале и статистикой
+                JsonStreamWriter writer(layout.estimateSize(result, binding) + 192);
+                writer.beginObject();
+                layout.writeFields(writer, row, binding);
+                if (!row["subscribers_count"].isNull()) {
+                    writer.key(kStatsKey);
+                    writer.beginObject();
+                    for (const char* column : kStatsColumns) {
+                        writer.key(column);
+                        writer.intValue(row[column].as<int64_t>());
+                    }
+                    writer.endObject();
                 }
-
-                // Создаем ответ с информацией о канале
-                Json::Value channelInfo = getUserJsonResponse(user);
-
-                // Добавляем статистику
-                if (!result[0]["subscribers_count"].isNull()) {
-                    channelInfo["stats"] = Json::Value();
-                    channelInfo["stats"]["subscribers_count"] = result[0]["subscribers_count"].as<int>();
-                    channelInfo["stats"]["completed_courses"] = result[0]["completed_courses"].as<int>();
-                    channelInfo["stats"]["study_hours"] = result[0]["study_hours"].as<int>();
-                    channelInfo["stats"]["created_courses"] = result[0]["created_courses"].as<int>();
-                    channelInfo["stats"]["total_likes"] = result[0]["total_likes"].as<int>();
-                    channelInfo["stats"]["total_views"] = result[0]["total_views"].as<int>();
+                writer.endObject();
+
+                ProfileCache::Entry entry;
+                entry.body = writer.release();
+                entry.version = row["etag_user_version"].as<string>() + "." + row["etag_stats_version"].as<string>();
+                entry.modifiedAt = row["etag_modified_at"].as<int64_t>();
+                entry.isPublic = !row["profile_is_public"].isNull() && row["profile_is_public"].as<bool>();
+
+                // Проверяем доступ к каналу; карточка кешируется в любом случае
+                HttpResponsePtr resp;
+                if (!entry.isPublic && !isOwner && !hasAdminAccess) {
+                    resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Channel is private"));
+                    resp->setStatusCode(k403Forbidden);
+                } else {
+                    resp = ProfileCache::respond(req, entry, "channel", currentUserId);
                 }
-
-                auto resp = HttpResponse::newHttpJsonResponse(channelInfo);
+                ProfileCache::instance().store(ProfileCache::View::Channel, channelId, {}, ticket, std::move(entry));
                 callback(resp);
 
             } catch (const exception& e) {
@@ -432,6 +329,18 @@ void ChannelController::getChannelCourses(const HttpRequestPtr& req,
     string level = paramsMap.find("level") != paramsMap.end() ? paramsMap["level"] : "";
     string sortBy = paramsMap.find("sort_by") != paramsMap.end() ? paramsMap["sort_by"] : "created_at";
     string sortOrder = paramsMap.find("sort_order") != paramsMap.end() ? paramsMap["sort_order"] : "desc";
+    string fields = paramsMap.find("fields") != paramsMap.end() ? paramsMap["fields"] : "";
+
+    FieldSelection::Projection projection;
+    string fieldsError;
+    if (!channelCourseFields().select(fields, {}, projection, fieldsError)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", fieldsError));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+    auto layoutPtr = projection.layout;
+    string courseColumns = projection.columns;
 
     // Валидация параметров
     int page, limit;
@@ -450,14 +359,33 @@ void ChannelController::getChannelCourses(const HttpRequestPtr& req,
     int offset = (page - 1) * limit;
 
     // Проверяем существование канала и его доступность
-    auto dbClient = app().getDbClient();
     string currentUserId = getCurrentUserId(req);
+    auto dbClient = DbRouter::instance().reader(req, currentUserId);
     bool isOwner = (currentUserId == channelId);
     bool hasAdminAccess = hasPermission(req, {"основатель", "админ"});
 
+    // Готовая страница в ProfileCache отдаётся, если отпечаток курсов не изменился
+    string pageVariant = string(isOwner || hasAdminAccess ? "all" : "public") + '\x1f' +
+                         to_string(page) + '\x1f' + to_string(limit) + '\x1f' + category + '\x1f' + level + '\x1f' +
+                         sortBy + '\x1f' + sortOrder + '\x1f' + fields;
+    auto ticket = ProfileCache::instance().ticket(channelId);
+
+    // Вместе с доступностью канала читаем отпечаток его курсов: количество,
+    // сумму версий и время последнего изменения (по индексу idx_courses_author_id).
+    // counters_version входит в сумму: страница показывает счётчики и рейтинг
+    // и сортируется по ним
     dbClient->execSqlAsync(
-        "SELECT profile_is_public FROM users WHERE id = $1",
-        [callback, channelId, isOwner, hasAdminAccess, category, level, sortBy, sortOrder, page, limit, offset, dbClient, this](
+        "SELECT u.profile_is_public, v.courses_count, v.versions_sum, v.last_change, v.modified_at "
+        "FROM users u, LATERAL ("
+        "    SELECT COUNT(*) AS courses_count, "
+        "           COALESCE(SUM(content_version + counters_version), 0) AS versions_sum, "
+        "           COALESCE((EXTRACT(EPOCH FROM MAX(GREATEST(content_updated_at, counters_updated_at))) * 1000000)::bigint, 0) AS last_change, "
+        "           COALESCE(EXTRACT(EPOCH FROM MAX(GREATEST(content_updated_at, counters_updated_at)))::bigint, 0) AS modified_at "
+        "    FROM courses WHERE author_id = u.id"
+        ") v "
+        "WHERE u.id = $1",
+        [req, callback, channelId, currentUserId, isOwner, hasAdminAccess, category, level, sortBy, sortOrder, page, limit, offset, dbClient,
+         layoutPtr, courseColumns, pageVariant, ticket, this](
             const Result& userResult) {
 
             if (userResult.empty()) {
@@ -476,8 +404,26 @@ void ChannelController::getChannelCourses(const HttpRequestPtr& req,
                 return;
             }
 
+            const auto& fingerprint = userResult[0];
+            string version = fingerprint["courses_count"].as<string>() + "." +
+                             fingerprint["versions_sum"].as<string>() + "." +
+                             fingerprint["last_change"].as<string>();
+            int64_t modifiedAt = fingerprint["modified_at"].as<int64_t>();
+
+            auto cached = ProfileCache::instance().find(ProfileCache::View::ChannelCourses, channelId, pageVariant);
+            if (cached && cached->version == version) {
+                callback(ProfileCache::respond(req, *cached, "channel-courses", currentUserId));
+                return;
+            }
+
+            auto validator = HttpCache::versioned(req, "channel-courses", version, modifiedAt, currentUserId);
+            if (HttpCache::isNotModified(req, validator)) {
+                callback(HttpCache::notModified(validator));
+                return;
+            }
+
             // Строим SQL запрос для курсов
-            string sql = "SELECT * FROM courses WHERE author_id = $1 ";
+            string sql = "SELECT " + courseColumns + " FROM courses WHERE author_id = $1 ";
             vector<string> params = {channelId};
 
             // Определяем условия видимости курсов
@@ -517,44 +463,48 @@ void ChannelController::getChannelCourses(const HttpRequestPtr& req,
             params.push_back(to_string(offset));
 
             // Функция для обработки результата курсов
-            auto processCoursesResult = [this, callback, channelId, page, limit, dbClient](const Result& coursesResult) {
+            auto processCoursesResult = [this, req, callback, channelId, currentUserId, page, limit, dbClient, layoutPtr,
+                                         pageVariant, ticket, version, modifiedAt](const Result& coursesResult) {
                 // Получаем общее количество курсов для пагинации
                 string countSql = "SELECT COUNT(*) as total FROM courses WHERE author_id = $1 AND is_published = true AND is_public = true";
                 dbClient->execSqlAsync(
                     countSql,
-                    [callback, coursesResult, channelId, page, limit, this](const Result& countResult) {
-
-                        Json::Value response;
-                        Json::Value coursesArray(Json::arrayValue);
-
-                        // Формируем массив курсов
-                        for (const auto& row : coursesResult) {
-                            try {
-                                auto course = Courses(row);
-                                coursesArray.append(getCourseJsonResponse(course));
-                            } catch (const exception& e) {
-                                LOG_ERROR << "Error processing course data: " << e.what();
-                            }
-                        }
-
-                        response["courses"] = coursesArray;
-                        response["pagination"] = Json::Value();
-                        response["pagination"]["page"] = page;
-                        response["pagination"]["limit"] = limit;
-
-                        if (!countResult.empty()) {
-                            int totalCourses = countResult[0]["total"].as<int>();
-                            response["pagination"]["total"] = totalCourses;
-                            response["pagination"]["pages"] = (totalCourses + limit - 1) / limit;
-                        } else {
-                            response["pagination"]["total"] = 0;
-                            response["pagination"]["pages"] = 0;
-                        }
-
-                        response["channel_id"] = channelId;
-
-                        auto resp = HttpResponse::newHttpJsonResponse(response);
-                        callback(resp);
+                    [req, callback, coursesResult, channelId, currentUserId, page, limit, layoutPtr,
+                     pageVariant, ticket, version, modifiedAt](const Result& countResult) {
+                        int totalCourses = countResult.empty() ? 0 : countResult[0]["total"].as<int>();
+
+                        // Формируем массив курсов прямо из строк результата
+                        const auto& layout = *layoutPtr;
+                        auto binding = layout.bind(coursesResult);
+
+                        JsonStreamWriter writer(layout.estimateSize(coursesResult, binding) + 192);
+                        writer.beginObject();
+                        writer.key(kCoursesKey);
+                        layout.writeArray(writer, coursesResult, binding);
+
+                        writer.key("pagination");
+                        writer.beginObject();
+                        writer.key("page");
+                        writer.intValue(page);
+                        writer.key("limit");
+                        writer.intValue(limit);
+                        writer.key("total");
+                        writer.intValue(totalCourses);
+                        writer.key("pages");
+                        writer.intValue((totalCourses + limit - 1) / limit);
+                        writer.endObject();
+
+                        writer.key("channel_id");
+                        writer.stringValue(channelId);
+                        writer.endObject();
+
+                        ProfileCache::Entry entry;
+                        entry.body = writer.release();
+                        entry.version = version;
+                        entry.modifiedAt = modifiedAt;
+                        callback(ProfileCache::respond(req, entry, "channel-courses", currentUserId));
+                        ProfileCache::instance().store(ProfileCache::View::ChannelCourses, channelId, pageVariant,
+                                                       ticket, std::move(entry));
                     },
                     [callback, this](const DrogonDbException& e) {
                         LOG_ERROR << "Database error counting courses: " << e.base().what();
@@ -659,3 +609,215 @@ void ChannelController::getChannelCourses(const HttpRequestPtr& req,
         channelId
         );
 }
+
+// Подписаться на канал
+void ChannelController::subscribe(const HttpRequestPtr& req,
+                                  function<void(const HttpResponsePtr&)>&& callback,
+                                  const string& channelId) {
+    string userId = getCurrentUserId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Unauthorized"));
+        resp->setStatusCode(k401Unauthorized);
+        callback(resp);
+        return;
+    }
+
+    if (!isValidUUID(channelId)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid channel ID format"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    if (userId == channelId) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Cannot subscribe to own channel"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    auto dbClient = app().getDbClient();
+
+    // Вместе с подпиской в ленту попадают последние уже разнесённые события канала;
+    // ещё не разнесённые дойдут с очередным проходом FeedService,
+    // события крупных каналов подмешиваются при чтении
+    dbClient->execSqlAsync(
+        "WITH channel AS (SELECT id FROM users WHERE id = $2), "
+        "added AS ("
+        "  INSERT INTO channel_subscriptions (subscriber_id, channel_id) "
+        "  SELECT $1, id FROM channel "
+        "  ON CONFLICT DO NOTHING RETURNING channel_id), "
+        "backfill AS ("
+        "  INSERT INTO user_feed (user_id, event_id) "
+        "  SELECT $1, e.id FROM added a "
+        "  CROSS JOIN LATERAL (SELECT id FROM channel_events "
+        "    WHERE channel_id = a.channel_id AND fanned_out "
+        "    ORDER BY id DESC LIMIT $3) e "
+        "  ON CONFLICT DO NOTHING) "
+        "SELECT EXISTS (SELECT 1 FROM channel) AS channel_exists, "
+        "EXISTS (SELECT 1 FROM added) AS added",
+        [callback, userId, channelId, this](const Result& result) {
+            if (!result[0]["channel_exists"].as<bool>()) {
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Channel not found"));
+                resp->setStatusCode(k404NotFound);
+                callback(resp);
+                return;
+            }
+
+            bool added = result[0]["added"].as<bool>();
+            if (added) {
+                FeedService::instance().forget(userId);
+                ProfileCache::instance().invalidate(channelId);
+            }
+
+            Json::Value json;
+            json["channel_id"] = channelId;
+            json["subscribed"] = true;
+            auto resp = HttpResponse::newHttpJsonResponse(json);
+            resp->setStatusCode(added ? k201Created : k200OK);
+            callback(resp);
+        },
+        [callback, this](const DrogonDbException& e) {
+            LOG_ERROR << "Database error subscribing to channel: " << e.base().what();
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+            resp->setStatusCode(k500InternalServerError);
+            callback(resp);
+        },
+        userId, channelId, static_cast<int64_t>(FeedService::instance().ringCapacity())
+        );
+}
+
+// Отписаться от канала
+void ChannelController::unsubscribe(const HttpRequestPtr& req,
+                                    function<void(const HttpResponsePtr&)>&& callback,
+                                    const string& channelId) {
+    string userId = getCurrentUserId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Unauthorized"));
+        resp->setStatusCode(k401Unauthorized);
+        callback(resp);
+        return;
+    }
+
+    if (!isValidUUID(channelId)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid channel ID format"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    auto dbClient = app().getDbClient();
+
+    // Вместе с подпиской из ленты уходят события этого канала
+    dbClient->execSqlAsync(
+        "WITH removed AS ("
+        "  DELETE FROM channel_subscriptions "
+        "  WHERE subscriber_id = $1 AND channel_id = $2 RETURNING channel_id), "
+        "purged AS ("
+        "  DELETE FROM user_feed f USING channel_events e, removed r "
+        "  WHERE f.user_id = $1 AND f.event_id = e.id AND e.channel_id = r.channel_id) "
+        "SELECT count(*) AS removed FROM removed",
+        [callback, userId, channelId, this](const Result& result) {
+            if (result[0]["removed"].as<int64_t>() == 0) {
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Subscription not found"));
+                resp->setStatusCode(k404NotFound);
+                callback(resp);
+                return;
+            }
+
+            FeedService::instance().forget(userId);
+            ProfileCache::instance().invalidate(channelId);
+
+            Json::Value json;
+            json["channel_id"] = channelId;
+            json["subscribed"] = false;
+            callback(HttpResponse::newHttpJsonResponse(json));
+        },
+        [callback, this](const DrogonDbException& e) {
+            LOG_ERROR << "Database error unsubscribing from channel: " << e.base().what();
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+            resp->setStatusCode(k500InternalServerError);
+            callback(resp);
+        },
+        userId, channelId
+        );
+}
+
+// Лента новых курсов и видео каналов, на которые подписан пользователь
+void ChannelController::getMyFeed(const HttpRequestPtr& req,
+                                  function<void(const HttpResponsePtr&)>&& callback) {
+    string userId = getCurrentUserId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Unauthorized"));
+        resp->setStatusCode(k401Unauthorized);
+        callback(resp);
+        return;
+    }
+
+    // before - id последнего события предыдущей страницы (next_before)
+    int limit = 20;
+    int64_t before = 0;
+    try {
+        auto limitStr = req->getParameter("limit");
+        auto beforeStr = req->getParameter("before");
+        if (!limitStr.empty()) {
+            limit = stoi(limitStr);
+            if (limit < 1 || limit > 100) limit = 20;
+        }
+        if (!beforeStr.empty()) {
+            before = stoll(beforeStr);
+            if (before < 0) before = 0;
+        }
+    } catch (const exception&) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid pagination parameters"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    FeedService::instance().readPage(userId, before, static_cast<size_t>(limit),
+        [callback, this](vector<FeedService::ItemPtr> items, const string& error) {
+            if (!error.empty()) {
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+                resp->setStatusCode(k500InternalServerError);
+                callback(resp);
+                return;
+            }
+
+            JsonStreamWriter writer(64 + items.size() * 256);
+            writer.beginObject();
+            writer.key("items");
+            writer.beginArray();
+            for (const auto& item : items) {
+                writer.beginObject();
+                writer.key("id");
+                writer.intValue(item->id);
+                writer.key("kind");
+                writer.stringValue(item->kind);
+                writer.key("channel_id");
+                writer.stringValue(item->channelId);
+                writer.key("course_id");
+                writer.stringValue(item->courseId);
+                writer.key("video_id");
+                if (item->videoId.empty()) {
+                    writer.nullValue();
+                } else {
+                    writer.stringValue(item->videoId);
+                }
+                writer.key("title");
+                writer.stringValue(item->title);
+                writer.key("created_at");
+                writer.timestampValue(item->createdAt);
+                writer.endObject();
+            }
+            writer.endArray();
+            writer.key("next_before");
+            if (items.empty()) {
+                writer.nullValue();
+            } else {
+                writer.intValue(items.back()->id);
+            }
+            writer.endObject();
+            callback(writer.toResponse());
+        });
+}
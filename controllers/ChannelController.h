@@ -19,6 +19,9 @@ public:
     METHOD_LIST_BEGIN
         ADD_METHOD_TO(ChannelController::getChannelInfo, "/channels/{1}", Get);
     ADD_METHOD_TO(ChannelController::getChannelCourses, "/channels/{1}/courses", Get);
+    ADD_METHOD_TO(ChannelController::subscribe, "/channels/{1}/subscribe", Post);
+    ADD_METHOD_TO(ChannelController::unsubscribe, "/channels/{1}/subscribe", Delete);
+    ADD_METHOD_TO(ChannelController::getMyFeed, "/users/me/feed", Get);
     METHOD_LIST_END
 
         // Получить информацию о канале
@@ -31,11 +34,23 @@ public:
                            std::function<void(const HttpResponsePtr&)>&& callback,
                            const std::string& channelId);
 
+    // Подписаться на канал
+    void subscribe(const HttpRequestPtr& req,
+                   std::function<void(const HttpResponsePtr&)>&& callback,
+                   const std::string& channelId);
+
+    // Отписаться от канала
+    void unsubscribe(const HttpRequestPtr& req,
+                     std::function<void(const HttpResponsePtr&)>&& callback,
+                     const std::string& channelId);
+
+    // Лента новых курсов и видео каналов, на которые подписан пользователь
+    void getMyFeed(const HttpRequestPtr& req,
+                   std::function<void(const HttpResponsePtr&)>&& callback);
+
 private:
     // Вспомогательные методы
     Json::Value createJsonResponse(const std::string& key, const std::string& value);
-    Json::Value getUserJsonResponse(const Users& user);
-    Json::Value getCourseJsonResponse(const Courses& course);
 
     // Валидация
     bool isValidUUID(const std::string& uuid);
@@ -0,0 +1,461 @@
+#include "CounterService.h"
+#include "PgArray.h"
+#include "TrendingService.h"
+#include <drogon/drogon.h>
+#include <drogon/orm/DbClient.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+// Параметры пакетных запросов, собранные из Batch
+struct LikeParams {
+    std::vector<std::string> userIds;
+    std::vector<std::string> courseIds;
+    std::vector<std::string> videoIds;
+    std::vector<bool> liked;
+};
+
+struct CounterParams {
+    std::vector<std::string> videoIds;
+    std::vector<std::string> courseIds;  // пусто - только лайки, курс не проверяется
+    std::vector<int64_t> views;
+    std::vector<int64_t> likes;
+};
+
+using MergedDeltas = std::map<std::string, std::pair<int64_t, int64_t>>;  // course_id|video_id -> (views, likes)
+
+template <typename LikesMap>
+LikeParams buildLikeParams(const LikesMap& likes) {
+    LikeParams params;
+    for (const auto& [key, like] : likes) {
+        auto sep = key.find('|');
+        params.userIds.push_back(key.substr(0, sep));
+        params.courseIds.push_back(like.courseId);
+        params.videoIds.push_back(key.substr(sep + 1));
+        params.liked.push_back(like.liked);
+    }
+    return params;
+}
+
+CounterParams buildCounterParams(const MergedDeltas& merged) {
+    CounterParams params;
+    for (const auto& [key, deltas] : merged) {
+        auto sep = key.find('|');
+        params.courseIds.push_back(key.substr(0, sep));
+        params.videoIds.push_back(key.substr(sep + 1));
+        params.views.push_back(deltas.first);
+        params.likes.push_back(deltas.second);
+    }
+    return params;
+}
+
+MergedDeltas mergeDeltas(const std::unordered_map<std::string, int64_t>& views,
+                         const std::map<std::string, int64_t>& likeDeltas) {
+    MergedDeltas merged;
+    for (const auto& [key, count] : views) {
+        merged[key].first += count;
+    }
+    // Лайки уже проверены в video_likes по самому видео
+    for (const auto& [videoId, delta] : likeDeltas) {
+        merged["|" + videoId].second += delta;
+    }
+    return merged;
+}
+
+using CourseViews = std::vector<std::pair<std::string, int64_t>>;
+
+CourseViews collectCourseViews(const Result& result) {
+    CourseViews views;
+    views.reserve(result.size());
+    for (const auto& row : result) {
+        views.emplace_back(row["course_id"].as<std::string>(), row["views"].as<int64_t>());
+    }
+    return views;
+}
+
+// Только записанные просмотры: без повторов и с проверенной парой курс-видео
+void reportCourseViews(const CourseViews& views) {
+    for (const auto& [courseId, count] : views) {
+        TrendingService::instance().record(courseId, TrendingService::Signal::View, count);
+    }
+}
+
+int64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+void CounterService::start() {
+    const auto& config = app().getCustomConfig()["counters"];
+    flushIntervalSeconds_ = std::max(0.5, config.get("flush_interval_seconds", 3.0).asDouble());
+
+    app().getLoop()->runEvery(flushIntervalSeconds_, [this]() {
+        flush();
+    });
+
+    // 0 отключает сверку
+    double reconcileInterval = config.get("reconcile_interval_seconds", 60.0).asDouble();
+    reconcileBatchSize_ = std::max(1, config.get("reconcile_batch_size", 200).asInt());
+    viewDedupeMs_ = static_cast<int64_t>(std::max(0.0, config.get("view_dedupe_seconds", 600.0).asDouble()) * 1000);
+    maxSeenPerShard_ = std::max<size_t>(1, config.get("max_tracked_views", 200000).asUInt() / kSeenShardCount);
+    maxPendingKeys_ = std::max<size_t>(kShardCount, config.get("max_pending_keys", 100000).asUInt());
+    if (reconcileInterval > 0) {
+        app().getLoop()->runEvery(reconcileInterval, [this]() {
+            reconcile();
+        });
+    }
+}
+
+CounterService::Shard& CounterService::currentShard() {
+    // Для не-IO потоков индекс >= числа IO потоков, они делят оставшиеся шарды
+    return shards_[app().getCurrentThreadIndex() % kShardCount];
+}
+
+bool CounterService::firstView(const std::string& viewerKey, const std::string& videoId) {
+    if (viewDedupeMs_ == 0) {
+        return true;
+    }
+
+    std::string key = viewerKey + "|" + videoId;
+    auto& shard = seen_[std::hash<std::string>{}(key) % kSeenShardCount];
+    int64_t now = steadyNowMs();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.until.find(key);
+    if (it != shard.until.end() && it->second > now) {
+        return false;
+    }
+    if (it == shard.until.end() && shard.until.size() >= maxSeenPerShard_) {
+        for (auto seen = shard.until.begin(); seen != shard.until.end();) {
+            seen = seen->second <= now ? shard.until.erase(seen) : std::next(seen);
+        }
+        // Все записи ещё в окне - повтор не отличить, просмотр не засчитываем
+        if (shard.until.size() >= maxSeenPerShard_) {
+            return false;
+        }
+    }
+    shard.until[key] = now + viewDedupeMs_;
+    return true;
+}
+
+void CounterService::recordView(const std::string& viewerKey, const std::string& courseId, const std::string& videoId) {
+    if (!firstView(viewerKey, videoId)) {
+        return;
+    }
+
+    std::string key = courseId + "|" + videoId;
+    auto& shard = currentShard();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pending.views.find(key);
+    if (it != shard.pending.views.end()) {
+        ++it->second;
+    } else if (shard.pending.views.size() + shard.pending.likes.size() < maxPendingKeys_ / kShardCount) {
+        shard.pending.views.emplace(std::move(key), 1);
+    }
+}
+
+void CounterService::recordLike(const std::string& userId,
+                                const std::string& courseId,
+                                const std::string& videoId,
+                                bool liked) {
+    uint64_t seq = ++likeSeq_;
+    std::string key = userId + "|" + videoId;
+    auto& shard = currentShard();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pending.likes.find(key);
+    if (it != shard.pending.likes.end()) {
+        it->second = PendingLike{liked, seq, courseId};
+    } else if (shard.pending.views.size() + shard.pending.likes.size() < maxPendingKeys_ / kShardCount) {
+        shard.pending.likes.emplace(std::move(key), PendingLike{liked, seq, courseId});
+    }
+}
+
+void CounterService::mergeInto(Batch& target, Batch&& source, size_t limit) {
+    for (auto& [key, count] : source.views) {
+        auto it = target.views.find(key);
+        if (it != target.views.end()) {
+            it->second += count;
+        } else if (target.views.size() + target.likes.size() < limit) {
+            target.views.emplace(key, count);
+        }
+    }
+    for (auto& [key, like] : source.likes) {
+        auto it = target.likes.find(key);
+        if (it != target.likes.end()) {
+            if (it->second.seq < like.seq) {
+                it->second = like;
+            }
+        } else if (target.views.size() + target.likes.size() < limit) {
+            target.likes.emplace(key, like);
+        }
+    }
+}
+
+CounterService::Batch CounterService::drainShards() {
+    Batch batch;
+    for (auto& shard : shards_) {
+        Batch drained;
+        {
+            // Под мьютексом только обмен контейнеров
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            std::swap(drained, shard.pending);
+        }
+        if (!drained.empty()) {
+            mergeInto(batch, std::move(drained));
+        }
+    }
+    return batch;
+}
+
+void CounterService::requeue(Batch&& batch) {
+    // Пока БД недоступна, неудавшиеся пакеты не растут без предела
+    auto& shard = shards_[0];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    mergeInto(shard.pending, std::move(batch), maxPendingKeys_);
+}
+
+// Лайки: вставка/удаление в video_likes, в ответ — фактические дельты по видео.
+// Повторный лайк или снятие несуществующего лайка дельты не дают, как и лайк
+// видео через курс, которому оно не принадлежит.
+std::string CounterService::likesSql() {
+    return R"(
+        WITH input AS (
+            SELECT * FROM unnest($1::text[], $2::text[], $3::text[], $4::boolean[]) AS t(user_id, course_id, video_id, liked)
+        ),
+        added AS (
+            INSERT INTO video_likes (user_id, video_id)
+            SELECT i.user_id, i.video_id
+            FROM input i
+            JOIN course_videos cv ON cv.id = i.video_id AND cv.course_id = i.course_id
+            JOIN users u ON u.id = i.user_id
+            WHERE i.liked
+            ON CONFLICT DO NOTHING
+            RETURNING video_id
+        ),
+        removed AS (
+            DELETE FROM video_likes vl
+            USING input i, course_videos cv
+            WHERE NOT i.liked AND vl.user_id = i.user_id AND vl.video_id = i.video_id
+              AND cv.id = i.video_id AND cv.course_id = i.course_id
+            RETURNING vl.video_id
+        )
+        SELECT video_id, SUM(delta)::bigint AS delta
+        FROM (
+            SELECT video_id, 1 AS delta FROM added
+            UNION ALL
+            SELECT video_id, -1 AS delta FROM removed
+        ) d
+        GROUP BY video_id
+    )";
+}
+
+// Дельты просмотров и лайков: видео, затем агрегаты курса и автора.
+// Каждая строка курса/автора обновляется один раз за пакет. Просмотры
+// с курсом, которому видео не принадлежит, отбрасываются здесь же.
+std::string CounterService::countersSql() {
+    return R"(
+        WITH delta AS (
+            SELECT cv.id AS video_id, SUM(t.views) AS views, SUM(t.likes) AS likes
+            FROM unnest($1::text[], $2::text[], $3::bigint[], $4::bigint[]) AS t(video_id, course_id, views, likes)
+            JOIN course_videos cv ON cv.id = t.video_id AND (t.course_id = '' OR cv.course_id = t.course_id)
+            GROUP BY cv.id
+            ORDER BY cv.id
+        ),
+        videos AS (
+            UPDATE course_videos cv
+            SET views_count = cv.views_count + d.views,
+                likes_count = cv.likes_count + d.likes,
+                last_accessed_at = CASE WHEN d.views > 0 THEN NOW() ELSE cv.last_accessed_at END
+            FROM delta d
+            WHERE cv.id = d.video_id
+            RETURNING cv.course_id, cv.author_id, d.views, d.likes
+        ),
+        course_totals AS (
+            UPDATE courses c
+            SET total_views = c.total_views + s.views,
+                total_likes = c.total_likes + s.likes
+            FROM (
+                SELECT course_id, SUM(views) AS views, SUM(likes) AS likes
+                FROM videos
+                GROUP BY course_id
+            ) s
+            WHERE c.id = s.course_id
+            RETURNING c.id, s.views
+        ),
+        author_totals AS (
+            UPDATE user_stats us
+            SET total_views = us.total_views + s.views
+            FROM (
+                SELECT author_id, SUM(views) AS views
+                FROM videos
+                GROUP BY author_id
+            ) s
+            WHERE us.user_id = s.author_id AND s.views <> 0
+        )
+        SELECT id AS course_id, views::bigint AS views FROM course_totals WHERE views > 0
+    )";
+}
+
+void CounterService::flush() {
+    // Предыдущий сброс ещё идёт — события просто накопятся до следующего тика
+    if (flushing_.exchange(true)) {
+        return;
+    }
+
+    auto batch = std::make_shared<Batch>(drainShards());
+    if (batch->empty()) {
+        flushing_ = false;
+        return;
+    }
+
+    auto likeParams = buildLikeParams(batch->likes);
+
+    auto done = std::make_shared<std::atomic<bool>>(false);
+    auto courseViews = std::make_shared<CourseViews>();
+    auto finish = [this, batch, done, courseViews](bool ok) {
+        if (done->exchange(true)) {
+            return;
+        }
+        if (!ok) {
+            requeue(std::move(*batch));
+        } else {
+            reportCourseViews(*courseViews);
+        }
+        flushing_ = false;
+    };
+
+    auto onError = [finish](const DrogonDbException& e) {
+        LOG_ERROR << "Counter flush failed, deltas are kept for the next attempt: " << e.base().what();
+        finish(false);
+    };
+
+    // Второй шаг: применяем дельты просмотров и (уже подтверждённых) лайков
+    auto applyCounters = [batch, courseViews, finish, onError](const std::shared_ptr<Transaction>& trans,
+                                                  const std::map<std::string, int64_t>& likeDeltas) {
+        MergedDeltas merged = mergeDeltas(batch->views, likeDeltas);
+        if (merged.empty()) {
+            return;
+        }
+
+        auto params = buildCounterParams(merged);
+
+        trans->execSqlAsync(
+            countersSql(),
+            [courseViews](const Result& result) {
+                *courseViews = collectCourseViews(result);
+            },
+            onError,
+            pg::textArray(params.videoIds), pg::textArray(params.courseIds),
+            pg::intArray(params.views), pg::intArray(params.likes));
+    };
+
+    auto dbClient = app().getDbClient();
+    dbClient->newTransactionAsync(
+        [batch, likeParams, finish, onError, applyCounters](const std::shared_ptr<Transaction>& trans) {
+            if (!trans) {
+                LOG_ERROR << "Counter flush failed: no database connection";
+                finish(false);
+                return;
+            }
+
+            trans->setCommitCallback([finish](bool committed) {
+                finish(committed);
+            });
+
+            if (likeParams.userIds.empty()) {
+                applyCounters(trans, {});
+                return;
+            }
+
+            trans->execSqlAsync(
+                likesSql(),
+                [trans, applyCounters](const Result& result) {
+                    std::map<std::string, int64_t> likeDeltas;
+                    for (const auto& row : result) {
+                        likeDeltas[row["video_id"].as<std::string>()] = row["delta"].as<int64_t>();
+                    }
+                    applyCounters(trans, likeDeltas);
+                },
+                onError,
+                pg::textArray(likeParams.userIds), pg::textArray(likeParams.courseIds),
+                pg::textArray(likeParams.videoIds), pg::boolArray(likeParams.liked));
+        });
+}
+
+void CounterService::reconcile() {
+    if (reconciling_.exchange(true)) {
+        return;
+    }
+
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        "SELECT next_cursor, fixed_rows FROM reconcile_counters($1, $2)",
+        [this](const Result& result) {
+            if (!result.empty()) {
+                int fixed = result[0]["fixed_rows"].as<int>();
+                if (fixed > 0) {
+                    LOG_WARN << "Counter reconciliation fixed " << fixed << " rows after course "
+                             << (reconcileCursor_.empty() ? "<start>" : reconcileCursor_);
+                }
+                reconcileCursor_ = result[0]["next_cursor"].isNull()
+                    ? std::string()
+                    : result[0]["next_cursor"].as<std::string>();
+            }
+            reconciling_ = false;
+        },
+        [this](const DrogonDbException& e) {
+            LOG_ERROR << "Counter reconciliation failed: " << e.base().what();
+            reconciling_ = false;
+        },
+        reconcileCursor_, reconcileBatchSize_);
+}
+
+void CounterService::shutdown() {
+    auto batch = drainShards();
+    if (batch.empty()) {
+        return;
+    }
+
+    try {
+        auto dbClient = app().getDbClient();
+        auto trans = dbClient->newTransaction();
+
+        std::map<std::string, int64_t> likeDeltas;
+        if (!batch.likes.empty()) {
+            auto likeParams = buildLikeParams(batch.likes);
+            auto result = trans->execSqlSync(likesSql(),
+                                             pg::textArray(likeParams.userIds),
+                                             pg::textArray(likeParams.courseIds),
+                                             pg::textArray(likeParams.videoIds),
+                                             pg::boolArray(likeParams.liked));
+            for (const auto& row : result) {
+                likeDeltas[row["video_id"].as<std::string>()] = row["delta"].as<int64_t>();
+            }
+        }
+
+        MergedDeltas merged = mergeDeltas(batch.views, likeDeltas);
+        if (!merged.empty()) {
+            auto params = buildCounterParams(merged);
+            auto result = trans->execSqlSync(countersSql(),
+                                             pg::textArray(params.videoIds),
+                                             pg::textArray(params.courseIds),
+                                             pg::intArray(params.views),
+                                             pg::intArray(params.likes));
+            reportCourseViews(collectCourseViews(result));
+        }
+
+        LOG_INFO << "Counters flushed on shutdown: " << batch.views.size() << " videos with views, "
+                 << batch.likes.size() << " like changes";
+    } catch (const std::exception& e) {
+        LOG_ERROR << "Failed to flush counters on shutdown: " << e.what();
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Приём просмотров и лайков видео без UPDATE на каждое событие.
+// События копятся в шардах по IO-потокам, раз в несколько секунд
+// дельты одним пакетом пишутся в course_videos, courses и user_stats.
+// Отдельный таймер порциями сверяет агрегаты с исходными данными (reconcile_counters).
+// Просмотр засчитывается один раз за view_dedupe_seconds на зрителя и видео;
+// принадлежность видео курсу проверяется при записи, чужие пары отбрасываются.
+// Число ожидающих записи ключей ограничено max_pending_keys: сверх него
+// события теряются, в том числе при возврате неудавшегося пакета.
+class CounterService {
+public:
+    static CounterService& instance() {
+        static CounterService instance;
+        return instance;
+    }
+
+    // Запуск периодического сброса (вызывается из main до app().run())
+    void start();
+
+    // Синхронный сброс остатков при остановке сервера
+    void shutdown();
+
+    // viewerKey - "user:<id>" или "ip:<адрес>"
+    void recordView(const std::string& viewerKey, const std::string& courseId, const std::string& videoId);
+    // Лайк видео с чужим courseId (видео не из этого курса) отбрасывается при записи
+    void recordLike(const std::string& userId, const std::string& courseId, const std::string& videoId, bool liked);
+
+private:
+    CounterService() = default;
+
+    struct PendingLike {
+        bool liked;
+        uint64_t seq;  // порядок событий между шардами: побеждает последнее
+        std::string courseId;  // курс из маршрута, сверяется с course_videos
+    };
+
+    struct Batch {
+        std::unordered_map<std::string, int64_t> views;  // ключ: courseId|videoId
+        std::unordered_map<std::string, PendingLike> likes;  // ключ: userId|videoId
+
+        bool empty() const { return views.empty() && likes.empty(); }
+    };
+
+    // Шард на IO-поток: мьютекс почти никогда не конкурирует
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        Batch pending;
+    };
+
+    static constexpr size_t kShardCount = 64;
+
+    // Недавние просмотры для отсечения повторов: viewerKey|videoId -> steady_clock, мс
+    struct alignas(64) SeenShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, int64_t> until;
+    };
+
+    static constexpr size_t kSeenShardCount = 16;
+
+    // false - повтор в окне или таблица переполнена
+    bool firstView(const std::string& viewerKey, const std::string& videoId);
+
+    Shard& currentShard();
+    Batch drainShards();
+    void requeue(Batch&& batch);
+    // limit - сколько ключей может быть в target; лишние новые ключи отбрасываются
+    static void mergeInto(Batch& target, Batch&& source, size_t limit = SIZE_MAX);
+
+    void flush();
+    void reconcile();
+
+    static std::string likesSql();
+    static std::string countersSql();
+
+    std::array<Shard, kShardCount> shards_;
+    std::array<SeenShard, kSeenShardCount> seen_;
+    int64_t viewDedupeMs_ = 600000;
+    size_t maxSeenPerShard_ = 200000 / kSeenShardCount;
+    size_t maxPendingKeys_ = 100000;
+    std::atomic<uint64_t> likeSeq_{0};
+    std::atomic<bool> flushing_{false};
+    double flushIntervalSeconds_ = 3.0;
+
+    std::atomic<bool> reconciling_{false};
+    std::string reconcileCursor_;  // id последнего сверенного курса, меняется только в цепочке reconcile
+    int reconcileBatchSize_ = 200;
+};
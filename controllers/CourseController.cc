@@ -1,15 +1,191 @@
 #include "CourseController.h"
+#include "AuditLogger.h"
+#include "AuthContext.h"
+#include "ImageService.h"
+#include "FileIoExecutor.h"
+#include "VideoPreviewService.h"
+#include "CounterService.h"
+#include "JsonStreamWriter.h"
+#include "FieldSelection.h"
+#include "DbRouter.h"
+#include "HttpCache.h"
+#include "ProfileCache.h"
+#include "RecommendationService.h"
+#include "TrendingService.h"
+#include "PgArray.h"
 #include <drogon/HttpResponse.h>
 #include <drogon/utils/Utilities.h>
 #include <drogon/drogon.h>
 #include <numeric>
 #include <algorithm>
+#include <unordered_map>
+#include <string_view>
 #include <jwt-cpp/jwt.h>
 
 using namespace drogon;
 using namespace drogon::orm;
 using namespace std;
 
+namespace {
+
+// Те же поля, что в getCourseJsonResponse, но прямо из строк результата
+const JsonRowLayout& courseLayout() {
+    static const JsonRowLayout layout({
+        {"id", JsonColumnKind::String},
+        {"title", JsonColumnKind::String},
+        {"description", JsonColumnKind::String},
+        {"category", JsonColumnKind::String},
+        {"level", JsonColumnKind::String},
+        {"language", JsonColumnKind::String},
+        {"author_id", JsonColumnKind::String},
+        {"chapters_count", JsonColumnKind::Integer},
+        {"videos_count", JsonColumnKind::Integer},
+        {"total_views", JsonColumnKind::Integer},
+        {"total_likes", JsonColumnKind::Integer},
+        {"price", JsonColumnKind::DecimalString},
+        {"is_paid", JsonColumnKind::Boolean},
+        {"is_published", JsonColumnKind::Boolean},
+        {"is_public", JsonColumnKind::Boolean},
+        {"rating", JsonColumnKind::DecimalString},
+        {"cover_path", JsonColumnKind::NullableString},
+        {"cover_variants", "cover_path", ImageService::writeVariants},
+        {"icon_path", JsonColumnKind::NullableString},
+        {"tags", JsonColumnKind::JsonArray},
+        {"created_at", JsonColumnKind::Timestamp},
+        {"updated_at", JsonColumnKind::Timestamp},
+        {"last_accessed_at", JsonColumnKind::Timestamp},
+    });
+    return layout;
+}
+
+const JsonRowLayout& chapterLayout() {
+    static const JsonRowLayout layout({
+        {"id", JsonColumnKind::String},
+        {"course_id", JsonColumnKind::String},
+        {"title", JsonColumnKind::String},
+        {"description", JsonColumnKind::String},
+        {"order", JsonColumnKind::Integer},
+        {"videos_count", JsonColumnKind::Integer},
+        {"total_duration", JsonColumnKind::Integer},
+        {"created_at", JsonColumnKind::Timestamp},
+        {"updated_at", JsonColumnKind::Timestamp},
+    });
+    return layout;
+}
+
+const JsonRowLayout& videoLayout() {
+    static const JsonRowLayout layout({
+        {"id", JsonColumnKind::String},
+        {"course_id", JsonColumnKind::String},
+        {"chapter_id", JsonColumnKind::NullableString},
+        {"author_id", JsonColumnKind::String},
+        {"title", JsonColumnKind::String},
+        {"description", JsonColumnKind::String},
+        {"order", JsonColumnKind::Integer},
+        {"video_filename", JsonColumnKind::String},
+        {"video_path", JsonColumnKind::String},
+        {"duration", JsonColumnKind::String},
+        {"duration_seconds", JsonColumnKind::Integer},
+        {"cover_path", JsonColumnKind::String},
+        {"preview_vtt", JsonColumnKind::NullableString},
+        {"has_subtitles", JsonColumnKind::Boolean},
+        {"has_notes", JsonColumnKind::Boolean},
+        {"views_count", JsonColumnKind::Integer},
+        {"likes_count", JsonColumnKind::Integer},
+        {"is_approved", JsonColumnKind::Boolean},
+        {"approved_by", JsonColumnKind::NullableString},
+        {"approved_at", JsonColumnKind::Timestamp},
+        {"uploaded_by", JsonColumnKind::NullableString},
+        {"created_at", JsonColumnKind::Timestamp},
+        {"updated_at", JsonColumnKind::Timestamp},
+        {"last_accessed_at", JsonColumnKind::Timestamp},
+    });
+    return layout;
+}
+
+const JsonKey kCoursesKey("courses");
+const JsonKey kChaptersKey("chapters");
+const JsonKey kVideosKey("videos");
+const JsonKey kVideosWithoutChaptersKey("videos_without_chapters");
+
+const FieldSelection& courseFields() {
+    static const auto selection = FieldSelection::forModel<Courses>(courseLayout());
+    return selection;
+}
+
+const FieldSelection& videoFields() {
+    static const auto selection = FieldSelection::forModel<CourseVideos>(videoLayout(), {"preview_vtt"});
+    return selection;
+}
+
+struct RankedCourse {
+    string courseId;
+    double score;
+};
+
+// Карточки курсов в порядке ранжирования (рекомендации, тренды).
+// Порядок считается в памяти, из БД берутся только строки по первичному ключу:
+// так отсеиваются снятые с публикации курсы и не устаревают названия и обложки
+void sendRankedCourses(shared_ptr<const vector<RankedCourse>> ranked,
+                       const FieldSelection::Projection& projection,
+                       function<void(const HttpResponsePtr&)>&& callback) {
+    vector<string> ids;
+    ids.reserve(ranked->size());
+    for (const auto& item : *ranked) {
+        ids.push_back(item.courseId);
+    }
+
+    auto layoutPtr = projection.layout;
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        "SELECT " + projection.columns + " FROM courses "
+        "WHERE id = ANY($1::text[]) AND is_published = true AND is_public = true",
+        [callback, ranked, layoutPtr](const Result& result) {
+            const auto& layout = *layoutPtr;
+            auto binding = layout.bind(result);
+
+            unordered_map<string, size_t> rowById;
+            for (size_t i = 0; i < result.size(); ++i) {
+                rowById.emplace(result[i]["id"].as<string>(), i);
+            }
+
+            JsonStreamWriter writer(layout.estimateSize(result, binding) + 32 * ranked->size() + 32);
+            writer.beginObject();
+            writer.key(kCoursesKey);
+            writer.beginArray();
+            for (const auto& item : *ranked) {
+                auto it = rowById.find(item.courseId);
+                if (it == rowById.end()) {
+                    continue;
+                }
+                writer.beginObject();
+                layout.writeFields(writer, result[it->second], binding);
+                char score[32];
+                snprintf(score, sizeof(score), "%.4f", item.score);
+                writer.key("score");
+                writer.rawValue(score);
+                writer.endObject();
+            }
+            writer.endArray();
+            writer.endObject();
+
+            auto resp = writer.toResponse();
+            resp->addHeader("Cache-Control", "private, no-cache");
+            callback(resp);
+        },
+        [callback](const DrogonDbException& e) {
+            LOG_ERROR << "Database error fetching ranked courses: " << e.base().what();
+            Json::Value error;
+            error["error"] = "Database error";
+            auto resp = HttpResponse::newHttpJsonResponse(error);
+            resp->setStatusCode(k500InternalServerError);
+            callback(resp);
+        },
+        pg::textArray(ids));
+}
+
+} // namespace
+
 // Вспомогательная функция для создания JSON ответов
 Json::Value CourseController::createJsonResponse(const string& key, const string& value) {
     Json::Value json;
@@ -78,6 +254,11 @@ bool CourseController::isValidVideoData(const Json::Value& data) {
 
 // JWT аутентификация
 string CourseController::getCurrentUserId(const HttpRequestPtr& req) {
+    // Подзапрос /batch: токен уже проверен
+    if (auto identity = AuthContext::attached(req)) {
+        return identity->userId;
+    }
+
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
         return "";
@@ -87,6 +268,18 @@ string CourseController::getCurrentUserId(const HttpRequestPtr& req) {
     return getUserIdFromToken(token);
 }
 
+string CourseController::getCurrentUserRole(const HttpRequestPtr& req) {
+    if (auto identity = AuthContext::attached(req)) {
+        return identity->role;
+    }
+
+    auto authHeader = req->getHeader("Authorization");
+    if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
+        return "";
+    }
+    return getRoleFromToken(authHeader.substr(7));
+}
+
 bool CourseController::validateJWT(const string& token) {
     try {
         auto decoded = jwt::decode(token);
@@ -162,6 +355,10 @@ string CourseController::getRoleFromToken(const string& token) {
 }
 
 bool CourseController::hasPermission(const HttpRequestPtr& req, const vector<string>& allowedRoles) {
+    if (auto identity = AuthContext::attached(req)) {
+        return find(allowedRoles.begin(), allowedRoles.end(), identity->role) != allowedRoles.end();
+    }
+
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
         return false;
@@ -202,11 +399,14 @@ Json::Value CourseController::getCourseJsonResponse(const Courses& course) {
             string coverPath = course.getValueOfCoverPath();
             if (!coverPath.empty()) {
                 courseJson["cover_path"] = coverPath;
+                courseJson["cover_variants"] = ImageService::variantsJson(coverPath);
             } else {
                 courseJson["cover_path"] = Json::nullValue;
+                courseJson["cover_variants"] = Json::nullValue;
             }
         } catch (const exception& e) {
             courseJson["cover_path"] = Json::nullValue;
+            courseJson["cover_variants"] = Json::nullValue;
         }
 
         try {
@@ -259,108 +459,6 @@ Json::Value CourseController::getCourseJsonResponse(const Courses& course) {
     return courseJson;
 }
 
-// Вспомогательный метод для создания JSON ответа главы
-Json::Value CourseController::getChapterJsonResponse(const CourseChapters& chapter) {
-    Json::Value chapterJson;
-
-    try {
-        chapterJson["id"] = chapter.getValueOfId();
-        chapterJson["course_id"] = chapter.getValueOfCourseId();
-        chapterJson["title"] = chapter.getValueOfTitle();
-        chapterJson["description"] = chapter.getValueOfDescription();
-        chapterJson["order"] = chapter.getValueOfOrder();
-        chapterJson["videos_count"] = chapter.getValueOfVideosCount();
-        chapterJson["total_duration"] = chapter.getValueOfTotalDuration();
-        chapterJson["created_at"] = chapter.getValueOfCreatedAt().toDbStringLocal();
-        chapterJson["updated_at"] = chapter.getValueOfUpdatedAt().toDbStringLocal();
-    } catch (const exception& e) {
-        LOG_ERROR << "Error creating chapter JSON response: " << e.what();
-    }
-
-    return chapterJson;
-}
-
-// Вспомогательный метод для создания JSON ответа видео
-Json::Value CourseController::getVideoJsonResponse(const CourseVideos& video) {
-    Json::Value videoJson;
-
-    try {
-        videoJson["id"] = video.getValueOfId();
-        videoJson["course_id"] = video.getValueOfCourseId();
-
-        // Исправление: проверяем, пустая ли строка вместо isNull()
-        string chapterId = video.getValueOfChapterId();
-        videoJson["chapter_id"] = chapterId.empty() ? Json::Value(Json::nullValue) : Json::Value(chapterId);
-        videoJson["author_id"] = video.getValueOfAuthorId();
-        videoJson["title"] = video.getValueOfTitle();
-        videoJson["description"] = video.getValueOfDescription();
-        videoJson["order"] = video.getValueOfOrder();
-        videoJson["video_filename"] = video.getValueOfVideoFilename();
-        videoJson["video_path"] = video.getValueOfVideoPath();
-        videoJson["duration"] = video.getValueOfDuration();
-        videoJson["duration_seconds"] = video.getValueOfDurationSeconds();
-        videoJson["cover_path"] = video.getValueOfCoverPath();
-        videoJson["has_subtitles"] = video.getValueOfHasSubtitles();
-        videoJson["has_notes"] = video.getValueOfHasNotes();
-        videoJson["views_count"] = video.getValueOfViewsCount();
-        videoJson["likes_count"] = video.getValueOfLikesCount();
-        videoJson["is_approved"] = video.getValueOfIsApproved();
-
-        // Поля модерации
-        try {
-            string approvedBy = video.getValueOfApprovedBy();
-            if (!approvedBy.empty()) {
-                videoJson["approved_by"] = approvedBy;
-            } else {
-                videoJson["approved_by"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            videoJson["approved_by"] = Json::nullValue;
-        }
-
-        try {
-            auto approvedAt = video.getValueOfApprovedAt();
-            if (approvedAt != trantor::Date()) {
-                videoJson["approved_at"] = approvedAt.toDbStringLocal();
-            } else {
-                videoJson["approved_at"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            videoJson["approved_at"] = Json::nullValue;
-        }
-
-        try {
-            string uploadedBy = video.getValueOfUploadedBy();
-            if (!uploadedBy.empty()) {
-                videoJson["uploaded_by"] = uploadedBy;
-            } else {
-                videoJson["uploaded_by"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            videoJson["uploaded_by"] = Json::nullValue;
-        }
-
-        videoJson["created_at"] = video.getValueOfCreatedAt().toDbStringLocal();
-        videoJson["updated_at"] = video.getValueOfUpdatedAt().toDbStringLocal();
-
-        try {
-            auto lastAccessed = video.getValueOfLastAccessedAt();
-            if (lastAccessed != trantor::Date()) {
-                videoJson["last_accessed_at"] = lastAccessed.toDbStringLocal();
-            } else {
-                videoJson["last_accessed_at"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            videoJson["last_accessed_at"] = Json::nullValue;
-        }
-
-    } catch (const exception& e) {
-        LOG_ERROR << "Error creating video JSON response: " << e.what();
-    }
-
-    return videoJson;
-}
-
 // Проверка, является ли пользователь автором курса
 bool CourseController::isCourseAuthor(const string& userId, const string& courseId) {
     auto dbClient = app().getDbClient();
@@ -411,22 +509,13 @@ bool CourseController::isEnrolledInCourse(const string& userId, const string& co
 // МЕТОДЫ ДЛЯ РАБОТЫ С ФАЙЛАМИ
 // =============================================================================
 
-CourseController::FileInfo CourseController::saveCoverImage(const HttpRequestPtr& req,
-                                                            const string& courseId,
-                                                            const string& chapterId) {
-    FileInfo fileInfo;
-
-    // Используем MultiPartParser для получения файлов
-    MultiPartParser fileUpload;
-    if (fileUpload.parse(req) != 0) {
-        return fileInfo;
-    }
-
-    auto files = fileUpload.getFiles();
+CourseController::PlannedFile CourseController::planCoverImage(const vector<HttpFile>& files,
+                                                               const string& courseId,
+                                                               const string& chapterId) {
+    PlannedFile planned;
 
     // Ищем файл обложки (второй файл в запросе или с определенным именем)
-    for (size_t i = 0; i < files.size(); ++i) {
-        const auto& file = files[i];
+    for (const auto& file : files) {
         string name = file.getFileName();
         if (name.find("cover") != string::npos ||
             name.find("image") != string::npos ||
@@ -441,40 +530,53 @@ CourseController::FileInfo CourseController::saveCoverImage(const HttpRequestPtr
                 savePath = baseUploadPath_ + "/courses/" + courseId + "/chapters/" + chapterId + "/covers";
             }
 
-            if (!ensureDirectoryExists(savePath)) {
-                throw runtime_error("Failed to create directory: " + savePath);
-            }
-
             string filename = generateFilename(file.getFileName());
             string fullPath = savePath + "/" + filename;
 
-            // Сохраняем файл - ИСПРАВЛЕНО: используем saveAs() вместо saveTo()
-            file.saveAs(fullPath);
-
-            fileInfo.filename = filename;
-            fileInfo.path = fullPath.substr(baseUploadPath_.length() + 1);
-            fileInfo.full_path = fullPath;
-            // ИСПРАВЛЕНО: используем length() вместо getFileSize()
-            fileInfo.size = file.fileLength();
-            fileInfo.mime_type = getMimeType(filename);
+            planned.info.filename = filename;
+            planned.info.path = fullPath.substr(baseUploadPath_.length() + 1);
+            planned.info.full_path = fullPath;
+            planned.info.size = file.fileLength();
+            planned.info.mime_type = getMimeType(filename);
+            planned.source = make_shared<HttpFile>(file);
 
             break;
         }
     }
 
-    return fileInfo;
+    return planned;
 }
 
-bool CourseController::deleteFile(const string& path) {
-    try {
-        if (fs::exists(path)) {
-            return fs::remove(path);
+void CourseController::saveVideoAndCover(const PlannedFile& video, const PlannedFile& cover,
+                                         function<void(const string& error, const FileInfo& cover)>&& done) {
+    FileIoExecutor::instance().writeFile(
+        *video.source, video.info.full_path,
+        [cover, done = std::move(done)](const string& error) mutable {
+            if (!error.empty() || !cover.source) {
+                done(error, FileInfo{});
+                return;
+            }
+
+            // Обложка необязательна: если записать её не удалось, видео всё равно сохраняется
+            FileIoExecutor::instance().writeFile(
+                *cover.source, cover.info.full_path,
+                [info = cover.info, done = std::move(done)](const string& coverError) {
+                    if (!coverError.empty()) {
+                        LOG_WARN << "Failed to save cover image: " << coverError;
+                        done("", FileInfo{});
+                        return;
+                    }
+                    done("", info);
+                });
+        });
+}
+
+void CourseController::deleteFiles(vector<string> paths) {
+    FileIoExecutor::instance().removeFiles(std::move(paths), [](const string& error) {
+        if (!error.empty()) {
+            LOG_ERROR << "Error deleting file: " << error;
         }
-        return true; // Файл и так не существует
-    } catch (const exception& e) {
-        LOG_ERROR << "Error deleting file: " << e.what();
-        return false;
-    }
+    });
 }
 
 string CourseController::getFilePath(const string& courseId,
@@ -539,6 +641,17 @@ void CourseController::getCourses(const HttpRequestPtr& req,
     string level = paramsMap.find("level") != paramsMap.end() ? paramsMap.at("level") : "";
     string sortBy = paramsMap.find("sort_by") != paramsMap.end() ? paramsMap.at("sort_by") : "created_at";
     string sortOrder = paramsMap.find("sort_order") != paramsMap.end() ? paramsMap.at("sort_order") : "desc";
+    string fields = paramsMap.find("fields") != paramsMap.end() ? paramsMap.at("fields") : "";
+
+    FieldSelection::Projection projection;
+    string fieldsError;
+    if (!courseFields().select(fields, {}, projection, fieldsError)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", fieldsError));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+    auto layoutPtr = projection.layout;
 
     // Валидация параметров
     int page, limit;
@@ -556,10 +669,8 @@ void CourseController::getCourses(const HttpRequestPtr& req,
 
     int offset = (page - 1) * limit;
 
-    auto dbClient = app().getDbClient();
-
     // Строим SQL запрос для получения курсов
-    string sql = "SELECT * FROM courses WHERE is_published = true ";
+    string sql = "SELECT " + projection.columns + " FROM courses WHERE is_published = true ";
     vector<string> params;
 
     if (!search.empty()) {
@@ -607,36 +718,44 @@ void CourseController::getCourses(const HttpRequestPtr& req,
         countParams.push_back(level);
     }
 
+    // Каталог только читается - реплика, если она не отстаёт (DbRouter)
+    auto dbClient = DbRouter::instance().clientFor(req, "", sql);
+
     auto callbackPtr = std::make_shared<std::function<void(const HttpResponsePtr&)>>(std::move(callback));
+    // Заполняется после проверки версии каталога, до запуска запросов списка
+    auto validatorPtr = std::make_shared<HttpCache::Validator>();
 
     // Выполняем запрос на подсчет с правильными параметрами
-    auto executeCountQuery = [dbClient, sql, params, countParams, page, limit, callbackPtr, this, &countSql](auto&&... countArgs) {
+    auto executeCountQuery = [dbClient, sql, params, page, limit, callbackPtr, validatorPtr, layoutPtr, this, countSql](auto&&... countArgs) {
         dbClient->execSqlAsync(countSql,
-                               [dbClient, sql, params, page, limit, callbackPtr, this](const Result& countResult) {
+                               [dbClient, sql, params, page, limit, callbackPtr, validatorPtr, layoutPtr, this](const Result& countResult) {
                                    int total = countResult[0]["total"].as<int>();
 
                                    // Выполняем запрос на получение курсов
-                                   auto coursesCallback = [callbackPtr, total, page, limit, this](const Result& coursesResult) {
-                                       Json::Value response;
-                                       Json::Value coursesArray(Json::arrayValue);
-
-                                       for (const auto& row : coursesResult) {
-                                           try {
-                                               auto course = Courses(row);
-                                               coursesArray.append(getCourseJsonResponse(course));
-                                           } catch (const exception& e) {
-                                               LOG_ERROR << "Error processing course data: " << e.what();
-                                           }
-                                       }
-
-                                       response["courses"] = coursesArray;
-                                       response["pagination"] = Json::Value();
-                                       response["pagination"]["page"] = page;
-                                       response["pagination"]["limit"] = limit;
-                                       response["pagination"]["total"] = total;
-                                       response["pagination"]["pages"] = (total + limit - 1) / limit;
-
-                                       auto resp = HttpResponse::newHttpJsonResponse(response);
+                                   auto coursesCallback = [callbackPtr, validatorPtr, total, page, limit, layoutPtr](const Result& coursesResult) {
+                                       const auto& layout = *layoutPtr;
+                                       auto binding = layout.bind(coursesResult);
+
+                                       JsonStreamWriter writer(layout.estimateSize(coursesResult, binding) + 128);
+                                       writer.beginObject();
+                                       writer.key(kCoursesKey);
+                                       layout.writeArray(writer, coursesResult, binding);
+
+                                       writer.key("pagination");
+                                       writer.beginObject();
+                                       writer.key("page");
+                                       writer.intValue(page);
+                                       writer.key("limit");
+                                       writer.intValue(limit);
+                                       writer.key("total");
+                                       writer.intValue(total);
+                                       writer.key("pages");
+                                       writer.intValue((total + limit - 1) / limit);
+                                       writer.endObject();
+                                       writer.endObject();
+
+                                       auto resp = writer.toResponse();
+                                       HttpCache::apply(resp, *validatorPtr);
                                        (*callbackPtr)(resp);
                                    };
 
@@ -680,24 +799,50 @@ void CourseController::getCourses(const HttpRequestPtr& req,
     };
 
     // Вызываем подсчет с правильным количеством параметров
-    switch (countParams.size()) {
-    case 0:
-        executeCountQuery();
-        break;
-    case 1:
-        executeCountQuery(countParams[0]);
-        break;
-    case 2:
-        executeCountQuery(countParams[0], countParams[1]);
-        break;
-    case 3:
-        executeCountQuery(countParams[0], countParams[1], countParams[2]);
-        break;
-    default:
-        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Too many parameters"));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
-    }
+    auto executeListing = [executeCountQuery, countParams, callbackPtr, this]() {
+        switch (countParams.size()) {
+        case 0:
+            executeCountQuery();
+            break;
+        case 1:
+            executeCountQuery(countParams[0]);
+            break;
+        case 2:
+            executeCountQuery(countParams[0], countParams[1]);
+            break;
+        case 3:
+            executeCountQuery(countParams[0], countParams[1], countParams[2]);
+            break;
+        default:
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Too many parameters"));
+            resp->setStatusCode(k400BadRequest);
+            (*callbackPtr)(resp);
+        }
+    };
+
+    // Каталог один для всех, его версия - одна строка resource_versions.
+    // Если она не изменилась, подсчёт и выборка курсов не выполняются
+    dbClient->execSqlAsync(
+        "SELECT version, EXTRACT(EPOCH FROM updated_at)::bigint AS modified_at "
+        "FROM resource_versions WHERE resource = 'courses'",
+        [req, callbackPtr, validatorPtr, executeListing](const Result& versionResult) {
+            if (!versionResult.empty()) {
+                *validatorPtr = HttpCache::versioned(req, "courses",
+                                                     versionResult[0]["version"].as<string>(),
+                                                     versionResult[0]["modified_at"].as<int64_t>(),
+                                                     "");
+                if (HttpCache::isNotModified(req, *validatorPtr)) {
+                    (*callbackPtr)(HttpCache::notModified(*validatorPtr));
+                    return;
+                }
+            }
+            executeListing();
+        },
+        [executeListing](const DrogonDbException& e) {
+            // Без версии просто отдаём список без валидатора
+            LOG_ERROR << "Database error reading courses version: " << e.base().what();
+            executeListing();
+        });
 }
 
 // POST /courses - Создать курс
@@ -768,11 +913,19 @@ void CourseController::createCourse(const HttpRequestPtr& req,
         }
 
         dbClient->execSqlAsync(sql,
-                               [callback](const Result& result) {
+                               [req, callback, userId, title, category](const Result& result) {
                                    Json::Value response;
                                    response["id"] = result[0]["id"].as<string>();
                                    response["message"] = "Course created successfully";
 
+                                   Json::Value details;
+                                   details["title"] = title;
+                                   details["category"] = category;
+                                   AuditLogger::instance().record(req, userId, "course_created", "course",
+                                                                  response["id"].asString(), details);
+                                   // Карточка канала автора (счётчик курсов) на всех экземплярах
+                                   ProfileCache::instance().invalidate(userId);
+
                                    auto resp = HttpResponse::newHttpJsonResponse(response);
                                    resp->setStatusCode(k201Created);
                                    callback(resp);
@@ -810,11 +963,22 @@ void CourseController::getCourseById(const HttpRequestPtr& req,
     string userId = getCurrentUserId(req);
 
     // Получаем роль пользователя для проверки прав доступа
-    string userRole = getRoleFromToken(req->getHeader("Authorization").substr(7));
+    string userRole = getCurrentUserRole(req);
     bool hasAdminAccess = (userRole == "основатель" || userRole == "админ");
 
-    dbClient->execSqlAsync("SELECT * FROM courses WHERE id = $1",
-                           [userId, hasAdminAccess, callback, this](const Result& result) {
+    FieldSelection::Projection projection;
+    string fieldsError;
+    if (!courseFields().select(req->getParameter("fields"), {"id", "author_id", "is_published", "is_public"},
+                               projection, fieldsError)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", fieldsError));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+    auto layoutPtr = projection.layout;
+
+    dbClient->execSqlAsync("SELECT " + projection.columns + ", " + HttpCache::courseVersionColumns() + " FROM courses WHERE id = $1",
+                           [req, userId, hasAdminAccess, callback, layoutPtr, this](const Result& result) {
                                if (result.empty()) {
                                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not found"));
                                    resp->setStatusCode(k404NotFound);
@@ -823,12 +987,12 @@ void CourseController::getCourseById(const HttpRequestPtr& req,
                                }
 
                                try {
-                                   auto course = Courses(result[0]);
+                                   const auto& row = result[0];
 
                                    // Проверяем доступ к курсу
-                                   bool isPublished = course.getValueOfIsPublished();
-                                   bool isPublic = course.getValueOfIsPublic();
-                                   bool isAuthor = (userId == course.getValueOfAuthorId());
+                                   bool isPublished = row["is_published"].as<bool>();
+                                   bool isPublic = row["is_public"].as<bool>();
+                                   bool isAuthor = (userId == row["author_id"].as<string>());
 
                                    if (!isPublished && !isAuthor && !hasAdminAccess) {
                                        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not published"));
@@ -837,15 +1001,26 @@ void CourseController::getCourseById(const HttpRequestPtr& req,
                                        return;
                                    }
 
-                                   if (!isPublic && !isAuthor && !hasAdminAccess && !isEnrolledInCourse(userId, course.getValueOfId())) {
+                                   if (!isPublic && !isAuthor && !hasAdminAccess && !isEnrolledInCourse(userId, row["id"].as<string>())) {
                                        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course is private"));
                                        resp->setStatusCode(k403Forbidden);
                                        callback(resp);
                                        return;
                                    }
 
-                                   auto courseJson = getCourseJsonResponse(course);
-                                   auto resp = HttpResponse::newHttpJsonResponse(courseJson);
+                                   // Версия проверяется после прав доступа: 304 не должен раскрывать закрытый курс
+                                   auto validator = HttpCache::courseValidator(req, row, userId);
+                                   if (HttpCache::isNotModified(req, validator)) {
+                                       callback(HttpCache::notModified(validator));
+                                       return;
+                                   }
+
+                                   // Служебные колонки для проверок в ответ не попадают, если их не просили
+                                   auto binding = layoutPtr->bind(result);
+                                   JsonStreamWriter writer(layoutPtr->estimateSize(result, binding));
+                                   layoutPtr->writeObject(writer, row, binding);
+                                   auto resp = writer.toResponse();
+                                   HttpCache::apply(resp, validator);
                                    callback(resp);
 
                                } catch (const exception& e) {
@@ -995,10 +1170,12 @@ void CourseController::updateCourse(const HttpRequestPtr& req,
                                params.push_back(courseId);
 
                                // Выполняем обновление
-                               auto executeUpdate = [sql, params, callback, this](auto&&... args) {
+                               string authorId = courseResult[0]["author_id"].as<string>();
+                               auto executeUpdate = [sql, params, authorId, callback, this](auto&&... args) {
                                    auto dbClient = app().getDbClient();
                                    dbClient->execSqlAsync(sql,
-                                                          [callback](const Result& result) {
+                                                          [authorId, callback](const Result& result) {
+                                                              ProfileCache::instance().invalidate(authorId);
                                                               Json::Value response;
                                                               response["message"] = "Course updated successfully";
                                                               auto resp = HttpResponse::newHttpJsonResponse(response);
@@ -1075,7 +1252,7 @@ void CourseController::deleteCourse(const HttpRequestPtr& req,
 
     // Сначала проверяем существование курса
     dbClient->execSqlAsync("SELECT * FROM courses WHERE id = $1",
-                           [dbClient, courseId, callback, this](const Result& courseResult) {
+                           [req, userId, dbClient, courseId, callback, this](const Result& courseResult) {
                                if (courseResult.empty()) {
                                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not found"));
                                    resp->setStatusCode(k404NotFound);
@@ -1084,8 +1261,15 @@ void CourseController::deleteCourse(const HttpRequestPtr& req,
                                }
 
                                // Удаляем курс (каскадное удаление должно быть настроено в БД для связанных записей)
+                               Json::Value details;
+                               details["title"] = courseResult[0]["title"].as<string>();
+                               string authorId = courseResult[0]["author_id"].as<string>();
                                dbClient->execSqlAsync("DELETE FROM courses WHERE id = $1",
-                                                      [callback](const Result& result) {
+                                                      [req, userId, authorId, courseId, details, callback](const Result& result) {
+                                                          AuditLogger::instance().record(req, userId, "course_deleted", "course",
+                                                                                         courseId, details);
+                                                          ProfileCache::instance().invalidate(authorId);
+
                                                           Json::Value response;
                                                           response["message"] = "Course deleted successfully";
 
@@ -1123,16 +1307,16 @@ void CourseController::getCourseStructure(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
     string userId = getCurrentUserId(req);
+    auto dbClient = DbRouter::instance().reader(req, userId);
 
     // Получаем роль пользователя для проверки прав доступа
-    string userRole = getRoleFromToken(req->getHeader("Authorization").substr(7));
+    string userRole = getCurrentUserRole(req);
     bool hasAdminAccess = (userRole == "основатель" || userRole == "админ");
 
-    // Сначала проверяем доступ к курсу
-    dbClient->execSqlAsync("SELECT * FROM courses WHERE id = $1",
-                           [dbClient, userId, hasAdminAccess, callback, courseId, this](const Result& courseResult) {
+    // Сначала проверяем доступ к курсу, заодно читаем его версию
+    dbClient->execSqlAsync("SELECT *, " + HttpCache::courseVersionColumns() + " FROM courses WHERE id = $1",
+                           [dbClient, req, userId, hasAdminAccess, callback, courseId, this](const Result& courseResult) {
                                if (courseResult.empty()) {
                                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not found"));
                                    resp->setStatusCode(k404NotFound);
@@ -1162,32 +1346,33 @@ void CourseController::getCourseStructure(const HttpRequestPtr& req,
                                        return;
                                    }
 
+                                   // Глав и видео не читаем, если у клиента актуальная версия
+                                   auto validator = HttpCache::courseValidator(req, courseResult[0], userId);
+                                   if (HttpCache::isNotModified(req, validator)) {
+                                       callback(HttpCache::notModified(validator));
+                                       return;
+                                   }
+
                                    // Получаем главы курса
                                    dbClient->execSqlAsync(
                                        "SELECT * FROM course_chapters WHERE course_id = $1 ORDER BY \"order\" ASC",
-                                       [dbClient, courseId, callback, this](const Result& chaptersResult) {
-                                           // Исправление: создаем структуру внутри лямбды
-                                           Json::Value structure;
-                                           Json::Value chaptersArray(Json::arrayValue);
-
+                                       [dbClient, courseId, callback, validator, this](const Result& chaptersResult) {
                                            // Если глав нет, получаем видео без глав
                                            if (chaptersResult.empty()) {
                                                dbClient->execSqlAsync(
                                                    "SELECT * FROM course_videos WHERE course_id = $1 AND chapter_id IS NULL AND is_approved = true ORDER BY \"order\" ASC",
-                                                   [callback, this](const Result& videosResult) {
-                                                       Json::Value structure;
-                                                       Json::Value videosArray(Json::arrayValue);
-                                                       for (const auto& row : videosResult) {
-                                                           try {
-                                                               auto video = CourseVideos(row);
-                                                               videosArray.append(this->getVideoJsonResponse(video));
-                                                           } catch (const exception& e) {
-                                                               LOG_ERROR << "Error processing video data: " << e.what();
-                                                           }
-                                                       }
-                                                       structure["videos_without_chapters"] = videosArray;
-
-                                                       auto resp = HttpResponse::newHttpJsonResponse(structure);
+                                                   [callback, validator](const Result& videosResult) {
+                                                       const auto& layout = videoLayout();
+                                                       auto binding = layout.bind(videosResult);
+
+                                                       JsonStreamWriter writer(layout.estimateSize(videosResult, binding) + 64);
+                                                       writer.beginObject();
+                                                       writer.key(kVideosWithoutChaptersKey);
+                                                       layout.writeArray(writer, videosResult, binding);
+                                                       writer.endObject();
+
+                                                       auto resp = writer.toResponse();
+                                                       HttpCache::apply(resp, validator);
                                                        callback(resp);
                                                    },
                                                    [callback, this](const DrogonDbException& e) {
@@ -1201,60 +1386,59 @@ void CourseController::getCourseStructure(const HttpRequestPtr& req,
                                                return;
                                            }
 
-                                           // Исправление: используем shared_ptr для корректного захвата
-                                           auto structurePtr = std::make_shared<Json::Value>();
-                                           auto chaptersArrayPtr = std::make_shared<Json::Value>(Json::arrayValue);
-                                           auto remainingChapters = std::make_shared<int>(chaptersResult.size());
-
-                                           for (const auto& chapterRow : chaptersResult) {
-                                               try {
-                                                   auto chapter = CourseChapters(chapterRow);
-                                                   auto chapterJsonPtr = std::make_shared<Json::Value>(this->getChapterJsonResponse(chapter));
-                                                   string chapterId = chapter.getValueOfId();
-
-                                                   // Получаем видео для этой главы
-                                                   dbClient->execSqlAsync(
-                                                       "SELECT * FROM course_videos WHERE chapter_id = $1 AND is_approved = true ORDER BY \"order\" ASC",
-                                                       [chapterJsonPtr, chaptersArrayPtr, remainingChapters, structurePtr, callback, this](
-                                                           const Result& videosResult) {
-
-                                                           Json::Value videosArray(Json::arrayValue);
-                                                           for (const auto& videoRow : videosResult) {
-                                                               try {
-                                                                   auto video = CourseVideos(videoRow);
-                                                                   videosArray.append(this->getVideoJsonResponse(video));
-                                                               } catch (const exception& e) {
-                                                                   LOG_ERROR << "Error processing video data: " << e.what();
-                                                               }
-                                                           }
-                                                           (*chapterJsonPtr)["videos"] = videosArray;
-                                                           chaptersArrayPtr->append(*chapterJsonPtr);
-
-                                                           (*remainingChapters)--;
-                                                           if (*remainingChapters == 0) {
-                                                               (*structurePtr)["chapters"] = *chaptersArrayPtr;
-                                                               auto resp = HttpResponse::newHttpJsonResponse(*structurePtr);
-                                                               callback(resp);
+                                           // Видео всех глав одним запросом, раскладываем по главам в памяти
+                                           dbClient->execSqlAsync(
+                                               "SELECT * FROM course_videos WHERE course_id = $1 AND chapter_id IS NOT NULL AND is_approved = true ORDER BY \"order\" ASC",
+                                               [chaptersResult, callback, validator](const Result& videosResult) {
+                                                   const auto& chapters = chapterLayout();
+                                                   const auto& videos = videoLayout();
+                                                   auto chapterBinding = chapters.bind(chaptersResult);
+                                                   auto videoBinding = videos.bind(videosResult);
+
+                                                   // Строки результата живут до конца колбэка, ключи можно не копировать
+                                                   unordered_map<string_view, vector<size_t>> videosByChapter;
+                                                   for (size_t i = 0; i < videosResult.size(); ++i) {
+                                                       const auto& field = videosResult[i]["chapter_id"];
+                                                       videosByChapter[string_view(field.c_str(), field.length())].push_back(i);
+                                                   }
+
+                                                   JsonStreamWriter writer(chapters.estimateSize(chaptersResult, chapterBinding) +
+                                                                           videos.estimateSize(videosResult, videoBinding) +
+                                                                           chaptersResult.size() * 16 + 64);
+                                                   writer.beginObject();
+                                                   writer.key(kChaptersKey);
+                                                   writer.beginArray();
+                                                   for (const auto& chapterRow : chaptersResult) {
+                                                       writer.beginObject();
+                                                       chapters.writeFields(writer, chapterRow, chapterBinding);
+
+                                                       writer.key(kVideosKey);
+                                                       writer.beginArray();
+                                                       const auto& idField = chapterRow["id"];
+                                                       auto it = videosByChapter.find(string_view(idField.c_str(), idField.length()));
+                                                       if (it != videosByChapter.end()) {
+                                                           for (size_t index : it->second) {
+                                                               videos.writeObject(writer, videosResult[index], videoBinding);
                                                            }
-                                                       },
-                                                       [callback, this](const DrogonDbException& e) {
-                                                           LOG_ERROR << "Database error fetching chapter videos: " << e.base().what();
-                                                           auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-                                                           resp->setStatusCode(k500InternalServerError);
-                                                           callback(resp);
-                                                       },
-                                                       chapterId
-                                                       );
-                                               } catch (const exception& e) {
-                                                   LOG_ERROR << "Error processing chapter data: " << e.what();
-                                                   (*remainingChapters)--;
-                                                   if (*remainingChapters == 0) {
-                                                       (*structurePtr)["chapters"] = *chaptersArrayPtr;
-                                                       auto resp = HttpResponse::newHttpJsonResponse(*structurePtr);
-                                                       callback(resp);
+                                                       }
+                                                       writer.endArray();
+                                                       writer.endObject();
                                                    }
-                                               }
-                                           }
+                                                   writer.endArray();
+                                                   writer.endObject();
+
+                                                   auto resp = writer.toResponse();
+                                                   HttpCache::apply(resp, validator);
+                                                   callback(resp);
+                                               },
+                                               [callback, this](const DrogonDbException& e) {
+                                                   LOG_ERROR << "Database error fetching chapter videos: " << e.base().what();
+                                                   auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+                                                   resp->setStatusCode(k500InternalServerError);
+                                                   callback(resp);
+                                               },
+                                               courseId
+                                               );
                                        },
                                        [callback, this](const DrogonDbException& e) {
                                            LOG_ERROR << "Database error fetching chapters: " << e.base().what();
@@ -1282,6 +1466,82 @@ void CourseController::getCourseStructure(const HttpRequestPtr& req,
                            );
 }
 
+// Просмотры и лайки попадают в CounterService и пишутся в БД пакетами,
+// поэтому здесь нет ни одного запроса к базе
+void CourseController::recordVideoView(const HttpRequestPtr& req,
+                                       function<void(const HttpResponsePtr&)>&& callback,
+                                       const string& courseId,
+                                       const string& videoId) {
+    if (!isValidUUID(courseId) || !isValidUUID(videoId)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid ID format"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    // Зритель - пользователь или, без токена, адрес клиента
+    string userId = getCurrentUserId(req);
+    string viewerKey = userId.empty() ? "ip:" + req->peerAddr().toIp() : "user:" + userId;
+    // В рейтинг "в тренде" просмотр попадает из CounterService после проверки
+    CounterService::instance().recordView(viewerKey, courseId, videoId);
+
+    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("message", "View recorded"));
+    resp->setStatusCode(k202Accepted);
+    callback(resp);
+}
+
+void CourseController::likeVideo(const HttpRequestPtr& req,
+                                 function<void(const HttpResponsePtr&)>&& callback,
+                                 const string& courseId,
+                                 const string& videoId) {
+    string userId = getCurrentUserId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Unauthorized"));
+        resp->setStatusCode(k401Unauthorized);
+        callback(resp);
+        return;
+    }
+
+    if (!isValidUUID(courseId) || !isValidUUID(videoId)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid ID format"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    CounterService::instance().recordLike(userId, courseId, videoId, true);
+
+    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("message", "Like recorded"));
+    resp->setStatusCode(k202Accepted);
+    callback(resp);
+}
+
+void CourseController::unlikeVideo(const HttpRequestPtr& req,
+                                   function<void(const HttpResponsePtr&)>&& callback,
+                                   const string& courseId,
+                                   const string& videoId) {
+    string userId = getCurrentUserId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Unauthorized"));
+        resp->setStatusCode(k401Unauthorized);
+        callback(resp);
+        return;
+    }
+
+    if (!isValidUUID(courseId) || !isValidUUID(videoId)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid ID format"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    CounterService::instance().recordLike(userId, courseId, videoId, false);
+
+    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("message", "Like removed"));
+    resp->setStatusCode(k202Accepted);
+    callback(resp);
+}
+
 // POST /courses/{id}/enroll - Записаться на курс
 void CourseController::enrollInCourse(const HttpRequestPtr& req,
                                       function<void(const HttpResponsePtr&)>&& callback,
@@ -1332,7 +1592,10 @@ void CourseController::enrollInCourse(const HttpRequestPtr& req,
                     )";
 
                                                           dbClient->execSqlAsync(sql,
-                                                                                 [callback](const Result& result) {
+                                                                                 [callback, userId, courseId](const Result& result) {
+                                                                                     RecommendationService::instance().recordEnrollment(userId, courseId);
+                                                                                     TrendingService::instance().record(courseId, TrendingService::Signal::Enrollment);
+
                                                                                      Json::Value response;
                                                                                      response["message"] = "Successfully enrolled in course";
 
@@ -1420,6 +1683,87 @@ void CourseController::getEnrolledCourses(const HttpRequestPtr& req,
         );
 }
 
+// GET /courses/recommended - Рекомендации для текущего пользователя
+void CourseController::getRecommendedCourses(const HttpRequestPtr& req,
+                                             function<void(const HttpResponsePtr&)>&& callback) {
+    // Без токена - только популярные курсы
+    string userId = getCurrentUserId(req);
+
+    int limit = 20;
+    try {
+        if (!req->getParameter("limit").empty()) {
+            limit = stoi(req->getParameter("limit"));
+        }
+    } catch (const exception&) {
+        limit = -1;
+    }
+    if (limit < 1 || limit > 50) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid limit"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    FieldSelection::Projection projection;
+    string fieldsError;
+    if (!courseFields().select(req->getParameter("fields"), {"id"}, projection, fieldsError)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", fieldsError));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+    auto layoutPtr = projection.layout;
+
+    auto& recommendations = RecommendationService::instance();
+    if (!recommendations.ready()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Recommendations are not ready yet"));
+        resp->setStatusCode(k503ServiceUnavailable);
+        resp->addHeader("Retry-After", "5");
+        callback(resp);
+        return;
+    }
+
+    auto ranked = make_shared<vector<RankedCourse>>();
+    for (auto& item : recommendations.recommend(userId, limit)) {
+        ranked->push_back({move(item.courseId), item.score});
+    }
+    sendRankedCourses(ranked, projection, move(callback));
+}
+
+// GET /courses/trending - Курсы с наибольшей затухающей активностью (TrendingService)
+void CourseController::getTrendingCourses(const HttpRequestPtr& req,
+                                          function<void(const HttpResponsePtr&)>&& callback) {
+    int limit = 20;
+    try {
+        if (!req->getParameter("limit").empty()) {
+            limit = stoi(req->getParameter("limit"));
+        }
+    } catch (const exception&) {
+        limit = -1;
+    }
+    if (limit < 1 || limit > 100) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid limit"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    FieldSelection::Projection projection;
+    string fieldsError;
+    if (!courseFields().select(req->getParameter("fields"), {"id"}, projection, fieldsError)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", fieldsError));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    auto ranked = make_shared<vector<RankedCourse>>();
+    for (auto& entry : TrendingService::instance().top(req->getParameter("category"), limit)) {
+        ranked->push_back({move(entry.courseId), entry.score});
+    }
+    sendRankedCourses(ranked, projection, move(callback));
+}
+
 // GET /courses/{id}/chapters - Получить главы курса
 void CourseController::getChapters(const HttpRequestPtr& req,
                                    function<void(const HttpResponsePtr&)>&& callback,
@@ -1436,8 +1780,8 @@ void CourseController::getChapters(const HttpRequestPtr& req,
     string userId = getCurrentUserId(req);
 
     // Проверяем доступ к курсу
-    dbClient->execSqlAsync("SELECT * FROM courses WHERE id = $1",
-                           [dbClient, userId, callback, courseId, this, &req](const Result& courseResult) {
+    dbClient->execSqlAsync("SELECT *, " + HttpCache::courseVersionColumns() + " FROM courses WHERE id = $1",
+                           [dbClient, userId, callback, courseId, this, req](const Result& courseResult) {
                                if (courseResult.empty()) {
                                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not found"));
                                    resp->setStatusCode(k404NotFound);
@@ -1452,7 +1796,7 @@ void CourseController::getChapters(const HttpRequestPtr& req,
                                    bool isPublished = course.getValueOfIsPublished();
                                    bool isPublic = course.getValueOfIsPublic();
                                    bool isAuthor = (userId == course.getValueOfAuthorId());
-                                   string userRole = getRoleFromToken(req->getHeader("Authorization").substr(7));
+                                   string userRole = getCurrentUserRole(req);
                                    bool hasAdminAccess = (userRole == "основатель" || userRole == "админ");
 
                                    if (!isPublished && !isAuthor && !hasAdminAccess) {
@@ -1469,24 +1813,27 @@ void CourseController::getChapters(const HttpRequestPtr& req,
                                        return;
                                    }
 
+                                   auto validator = HttpCache::courseValidator(req, courseResult[0], userId);
+                                   if (HttpCache::isNotModified(req, validator)) {
+                                       callback(HttpCache::notModified(validator));
+                                       return;
+                                   }
+
                                    // Получаем главы курса
                                    dbClient->execSqlAsync(
                                        "SELECT * FROM course_chapters WHERE course_id = $1 ORDER BY \"order\" ASC",
-                                       [callback, this](const Result& chaptersResult) {
-                                           Json::Value response;
-                                           Json::Value chaptersArray(Json::arrayValue);
-
-                                           for (const auto& row : chaptersResult) {
-                                               try {
-                                                   auto chapter = CourseChapters(row);
-                                                   chaptersArray.append(getChapterJsonResponse(chapter));
-                                               } catch (const exception& e) {
-                                                   LOG_ERROR << "Error processing chapter data: " << e.what();
-                                               }
-                                           }
-
-                                           response["chapters"] = chaptersArray;
-                                           auto resp = HttpResponse::newHttpJsonResponse(response);
+                                       [callback, validator](const Result& chaptersResult) {
+                                           const auto& layout = chapterLayout();
+                                           auto binding = layout.bind(chaptersResult);
+
+                                           JsonStreamWriter writer(layout.estimateSize(chaptersResult, binding) + 32);
+                                           writer.beginObject();
+                                           writer.key(kChaptersKey);
+                                           layout.writeArray(writer, chaptersResult, binding);
+                                           writer.endObject();
+
+                                           auto resp = writer.toResponse();
+                                           HttpCache::apply(resp, validator);
                                            callback(resp);
                                        },
                                        [callback, this](const DrogonDbException& e) {
@@ -1819,12 +2166,24 @@ void CourseController::getVideos(const HttpRequestPtr& req,
     string userId = getCurrentUserId(req);
 
     // Получаем роль пользователя для проверки прав доступа
-    string userRole = getRoleFromToken(req->getHeader("Authorization").substr(7));
+    string userRole = getCurrentUserRole(req);
     bool hasAdminAccess = (userRole == "основатель" || userRole == "админ");
 
+    FieldSelection::Projection projection;
+    string fieldsError;
+    if (!videoFields().select(req->getParameter("fields"), {}, projection, fieldsError)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", fieldsError));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+    auto layoutPtr = projection.layout;
+    string videoColumns = projection.columns;
+
     // Проверяем доступ к курсу
-    dbClient->execSqlAsync("SELECT * FROM courses WHERE id = $1",
-                           [dbClient, userId, hasAdminAccess, callback, courseId, this](const Result& courseResult) {
+    dbClient->execSqlAsync("SELECT id, author_id, is_published, is_public, " + HttpCache::courseVersionColumns() +
+                           " FROM courses WHERE id = $1",
+                           [dbClient, req, userId, hasAdminAccess, callback, courseId, layoutPtr, videoColumns, this](const Result& courseResult) {
                                if (courseResult.empty()) {
                                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not found"));
                                    resp->setStatusCode(k404NotFound);
@@ -1833,12 +2192,12 @@ void CourseController::getVideos(const HttpRequestPtr& req,
                                }
 
                                try {
-                                   auto course = Courses(courseResult[0]);
+                                   const auto& courseRow = courseResult[0];
 
                                    // Проверяем доступ к курсу
-                                   bool isPublished = course.getValueOfIsPublished();
-                                   bool isPublic = course.getValueOfIsPublic();
-                                   bool isAuthor = (userId == course.getValueOfAuthorId());
+                                   bool isPublished = courseRow["is_published"].as<bool>();
+                                   bool isPublic = courseRow["is_public"].as<bool>();
+                                   bool isAuthor = (userId == courseRow["author_id"].as<string>());
 
                                    if (!isPublished && !isAuthor && !hasAdminAccess) {
                                        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not published"));
@@ -1847,38 +2206,43 @@ void CourseController::getVideos(const HttpRequestPtr& req,
                                        return;
                                    }
 
-                                   if (!isPublic && !isAuthor && !hasAdminAccess && !isEnrolledInCourse(userId, course.getValueOfId())) {
+                                   if (!isPublic && !isAuthor && !hasAdminAccess && !isEnrolledInCourse(userId, courseRow["id"].as<string>())) {
                                        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course is private"));
                                        resp->setStatusCode(k403Forbidden);
                                        callback(resp);
                                        return;
                                    }
 
+                                   // Счётчики видео сбрасываются в БД вместе с курсом, поэтому версия курса
+                                   // покрывает и views_count/likes_count в списке
+                                   auto validator = HttpCache::courseValidator(req, courseRow, userId);
+                                   if (HttpCache::isNotModified(req, validator)) {
+                                       callback(HttpCache::notModified(validator));
+                                       return;
+                                   }
+
                                    // Для студентов показываем только одобренные видео, для автора/админа - все
                                    string sql;
                                    if (isAuthor || hasAdminAccess) {
-                                       sql = "SELECT * FROM course_videos WHERE course_id = $1 ORDER BY \"order\" ASC";
+                                       sql = "SELECT " + videoColumns + " FROM course_videos WHERE course_id = $1 ORDER BY \"order\" ASC";
                                    } else {
-                                       sql = "SELECT * FROM course_videos WHERE course_id = $1 AND is_approved = true ORDER BY \"order\" ASC";
+                                       sql = "SELECT " + videoColumns + " FROM course_videos WHERE course_id = $1 AND is_approved = true ORDER BY \"order\" ASC";
                                    }
 
                                    dbClient->execSqlAsync(
                                        sql,
-                                       [callback, this](const Result& videosResult) {
-                                           Json::Value response;
-                                           Json::Value videosArray(Json::arrayValue);
-
-                                           for (const auto& row : videosResult) {
-                                               try {
-                                                   auto video = CourseVideos(row);
-                                                   videosArray.append(getVideoJsonResponse(video));
-                                               } catch (const exception& e) {
-                                                   LOG_ERROR << "Error processing video data: " << e.what();
-                                               }
-                                           }
-
-                                           response["videos"] = videosArray;
-                                           auto resp = HttpResponse::newHttpJsonResponse(response);
+                                       [callback, layoutPtr, validator](const Result& videosResult) {
+                                           const auto& layout = *layoutPtr;
+                                           auto binding = layout.bind(videosResult);
+
+                                           JsonStreamWriter writer(layout.estimateSize(videosResult, binding) + 32);
+                                           writer.beginObject();
+                                           writer.key(kVideosKey);
+                                           layout.writeArray(writer, videosResult, binding);
+                                           writer.endObject();
+
+                                           auto resp = writer.toResponse();
+                                           HttpCache::apply(resp, validator);
                                            callback(resp);
                                        },
                                        [callback, this](const DrogonDbException& e) {
@@ -1907,30 +2271,6 @@ void CourseController::getVideos(const HttpRequestPtr& req,
                            );
 }
 
-// Исправленные методы для работы с файлами
-bool CourseController::createCourseDirectory(const string& courseId) {
-    string coursePath = baseUploadPath_ + "/courses/" + courseId;
-    return ensureDirectoryExists(coursePath);
-}
-
-bool CourseController::createChapterDirectory(const string& courseId, const string& chapterId) {
-    string chapterPath = baseUploadPath_ + "/courses/" + courseId + "/chapters/" + chapterId;
-    return ensureDirectoryExists(chapterPath);
-}
-
-// Исправленная функция создания директорий
-bool CourseController::ensureDirectoryExists(const string& path) {
-    try {
-        if (fs::exists(path)) {
-            return true; // Директория уже существует - это не ошибка
-        }
-        return fs::create_directories(path);
-    } catch (const exception& e) {
-        LOG_ERROR << "Error creating directory: " << e.what();
-        return false;
-    }
-}
-
 void CourseController::createVideoInChapter(const HttpRequestPtr& req,
                                             function<void(const HttpResponsePtr&)>&& callback,
                                             const string& courseId,
@@ -1969,10 +2309,12 @@ void CourseController::createVideoInChapter(const HttpRequestPtr& req,
     }
 
     auto dbClient = app().getDbClient();
+    auto files = fileUpload.getFiles();
+    auto params = fileUpload.getParameters();
 
     // Сначала проверяем, что глава принадлежит курсу
     dbClient->execSqlAsync("SELECT * FROM course_chapters WHERE id = $1 AND course_id = $2",
-                           [dbClient, req, courseId, chapterId, userId, callback, this](const Result& chapterResult) {
+                           [req, dbClient, files, params, courseId, chapterId, userId, callback, this](const Result& chapterResult) {
                                if (chapterResult.empty()) {
                                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Chapter not found or doesn't belong to this course"));
                                    resp->setStatusCode(k404NotFound);
@@ -1980,65 +2322,55 @@ void CourseController::createVideoInChapter(const HttpRequestPtr& req,
                                    return;
                                }
 
-                               try {
-                                   // Создаем директории если не существуют
-                                   if (!createCourseDirectory(courseId)) {
-                                       throw runtime_error("Failed to create course directory");
-                                   }
-                                   if (!createChapterDirectory(courseId, chapterId)) {
-                                       throw runtime_error("Failed to create chapter directory");
-                                   }
-
-                                   // Парсим multipart данные для получения параметров
-                                   MultiPartParser fileUpload;
-                                   if (fileUpload.parse(req) != 0) {
-                                       throw runtime_error("Failed to parse multipart request");
-                                   }
-
-                                   auto params = fileUpload.getParameters();
-
-                                   // Сохраняем видео файл
-                                   auto videoFileInfo = saveVideoFile(req, courseId, chapterId);
-                                   if (videoFileInfo.filename.empty()) {
-                                       throw runtime_error("Failed to save video file");
-                                   }
+                               auto video = planVideoFile(files, courseId, chapterId);
+                               if (!video.source) {
+                                   auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to save video file"));
+                                   resp->setStatusCode(k400BadRequest);
+                                   callback(resp);
+                                   return;
+                               }
 
-                                   // Сохраняем обложку если есть
-                                   FileInfo coverFileInfo;
-                                   try {
-                                       coverFileInfo = saveCoverImage(req, courseId, chapterId);
-                                   } catch (const exception& e) {
-                                       LOG_WARN << "No cover image uploaded or failed to save: " << e.what();
-                                   }
+                               // Получаем данные из параметров multipart
+                               string title = params.find("title") != params.end() ? params.at("title") : "";
+                               string description = params.find("description") != params.end() ? params.at("description") : "";
+                               int order = 0;
+                               try {
+                                   string orderStr = params.find("order") != params.end() ? params.at("order") : "0";
+                                   order = stoi(orderStr);
+                               } catch (...) {}
+                               int durationSeconds = 0;
+                               try {
+                                   string durationStr = params.find("duration_seconds") != params.end() ? params.at("duration_seconds") : "0";
+                                   durationSeconds = stoi(durationStr);
+                               } catch (...) {}
+                               string duration = params.find("duration") != params.end() ? params.at("duration") : "00:00";
+                               bool hasSubtitles = params.find("has_subtitles") != params.end() ? params.at("has_subtitles") == "true" : false;
+                               bool hasNotes = params.find("has_notes") != params.end() ? params.at("has_notes") == "true" : false;
+
+                               // Невалидные данные отсекаем до записи файлов на диск
+                               if (title.empty()) {
+                                   auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Title is required"));
+                                   resp->setStatusCode(k400BadRequest);
+                                   callback(resp);
+                                   return;
+                               }
 
-                                   // Получаем данные из параметров multipart
-                                   string title = params.find("title") != params.end() ? params.at("title") : "";
-                                   string description = params.find("description") != params.end() ? params.at("description") : "";
-                                   int order = 0;
-                                   try {
-                                       string orderStr = params.find("order") != params.end() ? params.at("order") : "0";
-                                       order = stoi(orderStr);
-                                   } catch (...) {}
-                                   int durationSeconds = 0;
-                                   try {
-                                       string durationStr = params.find("duration_seconds") != params.end() ? params.at("duration_seconds") : "0";
-                                       durationSeconds = stoi(durationStr);
-                                   } catch (...) {}
-                                   string duration = params.find("duration") != params.end() ? params.at("duration") : "00:00";
-                                   bool hasSubtitles = params.find("has_subtitles") != params.end() ? params.at("has_subtitles") == "true" : false;
-                                   bool hasNotes = params.find("has_notes") != params.end() ? params.at("has_notes") == "true" : false;
-
-                                   if (title.empty()) {
-                                       // Удаляем загруженные файлы если данные невалидны
-                                       deleteFile(videoFileInfo.full_path);
-                                       if (!coverFileInfo.filename.empty()) {
-                                           deleteFile(coverFileInfo.full_path);
+                               // Видео и обложка пишутся вне IO-потока, запись в БД - после записи файлов
+                               auto videoFileInfo = video.info;
+                               saveVideoAndCover(
+                                   video, planCoverImage(files, courseId, chapterId),
+                                   [req, dbClient, videoFileInfo, courseId, chapterId, userId, title, description, order,
+                                    duration, durationSeconds, hasSubtitles, hasNotes, callback, this](const string& error, const FileInfo& coverFileInfo) {
+                                       if (!error.empty()) {
+                                           LOG_ERROR << "Error creating video in chapter: " << error;
+                                           auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to save video file"));
+                                           resp->setStatusCode(k500InternalServerError);
+                                           callback(resp);
+                                           return;
                                        }
-                                       throw runtime_error("Title is required");
-                                   }
 
-                                   // Сохраняем в базу данных
-                                   string sql = R"(
+                                       // Сохраняем в базу данных
+                                       string sql = R"(
                     INSERT INTO course_videos
                     (course_id, chapter_id, author_id, title, description, "order",
                      video_filename, video_path, actual_video_path,
@@ -2048,44 +2380,47 @@ void CourseController::createVideoInChapter(const HttpRequestPtr& req,
                     RETURNING id
                 )";
 
-                                   dbClient->execSqlAsync(sql,
-                                                          [callback, videoFileInfo](const Result& result) {
-                                                              Json::Value response;
-                                                              response["id"] = result[0]["id"].as<string>();
-                                                              response["message"] = "Video created successfully in chapter";
-                                                              response["video_path"] = videoFileInfo.path;
-                                                              response["file_size"] = static_cast<Json::Int64>(videoFileInfo.size);
-
-                                                              auto resp = HttpResponse::newHttpJsonResponse(response);
-                                                              resp->setStatusCode(k201Created);
-                                                              callback(resp);
-                                                          },
-                                                          [callback, videoFileInfo, coverFileInfo, this](const DrogonDbException& e) {
-                                                              // Удаляем файлы если запись в БД не удалась
-                                                              deleteFile(videoFileInfo.full_path);
-                                                              if (!coverFileInfo.filename.empty()) {
-                                                                  deleteFile(coverFileInfo.full_path);
-                                                              }
-
-                                                              LOG_ERROR << "Database error creating video in chapter: " << e.base().what();
-                                                              auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to create video"));
-                                                              resp->setStatusCode(k500InternalServerError);
-                                                              callback(resp);
-                                                          },
-                                                          courseId, chapterId, userId, title, description, order,
-                                                          videoFileInfo.filename, videoFileInfo.path, videoFileInfo.full_path,
-                                                          duration, durationSeconds,
-                                                          coverFileInfo.filename.empty() ? "" : coverFileInfo.path,
-                                                          coverFileInfo.filename.empty() ? "" : coverFileInfo.full_path,
-                                                          hasSubtitles, hasNotes, static_cast<int64_t>(videoFileInfo.size), videoFileInfo.mime_type
-                                                          );
-
-                               } catch (const exception& e) {
-                                   LOG_ERROR << "Error creating video in chapter: " << e.what();
-                                   auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", e.what()));
-                                   resp->setStatusCode(k400BadRequest);
-                                   callback(resp);
-                               }
+                                       dbClient->execSqlAsync(sql,
+                                                              [req, userId, title, callback, videoFileInfo, courseId, chapterId](const Result& result) {
+                                                                  // Спрайты для перемотки готовятся в фоне
+                                                                  VideoPreviewService::instance().enqueue(videoFileInfo.full_path, videoFileInfo.path,
+                                                                                                          result[0]["id"].as<string>());
+
+                                                                  Json::Value response;
+                                                                  response["id"] = result[0]["id"].as<string>();
+                                                                  response["message"] = "Video created successfully in chapter";
+
+                                                                  Json::Value details;
+                                                                  details["course_id"] = courseId;
+                                                                  details["chapter_id"] = chapterId;
+                                                                  details["title"] = title;
+                                                                  details["file_size"] = static_cast<Json::Int64>(videoFileInfo.size);
+                                                                  AuditLogger::instance().record(req, userId, "video_uploaded", "video",
+                                                                                                 response["id"].asString(), details);
+                                                                  response["video_path"] = videoFileInfo.path;
+                                                                  response["file_size"] = static_cast<Json::Int64>(videoFileInfo.size);
+
+                                                                  auto resp = HttpResponse::newHttpJsonResponse(response);
+                                                                  resp->setStatusCode(k201Created);
+                                                                  callback(resp);
+                                                              },
+                                                              [callback, videoFileInfo, coverFileInfo, this](const DrogonDbException& e) {
+                                                                  // Удаляем файлы если запись в БД не удалась
+                                                                  deleteFiles({videoFileInfo.full_path, coverFileInfo.full_path});
+
+                                                                  LOG_ERROR << "Database error creating video in chapter: " << e.base().what();
+                                                                  auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to create video"));
+                                                                  resp->setStatusCode(k500InternalServerError);
+                                                                  callback(resp);
+                                                              },
+                                                              courseId, chapterId, userId, title, description, order,
+                                                              videoFileInfo.filename, videoFileInfo.path, videoFileInfo.full_path,
+                                                              duration, durationSeconds,
+                                                              coverFileInfo.filename.empty() ? "" : coverFileInfo.path,
+                                                              coverFileInfo.filename.empty() ? "" : coverFileInfo.full_path,
+                                                              hasSubtitles, hasNotes, static_cast<int64_t>(videoFileInfo.size), videoFileInfo.mime_type
+                                                              );
+                                   });
                            },
                            [callback, this](const DrogonDbException& e) {
                                LOG_ERROR << "Database error checking chapter: " << e.base().what();
@@ -2176,6 +2511,8 @@ void CourseController::updateVideoInCourse(const HttpRequestPtr& req,
                                if (jsonBody.isMember("video_path")) {
                                    updates.push_back("video_path = $" + to_string(params.size() + 1));
                                    params.push_back(jsonBody["video_path"].asString());
+                                   // Превью относилось к прежнему файлу
+                                   updates.push_back("preview_vtt = NULL");
                                }
 
                                if (jsonBody.isMember("duration")) {
@@ -2351,6 +2688,8 @@ void CourseController::updateVideoInChapter(const HttpRequestPtr& req,
                                if (jsonBody.isMember("video_path")) {
                                    updates.push_back("video_path = $" + to_string(params.size() + 1));
                                    params.push_back(jsonBody["video_path"].asString());
+                                   // Превью относилось к прежнему файлу
+                                   updates.push_back("preview_vtt = NULL");
                                }
 
                                if (jsonBody.isMember("duration")) {
@@ -2478,7 +2817,7 @@ void CourseController::deleteVideo(const HttpRequestPtr& req,
 
     // Сначала проверяем существование видео
     dbClient->execSqlAsync("SELECT * FROM course_videos WHERE id = $1 AND course_id = $2",
-                           [dbClient, videoId, callback, this](const Result& videoResult) {
+                           [req, userId, courseId, dbClient, videoId, callback, this](const Result& videoResult) {
                                if (videoResult.empty()) {
                                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Video not found"));
                                    resp->setStatusCode(k404NotFound);
@@ -2495,14 +2834,22 @@ void CourseController::deleteVideo(const HttpRequestPtr& req,
 
                                    // Удаляем видео
                                    dbClient->execSqlAsync("DELETE FROM course_videos WHERE id = $1",
-                                                          [callback, actualVideoPath, actualCoverPath, this](const Result& result) {
-                                                              // Удаляем физические файлы
+                                                          [req, userId, courseId, videoId, callback, actualVideoPath, actualCoverPath, this](const Result& result) {
+                                                              Json::Value details;
+                                                              details["course_id"] = courseId;
+                                                              AuditLogger::instance().record(req, userId, "video_deleted", "video",
+                                                                                             videoId, details);
+
+                                                              // Удаляем физические файлы (в БД пути относительно uploads)
+                                                              vector<string> paths;
                                                               if (!actualVideoPath.empty()) {
-                                                                  deleteFile(actualVideoPath);
+                                                                  paths.push_back(baseUploadPath_ + "/" + actualVideoPath);
+                                                                  VideoPreviewService::instance().removePreviews(baseUploadPath_ + "/" + actualVideoPath);
                                                               }
                                                               if (!actualCoverPath.empty()) {
-                                                                  deleteFile(actualCoverPath);
+                                                                  paths.push_back(baseUploadPath_ + "/" + actualCoverPath);
                                                               }
+                                                              deleteFiles(std::move(paths));
 
                                                               Json::Value response;
                                                               response["message"] = "Video deleted successfully";
@@ -2798,9 +3145,10 @@ void CourseController::unenrollFromCourse(const HttpRequestPtr& req,
 
     // Удаляем запись о зачислении
     dbClient->execSqlAsync("DELETE FROM course_enrollments WHERE user_id = $1 AND course_id = $2",
-                           [callback](const Result& result) {
+                           [callback, userId, courseId](const Result& result) {
                                Json::Value response;
                                if (result.affectedRows() > 0) {
+                                   RecommendationService::instance().recordUnenrollment(userId, courseId);
                                    response["message"] = "Successfully unenrolled from course";
                                } else {
                                    response["message"] = "Not enrolled in this course";
@@ -2847,35 +3195,126 @@ void CourseController::uploadVideoFile(const HttpRequestPtr& req,
         return;
     }
 
-    try {
-        // Создаем директорию курса если не существует
-        if (!createCourseDirectory(courseId)) {
-            throw runtime_error("Failed to create course directory");
-        }
+    auto video = planVideoFile(fileUpload.getFiles(), courseId);
+    if (!video.source) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to save file"));
+        resp->setStatusCode(k500InternalServerError);
+        callback(resp);
+        return;
+    }
 
-        // Сохраняем файл
-        auto fileInfo = saveVideoFile(req, courseId);
-        if (fileInfo.filename.empty()) {
-            throw runtime_error("Failed to save file");
-        }
+    auto fileInfo = video.info;
+    FileIoExecutor::instance().writeFile(
+        *video.source, fileInfo.full_path,
+        [callback, fileInfo, this](const string& error) {
+            if (!error.empty()) {
+                LOG_ERROR << "Error uploading file: " << error;
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to save file"));
+                resp->setStatusCode(k500InternalServerError);
+                callback(resp);
+                return;
+            }
+
+            Json::Value response;
+            response["filename"] = fileInfo.filename;
+            response["path"] = fileInfo.path;
+            response["full_path"] = fileInfo.full_path;
+            response["size"] = static_cast<Json::Int64>(fileInfo.size);
+            response["mime_type"] = fileInfo.mime_type;
+            response["message"] = "File uploaded successfully";
+
+            auto resp = HttpResponse::newHttpJsonResponse(response);
+            callback(resp);
+        });
+}
+
+void CourseController::uploadCourseCover(const HttpRequestPtr& req,
+                                         function<void(const HttpResponsePtr&)>&& callback,
+                                         const string& courseId) {
 
-        Json::Value response;
-        response["filename"] = fileInfo.filename;
-        response["path"] = fileInfo.path;
-        response["full_path"] = fileInfo.full_path;
-        response["size"] = static_cast<Json::Int64>(fileInfo.size);
-        response["mime_type"] = fileInfo.mime_type;
-        response["message"] = "File uploaded successfully";
+    string userId = getCurrentUserId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Unauthorized"));
+        resp->setStatusCode(k401Unauthorized);
+        callback(resp);
+        return;
+    }
 
-        auto resp = HttpResponse::newHttpJsonResponse(response);
+    if (!isValidUUID(courseId)) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid course ID format"));
+        resp->setStatusCode(k400BadRequest);
         callback(resp);
+        return;
+    }
 
-    } catch (const exception& e) {
-        LOG_ERROR << "Error uploading file: " << e.what();
-        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", e.what()));
-        resp->setStatusCode(k500InternalServerError);
+    if (!isCourseAuthor(userId, courseId) && !hasPermission(req, {"основатель", "админ"})) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden - only course author can update course"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    MultiPartParser fileUpload;
+    if (fileUpload.parse(req) != 0 || fileUpload.getFiles().empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "No file uploaded or failed to parse request"));
+        resp->setStatusCode(k400BadRequest);
         callback(resp);
+        return;
     }
+
+    // Варианты обложки (thumb/card/full) готовятся в очереди ImageService
+    ImageService::instance().processUpload(
+        fileUpload.getFiles()[0], ImageService::ImageKind::CourseCover, courseId,
+        [callback, courseId, this](const ImageService::ImageVariants& variants, const string& error) {
+            if (!error.empty()) {
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid image: " + error));
+                resp->setStatusCode(k400BadRequest);
+                callback(resp);
+                return;
+            }
+
+            auto dbClient = app().getDbClient();
+
+            // Одним запросом меняем обложку и получаем старый путь для удаления
+            dbClient->execSqlAsync(
+                R"(
+                    UPDATE courses c
+                    SET cover_path = $1, updated_at = NOW()
+                    FROM (SELECT id, cover_path AS old_cover_path FROM courses WHERE id = $2 FOR UPDATE) old
+                    WHERE c.id = old.id
+                    RETURNING old.old_cover_path
+                )",
+                [callback, variants, this](const Result& result) {
+                    if (result.empty()) {
+                        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Course not found"));
+                        resp->setStatusCode(k404NotFound);
+                        callback(resp);
+                        return;
+                    }
+
+                    if (!result[0]["old_cover_path"].isNull()) {
+                        string oldCoverPath = result[0]["old_cover_path"].as<string>();
+                        if (!oldCoverPath.empty() && oldCoverPath != variants.full) {
+                            ImageService::instance().deleteVariants(oldCoverPath);
+                        }
+                    }
+
+                    Json::Value response;
+                    response["message"] = "Cover uploaded successfully";
+                    response["cover_path"] = variants.full;
+                    response["cover_variants"] = ImageService::variantsJson(variants.full);
+                    auto resp = HttpResponse::newHttpJsonResponse(response);
+                    callback(resp);
+                },
+                [callback, this](const DrogonDbException& e) {
+                    LOG_ERROR << "Database error updating course cover: " << e.base().what();
+                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to update cover"));
+                    resp->setStatusCode(k500InternalServerError);
+                    callback(resp);
+                },
+                variants.full, courseId
+                );
+        });
 }
 
 void CourseController::createVideoInCourse(const HttpRequestPtr& req,
@@ -2925,133 +3364,126 @@ void CourseController::createVideoInCourse(const HttpRequestPtr& req,
 
     auto dbClient = app().getDbClient();
 
-    try {
-        // Создаем директорию курса если не существует
-        string videosPath = baseUploadPath_ + "/courses/" + courseId + "/videos";
-        if (!ensureDirectoryExists(videosPath)) {
-            throw runtime_error("Failed to create videos directory");
-        }
+    auto video = planVideoFile(files, courseId);
+    if (!video.source) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to save video file"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
 
-        // Сохраняем видео файл
-        auto videoFileInfo = saveVideoFile(req, courseId);
-        if (videoFileInfo.filename.empty()) {
-            throw runtime_error("Failed to save video file");
-        }
+    // Получаем параметры из multipart данных
+    auto params = fileUpload.getParameters();
+
+    // Извлекаем обязательные поля из form-data; невалидные данные отсекаем до записи файлов
+    string title;
+    if (params.find("title") != params.end()) {
+        title = params.at("title");
+    } else {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Title is required"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
 
-        // Сохраняем обложку если есть
-        FileInfo coverFileInfo;
+    string description = params.find("description") != params.end() ? params.at("description") : "";
+
+    int order = 0;
+    if (params.find("order") != params.end()) {
         try {
-            coverFileInfo = saveCoverImage(req, courseId);
+            order = stoi(params.at("order"));
         } catch (const exception& e) {
-            LOG_WARN << "No cover image uploaded or failed to save: " << e.what();
+            LOG_WARN << "Invalid order value, using default: " << e.what();
+            order = 0;
         }
+    }
 
-        // Получаем параметры из multipart данных
-        auto params = fileUpload.getParameters();
-
-        // Извлекаем обязательные поля из form-data
-        string title;
-        if (params.find("title") != params.end()) {
-            title = params.at("title");
-        } else {
-            // Удаляем загруженные файлы если данные невалидны
-            deleteFile(videoFileInfo.full_path);
-            if (!coverFileInfo.filename.empty()) {
-                deleteFile(coverFileInfo.full_path);
-            }
-            throw runtime_error("Title is required");
-        }
-
-        string description = params.find("description") != params.end() ? params.at("description") : "";
-
-        int order = 0;
-        if (params.find("order") != params.end()) {
-            try {
-                order = stoi(params.at("order"));
-            } catch (const exception& e) {
-                LOG_WARN << "Invalid order value, using default: " << e.what();
-                order = 0;
-            }
+    int durationSeconds = 0;
+    if (params.find("duration_seconds") != params.end()) {
+        try {
+            durationSeconds = stoi(params.at("duration_seconds"));
+        } catch (const exception& e) {
+            LOG_WARN << "Invalid duration_seconds value: " << e.what();
         }
+    }
 
-        int durationSeconds = 0;
-        if (params.find("duration_seconds") != params.end()) {
-            try {
-                durationSeconds = stoi(params.at("duration_seconds"));
-            } catch (const exception& e) {
-                LOG_WARN << "Invalid duration_seconds value: " << e.what();
+    string duration = params.find("duration") != params.end() ? params.at("duration") : "00:00";
+    bool hasSubtitles = params.find("has_subtitles") != params.end() ?
+                            (params.at("has_subtitles") == "true" || params.at("has_subtitles") == "1") : false;
+    bool hasNotes = params.find("has_notes") != params.end() ?
+                        (params.at("has_notes") == "true" || params.at("has_notes") == "1") : false;
+
+    // Видео и обложка пишутся вне IO-потока, запись в БД - после записи файлов
+    auto videoFileInfo = video.info;
+    saveVideoAndCover(
+        video, planCoverImage(files, courseId),
+        [req, dbClient, videoFileInfo, courseId, userId, title, description, order,
+         duration, durationSeconds, hasSubtitles, hasNotes, callback, this](const string& error, const FileInfo& coverFileInfo) {
+            if (!error.empty()) {
+                LOG_ERROR << "Error creating video: " << error;
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to save video file"));
+                resp->setStatusCode(k500InternalServerError);
+                callback(resp);
+                return;
             }
-        }
-
-        string duration = params.find("duration") != params.end() ? params.at("duration") : "00:00";
-        bool hasSubtitles = params.find("has_subtitles") != params.end() ?
-                                (params.at("has_subtitles") == "true" || params.at("has_subtitles") == "1") : false;
-        bool hasNotes = params.find("has_notes") != params.end() ?
-                            (params.at("has_notes") == "true" || params.at("has_notes") == "1") : false;
 
-        // Сохраняем в базу данных
-        string sql = R"(
-            INSERT INTO course_videos
-            (course_id, author_id, title, description, "order",
-             video_filename, video_path, actual_video_path,
-             duration, duration_seconds, cover_path, actual_cover_path,
-             has_subtitles, has_notes, file_size, mime_type)
-            VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, $14, $15, $16)
-            RETURNING id
-        )";
-
-        dbClient->execSqlAsync(sql,
-                               [callback, videoFileInfo](const Result& result) {
-                                   Json::Value response;
-                                   response["id"] = result[0]["id"].as<string>();
-                                   response["message"] = "Video created successfully";
-                                   response["video_path"] = videoFileInfo.path;
-                                   response["file_size"] = static_cast<Json::Int64>(videoFileInfo.size);
+            // Сохраняем в базу данных
+            string sql = R"(
+                INSERT INTO course_videos
+                (course_id, author_id, title, description, "order",
+                 video_filename, video_path, actual_video_path,
+                 duration, duration_seconds, cover_path, actual_cover_path,
+                 has_subtitles, has_notes, file_size, mime_type)
+                VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13, $14, $15, $16)
+                RETURNING id
+            )";
+
+            dbClient->execSqlAsync(sql,
+                                   [req, userId, title, callback, videoFileInfo, courseId](const Result& result) {
+                                       // Спрайты для перемотки готовятся в фоне
+                                       VideoPreviewService::instance().enqueue(videoFileInfo.full_path, videoFileInfo.path,
+                                                                               result[0]["id"].as<string>());
 
-                                   auto resp = HttpResponse::newHttpJsonResponse(response);
-                                   resp->setStatusCode(k201Created);
-                                   callback(resp);
-                               },
-                               [callback, videoFileInfo, coverFileInfo, this](const DrogonDbException& e) {
-                                   // Удаляем файлы если запись в БД не удалась
-                                   deleteFile(videoFileInfo.full_path);
-                                   if (!coverFileInfo.filename.empty()) {
-                                       deleteFile(coverFileInfo.full_path);
-                                   }
+                                       Json::Value response;
+                                       response["id"] = result[0]["id"].as<string>();
+                                       response["message"] = "Video created successfully";
+
+                                       Json::Value details;
+                                       details["course_id"] = courseId;
+                                       details["title"] = title;
+                                       details["file_size"] = static_cast<Json::Int64>(videoFileInfo.size);
+                                       AuditLogger::instance().record(req, userId, "video_uploaded", "video",
+                                                                      response["id"].asString(), details);
+                                       response["video_path"] = videoFileInfo.path;
+                                       response["file_size"] = static_cast<Json::Int64>(videoFileInfo.size);
 
-                                   LOG_ERROR << "Database error creating video: " << e.base().what();
-                                   auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to create video"));
-                                   resp->setStatusCode(k500InternalServerError);
-                                   callback(resp);
-                               },
-                               courseId, userId, title, description, order,
-                               videoFileInfo.filename, videoFileInfo.path, videoFileInfo.full_path,
-                               duration, durationSeconds,
-                               coverFileInfo.filename.empty() ? "" : coverFileInfo.path,
-                               coverFileInfo.filename.empty() ? "" : coverFileInfo.full_path,
-                               hasSubtitles, hasNotes, static_cast<int64_t>(videoFileInfo.size), videoFileInfo.mime_type
-                               );
+                                       auto resp = HttpResponse::newHttpJsonResponse(response);
+                                       resp->setStatusCode(k201Created);
+                                       callback(resp);
+                                   },
+                                   [callback, videoFileInfo, coverFileInfo, this](const DrogonDbException& e) {
+                                       // Удаляем файлы если запись в БД не удалась
+                                       deleteFiles({videoFileInfo.full_path, coverFileInfo.full_path});
 
-    } catch (const exception& e) {
-        LOG_ERROR << "Error creating video: " << e.what();
-        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", e.what()));
-        resp->setStatusCode(k400BadRequest);
-        callback(resp);
-    }
+                                       LOG_ERROR << "Database error creating video: " << e.base().what();
+                                       auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to create video"));
+                                       resp->setStatusCode(k500InternalServerError);
+                                       callback(resp);
+                                   },
+                                   courseId, userId, title, description, order,
+                                   videoFileInfo.filename, videoFileInfo.path, videoFileInfo.full_path,
+                                   duration, durationSeconds,
+                                   coverFileInfo.filename.empty() ? "" : coverFileInfo.path,
+                                   coverFileInfo.filename.empty() ? "" : coverFileInfo.full_path,
+                                   hasSubtitles, hasNotes, static_cast<int64_t>(videoFileInfo.size), videoFileInfo.mime_type
+                                   );
+        });
 }
 
-CourseController::FileInfo CourseController::saveVideoFile(const HttpRequestPtr& req,
-                                                           const string& courseId,
-                                                           const string& chapterId) {
-    FileInfo fileInfo;
-
-    // Используем MultiPartParser для получения файлов
-    MultiPartParser fileUpload;
-    if (fileUpload.parse(req) != 0 || fileUpload.getFiles().size() == 0) {
-        return fileInfo; // возвращаем пустой FileInfo
-    }
-
-    auto files = fileUpload.getFiles();
+CourseController::PlannedFile CourseController::planVideoFile(const vector<HttpFile>& files,
+                                                              const string& courseId,
+                                                              const string& chapterId) {
+    PlannedFile planned;
 
     // Ищем видео файл (первый файл или с определенным именем)
     for (const auto& file : files) {
@@ -3067,7 +3499,7 @@ CourseController::FileInfo CourseController::saveVideoFile(const HttpRequestPtr&
             name.find(".mov") != string::npos ||
             name.find(".webm") != string::npos) {
 
-            // Определяем путь для сохранения
+            // Определяем путь для сохранения; каталоги создаёт FileIoExecutor при записи
             string savePath;
             if (chapterId.empty()) {
                 savePath = baseUploadPath_ + "/courses/" + courseId + "/videos";
@@ -3075,29 +3507,22 @@ CourseController::FileInfo CourseController::saveVideoFile(const HttpRequestPtr&
                 savePath = baseUploadPath_ + "/courses/" + courseId + "/chapters/" + chapterId + "/videos";
             }
 
-            // Создаем директорию если не существует
-            if (!ensureDirectoryExists(savePath)) {
-                throw runtime_error("Failed to create directory: " + savePath);
-            }
-
             string filename = generateFilename(file.getFileName());
             string fullPath = savePath + "/" + filename;
 
-            // Сохраняем файл
-            file.saveAs(fullPath);
-
             // Заполняем информацию о файле
-            fileInfo.filename = filename;
-            fileInfo.path = fullPath.substr(baseUploadPath_.length() + 1); // относительный путь
-            fileInfo.full_path = fullPath;
-            fileInfo.size = file.fileLength();
-            fileInfo.mime_type = mimeType;
+            planned.info.filename = filename;
+            planned.info.path = fullPath.substr(baseUploadPath_.length() + 1); // относительный путь
+            planned.info.full_path = fullPath;
+            planned.info.size = file.fileLength();
+            planned.info.mime_type = mimeType;
+            planned.source = make_shared<HttpFile>(file);
 
             break; // Используем первый найденный видео файл
         }
     }
 
-    return fileInfo;
+    return planned;
 }
 
 // =============================================================================
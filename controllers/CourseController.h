@@ -54,14 +54,22 @@ public:
     // Перемещение видео
     ADD_METHOD_TO(CourseController::moveVideoPosition, "/courses/{1}/videos/{2}/position", Put);
 
+    // Просмотры и лайки
+    ADD_METHOD_TO(CourseController::recordVideoView, "/courses/{1}/videos/{2}/view", Post);
+    ADD_METHOD_TO(CourseController::likeVideo, "/courses/{1}/videos/{2}/like", Post);
+    ADD_METHOD_TO(CourseController::unlikeVideo, "/courses/{1}/videos/{2}/like", Delete);
+
     // Запись на курс
     ADD_METHOD_TO(CourseController::enrollInCourse, "/courses/{1}/enroll", Post);
     ADD_METHOD_TO(CourseController::unenrollFromCourse, "/courses/{1}/enroll", Delete);
     ADD_METHOD_TO(CourseController::getEnrollments, "/courses/{1}/enrollments", Get);
     ADD_METHOD_TO(CourseController::getEnrolledCourses, "/courses/enrolled", Get);
+    ADD_METHOD_TO(CourseController::getRecommendedCourses, "/courses/recommended", Get);
+    ADD_METHOD_TO(CourseController::getTrendingCourses, "/courses/trending", Get);
 
     // Загрузка файлов
     ADD_METHOD_TO(CourseController::uploadVideoFile, "/courses/{1}/upload", Post);
+    ADD_METHOD_TO(CourseController::uploadCourseCover, "/courses/{1}/cover", Post);
     METHOD_LIST_END
 
         // Основные методы курсов
@@ -139,6 +147,20 @@ public:
                            const std::string& courseId,
                            const std::string& videoId);
 
+    // Просмотры и лайки
+    void recordVideoView(const HttpRequestPtr& req,
+                         std::function<void(const HttpResponsePtr&)>&& callback,
+                         const std::string& courseId,
+                         const std::string& videoId);
+    void likeVideo(const HttpRequestPtr& req,
+                   std::function<void(const HttpResponsePtr&)>&& callback,
+                   const std::string& courseId,
+                   const std::string& videoId);
+    void unlikeVideo(const HttpRequestPtr& req,
+                     std::function<void(const HttpResponsePtr&)>&& callback,
+                     const std::string& courseId,
+                     const std::string& videoId);
+
     // Запись на курс
     void enrollInCourse(const HttpRequestPtr& req,
                         std::function<void(const HttpResponsePtr&)>&& callback,
@@ -151,11 +173,20 @@ public:
                         const std::string& courseId);
     void getEnrolledCourses(const HttpRequestPtr& req,
                             std::function<void(const HttpResponsePtr&)>&& callback);
+    // Рекомендации по совместным записям (RecommendationService)
+    void getRecommendedCourses(const HttpRequestPtr& req,
+                               std::function<void(const HttpResponsePtr&)>&& callback);
+    // Тренды по затухающим счётчикам активности (TrendingService)
+    void getTrendingCourses(const HttpRequestPtr& req,
+                            std::function<void(const HttpResponsePtr&)>&& callback);
 
     // Загрузка файлов
     void uploadVideoFile(const HttpRequestPtr& req,
                          std::function<void(const HttpResponsePtr&)>&& callback,
                          const std::string& courseId);
+    void uploadCourseCover(const HttpRequestPtr& req,
+                           std::function<void(const HttpResponsePtr&)>&& callback,
+                           const std::string& courseId);
 
 private:
     // Структура для информации о файле
@@ -167,8 +198,15 @@ private:
         std::string mime_type;
     };
 
+    // Файл из multipart-запроса и место, куда он будет записан
+    struct PlannedFile {
+        FileInfo info;
+        std::shared_ptr<HttpFile> source;  // nullptr - файла нет
+    };
+
     // JWT аутентификация
     std::string getCurrentUserId(const HttpRequestPtr& req);
+    std::string getCurrentUserRole(const HttpRequestPtr& req);
     bool validateJWT(const std::string& token);
     std::string getUserIdFromToken(const std::string& token);
     std::string getRoleFromToken(const std::string& token);
@@ -183,24 +221,22 @@ private:
     // Вспомогательные методы
     Json::Value createJsonResponse(const std::string& key, const std::string& value);
     Json::Value getCourseJsonResponse(const Courses& course);
-    Json::Value getChapterJsonResponse(const CourseChapters& chapter);
-    Json::Value getVideoJsonResponse(const CourseVideos& video);
 
     // Проверка прав доступа
     bool isCourseAuthor(const std::string& userId, const std::string& courseId);
     bool isVideoAuthor(const std::string& userId, const std::string& videoId);
     bool isEnrolledInCourse(const std::string& userId, const std::string& courseId);
 
-    // Методы для работы с файлами
-    bool createCourseDirectory(const std::string& courseId);
-    bool createChapterDirectory(const std::string& courseId, const std::string& chapterId);
-    FileInfo saveVideoFile(const HttpRequestPtr& req, const std::string& courseId, const std::string& chapterId = "");
-    FileInfo saveCoverImage(const HttpRequestPtr& req, const std::string& courseId, const std::string& chapterId = "");
-    bool deleteFile(const std::string& path);
+    // Методы для работы с файлами: запись и удаление идут через FileIoExecutor,
+    // поток обработчика диска не ждёт
+    PlannedFile planVideoFile(const std::vector<HttpFile>& files, const std::string& courseId, const std::string& chapterId = "");
+    PlannedFile planCoverImage(const std::vector<HttpFile>& files, const std::string& courseId, const std::string& chapterId = "");
+    void saveVideoAndCover(const PlannedFile& video, const PlannedFile& cover,
+                           std::function<void(const std::string& error, const FileInfo& cover)>&& done);
+    void deleteFiles(std::vector<std::string> paths);
     std::string getFilePath(const std::string& courseId, const std::string& chapterId,
                             const std::string& filename, bool isCover = false);
     std::string generateFilename(const std::string& originalName);
-    bool ensureDirectoryExists(const std::string& path);
     std::string getMimeType(const std::string& filename);
 
     // Вспомогательный метод для обновления позиции видео
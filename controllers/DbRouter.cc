@@ -0,0 +1,365 @@
+#include "DbRouter.h"
+#include "AuthContext.h"
+#include "InvalidationBus.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <cctype>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+const std::string kPrimaryAttribute = "db_router.primary";
+
+// Реплика сравнивается с позицией WAL основного сервера, а не со своей
+// полученной: при отключённом приёмнике WAL полученное и применённое совпадают,
+// хотя реплика давно отстала
+const std::string kPrimaryLsnSql = "SELECT pg_current_wal_flush_lsn()::text AS lsn";
+
+// Не в восстановлении (повышенная реплика) - отставания нет
+const std::string kReplayLsnSql =
+    "SELECT pg_is_in_recovery() AS in_recovery, pg_last_wal_replay_lsn()::text AS replay_lsn";
+
+bool isWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Слово целиком, без учёта регистра: updated_at не совпадает с UPDATE
+bool containsWord(const std::string& upper, const char* word) {
+    size_t length = std::char_traits<char>::length(word);
+    for (size_t pos = upper.find(word); pos != std::string::npos; pos = upper.find(word, pos + 1)) {
+        bool startOk = pos == 0 || !isWordChar(upper[pos - 1]);
+        bool endOk = pos + length == upper.size() || !isWordChar(upper[pos + length]);
+        if (startOk && endOk) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int64_t DbRouter::nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+void DbRouter::start() {
+    const auto& config = app().getCustomConfig()["db_routing"];
+    enabled_ = config.get("enabled", false).asBool();
+    maxLagMs_ = std::max(0, config.get("max_lag_ms", 1000).asInt());
+    pinMs_ = static_cast<int64_t>(std::max(0.0, config.get("pin_seconds", 5.0).asDouble()) * 1000);
+    checkIntervalSeconds_ = std::max(0.1, config.get("lag_check_interval_seconds", 1.0).asDouble());
+
+    for (const auto& name : config["replicas"]) {
+        auto replica = std::make_unique<Replica>();
+        replica->name = name.asString();
+        replicas_.push_back(std::move(replica));
+    }
+
+    if (!enabled_ || replicas_.empty()) {
+        enabled_ = false;
+        LOG_INFO << "DB routing disabled, all queries go to the primary";
+        return;
+    }
+
+    InvalidationBus::instance().subscribe(
+        "db_pin",
+        [this](const std::string& userId) { pinLocal(userId); },
+        [this]() { pinAllUntilMs_ = nowMs() + pinMs_; });
+
+    // Успешный запрос на изменение закрепляет пользователя за основным сервером
+    app().registerPostHandlingAdvice([this](const HttpRequestPtr& req, const HttpResponsePtr& resp) {
+        auto method = req->method();
+        if (method == Get || method == Head || method == Options || static_cast<int>(resp->statusCode()) >= 400) {
+            return;
+        }
+        if (const auto* identity = AuthContext::attached(req)) {
+            pin(identity->userId);
+            return;
+        }
+        AuthContext::Identity identity;
+        if (AuthContext::verifyBearer(req->getHeader("Authorization"), identity)) {
+            pin(identity.userId);
+        }
+    });
+
+    // Клиенты БД создаются в app().run() - первая проверка по таймеру
+    app().getLoop()->runEvery(checkIntervalSeconds_, [this]() {
+        checkLag();
+        prunePins();
+    });
+}
+
+bool DbRouter::isReadOnly(const std::string& sql) {
+    size_t start = 0;
+    while (start < sql.size() && (std::isspace(static_cast<unsigned char>(sql[start])) || sql[start] == '(')) {
+        ++start;
+    }
+    std::string upper(sql, start);
+    std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return std::toupper(c); });
+
+    static const char* const kReadVerbs[] = {"SELECT", "WITH", "VALUES", "TABLE", "SHOW"};
+    bool readVerb = std::any_of(std::begin(kReadVerbs), std::end(kReadVerbs), [&upper](const char* verb) {
+        size_t length = std::char_traits<char>::length(verb);
+        return upper.compare(0, length, verb) == 0 && (upper.size() == length || !isWordChar(upper[length]));
+    });
+    if (!readVerb) {
+        return false;
+    }
+
+    // Изменяющие CTE, SELECT ... FOR UPDATE/SHARE и функции с побочными эффектами
+    static const char* const kWriteWords[] = {"INSERT", "UPDATE", "DELETE", "MERGE", "SHARE",
+                                              "NEXTVAL", "SETVAL", "PG_NOTIFY", "INTO"};
+    return std::none_of(std::begin(kWriteWords), std::end(kWriteWords), [&upper](const char* word) {
+        return containsWord(upper, word);
+    });
+}
+
+DbClientPtr DbRouter::primary(const HttpRequestPtr& req) {
+    if (req) {
+        req->attributes()->insert(kPrimaryAttribute, true);
+    }
+    return app().getDbClient();
+}
+
+DbClientPtr DbRouter::clientFor(const HttpRequestPtr& req, const std::string& userId, const std::string& sql) {
+    if (!enabled_ || isReadOnly(sql)) {
+        return reader(req, userId);
+    }
+    ++writes_;
+    return primary(req);
+}
+
+DbClientPtr DbRouter::reader(const HttpRequestPtr& req, const std::string& userId) {
+    if (!enabled_) {
+        return app().getDbClient();
+    }
+
+    if (req && (req->attributes()->find(kPrimaryAttribute) || req->getHeader("X-Read-Your-Writes") == "true")) {
+        ++primaryReads_;
+        return app().getDbClient();
+    }
+
+    int64_t now = nowMs();
+    if (now < pinAllUntilMs_.load(std::memory_order_relaxed) || (!userId.empty() && isPinned(userId, now))) {
+        ++pinnedReads_;
+        return app().getDbClient();
+    }
+
+    Replica* replica = pickReplica(now);
+    if (!replica) {
+        ++fallbackReads_;
+        return app().getDbClient();
+    }
+    ++replica->reads;
+    return replica->client;
+}
+
+DbRouter::Replica* DbRouter::pickReplica(int64_t now) {
+    // Проверка старше трёх интервалов - реплика или её проверка зависла
+    int64_t freshAfter = now - static_cast<int64_t>(checkIntervalSeconds_ * 3000);
+    size_t count = replicas_.size();
+    size_t first = nextReplica_.fetch_add(1, std::memory_order_relaxed) % count;
+    for (size_t i = 0; i < count; ++i) {
+        auto& replica = *replicas_[(first + i) % count];
+        if (!replica.resolved.load(std::memory_order_acquire)) {
+            continue;
+        }
+        int64_t lag = replica.lagMs.load(std::memory_order_relaxed);
+        if (lag >= 0 && lag <= maxLagMs_ && replica.checkedAtMs.load(std::memory_order_relaxed) >= freshAfter) {
+            return &replica;
+        }
+    }
+    return nullptr;
+}
+
+bool DbRouter::parseLsn(const std::string& text, uint64_t& lsn) {
+    size_t slash = text.find('/');
+    if (slash == std::string::npos || slash == 0 || slash + 1 == text.size()) {
+        return false;
+    }
+    try {
+        size_t hiEnd = 0;
+        size_t loEnd = 0;
+        uint64_t hi = std::stoull(text.substr(0, slash), &hiEnd, 16);
+        uint64_t lo = std::stoull(text.substr(slash + 1), &loEnd, 16);
+        if (hiEnd != slash || loEnd != text.size() - slash - 1) {
+            return false;
+        }
+        lsn = (hi << 32) | lo;
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+void DbRouter::addWalSample(uint64_t lsn, int64_t now) {
+    std::lock_guard<std::mutex> lock(walMutex_);
+    primaryCheckedAtMs_ = now;
+    // Время важно только для новой позиции: простаивающий сервер не плодит замеры
+    if (walSamples_.empty() || lsn > walSamples_.back().lsn) {
+        walSamples_.push_back({lsn, now});
+        if (walSamples_.size() > kMaxWalSamples) {
+            walSamples_.pop_front();
+        }
+    }
+}
+
+int64_t DbRouter::lagFor(uint64_t replayLsn, int64_t now) {
+    std::lock_guard<std::mutex> lock(walMutex_);
+    // Первая неприменённая позиция: данные записаны не позже её замера
+    for (const auto& sample : walSamples_) {
+        if (sample.lsn > replayLsn) {
+            return now - sample.seenAtMs;
+        }
+    }
+    // Применено всё, что было на основном при последнем замере
+    return primaryCheckedAtMs_ > 0 ? now - primaryCheckedAtMs_ : 0;
+}
+
+void DbRouter::resolveReplicas() {
+    replicasResolved_ = true;
+    size_t resolved = 0;
+    for (auto& replica : replicas_) {
+        auto client = app().getDbClient(replica->name);
+        if (!client) {
+            LOG_ERROR << "DB routing: replica " << replica->name << " is not in db_clients, ignored";
+            continue;
+        }
+        replica->client = std::move(client);
+        replica->resolved.store(true, std::memory_order_release);
+        ++resolved;
+    }
+    if (resolved == 0) {
+        LOG_ERROR << "DB routing: no configured replica is in db_clients, all reads go to the primary";
+    }
+}
+
+void DbRouter::checkLag() {
+    if (!replicasResolved_) {
+        resolveReplicas();
+    }
+
+    // Без позиции основного сервера реплики не проверяются и через 3 интервала
+    // перестают считаться пригодными
+    app().getDbClient()->execSqlAsync(
+        kPrimaryLsnSql,
+        [this](const Result& result) {
+            uint64_t primaryLsn = 0;
+            if (result.empty() || !parseLsn(result[0]["lsn"].as<std::string>(), primaryLsn)) {
+                return;
+            }
+            addWalSample(primaryLsn, nowMs());
+
+            for (auto& replicaPtr : replicas_) {
+                Replica* replica = replicaPtr.get();
+                if (!replica->resolved.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                replica->client->execSqlAsync(
+                    kReplayLsnSql,
+                    [this, replica](const Result& result) {
+                        if (result.empty()) {
+                            return;
+                        }
+                        int64_t now = nowMs();
+                        uint64_t replayLsn = 0;
+                        if (!result[0]["in_recovery"].as<bool>()) {
+                            replica->lagMs = 0;
+                        } else if (!result[0]["replay_lsn"].isNull() &&
+                                   parseLsn(result[0]["replay_lsn"].as<std::string>(), replayLsn)) {
+                            replica->lagMs = lagFor(replayLsn, now);
+                        } else {
+                            return;
+                        }
+                        replica->checkedAtMs = now;
+                    },
+                    [replica](const DrogonDbException& e) {
+                        ++replica->checkErrors;
+                        LOG_WARN << "Replica " << replica->name << " lag check failed: " << e.base().what();
+                    });
+            }
+        },
+        [](const DrogonDbException& e) {
+            LOG_WARN << "Primary WAL position check failed: " << e.base().what();
+        });
+}
+
+DbRouter::PinShard& DbRouter::pinShardFor(const std::string& userId) const {
+    return pins_[std::hash<std::string>{}(userId) % kPinShardCount];
+}
+
+void DbRouter::pin(const std::string& userId) {
+    if (!enabled_ || userId.empty() || pinMs_ == 0) {
+        return;
+    }
+    pinLocal(userId);
+    InvalidationBus::instance().publish("db_pin", userId);
+}
+
+void DbRouter::pinLocal(const std::string& userId) {
+    auto& shard = pinShardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.until[userId] = nowMs() + pinMs_;
+    ++pinsSet_;
+}
+
+bool DbRouter::isPinned(const std::string& userId, int64_t now) {
+    auto& shard = pinShardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.until.find(userId);
+    return it != shard.until.end() && it->second > now;
+}
+
+void DbRouter::prunePins() {
+    int64_t now = nowMs();
+    for (auto& shard : pins_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.until.begin(); it != shard.until.end();) {
+            it = it->second <= now ? shard.until.erase(it) : std::next(it);
+        }
+    }
+}
+
+Json::Value DbRouter::stats() const {
+    Json::Value json;
+    json["enabled"] = enabled_;
+    json["max_lag_ms"] = static_cast<Json::Int64>(maxLagMs_);
+    json["pin_seconds"] = static_cast<double>(pinMs_) / 1000;
+
+    int64_t now = nowMs();
+    int64_t freshAfter = now - static_cast<int64_t>(checkIntervalSeconds_ * 3000);
+    Json::Value replicas(Json::arrayValue);
+    for (const auto& replica : replicas_) {
+        Json::Value item;
+        int64_t lag = replica->lagMs.load();
+        int64_t checkedAt = replica->checkedAtMs.load();
+        item["name"] = replica->name;
+        item["resolved"] = replica->resolved.load();
+        item["lag_ms"] = lag >= 0 ? Json::Value(static_cast<Json::Int64>(lag)) : Json::Value();
+        item["checked_ms_ago"] = checkedAt > 0 ? Json::Value(static_cast<Json::Int64>(now - checkedAt)) : Json::Value();
+        item["healthy"] = lag >= 0 && lag <= maxLagMs_ && checkedAt >= freshAfter;
+        item["check_errors"] = static_cast<Json::UInt64>(replica->checkErrors.load());
+        item["reads"] = static_cast<Json::UInt64>(replica->reads.load());
+        replicas.append(item);
+    }
+    json["replicas"] = replicas;
+
+    size_t pinnedUsers = 0;
+    for (auto& shard : pins_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        pinnedUsers += std::count_if(shard.until.begin(), shard.until.end(),
+                                     [now](const auto& entry) { return entry.second > now; });
+    }
+    json["pinned_users"] = static_cast<Json::UInt64>(pinnedUsers);
+    json["pin_all_ms_left"] = static_cast<Json::Int64>(std::max<int64_t>(0, pinAllUntilMs_.load() - now));
+    json["pins_set"] = static_cast<Json::UInt64>(pinsSet_.load());
+    json["primary_reads"] = static_cast<Json::UInt64>(primaryReads_.load());
+    json["pinned_reads"] = static_cast<Json::UInt64>(pinnedReads_.load());
+    json["fallback_reads"] = static_cast<Json::UInt64>(fallbackReads_.load());
+    json["writes"] = static_cast<Json::UInt64>(writes_.load());
+    return json;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Разделение чтения и записи между основным сервером (db_clients "default")
+// и репликами из custom_config.db_routing.replicas. Чтения (SELECT/WITH без
+// изменения данных) уходят на реплики по кругу, всё остальное - на основной.
+// Основной сервер выбирается и для чтений, если:
+//  - запрос уже писал (атрибут запроса) или пришёл с X-Read-Your-Writes: true;
+//  - пользователь писал не позже pin_seconds назад (закрепление передаётся
+//    остальным экземплярам через InvalidationBus, вид "db_pin");
+//  - ни одна реплика не проверена за последние 3 интервала или отстаёт
+//    больше max_lag_ms.
+// Отставание - сколько прошло с момента, когда основной сервер записал WAL,
+// который реплика ещё не применила (позиции основного замеряются каждый интервал).
+// Обработчик берёт клиент один раз и выполняет на нём всю цепочку запросов,
+// чтобы не смешивать снимки разных серверов.
+class DbRouter {
+public:
+    static DbRouter& instance() {
+        static DbRouter instance;
+        return instance;
+    }
+
+    // Настройки из custom_config.db_routing и таймер проверки отставания
+    // (вызывается из main до app().run(), до start() InvalidationBus)
+    void start();
+
+    // Клиент для цепочки чтений пользователя userId (пусто - аноним)
+    drogon::orm::DbClientPtr reader(const drogon::HttpRequestPtr& req, const std::string& userId);
+    // Клиент по виду запроса: чтение - как reader, запись - основной сервер,
+    // после чего чтения этого запроса тоже идут на основной
+    drogon::orm::DbClientPtr clientFor(const drogon::HttpRequestPtr& req, const std::string& userId,
+                                       const std::string& sql);
+
+    // Чтения пользователя идут на основной сервер pin_seconds (на всех экземплярах)
+    void pin(const std::string& userId);
+
+    // Только чтение: SELECT/WITH/VALUES/TABLE/SHOW без изменяющих слов и блокировок
+    static bool isReadOnly(const std::string& sql);
+
+    // Реплики с отставанием и счётчики маршрутизации
+    Json::Value stats() const;
+
+private:
+    DbRouter() = default;
+
+    struct Replica {
+        std::string name;                       // имя в db_clients
+        drogon::orm::DbClientPtr client;        // задаётся один раз в resolveReplicas
+        std::atomic<bool> resolved{false};      // client задан; имени нет в db_clients - навсегда false
+        std::atomic<int64_t> lagMs{-1};         // -1 - ещё не проверялась
+        std::atomic<int64_t> checkedAtMs{0};    // steady_clock последней удачной проверки
+        std::atomic<uint64_t> checkErrors{0};
+        std::atomic<uint64_t> reads{0};
+    };
+
+    struct alignas(64) PinShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, int64_t> until;  // userId -> steady_clock, мс
+    };
+
+    static constexpr size_t kPinShardCount = 16;
+
+    static int64_t nowMs();
+
+    PinShard& pinShardFor(const std::string& userId) const;
+    void pinLocal(const std::string& userId);
+    bool isPinned(const std::string& userId, int64_t now);
+    void prunePins();
+
+    // Позиция WAL основного сервера и когда она впервые замечена
+    struct WalSample {
+        uint64_t lsn;
+        int64_t seenAtMs;
+    };
+
+    static constexpr size_t kMaxWalSamples = 64;
+
+    // nullptr - нет реплики, пригодной для чтения
+    Replica* pickReplica(int64_t now);
+    // Клиенты БД по именам реплик (при первой проверке: до app().run() их ещё нет).
+    // Реплики, которых нет в db_clients, пропускаются с LOG_ERROR
+    void resolveReplicas();
+    void checkLag();
+    // "16/B374D848" -> число; false - не LSN
+    static bool parseLsn(const std::string& text, uint64_t& lsn);
+    void addWalSample(uint64_t lsn, int64_t now);
+    int64_t lagFor(uint64_t replayLsn, int64_t now);
+    drogon::orm::DbClientPtr primary(const drogon::HttpRequestPtr& req);
+
+    bool enabled_ = false;
+    std::vector<std::unique_ptr<Replica>> replicas_;
+    int64_t maxLagMs_ = 1000;
+    int64_t pinMs_ = 5000;
+    double checkIntervalSeconds_ = 1.0;
+
+    std::atomic<uint64_t> nextReplica_{0};
+    bool replicasResolved_ = false;  // только в потоке главного цикла (checkLag)
+
+    // Проверки реплик приходят из потоков клиентов БД
+    std::mutex walMutex_;
+    std::deque<WalSample> walSamples_;  // по возрастанию lsn
+    int64_t primaryCheckedAtMs_ = 0;
+    mutable std::array<PinShard, kPinShardCount> pins_;
+    // После переподключения InvalidationBus закрепления с других экземпляров
+    // могли потеряться - до этого момента все чтения идут на основной
+    std::atomic<int64_t> pinAllUntilMs_{0};
+
+    std::atomic<uint64_t> primaryReads_{0};
+    std::atomic<uint64_t> pinnedReads_{0};
+    std::atomic<uint64_t> fallbackReads_{0};
+    std::atomic<uint64_t> writes_{0};
+    std::atomic<uint64_t> pinsSet_{0};
+};
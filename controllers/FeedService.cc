@@ -0,0 +1,476 @@
+#include "FeedService.h"
+#include "InvalidationBus.h"
+#include "PgArray.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <future>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+// Поля события, которые нужны ленте
+const char* const kEventColumns =
+    "e.id, e.kind, e.channel_id, e.course_id, e.video_id, e.title, e.created_at";
+
+// Ключ pg_try_advisory_xact_lock: разносит один экземпляр за раз
+const int64_t kFanoutLockKey = 0x66656564;  // "feed"
+
+// Склейка двух упорядоченных по убыванию id источников без повторов
+std::vector<FeedService::ItemPtr> mergePages(std::vector<FeedService::ItemPtr> page,
+                                             std::vector<FeedService::ItemPtr> extra,
+                                             size_t limit) {
+    page.insert(page.end(), extra.begin(), extra.end());
+    std::sort(page.begin(), page.end(), [](const FeedService::ItemPtr& a, const FeedService::ItemPtr& b) {
+        return a->id > b->id;
+    });
+    page.erase(std::unique(page.begin(), page.end(),
+                           [](const FeedService::ItemPtr& a, const FeedService::ItemPtr& b) {
+                               return a->id == b->id;
+                           }),
+               page.end());
+    if (page.size() > limit) {
+        page.resize(limit);
+    }
+    return page;
+}
+
+} // namespace
+
+FeedService::FeedService()
+    : queue_(1, "FeedService") {
+}
+
+void FeedService::start() {
+    const auto& config = app().getCustomConfig()["feeds"];
+    ringCapacity_ = std::max(10u, config.get("ring_capacity", 200).asUInt());
+    maxUsersPerShard_ = std::max<size_t>(1, config.get("max_users", 100000).asUInt() / kShardCount);
+    celebrityThreshold_ = std::max<int64_t>(1, config.get("celebrity_threshold", 10000).asInt64());
+    pollIntervalSeconds_ = std::max(0.1, config.get("poll_interval_ms", 1000).asDouble() / 1000.0);
+    fanoutBatch_ = std::max(1u, config.get("fanout_batch", 100).asUInt());
+    unsigned retentionDays = config.get("retention_days", 90).asUInt();
+
+    InvalidationBus::instance().subscribe(
+        "feed",
+        [this](const std::string& userId) { evict(userId); },
+        [this]() { clear(); });
+    // Пачку разнёс другой экземпляр: отставшие буферы дочитают её при чтении.
+    // После переподключения буферы и так сброшены видом "feed"
+    InvalidationBus::instance().subscribe(
+        "feed_seq",
+        [this](const std::string& key) {
+            int64_t seq = std::strtoll(key.c_str(), nullptr, 10);
+            int64_t known = latestSeq_.load();
+            while (seq > known && !latestSeq_.compare_exchange_weak(known, seq)) {
+            }
+        },
+        []() {});
+
+    app().getLoop()->runEvery(pollIntervalSeconds_, [this]() {
+        if (fanningOut_.exchange(true)) {
+            return;
+        }
+        queue_.runTaskInQueue([this]() {
+            try {
+                fanOut();
+            } catch (const DrogonDbException& e) {
+                LOG_ERROR << "Feed fan-out failed: " << e.base().what();
+            } catch (const std::exception& e) {
+                LOG_ERROR << "Feed fan-out failed: " << e.what();
+            }
+            fanningOut_ = false;
+        });
+    });
+
+    // Старые события удаляются вместе с записями лент (ON DELETE CASCADE)
+    if (retentionDays > 0) {
+        app().getLoop()->runEvery(3600.0, [retentionDays]() {
+            app().getDbClient()->execSqlAsync(
+                "DELETE FROM channel_events WHERE created_at < NOW() - $1::integer * INTERVAL '1 day'",
+                [](const Result& result) {
+                    if (result.affectedRows() > 0) {
+                        LOG_INFO << "Feed retention removed " << result.affectedRows() << " channel events";
+                    }
+                },
+                [](const DrogonDbException& e) {
+                    LOG_ERROR << "Feed retention failed: " << e.base().what();
+                },
+                static_cast<int32_t>(retentionDays));
+        });
+    }
+}
+
+FeedService::Shard& FeedService::shardFor(const std::string& userId) const {
+    return shards_[std::hash<std::string>{}(userId) % kShardCount];
+}
+
+FeedService::ItemPtr FeedService::itemFromRow(const Row& row) {
+    auto item = std::make_shared<Item>();
+    item->id = row["id"].as<int64_t>();
+    item->kind = row["kind"].as<std::string>();
+    item->channelId = row["channel_id"].as<std::string>();
+    item->courseId = row["course_id"].as<std::string>();
+    if (!row["video_id"].isNull()) {
+        item->videoId = row["video_id"].as<std::string>();
+    }
+    item->title = row["title"].as<std::string>();
+    item->createdAt = row["created_at"].as<std::string>();
+    return item;
+}
+
+std::unique_ptr<FeedService::Ring> FeedService::residentRing(const std::string& userId, int64_t& seq) const {
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.users.find(userId);
+    if (it == shard.users.end()) {
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+    seq = it->second.seq;
+    return std::make_unique<Ring>(it->second.items);
+}
+
+void FeedService::storeRing(const std::string& userId, Ring ring, int64_t seq) {
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // Пачки, разнесённые после снимка, буфер дочитает при чтении (seq < latestSeq_)
+    if (shard.users.count(userId)) {
+        return;
+    }
+
+    if (shard.users.size() >= maxUsersPerShard_) {
+        shard.users.erase(shard.lru.back());
+        shard.lru.pop_back();
+    }
+    shard.lru.push_front(userId);
+    auto& resident = shard.users[userId];
+    resident.items = std::move(ring);
+    resident.seq = seq;
+    resident.lru = shard.lru.begin();
+}
+
+void FeedService::mergeIntoRing(Ring& ring, const Ring& items) const {
+    // Пачки фиксируются не в порядке id: событие может оказаться старше начала буфера
+    for (const auto& item : items) {
+        auto pos = std::lower_bound(ring.begin(), ring.end(), item->id,
+                                    [](const ItemPtr& existing, int64_t id) { return existing->id > id; });
+        if (pos == ring.end() || (*pos)->id != item->id) {
+            ring.insert(pos, item);
+        }
+    }
+    while (ring.size() > ringCapacity_) {
+        ring.pop_back();
+    }
+}
+
+void FeedService::applyDelta(const std::string& userId, Ring& ring, const Ring& delta, int64_t seq) {
+    mergeIntoRing(ring, delta);
+
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.users.find(userId);
+    if (it == shard.users.end()) {
+        return;
+    }
+    // Буфер мог уйти дальше параллельным дочитыванием - события идемпотентны, номер не убывает
+    mergeIntoRing(it->second.items, delta);
+    it->second.seq = std::max(it->second.seq, seq);
+}
+
+void FeedService::advanceResident(int64_t seq, const std::unordered_map<std::string, Ring>& added) {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto& [userId, resident] : shard.users) {
+            // Отставший буфер пропустил чужие пачки и дочитает всё разом при чтении
+            if (resident.seq != seq - 1) {
+                continue;
+            }
+            auto it = added.find(userId);
+            if (it != added.end()) {
+                mergeIntoRing(resident.items, it->second);
+            }
+            resident.seq = seq;
+        }
+    }
+}
+
+void FeedService::forget(const std::string& userId) {
+    evict(userId);
+    InvalidationBus::instance().publish("feed", userId);
+}
+
+void FeedService::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.users.clear();
+        shard.lru.clear();
+    }
+}
+
+void FeedService::evict(const std::string& userId) {
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.users.find(userId);
+    if (it != shard.users.end()) {
+        shard.lru.erase(it->second.lru);
+        shard.users.erase(it);
+    }
+}
+
+void FeedService::readPage(const std::string& userId, int64_t beforeId, size_t limit, PageCallback&& callback) {
+    // Полный буфер хранит только последние ring_capacity событий, страницы старше - из таблицы
+    auto servePage = [this, userId, beforeId, limit](Ring ring, PageCallback&& callback) {
+        if (beforeId > 0 && ring.size() >= ringCapacity_ && beforeId <= ring.back()->id) {
+            readFromTable(userId, beforeId, limit, std::move(callback));
+            return;
+        }
+        mergeUnfanned(userId, std::move(ring), beforeId, limit, std::move(callback));
+    };
+
+    int64_t seq = 0;
+    if (auto ring = residentRing(userId, seq)) {
+        if (seq >= latestSeq_.load()) {
+            servePage(std::move(*ring), std::move(callback));
+            return;
+        }
+
+        // Пачки, разнесённые другим экземпляром: только их события этого пользователя
+        auto cached = std::make_shared<Ring>(std::move(*ring));
+        app().getDbClient()->execSqlAsync(
+            std::string("SELECT s.last_seq AS fanout_seq, ") + kEventColumns + R"(
+                FROM feed_fanout_state s
+                LEFT JOIN LATERAL (
+                    SELECT ev.*
+                    FROM channel_events ev
+                    JOIN user_feed f ON f.event_id = ev.id AND f.user_id = $1
+                    WHERE ev.fanout_seq > $2
+                    ORDER BY ev.id DESC
+                    LIMIT $3
+                ) e ON true
+                ORDER BY e.id DESC
+            )",
+            [this, userId, cached, servePage, callback](const Result& result) mutable {
+                Ring delta;
+                int64_t snapshotSeq = result.empty() ? 0 : result[0]["fanout_seq"].as<int64_t>();
+                for (const auto& row : result) {
+                    if (!row["id"].isNull()) {
+                        delta.push_back(itemFromRow(row));
+                    }
+                }
+                applyDelta(userId, *cached, delta, snapshotSeq);
+                servePage(std::move(*cached), std::move(callback));
+            },
+            [callback](const DrogonDbException& e) {
+                LOG_ERROR << "Failed to load feed updates: " << e.base().what();
+                callback({}, "Failed to load feed");
+            },
+            userId, seq, static_cast<int64_t>(ringCapacity_));
+        return;
+    }
+
+    // Номер пачки читается тем же запросом, что и лента: буфер полон до него
+    app().getDbClient()->execSqlAsync(
+        std::string("SELECT s.last_seq AS fanout_seq, ") + kEventColumns + R"(
+            FROM feed_fanout_state s
+            LEFT JOIN LATERAL (
+                SELECT ev.*
+                FROM user_feed f
+                JOIN channel_events ev ON ev.id = f.event_id
+                WHERE f.user_id = $1
+                ORDER BY f.event_id DESC
+                LIMIT $2
+            ) e ON true
+            ORDER BY e.id DESC
+        )",
+        [this, userId, servePage, callback](const Result& result) mutable {
+            Ring ring;
+            int64_t snapshotSeq = result.empty() ? 0 : result[0]["fanout_seq"].as<int64_t>();
+            for (const auto& row : result) {
+                if (!row["id"].isNull()) {
+                    ring.push_back(itemFromRow(row));
+                }
+            }
+            storeRing(userId, ring, snapshotSeq);
+            servePage(std::move(ring), std::move(callback));
+        },
+        [callback](const DrogonDbException& e) {
+            LOG_ERROR << "Failed to load feed: " << e.base().what();
+            callback({}, "Failed to load feed");
+        },
+        userId, static_cast<int64_t>(ringCapacity_));
+}
+
+void FeedService::mergeUnfanned(const std::string& userId, Ring ring, int64_t beforeId, size_t limit,
+                                PageCallback&& callback) const {
+    std::vector<ItemPtr> page;
+    for (const auto& item : ring) {
+        if (page.size() == limit) {
+            break;
+        }
+        if (beforeId == 0 || item->id < beforeId) {
+            page.push_back(item);
+        }
+    }
+
+    // Крупные каналы подписок: события читаются прямо из channel_events
+    app().getDbClient()->execSqlAsync(
+        std::string("SELECT ") + kEventColumns + R"(
+            FROM channel_subscriptions s
+            JOIN LATERAL (
+                SELECT ev.*
+                FROM channel_events ev
+                WHERE ev.channel_id = s.channel_id
+                  AND ev.fanned_out = false
+                  AND ($2::bigint = 0 OR ev.id < $2)
+                ORDER BY ev.id DESC
+                LIMIT $3
+            ) e ON true
+            WHERE s.subscriber_id = $1
+        )",
+        [page = std::move(page), limit, callback](const Result& result) mutable {
+            std::vector<ItemPtr> extra;
+            extra.reserve(result.size());
+            for (const auto& row : result) {
+                extra.push_back(itemFromRow(row));
+            }
+            callback(mergePages(std::move(page), std::move(extra), limit), "");
+        },
+        [callback](const DrogonDbException& e) {
+            LOG_ERROR << "Failed to read feed events: " << e.base().what();
+            callback({}, "Failed to load feed");
+        },
+        userId, beforeId, static_cast<int64_t>(limit));
+}
+
+void FeedService::readFromTable(const std::string& userId, int64_t beforeId, size_t limit,
+                                PageCallback&& callback) const {
+    app().getDbClient()->execSqlAsync(
+        std::string("SELECT ") + kEventColumns + R"(
+            FROM user_feed f
+            JOIN channel_events e ON e.id = f.event_id
+            WHERE f.user_id = $1 AND f.event_id < $2
+            ORDER BY f.event_id DESC
+            LIMIT $3
+        )",
+        [this, userId, beforeId, limit, callback](const Result& result) mutable {
+            Ring ring;
+            for (const auto& row : result) {
+                ring.push_back(itemFromRow(row));
+            }
+            mergeUnfanned(userId, std::move(ring), beforeId, limit, std::move(callback));
+        },
+        [callback](const DrogonDbException& e) {
+            LOG_ERROR << "Failed to read feed page: " << e.base().what();
+            callback({}, "Failed to load feed");
+        },
+        userId, beforeId, static_cast<int64_t>(limit));
+}
+
+void FeedService::fanOut() {
+    auto dbClient = app().getDbClient();
+
+    // Накопившееся за время простоя разносится пачками подряд
+    while (true) {
+        auto trans = dbClient->newTransaction();
+
+        // Блокировка до конца транзакции: номера пачек идут в порядке фиксации,
+        // остальные экземпляры пропускают тик
+        auto locked = trans->execSqlSync("SELECT pg_try_advisory_xact_lock($1) AS locked", kFanoutLockKey);
+        if (!locked[0]["locked"].as<bool>()) {
+            return;
+        }
+
+        // Выбор по признаку, а не по курсору id: событие, зафиксированное позже
+        // события с большим id, не пропускается
+        auto events = trans->execSqlSync(
+            std::string("SELECT ") + kEventColumns + R"(, COALESCE(us.subscribers_count, 0) AS subscribers
+                FROM channel_events e
+                LEFT JOIN user_stats us ON us.user_id = e.channel_id
+                WHERE e.fanned_out IS NULL
+                ORDER BY e.id
+                LIMIT $1
+                FOR UPDATE OF e SKIP LOCKED
+            )",
+            static_cast<int64_t>(fanoutBatch_));
+        if (events.empty()) {
+            return;
+        }
+
+        std::unordered_map<int64_t, ItemPtr> items;
+        std::vector<int64_t> allIds;
+        std::vector<int64_t> fannedIds;
+        std::vector<std::string> fannedChannels;
+        for (const auto& row : events) {
+            auto item = itemFromRow(row);
+            allIds.push_back(item->id);
+            if (row["subscribers"].as<int64_t>() <= celebrityThreshold_) {
+                fannedIds.push_back(item->id);
+                fannedChannels.push_back(item->channelId);
+            }
+            items.emplace(item->id, std::move(item));
+        }
+
+        // Записи лент, пометка событий и номер пачки - один оператор
+        auto recipients = trans->execSqlSync(
+            R"(
+                WITH fan AS (
+                    INSERT INTO user_feed (user_id, event_id)
+                    SELECT s.subscriber_id, e.id
+                    FROM unnest($1::bigint[], $2::text[]) AS e(id, channel_id)
+                    JOIN channel_subscriptions s ON s.channel_id = e.channel_id
+                    ON CONFLICT DO NOTHING
+                    RETURNING user_id, event_id
+                ), seq AS (
+                    UPDATE feed_fanout_state SET last_seq = last_seq + 1 RETURNING last_seq
+                ), marked AS (
+                    UPDATE channel_events
+                    SET fanned_out = (id = ANY($1::bigint[])),
+                        fanout_seq = (SELECT last_seq FROM seq)
+                    WHERE id = ANY($3::bigint[])
+                )
+                SELECT s.last_seq AS fanout_seq, f.user_id, f.event_id
+                FROM seq s
+                LEFT JOIN fan f ON true
+                ORDER BY f.event_id
+            )",
+            pg::intArray(fannedIds), pg::textArray(fannedChannels), pg::intArray(allIds));
+        int64_t seq = recipients[0]["fanout_seq"].as<int64_t>();
+
+        std::unordered_map<std::string, Ring> added;
+        for (const auto& row : recipients) {
+            if (row["event_id"].isNull()) {
+                continue;
+            }
+            auto item = items.find(row["event_id"].as<int64_t>());
+            if (item != items.end()) {
+                added[row["user_id"].as<std::string>()].push_back(item->second);
+            }
+        }
+
+        // Буферы и другие экземпляры узнают о пачке только после фиксации
+        auto committed = std::make_shared<std::promise<bool>>();
+        auto committedFuture = committed->get_future();
+        trans->setCommitCallback([committed](bool ok) {
+            committed->set_value(ok);
+        });
+        trans.reset();
+        if (!committedFuture.get()) {
+            LOG_ERROR << "Feed fan-out batch " << seq << " was not committed";
+            return;
+        }
+
+        advanceResident(seq, added);
+        int64_t known = latestSeq_.load();
+        while (seq > known && !latestSeq_.compare_exchange_weak(known, seq)) {
+        }
+        InvalidationBus::instance().publish("feed_seq", std::to_string(seq));
+
+        if (events.size() < fanoutBatch_) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Ленты подписчиков: новые курсы и видео каналов, на которые подписан пользователь.
+// Триггеры пишут события в channel_events, поток сервиса раз в poll_interval_ms
+// забирает необработанные (fanned_out IS NULL) и разносит их при записи: одним
+// запросом в user_feed каждого подписчика и в кольцевые буферы лент, которые
+// сейчас в памяти. Каналы с числом подписчиков больше celebrity_threshold не
+// разносятся - их события подмешиваются при чтении ленты (fanned_out = false).
+// Разносит один экземпляр за раз (advisory-блокировка); каждая пачка получает
+// номер fanout_seq, который расходится по остальным через InvalidationBus
+// (вид "feed_seq"). Буфер помнит номер, до которого он полон, и при отставании
+// дочитывает из БД только события более поздних пачек.
+// Лента читается из буфера в памяти, при промахе буфер загружается из user_feed.
+// События удалённых курсов и видео уходят из лент каскадом в БД.
+class FeedService {
+public:
+    static FeedService& instance() {
+        static FeedService instance;
+        return instance;
+    }
+
+    // Настройки из custom_config.feeds и таймер разноса (вызывается из main до app().run())
+    void start();
+
+    struct Item {
+        int64_t id = 0;            // channel_events.id, лента упорядочена по нему
+        std::string kind;          // course / video
+        std::string channelId;
+        std::string courseId;
+        std::string videoId;       // пусто для курса
+        std::string title;
+        std::string createdAt;     // как пришло из БД
+    };
+    using ItemPtr = std::shared_ptr<const Item>;
+
+    // Страница ленты: события с id < beforeId (0 - с начала), не больше limit.
+    // Колбэк вызывается в потоке клиента БД или сразу, если всё нашлось в памяти
+    using PageCallback = std::function<void(std::vector<ItemPtr> items, const std::string& error)>;
+    void readPage(const std::string& userId, int64_t beforeId, size_t limit, PageCallback&& callback);
+
+    // Подписки пользователя изменились: буфер будет загружен заново при следующем чтении.
+    // Сбрасывает и на остальных экземплярах (InvalidationBus, вид "feed")
+    void forget(const std::string& userId);
+
+    size_t ringCapacity() const { return ringCapacity_; }
+
+private:
+    FeedService();
+
+    using Ring = std::deque<ItemPtr>;  // в начале - новые
+
+    struct Resident {
+        Ring items;
+        int64_t seq = 0;  // буфер полон до этой пачки разноса включительно
+        std::list<std::string>::iterator lru;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Resident> users;
+        std::list<std::string> lru;  // в начале - последние прочитанные
+    };
+
+    static constexpr size_t kShardCount = 32;
+
+    Shard& shardFor(const std::string& userId) const;
+
+    // Только здесь: по ключу из InvalidationBus и при полном сбросе
+    void evict(const std::string& userId);
+    void clear();
+
+    // Копия буфера и его номер пачки, nullptr - ленты нет в памяти
+    std::unique_ptr<Ring> residentRing(const std::string& userId, int64_t& seq) const;
+    // Сохранить загруженную из БД ленту; seq - feed_fanout_state в момент чтения
+    void storeRing(const std::string& userId, Ring ring, int64_t seq);
+    // Дочитанные события пачек после seq буфера: в копию для ответа и в буфер, если он ещё в памяти
+    void applyDelta(const std::string& userId, Ring& ring, const Ring& delta, int64_t seq);
+    // После своей пачки seq: буферы, полные до seq - 1, получают её события и номер seq
+    void advanceResident(int64_t seq, const std::unordered_map<std::string, Ring>& added);
+    // События в порядке убывания id без повторов, не больше ringCapacity_
+    void mergeIntoRing(Ring& ring, const Ring& items) const;
+
+    // Дочитать события крупных каналов и склеить с буфером
+    void mergeUnfanned(const std::string& userId, Ring ring, int64_t beforeId, size_t limit,
+                       PageCallback&& callback) const;
+    // Страница старше того, что помещается в буфер
+    void readFromTable(const std::string& userId, int64_t beforeId, size_t limit,
+                       PageCallback&& callback) const;
+
+    // Выполняется в потоке queue_
+    void fanOut();
+
+    static ItemPtr itemFromRow(const drogon::orm::Row& row);
+
+    trantor::ConcurrentTaskQueue queue_;
+    std::atomic<bool> fanningOut_{false};
+    // Последняя известная пачка разноса (своя или с другого экземпляра)
+    std::atomic<int64_t> latestSeq_{0};
+
+    mutable std::array<Shard, kShardCount> shards_;
+
+    size_t ringCapacity_ = 200;
+    size_t maxUsersPerShard_ = 100000 / kShardCount;
+    int64_t celebrityThreshold_ = 10000;
+    double pollIntervalSeconds_ = 1.0;
+    size_t fanoutBatch_ = 100;
+};
@@ -0,0 +1,94 @@
+#include "FieldSelection.h"
+#include <algorithm>
+
+namespace {
+
+// Ограничение на длину списка, чтобы не разбирать мусор
+constexpr size_t kMaxFields = 64;
+
+void appendQuoted(std::string& out, const std::string& column) {
+    if (!out.empty()) {
+        out += ", ";
+    }
+    out += '"';
+    out += column;
+    out += '"';
+}
+
+} // namespace
+
+FieldSelection::FieldSelection(const JsonRowLayout& layout, const std::unordered_set<std::string>& modelColumns)
+    : layout_(layout) {
+    for (const auto& column : layout.columns()) {
+        if (modelColumns.count(column.column)) {
+            allowedKeys_.insert(column.key.name());
+        }
+    }
+}
+
+bool FieldSelection::select(const std::string& fieldsParam,
+                            const std::vector<std::string>& requiredColumns,
+                            Projection& projection,
+                            std::string& error) const {
+    if (fieldsParam.empty()) {
+        // Описание ответа статическое, владеть им не нужно
+        projection.layout = std::shared_ptr<const JsonRowLayout>(&layout_, [](const JsonRowLayout*) {});
+        projection.columns = "*";
+        return true;
+    }
+
+    std::vector<std::string> keys;
+    size_t start = 0;
+    while (start <= fieldsParam.size()) {
+        size_t end = fieldsParam.find(',', start);
+        if (end == std::string::npos) {
+            end = fieldsParam.size();
+        }
+
+        std::string key = fieldsParam.substr(start, end - start);
+        key.erase(0, key.find_first_not_of(' '));
+        key.erase(key.find_last_not_of(' ') + 1);
+
+        if (!key.empty()) {
+            if (!allowedKeys_.count(key)) {
+                error = "Unknown field: " + key;
+                return false;
+            }
+            if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+                keys.push_back(key);
+            }
+            if (keys.size() > kMaxFields) {
+                error = "Too many fields";
+                return false;
+            }
+        }
+        start = end + 1;
+    }
+
+    if (keys.empty()) {
+        error = "No fields selected";
+        return false;
+    }
+
+    auto projected = std::make_shared<JsonRowLayout>(layout_.project(keys));
+
+    // Колонки в SELECT берутся из белого списка, а не из запроса
+    std::vector<std::string> columns;
+    for (const auto& column : projected->columns()) {
+        if (std::find(columns.begin(), columns.end(), column.column) == columns.end()) {
+            columns.push_back(column.column);
+        }
+    }
+    for (const auto& column : requiredColumns) {
+        if (std::find(columns.begin(), columns.end(), column) == columns.end()) {
+            columns.push_back(column);
+        }
+    }
+
+    projection.columns.clear();
+    for (const auto& column : columns) {
+        appendQuoted(projection.columns, column);
+    }
+    projection.layout = std::move(projected);
+    return true;
+}
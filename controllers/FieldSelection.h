@@ -0,0 +1,43 @@
+#pragma once
+
+#include "JsonStreamWriter.h"
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Параметр ?fields=a,b,c: сужает и список колонок в SELECT, и JSON ответа.
+// Допустимые поля - поля описания ответа, чьи колонки есть в ORM-модели
+// (models/*.h генерируются drogon_ctl по models/model.json).
+class FieldSelection {
+public:
+    // extraColumns - колонки таблицы, которых ещё нет в сгенерированной модели
+    template <typename Model>
+    static FieldSelection forModel(const JsonRowLayout& layout,
+                                   const std::unordered_set<std::string>& extraColumns = {}) {
+        std::unordered_set<std::string> modelColumns(extraColumns);
+        for (size_t i = 0; i < Model::getColumnNumber(); ++i) {
+            modelColumns.insert(Model::getColumnName(i));
+        }
+        return FieldSelection(layout, modelColumns);
+    }
+
+    struct Projection {
+        std::shared_ptr<const JsonRowLayout> layout;
+        std::string columns;  // список для SELECT; "*" если поля не выбирались
+    };
+
+    // Пустой параметр - все поля и SELECT *. requiredColumns нужны обработчику
+    // (проверки доступа и т.п.) и попадают в SELECT, но не в ответ.
+    // false и error при неизвестном поле.
+    bool select(const std::string& fieldsParam,
+                const std::vector<std::string>& requiredColumns,
+                Projection& projection,
+                std::string& error) const;
+
+private:
+    FieldSelection(const JsonRowLayout& layout, const std::unordered_set<std::string>& modelColumns);
+
+    const JsonRowLayout& layout_;
+    std::unordered_set<std::string> allowedKeys_;
+};
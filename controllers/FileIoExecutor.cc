@@ -0,0 +1,469 @@
+#include "FileIoExecutor.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAS_LIBURING
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <atomic>
+#include <thread>
+#endif
+
+using namespace drogon;
+
+namespace {
+
+// Одна запись не больше этого: короткие записи на больших видео всё равно дописываются в цикле
+constexpr size_t kWriteChunk = 1 << 20;
+
+std::string errnoText(const std::string& what, const std::string& path, int error) {
+    return what + " " + path + ": " + std::strerror(error);
+}
+
+// Родительские каталоги пути по порядку: "a", "a/b" для "a/b/file"
+std::vector<std::string> parentDirectories(const std::string& path) {
+    std::vector<std::string> dirs;
+    size_t pos = path.find('/', 1);
+    while (pos != std::string::npos) {
+        dirs.push_back(path.substr(0, pos));
+        pos = path.find('/', pos + 1);
+    }
+    return dirs;
+}
+
+} // namespace
+
+struct FileIoExecutor::Job {
+    enum class Kind { Write, Remove };
+
+    Kind kind;
+    std::vector<std::string> paths;  // Write: один путь назначения
+
+    // Данные загрузки живут, пока жив HttpFile (копия держит общий буфер)
+    std::shared_ptr<const HttpFile> file;
+    const char* data = nullptr;
+    size_t size = 0;
+
+    Done done;
+    trantor::EventLoop* loop = nullptr;
+    std::string error;
+
+    // Состояние для io_uring
+    enum class Step { MakeDirectory, Open, Write, Close, Unlink, Cleanup };
+    Step step = Step::MakeDirectory;
+    std::vector<std::string> directories;
+    size_t index = 0;      // каталог или файл для удаления
+    size_t written = 0;
+    int fd = -1;
+
+    void finish() {
+        if (!done) {
+            return;
+        }
+        if (loop) {
+            loop->queueInLoop([done = std::move(done), error = std::move(error)]() {
+                done(error);
+            });
+        } else {
+            done(error);
+        }
+    }
+};
+
+#ifdef HAS_LIBURING
+
+// Один поток с кольцом: принимает задания через eventfd, каждое задание -
+// цепочка SQE (mkdirat... -> openat -> write... -> close или unlinkat...),
+// следующий шаг готовится по результату предыдущего CQE.
+class FileIoExecutor::Ring {
+public:
+    static bool supported() {
+        io_uring_probe* probe = io_uring_get_probe();
+        if (!probe) {
+            return false;
+        }
+        bool ok = true;
+        for (int op : {IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE,
+                       IORING_OP_UNLINKAT, IORING_OP_MKDIRAT, IORING_OP_READ}) {
+            ok = ok && io_uring_opcode_supported(probe, op);
+        }
+        io_uring_free_probe(probe);
+        return ok;
+    }
+
+    explicit Ring(unsigned entries) {
+        int rc = io_uring_queue_init(entries, &ring_, 0);
+        if (rc < 0) {
+            throw std::runtime_error(std::string("io_uring_queue_init: ") + std::strerror(-rc));
+        }
+        wakeFd_ = eventfd(0, EFD_CLOEXEC);
+        if (wakeFd_ < 0) {
+            io_uring_queue_exit(&ring_);
+            throw std::runtime_error(std::string("eventfd: ") + std::strerror(errno));
+        }
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~Ring() {
+        stop();
+        io_uring_queue_exit(&ring_);
+        close(wakeFd_);
+    }
+
+    void submit(std::unique_ptr<Job> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            incoming_.push_back(std::move(job));
+        }
+        wake();
+    }
+
+    // Дожидается уже поставленных заданий
+    void stop() {
+        if (!thread_.joinable()) {
+            return;
+        }
+        stopping_ = true;
+        wake();
+        thread_.join();
+    }
+
+private:
+    void wake() {
+        uint64_t one = 1;
+        (void)!write(wakeFd_, &one, sizeof(one));
+    }
+
+    io_uring_sqe* nextSqe() {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+        while (!sqe) {
+            io_uring_submit(&ring_);
+            sqe = io_uring_get_sqe(&ring_);
+        }
+        return sqe;
+    }
+
+    void armWake() {
+        io_uring_sqe* sqe = nextSqe();
+        io_uring_prep_read(sqe, wakeFd_, &wakeCounter_, sizeof(wakeCounter_), 0);
+        io_uring_sqe_set_data(sqe, nullptr);
+    }
+
+    void run() {
+        armWake();
+        while (true) {
+            io_uring_submit_and_wait(&ring_, 1);
+
+            io_uring_cqe* cqe;
+            unsigned head;
+            unsigned seen = 0;
+            bool woken = false;
+            io_uring_for_each_cqe(&ring_, head, cqe) {
+                ++seen;
+                // Задания - указатели Job, у чтения eventfd данных нет
+                if (cqe->user_data == 0) {
+                    woken = true;
+                    continue;
+                }
+                auto* job = reinterpret_cast<Job*>(cqe->user_data);
+                advance(job, cqe->res);
+            }
+            io_uring_cq_advance(&ring_, seen);
+
+            if (woken) {
+                std::vector<std::unique_ptr<Job>> jobs;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    jobs.swap(incoming_);
+                }
+                for (auto& job : jobs) {
+                    ++active_;
+                    begin(job.release());
+                }
+                if (stopping_ && active_ == 0) {
+                    break;
+                }
+                armWake();
+            } else if (stopping_ && active_ == 0) {
+                // Последнее задание завершилось после сигнала остановки
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (incoming_.empty()) {
+                    break;
+                }
+            }
+        }
+    }
+
+    void begin(Job* job) {
+        if (job->kind == Job::Kind::Remove) {
+            job->step = Job::Step::Unlink;
+            job->index = 0;
+            if (job->paths.empty()) {
+                complete(job);
+                return;
+            }
+        } else {
+            job->directories = parentDirectories(job->paths[0]);
+            job->step = job->directories.empty() ? Job::Step::Open : Job::Step::MakeDirectory;
+        }
+        prepare(job);
+    }
+
+    void prepare(Job* job) {
+        io_uring_sqe* sqe = nextSqe();
+        switch (job->step) {
+        case Job::Step::MakeDirectory:
+            io_uring_prep_mkdirat(sqe, AT_FDCWD, job->directories[job->index].c_str(), 0755);
+            break;
+        case Job::Step::Open:
+            io_uring_prep_openat(sqe, AT_FDCWD, job->paths[0].c_str(),
+                                 O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            break;
+        case Job::Step::Write:
+            io_uring_prep_write(sqe, job->fd, job->data + job->written,
+                                static_cast<unsigned>(std::min(job->size - job->written, kWriteChunk)),
+                                job->written);
+            break;
+        case Job::Step::Close:
+            io_uring_prep_close(sqe, job->fd);
+            break;
+        case Job::Step::Unlink:
+            io_uring_prep_unlinkat(sqe, AT_FDCWD, job->paths[job->index].c_str(), 0);
+            break;
+        case Job::Step::Cleanup:
+            io_uring_prep_unlinkat(sqe, AT_FDCWD, job->paths[0].c_str(), 0);
+            break;
+        }
+        io_uring_sqe_set_data(sqe, job);
+    }
+
+    // Ошибка на записи: закрыть файл и удалить недописанное
+    void fail(Job* job, const char* what, int res) {
+        job->error = errnoText(what, job->paths[0], -res);
+        if (job->fd >= 0) {
+            job->step = Job::Step::Close;
+        } else {
+            complete(job);
+            return;
+        }
+        prepare(job);
+    }
+
+    void advance(Job* job, int res) {
+        switch (job->step) {
+        case Job::Step::MakeDirectory:
+            if (res < 0 && res != -EEXIST) {
+                fail(job, "mkdir", res);
+                return;
+            }
+            if (++job->index == job->directories.size()) {
+                job->step = Job::Step::Open;
+            }
+            break;
+        case Job::Step::Open:
+            if (res < 0) {
+                fail(job, "open", res);
+                return;
+            }
+            job->fd = res;
+            job->step = job->size == 0 ? Job::Step::Close : Job::Step::Write;
+            break;
+        case Job::Step::Write:
+            if (res <= 0) {
+                fail(job, "write", res == 0 ? -EIO : res);
+                return;
+            }
+            job->written += static_cast<size_t>(res);
+            if (job->written == job->size) {
+                job->step = Job::Step::Close;
+            }
+            break;
+        case Job::Step::Close:
+            job->fd = -1;
+            if (res < 0 && job->error.empty()) {
+                job->error = errnoText("close", job->paths[0], -res);
+            }
+            if (job->error.empty()) {
+                complete(job);
+                return;
+            }
+            job->step = Job::Step::Cleanup;
+            break;
+        case Job::Step::Cleanup:
+            complete(job);
+            return;
+        case Job::Step::Unlink:
+            if (res < 0 && res != -ENOENT && job->error.empty()) {
+                job->error = errnoText("unlink", job->paths[job->index], -res);
+            }
+            if (++job->index == job->paths.size()) {
+                complete(job);
+                return;
+            }
+            break;
+        }
+        prepare(job);
+    }
+
+    void complete(Job* job) {
+        std::unique_ptr<Job> owned(job);
+        --active_;
+        owned->finish();
+    }
+
+    io_uring ring_;
+    int wakeFd_ = -1;
+    uint64_t wakeCounter_ = 0;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Job>> incoming_;
+
+    size_t active_ = 0;  // только поток кольца
+    std::atomic<bool> stopping_{false};
+    std::thread thread_;
+};
+
+#endif
+
+FileIoExecutor::~FileIoExecutor() = default;
+
+void FileIoExecutor::start() {
+    std::call_once(started_, [this]() { init(); });
+}
+
+void FileIoExecutor::init() {
+    const auto& config = app().getCustomConfig()["file_io"];
+    std::string backend = config.get("backend", "auto").asString();
+
+#ifdef HAS_LIBURING
+    if (backend != "threads") {
+        if (Ring::supported()) {
+            try {
+                ring_ = std::make_unique<Ring>(std::max(8u, config.get("ring_entries", 256).asUInt()));
+                LOG_INFO << "File I/O: io_uring";
+                return;
+            } catch (const std::exception& e) {
+                LOG_WARN << "io_uring is not available, falling back to threads: " << e.what();
+            }
+        } else {
+            LOG_WARN << "Kernel lacks io_uring file operations, falling back to threads";
+        }
+    }
+#else
+    if (backend == "io_uring") {
+        LOG_WARN << "Built without liburing, file I/O uses threads";
+    }
+#endif
+
+    pool_ = std::make_unique<trantor::ConcurrentTaskQueue>(
+        std::max(1u, config.get("threads", 4).asUInt()), "FileIoExecutor");
+    LOG_INFO << "File I/O: thread pool";
+}
+
+void FileIoExecutor::shutdown() {
+#ifdef HAS_LIBURING
+    if (ring_) {
+        ring_->stop();
+        return;
+    }
+#endif
+    if (pool_) {
+        pool_->waitAllTasksFinished();
+    }
+}
+
+const char* FileIoExecutor::backendName() const {
+#ifdef HAS_LIBURING
+    if (ring_) {
+        return "io_uring";
+    }
+#endif
+    return "threads";
+}
+
+void FileIoExecutor::writeFile(const HttpFile& file, const std::string& path, Done&& done) {
+    auto job = std::make_unique<Job>();
+    job->kind = Job::Kind::Write;
+    job->paths.push_back(path);
+    job->file = std::make_shared<const HttpFile>(file);
+    job->data = job->file->fileData();
+    job->size = job->file->fileLength();
+    job->done = std::move(done);
+    submit(std::move(job));
+}
+
+void FileIoExecutor::removeFiles(std::vector<std::string> paths, Done&& done) {
+    auto job = std::make_unique<Job>();
+    job->kind = Job::Kind::Remove;
+    job->paths = std::move(paths);
+    job->paths.erase(std::remove(job->paths.begin(), job->paths.end(), std::string()), job->paths.end());
+    job->done = std::move(done);
+    submit(std::move(job));
+}
+
+void FileIoExecutor::submit(std::unique_ptr<Job> job) {
+    start();
+
+    // Вне цикла событий (очереди сервисов) колбэк вызывается прямо в потоке ввода-вывода
+    job->loop = trantor::EventLoop::getEventLoopOfCurrentThread();
+
+#ifdef HAS_LIBURING
+    if (ring_) {
+        ring_->submit(std::move(job));
+        return;
+    }
+#endif
+
+    pool_->runTaskInQueue([job = std::shared_ptr<Job>(std::move(job))]() {
+        runSync(*job);
+        job->finish();
+    });
+}
+
+void FileIoExecutor::runSync(Job& job) {
+    if (job.kind == Job::Kind::Remove) {
+        for (const auto& path : job.paths) {
+            if (unlink(path.c_str()) != 0 && errno != ENOENT && job.error.empty()) {
+                job.error = errnoText("unlink", path, errno);
+            }
+        }
+        return;
+    }
+
+    const auto& path = job.paths[0];
+    for (const auto& dir : parentDirectories(path)) {
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            job.error = errnoText("mkdir", dir, errno);
+            return;
+        }
+    }
+
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        job.error = errnoText("open", path, errno);
+        return;
+    }
+
+    while (job.written < job.size) {
+        ssize_t n = write(fd, job.data + job.written, std::min(job.size - job.written, kWriteChunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            job.error = errnoText("write", path, n == 0 ? EIO : errno);
+            break;
+        }
+        job.written += static_cast<size_t>(n);
+    }
+
+    if (close(fd) != 0 && job.error.empty()) {
+        job.error = errnoText("close", path, errno);
+    }
+    if (!job.error.empty()) {
+        unlink(path.c_str());
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Файловые операции загрузок вне IO-потоков drogon.
+// Запись загруженного файла (с созданием каталогов) и удаление идут через
+// io_uring, если сервер собран с liburing (HAS_LIBURING) и ядро поддерживает
+// нужные операции, иначе - через пул потоков. Колбэк вызывается в цикле
+// событий того потока, который поставил операцию, поэтому продолжение
+// обработчика (запросы в БД, ответ) остаётся там же, где и было.
+class FileIoExecutor {
+public:
+    static FileIoExecutor& instance() {
+        static FileIoExecutor instance;
+        return instance;
+    }
+
+    // Выбор бэкенда по custom_config.file_io (вызывается из main до app().run())
+    void start();
+
+    // Дождаться уже поставленных операций при остановке сервера
+    void shutdown();
+
+    // Пустая строка - успех, иначе текст ошибки
+    using Done = std::function<void(const std::string& error)>;
+
+    // Записать загруженный файл по пути path, недостающие каталоги создаются.
+    // При ошибке недописанный файл удаляется
+    void writeFile(const drogon::HttpFile& file, const std::string& path, Done&& done);
+
+    // Удалить файлы; отсутствующий файл ошибкой не считается
+    void removeFiles(std::vector<std::string> paths, Done&& done = nullptr);
+
+    const char* backendName() const;
+
+private:
+    FileIoExecutor() = default;
+    ~FileIoExecutor();
+
+    struct Job;
+
+    void init();
+    void submit(std::unique_ptr<Job> job);
+
+    // Бэкенд пула потоков: те же шаги обычными системными вызовами
+    static void runSync(Job& job);
+
+    std::once_flag started_;
+    std::unique_ptr<trantor::ConcurrentTaskQueue> pool_;
+
+#ifdef HAS_LIBURING
+    class Ring;
+    std::unique_ptr<Ring> ring_;
+#endif
+};
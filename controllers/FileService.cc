@@ -1,41 +1,29 @@
 #include "FileService.h"
 #include <drogon/drogon.h>
 #include <drogon/utils/Utilities.h>
-#include <filesystem>
 #include <algorithm>
 #include <cctype>
 
 using namespace drogon;
-namespace fs = std::filesystem;
 
-bool FileService::createCourseDirectory(const std::string& courseId) {
-    std::string coursePath = baseUploadPath_ + "/courses/" + courseId;
-    return ensureDirectoryExists(coursePath);
-}
-
-bool FileService::createChapterDirectory(const std::string& courseId, const std::string& chapterId) {
-    std::string chapterPath = baseUploadPath_ + "/courses/" + courseId + "/chapters/" + chapterId;
-    return ensureDirectoryExists(chapterPath);
-}
-
-FileService::FileInfo FileService::saveVideoFile(const HttpRequestPtr& req,
-                                                 const std::string& courseId,
-                                                 const std::string& chapterId) {
-    FileInfo fileInfo;
+void FileService::saveVideoFile(const HttpRequestPtr& req,
+                                const std::string& courseId,
+                                const std::string& chapterId,
+                                Saved&& done) {
     drogon::MultiPartParser fileUpload;
 
     // Парсим multipart запрос
     if (fileUpload.parse(req) != 0) {
-        throw std::runtime_error("Failed to parse multipart request");
+        done(FileInfo{}, "Failed to parse multipart request");
+        return;
     }
 
     auto& files = fileUpload.getFiles();
     if (files.empty()) {
-        throw std::runtime_error("No files found in request");
+        done(FileInfo{}, "No files found in request");
+        return;
     }
 
-    auto& file = files[0];
-
     // Определяем путь для сохранения
     std::string savePath;
     if (chapterId.empty()) {
@@ -44,50 +32,29 @@ FileService::FileInfo FileService::saveVideoFile(const HttpRequestPtr& req,
         savePath = baseUploadPath_ + "/courses/" + courseId + "/chapters/" + chapterId + "/videos";
     }
 
-    // Создаем директорию если не существует
-    if (!ensureDirectoryExists(savePath)) {
-        throw std::runtime_error("Failed to create directory: " + savePath);
-    }
-
-    // Генерируем уникальное имя файла
-    std::string filename = generateFilename(file.getFileName());
-    std::string fullPath = savePath + "/" + filename;
-
-    // Сохраняем файл с проверкой успеха операции
-    if (!file.saveAs(fullPath)) {
-        throw std::runtime_error("Failed to save file: " + fullPath);
-    }
-
-    // Заполняем информацию о файле
-    fileInfo.filename = filename;
-    fileInfo.path = fullPath.substr(baseUploadPath_.length() + 1); // относительный путь
-    fileInfo.full_path = fullPath;
-    fileInfo.size = file.fileLength(); // Исправлено: fileSize() вместо getFileSize()
-    fileInfo.mime_type = getMimeType(filename);
-
-    return fileInfo;
+    writeUpload(files[0], savePath, std::move(done));
 }
 
-FileService::FileInfo FileService::saveCoverImage(const HttpRequestPtr& req,
-                                                  const std::string& courseId,
-                                                  const std::string& chapterId) {
-    FileInfo fileInfo;
+void FileService::saveCoverImage(const HttpRequestPtr& req,
+                                 const std::string& courseId,
+                                 const std::string& chapterId,
+                                 Saved&& done) {
     drogon::MultiPartParser fileUpload;
 
     // Парсим multipart запрос
     if (fileUpload.parse(req) != 0) {
-        throw std::runtime_error("Failed to parse multipart request");
+        done(FileInfo{}, "Failed to parse multipart request");
+        return;
     }
 
     auto& files = fileUpload.getFiles();
     if (files.empty()) {
-        throw std::runtime_error("No files found in request");
+        done(FileInfo{}, "No files found in request");
+        return;
     }
 
-    bool coverFound = false;
     for (auto& file : files) {
-        std::string name = file.getFileName();
-        std::string lowerName = name;
+        std::string lowerName = file.getFileName();
         std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(),
                        [](unsigned char c){ return std::tolower(c); });
 
@@ -95,60 +62,43 @@ FileService::FileInfo FileService::saveCoverImage(const HttpRequestPtr& req,
         if (lowerName.find("cover") != std::string::npos ||
             lowerName.find("image") != std::string::npos ||
             lowerName.find("poster") != std::string::npos) {
-
-            std::string savePath = getCoverSavePath(courseId, chapterId);
-
-            if (!ensureDirectoryExists(savePath)) {
-                throw std::runtime_error("Failed to create directory: " + savePath);
-            }
-
-            std::string filename = generateFilename(file.getFileName());
-            std::string fullPath = savePath + "/" + filename;
-
-            if (!file.saveAs(fullPath)) {
-                throw std::runtime_error("Failed to save cover image: " + fullPath);
-            }
-
-            fillFileInfo(fileInfo, file, fullPath, filename);
-            coverFound = true;
-            break;
+            writeUpload(file, getCoverSavePath(courseId, chapterId), std::move(done));
+            return;
         }
     }
 
     // Если не нашли по ключевым словам - ищем по расширению
-    if (!coverFound) {
-        for (auto& file : files) {
-            std::string filename = file.getFileName();
-            std::string lowerName = filename;
-            std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(),
-                           [](unsigned char c){ return std::tolower(c); }); // Исправлено: tolower вместо toLowerCase
-
-            if (hasValidImageExtension(lowerName)) {
-                std::string savePath = getCoverSavePath(courseId, chapterId);
-
-                if (!ensureDirectoryExists(savePath)) {
-                    throw std::runtime_error("Failed to create directory: " + savePath);
-                }
-
-                std::string newFilename = generateFilename(filename);
-                std::string fullPath = savePath + "/" + newFilename;
-
-                if (!file.saveAs(fullPath)) {
-                    throw std::runtime_error("Failed to save cover image: " + fullPath);
-                }
-
-                fillFileInfo(fileInfo, file, fullPath, newFilename);
-                coverFound = true;
-                break;
-            }
+    for (auto& file : files) {
+        std::string lowerName = file.getFileName();
+        std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(),
+                       [](unsigned char c){ return std::tolower(c); }); // Исправлено: tolower вместо toLowerCase
+
+        if (hasValidImageExtension(lowerName)) {
+            writeUpload(file, getCoverSavePath(courseId, chapterId), std::move(done));
+            return;
         }
     }
 
-    if (!coverFound) {
-        throw std::runtime_error("No valid cover image found in request");
-    }
+    done(FileInfo{}, "No valid cover image found in request");
+}
 
-    return fileInfo;
+void FileService::writeUpload(const drogon::HttpFile& file, const std::string& savePath, Saved&& done) {
+    // Генерируем уникальное имя файла; недостающие папки создаются при записи
+    std::string filename = generateFilename(file.getFileName());
+    std::string fullPath = savePath + "/" + filename;
+
+    FileInfo fileInfo;
+    fillFileInfo(fileInfo, file, fullPath, filename);
+
+    FileIoExecutor::instance().writeFile(
+        file, fullPath,
+        [fileInfo, done = std::move(done)](const std::string& error) {
+            if (!error.empty()) {
+                done(FileInfo{}, "Failed to save file: " + error);
+                return;
+            }
+            done(fileInfo, "");
+        });
 }
 
 std::string FileService::getCoverSavePath(const std::string& courseId, const std::string& chapterId) {
@@ -179,16 +129,15 @@ void FileService::fillFileInfo(FileInfo& fileInfo, const drogon::HttpFile& file,
     fileInfo.mime_type = getMimeType(filename);
 }
 
-bool FileService::deleteFile(const std::string& path) {
-    try {
-        if (fs::exists(path)) {
-            return fs::remove(path);
+void FileService::deleteFile(const std::string& path, FileIoExecutor::Done&& done) {
+    FileIoExecutor::instance().removeFiles({path}, [done = std::move(done)](const std::string& error) {
+        if (!error.empty()) {
+            LOG_ERROR << "Error deleting file: " << error;
         }
-        return true; // Файл и так не существует
-    } catch (const std::exception& e) {
-        LOG_ERROR << "Error deleting file: " << e.what();
-        return false;
-    }
+        if (done) {
+            done(error);
+        }
+    });
 }
 
 std::string FileService::getFilePath(const std::string& courseId,
@@ -217,15 +166,6 @@ std::string FileService::generateFilename(const std::string& originalName) {
     return uuid + extension;
 }
 
-bool FileService::ensureDirectoryExists(const std::string& path) {
-    try {
-        return fs::create_directories(path);
-    } catch (const std::exception& e) {
-        LOG_ERROR << "Error creating directory: " << e.what();
-        return false;
-    }
-}
-
 std::string FileService::getMimeType(const std::string& filename) {
     size_t dotPos = filename.find_last_of('.');
     if (dotPos == std::string::npos) return "application/octet-stream";
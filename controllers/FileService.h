@@ -3,8 +3,9 @@
 #include <drogon/drogon.h>
 #include <drogon/HttpRequest.h>
 #include <drogon/HttpResponse.h>
+#include "FileIoExecutor.h"
+#include <functional>
 #include <string>
-#include <filesystem>
 
 class FileService {
 public:
@@ -21,24 +22,24 @@ public:
         std::string mime_type;
     };
 
-    // Создание структуры папок для курса
-    bool createCourseDirectory(const std::string& courseId);
+    // Результат сохранения: error пустой при успехе
+    using Saved = std::function<void(const FileInfo& info, const std::string& error)>;
 
-    // Создание структуры папок для главы
-    bool createChapterDirectory(const std::string& courseId, const std::string& chapterId);
-
-    // Сохранение видео файла
-    FileInfo saveVideoFile(const drogon::HttpRequestPtr& req,
-                           const std::string& courseId,
-                           const std::string& chapterId = "");
+    // Сохранение видео файла. Запись (вместе с созданием папок курса и главы)
+    // идёт через FileIoExecutor, колбэк - в потоке вызывающего
+    void saveVideoFile(const drogon::HttpRequestPtr& req,
+                       const std::string& courseId,
+                       const std::string& chapterId,
+                       Saved&& done);
 
     // Сохранение обложки видео
-    FileInfo saveCoverImage(const drogon::HttpRequestPtr& req,
-                            const std::string& courseId,
-                            const std::string& chapterId = "");
+    void saveCoverImage(const drogon::HttpRequestPtr& req,
+                        const std::string& courseId,
+                        const std::string& chapterId,
+                        Saved&& done);
 
     // Удаление файла
-    bool deleteFile(const std::string& path);
+    void deleteFile(const std::string& path, FileIoExecutor::Done&& done = nullptr);
 
     // Получение пути для файла
     std::string getFilePath(const std::string& courseId,
@@ -51,9 +52,11 @@ private:
     std::string baseUploadPath_ = "uploads";
 
     std::string generateFilename(const std::string& originalName);
-    bool ensureDirectoryExists(const std::string& path);
     std::string getMimeType(const std::string& filename);
 
+    // Запись файла в папку savePath под новым именем
+    void writeUpload(const drogon::HttpFile& file, const std::string& savePath, Saved&& done);
+
     // Вспомогательные методы для saveCoverImage
     std::string getCoverSavePath(const std::string& courseId, const std::string& chapterId);
     bool hasValidImageExtension(const std::string& filename);
@@ -0,0 +1,197 @@
+#include "HttpCache.h"
+#include "ResponseFormat.h"
+#include <drogon/drogon.h>
+#include <drogon/utils/Utilities.h>
+#include <charconv>
+#include <map>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+// Заголовок If-None-Match: список тегов через запятую, "*" или слабые W/"..."
+bool etagListMatches(const std::string& header, const std::string& etag) {
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == std::string::npos) {
+            end = header.size();
+        }
+
+        std::string_view candidate(header.data() + pos, end - pos);
+        while (!candidate.empty() && candidate.front() == ' ') {
+            candidate.remove_prefix(1);
+        }
+        while (!candidate.empty() && candidate.back() == ' ') {
+            candidate.remove_suffix(1);
+        }
+        if (candidate == "*") {
+            return true;
+        }
+        // Для GET сравнение слабое: W/ игнорируется
+        if (candidate.substr(0, 2) == "W/") {
+            candidate.remove_prefix(2);
+        }
+        if (candidate == etag) {
+            return true;
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+std::string httpDate(int64_t seconds) {
+    return utils::getHttpFullDate(trantor::Date(seconds * 1000000));
+}
+
+} // namespace
+
+HttpCache::Validator HttpCache::versioned(const HttpRequestPtr& req,
+                                          std::string_view kind,
+                                          std::string_view version,
+                                          int64_t lastModified,
+                                          const std::string& viewerId) {
+    // Параметры в порядке ключей, а не строка query(): у внутренних подзапросов
+    // (/batch) параметры заданы через setParameter и строки query нет
+    const auto& parameters = req->getParameters();
+    std::map<std::string, std::string> sorted(parameters.begin(), parameters.end());
+
+    std::string variant = req->path();
+    variant += '?';
+    for (const auto& [key, value] : sorted) {
+        variant += key;
+        variant += '=';
+        variant += value;
+        variant += '&';
+    }
+    variant += '|';
+    variant += viewerId;
+    // JSON и CBOR - разные представления, у каждого свой ETag
+    if (ResponseFormat::prefersCbor(req)) {
+        variant += "|cbor";
+    }
+
+    Validator validator;
+    validator.etag.reserve(kind.size() + version.size() + 22);
+    validator.etag += '"';
+    validator.etag.append(kind.data(), kind.size());
+    validator.etag += '-';
+    validator.etag.append(version.data(), version.size());
+    validator.etag += '-';
+    validator.etag += utils::getMd5(variant).substr(0, 16);
+    validator.etag += '"';
+    validator.lastModified = lastModified;
+    return validator;
+}
+
+const std::string& HttpCache::courseVersionColumns() {
+    static const std::string columns =
+        "content_version || '.' || counters_version AS etag_version, "
+        "EXTRACT(EPOCH FROM GREATEST(content_updated_at, counters_updated_at))::bigint AS etag_modified_at";
+    return columns;
+}
+
+HttpCache::Validator HttpCache::courseValidator(const HttpRequestPtr& req,
+                                                const Row& row,
+                                                const std::string& viewerId) {
+    return versioned(req, "course",
+                     row["etag_version"].as<std::string>(),
+                     row["etag_modified_at"].as<int64_t>(),
+                     viewerId);
+}
+
+bool HttpCache::isNotModified(const HttpRequestPtr& req, const Validator& validator) {
+    const auto& ifNoneMatch = req->getHeader("If-None-Match");
+    if (!ifNoneMatch.empty()) {
+        return !validator.etag.empty() && etagListMatches(ifNoneMatch, validator.etag);
+    }
+
+    const auto& ifModifiedSince = req->getHeader("If-Modified-Since");
+    if (!ifModifiedSince.empty() && validator.lastModified > 0) {
+        auto since = utils::getHttpDate(ifModifiedSince);
+        return since.microSecondsSinceEpoch() > 0 &&
+               validator.lastModified <= since.microSecondsSinceEpoch() / 1000000;
+    }
+    return false;
+}
+
+int64_t HttpCache::expectedVersion(const HttpRequestPtr& req, std::string_view kind) {
+    std::string_view tag = req->getHeader("If-Match");
+    while (!tag.empty() && tag.front() == ' ') {
+        tag.remove_prefix(1);
+    }
+    while (!tag.empty() && tag.back() == ' ') {
+        tag.remove_suffix(1);
+    }
+    if (tag.empty() || tag == "*") {
+        return -1;
+    }
+
+    // Слабым может быть только наш тег вида kind: W/ добавляет сжатие, а версия
+    // ресурса в нём не меняется. Список тегов не подходит
+    bool weak = tag.substr(0, 2) == "W/";
+    if (weak) {
+        tag.remove_prefix(2);
+    }
+    if (tag.size() >= 2 && tag.front() == '"' && tag.back() == '"') {
+        tag = tag.substr(1, tag.size() - 2);
+    }
+    if (tag.size() > kind.size() && tag.substr(0, kind.size()) == kind && tag[kind.size()] == '-') {
+        tag.remove_prefix(kind.size() + 1);
+        tag = tag.substr(0, tag.find('-'));
+    } else if (weak) {
+        return 0;
+    }
+
+    int64_t version = 0;
+    auto [end, ec] = std::from_chars(tag.data(), tag.data() + tag.size(), version);
+    if (ec != std::errc() || end != tag.data() + tag.size() || version <= 0) {
+        return 0;
+    }
+    return version;
+}
+
+HttpResponsePtr HttpCache::notModified(const Validator& validator) {
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(k304NotModified);
+    apply(resp, validator);
+    return resp;
+}
+
+void HttpCache::apply(const HttpResponsePtr& resp, const Validator& validator) {
+    if (!validator.etag.empty()) {
+        resp->addHeader("ETag", validator.etag);
+    }
+    if (validator.lastModified > 0) {
+        resp->addHeader("Last-Modified", httpDate(validator.lastModified));
+    }
+    // Ответы зависят от токена: хранить можно только клиенту и только с перепроверкой
+    resp->addHeader("Cache-Control", "private, no-cache");
+}
+
+void HttpCache::registerDigestFallback() {
+    app().registerPostHandlingAdvice([](const HttpRequestPtr& req, const HttpResponsePtr& resp) {
+        if (req->method() != Get || resp->statusCode() != k200OK) {
+            return;
+        }
+        // Уже есть валидатор (версия ресурса, файл) или тело отдаётся файлом
+        if (!resp->getHeader("ETag").empty() || resp->body().empty()) {
+            return;
+        }
+
+        Validator validator;
+        validator.etag = (ResponseFormat::prefersCbor(req) ? "\"md5-cbor-" : "\"md5-") +
+                         utils::getMd5(resp->body().data(), resp->body().size()) + "\"";
+
+        const auto& ifNoneMatch = req->getHeader("If-None-Match");
+        if (!ifNoneMatch.empty() && etagListMatches(ifNoneMatch, validator.etag)) {
+            resp->setStatusCode(k304NotModified);
+            resp->setBody("");
+        }
+        resp->addHeader("ETag", validator.etag);
+        if (resp->getHeader("Cache-Control").empty()) {
+            resp->addHeader("Cache-Control", "private, no-cache");
+        }
+    });
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <drogon/orm/Row.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Условные GET: сильный ETag из версии ресурса и Last-Modified.
+// Версия берётся дешёвым запросом (или из строки, которую обработчик и так
+// читает для проверки доступа), и при совпадении ответ 304 отдаётся до того,
+// как собирается тело.
+class HttpCache {
+public:
+    struct Validator {
+        std::string etag;          // вместе с кавычками
+        int64_t lastModified = 0;  // unix-время в секундах, 0 - не отправлять
+    };
+
+    // ETag = вид ресурса + версия + хеш представления (путь, query, кто смотрит,
+    // JSON или CBOR): разные fields/page/права дают разные представления одной версии
+    static Validator versioned(const drogon::HttpRequestPtr& req,
+                               std::string_view kind,
+                               std::string_view version,
+                               int64_t lastModified,
+                               const std::string& viewerId);
+
+    // Колонки версии курса для SELECT (под своими псевдонимами, чтобы не
+    // пересекаться с SELECT *), по ним строит валидатор courseValidator.
+    // Версия - content_version.counters_version: счётчики тоже есть в телах
+    static const std::string& courseVersionColumns();
+    static Validator courseValidator(const drogon::HttpRequestPtr& req,
+                                     const drogon::orm::Row& row,
+                                     const std::string& viewerId);
+
+    // If-None-Match (приоритетнее) или If-Modified-Since
+    static bool isNotModified(const drogon::HttpRequestPtr& req, const Validator& validator);
+
+    // Версия из If-Match для условных изменений: -1 - заголовка нет или "*",
+    // 0 - тег не подходит (такой версии не бывает, изменение получит 412).
+    // Принимает ETag из GET этого вида ресурса ("kind-версия-...") или голую версию.
+    // Сжатые ответы отдают тег с W/ (ResponseCompressor): версия в нём та же,
+    // поэтому W/"kind-..." тоже принимается, другие слабые теги - нет
+    static int64_t expectedVersion(const drogon::HttpRequestPtr& req, std::string_view kind);
+
+    static drogon::HttpResponsePtr notModified(const Validator& validator);
+    static void apply(const drogon::HttpResponsePtr& resp, const Validator& validator);
+
+    // Для остальных GET: ETag по md5 готового тела и 304 при совпадении.
+    // Экономит трафик, но не работу сервера (вызывается из main)
+    static void registerDigestFallback();
+};
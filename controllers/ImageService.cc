@@ -0,0 +1,334 @@
+#include "ImageService.h"
+#include "FileIoExecutor.h"
+#include "JsonStreamWriter.h"
+#include <drogon/drogon.h>
+#include <drogon/utils/Utilities.h>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <cstring>
+#include <algorithm>
+
+#include "LibavUtils.h"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+using namespace drogon;
+namespace fs = std::filesystem;
+
+namespace {
+
+using libav::CodecContextPtr;
+using libav::FramePtr;
+using libav::PacketPtr;
+using libav::SwsContextPtr;
+
+// Защита от "картинок-бомб": слишком большие исходники не обрабатываем
+constexpr int kMaxSourceDimension = 10000;
+
+// Определяем формат по сигнатуре, а не по расширению из запроса
+AVCodecID detectCodec(const std::string& data) {
+    auto bytes = reinterpret_cast<const unsigned char*>(data.data());
+    if (data.size() >= 8 && std::memcmp(bytes, "\x89PNG\r\n\x1a\n", 8) == 0) {
+        return AV_CODEC_ID_PNG;
+    }
+    if (data.size() >= 3 && bytes[0] == 0xFF && bytes[1] == 0xD8 && bytes[2] == 0xFF) {
+        return AV_CODEC_ID_MJPEG;
+    }
+    if (data.size() >= 12 && std::memcmp(bytes, "RIFF", 4) == 0 && std::memcmp(bytes + 8, "WEBP", 4) == 0) {
+        return AV_CODEC_ID_WEBP;
+    }
+    return AV_CODEC_ID_NONE;
+}
+
+FramePtr decodeImage(const std::string& data) {
+    AVCodecID codecId = detectCodec(data);
+    if (codecId == AV_CODEC_ID_NONE) {
+        throw std::runtime_error("Unsupported image format");
+    }
+
+    const AVCodec* codec = avcodec_find_decoder(codecId);
+    if (!codec) {
+        throw std::runtime_error("Image decoder is not available");
+    }
+
+    CodecContextPtr ctx(avcodec_alloc_context3(codec));
+    if (!ctx || avcodec_open2(ctx.get(), codec, nullptr) < 0) {
+        throw std::runtime_error("Failed to open image decoder");
+    }
+
+    // Декодеру нужен буфер с нулевым хвостом AV_INPUT_BUFFER_PADDING_SIZE
+    std::vector<uint8_t> buffer(data.size() + AV_INPUT_BUFFER_PADDING_SIZE, 0);
+    std::memcpy(buffer.data(), data.data(), data.size());
+
+    PacketPtr packet(av_packet_alloc());
+    FramePtr frame(av_frame_alloc());
+    if (!packet || !frame) {
+        throw std::runtime_error("Out of memory");
+    }
+    packet->data = buffer.data();
+    packet->size = static_cast<int>(data.size());
+
+    if (avcodec_send_packet(ctx.get(), packet.get()) < 0) {
+        throw std::runtime_error("Failed to decode image");
+    }
+    avcodec_send_packet(ctx.get(), nullptr);
+
+    if (avcodec_receive_frame(ctx.get(), frame.get()) < 0) {
+        throw std::runtime_error("Failed to decode image");
+    }
+
+    if (frame->width <= 0 || frame->height <= 0 ||
+        frame->width > kMaxSourceDimension || frame->height > kMaxSourceDimension) {
+        throw std::runtime_error("Image dimensions are out of range");
+    }
+
+    return frame;
+}
+
+// Вписываем изображение в рамку с сохранением пропорций, без увеличения
+void fitInto(int srcWidth, int srcHeight, int maxWidth, int maxHeight, int& width, int& height) {
+    double scale = std::min({1.0,
+                             static_cast<double>(maxWidth) / srcWidth,
+                             static_cast<double>(maxHeight) / srcHeight});
+    // Для yuv420 размеры должны быть чётными
+    width = std::max(2, static_cast<int>(srcWidth * scale) & ~1);
+    height = std::max(2, static_cast<int>(srcHeight * scale) & ~1);
+}
+
+FramePtr scaleImage(const AVFrame* src, int width, int height, AVPixelFormat format) {
+    SwsContextPtr sws(sws_getContext(src->width, src->height, static_cast<AVPixelFormat>(src->format),
+                                     width, height, format,
+                                     SWS_LANCZOS, nullptr, nullptr, nullptr));
+    if (!sws) {
+        throw std::runtime_error("Failed to create scaler");
+    }
+
+    FramePtr dst(av_frame_alloc());
+    if (!dst) {
+        throw std::runtime_error("Out of memory");
+    }
+    dst->width = width;
+    dst->height = height;
+    dst->format = format;
+
+    if (av_frame_get_buffer(dst.get(), 0) < 0) {
+        throw std::runtime_error("Failed to allocate frame");
+    }
+
+    sws_scale(sws.get(), src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+
+    return dst;
+}
+
+const AVCodec* findVariantEncoder() {
+    if (auto webp = avcodec_find_encoder_by_name("libwebp")) {
+        return webp;
+    }
+    return avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+}
+
+} // namespace
+
+ImageService::ImageService()
+    : queue_(std::max(1u, app().getCustomConfig()["images"].get("worker_threads", 2).asUInt()),
+             "ImageService") {
+    auto encoder = findVariantEncoder();
+    extension_ = (encoder && encoder->id == AV_CODEC_ID_WEBP) ? "webp" : "jpg";
+    if (extension_ != "webp") {
+        LOG_WARN << "libwebp encoder is not available, image variants will be stored as JPEG";
+    }
+}
+
+const std::string& ImageService::variantsDirectory() {
+    static const std::string dir = "uploads/images";
+    return dir;
+}
+
+const std::string& ImageService::variantsUrlPrefix() {
+    static const std::string prefix = "/media/images/";
+    return prefix;
+}
+
+std::vector<ImageService::VariantSize> ImageService::sizesFor(ImageKind kind) {
+    switch (kind) {
+    case ImageKind::Avatar:
+        return {{"thumb", 64, 64}, {"card", 200, 200}, {"full", 512, 512}};
+    case ImageKind::ProfileCover:
+        return {{"thumb", 480, 135}, {"card", 1280, 360}, {"full", 1920, 540}};
+    case ImageKind::CourseCover:
+        return {{"thumb", 320, 180}, {"card", 640, 360}, {"full", 1280, 720}};
+    }
+    return {};
+}
+
+const char* ImageService::kindPrefix(ImageKind kind) {
+    switch (kind) {
+    case ImageKind::Avatar: return "avatar";
+    case ImageKind::ProfileCover: return "cover";
+    case ImageKind::CourseCover: return "course";
+    }
+    return "image";
+}
+
+void ImageService::processUpload(const HttpFile& file,
+                                 ImageKind kind,
+                                 const std::string& ownerId,
+                                 ProcessCallback&& callback) {
+    // Копируем данные: объект запроса может быть освобождён раньше, чем отработает очередь
+    std::string data(file.fileData(), file.fileLength());
+
+    queue_.runTaskInQueue([this, data = std::move(data), kind, ownerId, callback = std::move(callback)]() {
+        try {
+            auto variants = processSync(data, kind, ownerId);
+            callback(variants, "");
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Image processing error: " << e.what();
+            callback(ImageVariants{}, e.what());
+        }
+    });
+}
+
+ImageService::ImageVariants ImageService::processSync(const std::string& data,
+                                                      ImageKind kind,
+                                                      const std::string& ownerId) {
+    const AVCodec* encoder = findVariantEncoder();
+    if (!encoder) {
+        throw std::runtime_error("No image encoder available");
+    }
+
+    auto source = decodeImage(data);
+
+    // Имя файла зависит только от содержимого, типа и владельца,
+    // поэтому файлы никогда не перезаписываются другим содержимым
+    std::string hash = utils::getMd5(std::string(kindPrefix(kind)) + ":" + ownerId + ":" + data);
+    std::string baseName = std::string(kindPrefix(kind)) + "_" + hash;
+
+    const auto* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(source->format));
+    bool hasAlpha = desc && (desc->flags & AV_PIX_FMT_FLAG_ALPHA);
+
+    AVPixelFormat targetFormat = AV_PIX_FMT_YUVJ420P;
+    if (encoder->id == AV_CODEC_ID_WEBP) {
+        targetFormat = hasAlpha ? AV_PIX_FMT_YUVA420P : AV_PIX_FMT_YUV420P;
+    }
+
+    int quality = app().getCustomConfig()["images"].get("quality", 80).asInt();
+
+    fs::create_directories(variantsDirectory());
+
+    ImageVariants variants;
+    for (const auto& size : sizesFor(kind)) {
+        std::string path = variantsDirectory() + "/" + baseName + "_" + size.name + "." + extension_;
+
+        if (!fs::exists(path)) {
+            int width = 0;
+            int height = 0;
+            fitInto(source->width, source->height, size.maxWidth, size.maxHeight, width, height);
+
+            auto scaled = scaleImage(source.get(), width, height, targetFormat);
+            std::string encoded = libav::encodeFrame(scaled.get(), encoder, quality);
+
+            if (!writeFileAtomically(path, encoded)) {
+                throw std::runtime_error("Failed to save image: " + path);
+            }
+        } else {
+            // Повторная загрузка того же изображения: свежая дата изменения
+            // не даёт UploadGarbageCollector удалить файл до записи ссылки в БД
+            std::error_code ec;
+            fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+        }
+
+        if (std::strcmp(size.name, "thumb") == 0) {
+            variants.thumb = path;
+        } else if (std::strcmp(size.name, "card") == 0) {
+            variants.card = path;
+        } else {
+            variants.full = path;
+        }
+    }
+
+    return variants;
+}
+
+bool ImageService::writeFileAtomically(const std::string& path, const std::string& data) {
+    // Пишем во временный файл и переименовываем, чтобы по URL никогда
+    // не отдавался недописанный файл
+    std::string tmpPath = path + "." + utils::getUuid() + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            out.close();
+            std::error_code ec;
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    if (ec) {
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+Json::Value ImageService::variantsJson(const std::string& storedPath) {
+    const std::string dirPrefix = variantsDirectory() + "/";
+    if (storedPath.compare(0, dirPrefix.size(), dirPrefix) != 0) {
+        return Json::nullValue;
+    }
+
+    auto fullPos = storedPath.rfind("_full.");
+    if (fullPos == std::string::npos || fullPos < dirPrefix.size()) {
+        return Json::nullValue;
+    }
+
+    std::string baseName = storedPath.substr(dirPrefix.size(), fullPos - dirPrefix.size());
+    std::string extension = storedPath.substr(fullPos + 6);
+
+    Json::Value variants;
+    variants["thumb"] = variantsUrlPrefix() + baseName + "_thumb." + extension;
+    variants["card"] = variantsUrlPrefix() + baseName + "_card." + extension;
+    variants["full"] = variantsUrlPrefix() + baseName + "_full." + extension;
+    return variants;
+}
+
+void ImageService::writeVariants(JsonStreamWriter& writer, const orm::Field& field) {
+    if (field.isNull() || field.length() == 0) {
+        writer.nullValue();
+        return;
+    }
+    writer.jsonValue(variantsJson(field.as<std::string>()));
+}
+
+void ImageService::deleteVariants(const std::string& storedPath) {
+    if (storedPath.empty()) {
+        return;
+    }
+
+    std::vector<std::string> paths;
+    auto fullPos = storedPath.rfind("_full.");
+    if (storedPath.compare(0, variantsDirectory().size(), variantsDirectory()) == 0 &&
+        fullPos != std::string::npos) {
+        std::string base = storedPath.substr(0, fullPos);
+        std::string extension = storedPath.substr(fullPos + 6);
+        paths = {base + "_thumb." + extension, base + "_card." + extension, storedPath};
+    } else {
+        // Загрузки, сделанные до появления вариантов
+        paths = {storedPath};
+    }
+
+    // Удаление отложено в FileIoExecutor: обработчик запроса диск не ждёт
+    FileIoExecutor::instance().removeFiles(std::move(paths), [storedPath](const std::string& error) {
+        if (!error.empty()) {
+            LOG_ERROR << "Failed to delete image " << storedPath << ": " << error;
+        }
+    });
+}
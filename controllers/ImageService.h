@@ -0,0 +1,79 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <drogon/HttpRequest.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <json/json.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+class JsonStreamWriter;
+
+// Обработка загружаемых изображений: декодирование, ресайз до фиксированных
+// размеров (thumb / card / full) и перекодирование в WebP.
+// Тяжёлая работа выполняется в отдельной очереди, а не в IO-потоках drogon.
+class ImageService {
+public:
+    static ImageService& instance() {
+        static ImageService instance;
+        return instance;
+    }
+
+    enum class ImageKind {
+        Avatar,
+        ProfileCover,
+        CourseCover
+    };
+
+    // Набор сохранённых вариантов одного изображения (пути на диске)
+    struct ImageVariants {
+        std::string thumb;
+        std::string card;
+        std::string full;
+    };
+
+    using ProcessCallback = std::function<void(const ImageVariants& variants, const std::string& error)>;
+
+    // Асинхронная обработка загруженного файла.
+    // ownerId входит в хеш, поэтому одинаковые картинки разных владельцев
+    // не делят файлы и могут удаляться независимо.
+    void processUpload(const drogon::HttpFile& file,
+                       ImageKind kind,
+                       const std::string& ownerId,
+                       ProcessCallback&& callback);
+
+    // Варианты для JSON ответа по сохранённому в БД пути (путь к full-варианту).
+    // Для старых загрузок без вариантов возвращает null.
+    static Json::Value variantsJson(const std::string& storedPath);
+
+    // Колонка описания ответа (JsonRowLayout): варианты по пути из поля, null без изображения
+    static void writeVariants(JsonStreamWriter& writer, const drogon::orm::Field& field);
+
+    // Удаление всех вариантов изображения (или одиночного старого файла),
+    // выполняется в FileIoExecutor после возврата
+    void deleteVariants(const std::string& storedPath);
+
+    // Каталог с вариантами и URL, по которому они отдаются
+    static const std::string& variantsDirectory();
+    static const std::string& variantsUrlPrefix();
+
+private:
+    ImageService();
+
+    struct VariantSize {
+        const char* name;
+        int maxWidth;
+        int maxHeight;
+    };
+
+    static std::vector<VariantSize> sizesFor(ImageKind kind);
+    static const char* kindPrefix(ImageKind kind);
+
+    // Выполняются в очереди обработки
+    ImageVariants processSync(const std::string& data, ImageKind kind, const std::string& ownerId);
+    bool writeFileAtomically(const std::string& path, const std::string& data);
+
+    trantor::ConcurrentTaskQueue queue_;
+    std::string extension_;
+};
@@ -0,0 +1,302 @@
+#include "InvalidationBus.h"
+#include "PgArray.h"
+#include <libpq-fe.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <random>
+#include <unordered_set>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Имя канала подставляется в LISTEN как идентификатор
+bool isValidChannel(const std::string& channel) {
+    return !channel.empty() && std::all_of(channel.begin(), channel.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '_';
+    });
+}
+
+} // namespace
+
+InvalidationBus::InvalidationBus() {
+    std::random_device random;
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%08x%08x", random(), static_cast<unsigned>(getpid()));
+    nodeId_ = buffer;
+}
+
+void InvalidationBus::subscribe(const std::string& kind, KeyHandler onKey, FlushHandler onFlush) {
+    subscribers_[kind] = Subscriber{std::move(onKey), std::move(onFlush)};
+}
+
+void InvalidationBus::start() {
+    const auto& config = app().getCustomConfig()["invalidation"];
+    enabled_ = config.get("enabled", false).asBool();
+    channel_ = config.get("channel", "cache_invalidation").asString();
+    connectionString_ = config.get("connection_string", "").asString();
+    reconnectDelay_ = std::chrono::milliseconds(std::max(100, config.get("reconnect_delay_ms", 1000).asInt()));
+    keepalive_ = std::chrono::seconds(std::max(1, config.get("keepalive_seconds", 30).asInt()));
+
+    if (!enabled_) {
+        return;
+    }
+    if (!isValidChannel(channel_) || connectionString_.empty()) {
+        LOG_ERROR << "Invalidation bus disabled: invalid channel or empty connection_string";
+        enabled_ = false;
+        return;
+    }
+
+    listener_ = std::thread([this]() {
+        listen();
+    });
+}
+
+void InvalidationBus::shutdown() {
+    if (!listener_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+        stopping_ = true;
+    }
+    stopCondition_.notify_all();
+    listener_.join();
+}
+
+bool InvalidationBus::waitForStop(std::chrono::milliseconds delay) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    return stopCondition_.wait_for(lock, delay, [this]() { return stopping_.load(); });
+}
+
+void InvalidationBus::publish(const std::string& kind, const std::string& key) {
+    if (!enabled_) {
+        return;
+    }
+
+    bool first;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        first = pending_.empty();
+        pending_.push_back(kind + "|" + key);
+    }
+    // Все публикации текущего прохода цикла уйдут одним запросом
+    if (first) {
+        app().getLoop()->queueInLoop([this]() {
+            sendPending();
+        });
+    }
+}
+
+void InvalidationBus::sendPending() {
+    std::vector<std::string> batch;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex_);
+        batch.swap(pending_);
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    // Полезная нагрузка: узел|время отправки (мкс)|вид|ключ
+    std::string prefix = nodeId_ + "|" + std::to_string(nowMicros()) + "|";
+    std::unordered_set<std::string> seen;
+    std::vector<std::string> payloads;
+    payloads.reserve(batch.size());
+    for (auto& item : batch) {
+        if (seen.insert(item).second) {
+            payloads.push_back(prefix + item);
+        }
+    }
+
+    auto count = payloads.size();
+    app().getDbClient()->execSqlAsync(
+        "SELECT pg_notify($1, payload) FROM unnest($2::text[]) AS payload",
+        [this, count](const Result&) {
+            published_.fetch_add(count, std::memory_order_relaxed);
+        },
+        [this, count](const DrogonDbException& e) {
+            // Остальные экземпляры увидят изменения только по сроку жизни своих кешей
+            sendErrors_.fetch_add(count, std::memory_order_relaxed);
+            LOG_ERROR << "Failed to publish " << count << " cache invalidations: " << e.base().what();
+        },
+        channel_, pg::textArray(payloads));
+}
+
+void InvalidationBus::listen() {
+    bool everConnected = false;
+    while (!stopping_) {
+        PGconn* conn = PQconnectdb(connectionString_.c_str());
+        if (PQstatus(conn) != CONNECTION_OK) {
+            LOG_ERROR << "Invalidation listener failed to connect: " << PQerrorMessage(conn);
+            PQfinish(conn);
+            waitForStop(reconnectDelay_);
+            continue;
+        }
+
+        PGresult* result = PQexec(conn, ("LISTEN " + channel_).c_str());
+        bool listening = PQresultStatus(result) == PGRES_COMMAND_OK;
+        PQclear(result);
+        if (!listening) {
+            LOG_ERROR << "Invalidation listener failed to LISTEN: " << PQerrorMessage(conn);
+            PQfinish(conn);
+            waitForStop(reconnectDelay_);
+            continue;
+        }
+
+        connected_ = true;
+        connects_.fetch_add(1, std::memory_order_relaxed);
+        if (everConnected) {
+            LOG_INFO << "Invalidation listener reconnected, flushing local caches";
+        }
+        everConnected = true;
+        // Уведомления, пришедшие без соединения (или до первого), не получены
+        flushAll();
+
+        int socket = PQsocket(conn);
+        auto lastActivity = std::chrono::steady_clock::now();
+        while (!stopping_) {
+            pollfd descriptor{socket, POLLIN, 0};
+            int ready = poll(&descriptor, 1, 500);
+            if (ready < 0 && errno != EINTR) {
+                break;
+            }
+
+            if (ready > 0) {
+                if (!PQconsumeInput(conn)) {
+                    LOG_ERROR << "Invalidation listener lost connection: " << PQerrorMessage(conn);
+                    break;
+                }
+                lastActivity = std::chrono::steady_clock::now();
+            } else if (std::chrono::steady_clock::now() - lastActivity >= keepalive_) {
+                // Тишина на сокете не отличается от оборванного соединения - проверяем запросом
+                PGresult* ping = PQexec(conn, "SELECT 1");
+                bool alive = PQresultStatus(ping) == PGRES_TUPLES_OK;
+                PQclear(ping);
+                if (!alive) {
+                    LOG_ERROR << "Invalidation listener keepalive failed: " << PQerrorMessage(conn);
+                    break;
+                }
+                lastActivity = std::chrono::steady_clock::now();
+            }
+
+            while (PGnotify* notify = PQnotifies(conn)) {
+                dispatch(notify->extra);
+                PQfreemem(notify);
+            }
+        }
+
+        connected_ = false;
+        PQfinish(conn);
+        if (!stopping_) {
+            waitForStop(reconnectDelay_);
+        }
+    }
+}
+
+void InvalidationBus::dispatch(const std::string& payload) {
+    received_.fetch_add(1, std::memory_order_relaxed);
+
+    // узел|время|вид|ключ; ключ - остаток строки
+    auto first = payload.find('|');
+    auto second = first == std::string::npos ? first : payload.find('|', first + 1);
+    auto third = second == std::string::npos ? second : payload.find('|', second + 1);
+    if (third == std::string::npos) {
+        malformed_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::string node = payload.substr(0, first);
+    std::string kind = payload.substr(second + 1, third - second - 1);
+    std::string key = payload.substr(third + 1);
+
+    int64_t sentAt = 0;
+    try {
+        sentAt = std::stoll(payload.substr(first + 1, second - first - 1));
+    } catch (const std::exception&) {
+        malformed_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (sentAt > 0) {
+        double lagMs = std::max<int64_t>(0, nowMicros() - sentAt) / 1000.0;
+        std::lock_guard<std::mutex> lock(lagMutex_);
+        recordLag(node == nodeId_ ? selfLag_ : remoteLag_, lagMs);
+    }
+
+    // Свой кеш отправитель уже сбросил
+    if (node == nodeId_) {
+        return;
+    }
+
+    // Ручной сброс всего: NOTIFY <channel>, 'manual|0|*|'
+    if (kind == "*") {
+        flushAll();
+        return;
+    }
+
+    auto it = subscribers_.find(kind);
+    if (it == subscribers_.end()) {
+        return;
+    }
+    it->second.onKey(key);
+    applied_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InvalidationBus::flushAll() {
+    for (auto& [kind, subscriber] : subscribers_) {
+        if (subscriber.onFlush) {
+            subscriber.onFlush();
+        }
+    }
+    fullFlushes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void InvalidationBus::recordLag(Lag& lag, double ms) {
+    ++lag.count;
+    lag.sumMs += ms;
+    lag.maxMs = std::max(lag.maxMs, ms);
+    lag.lastMs = ms;
+    size_t bucket = ms < 1 ? 0 : ms < 10 ? 1 : ms < 100 ? 2 : ms < 1000 ? 3 : 4;
+    ++lag.buckets[bucket];
+}
+
+Json::Value InvalidationBus::lagJson(const Lag& lag) {
+    static const char* const kBuckets[] = {"lt_1ms", "lt_10ms", "lt_100ms", "lt_1s", "ge_1s"};
+    Json::Value json;
+    json["count"] = static_cast<Json::UInt64>(lag.count);
+    json["avg_ms"] = lag.count ? lag.sumMs / lag.count : 0.0;
+    json["max_ms"] = lag.maxMs;
+    json["last_ms"] = lag.lastMs;
+    for (size_t i = 0; i < lag.buckets.size(); ++i) {
+        json["buckets"][kBuckets[i]] = static_cast<Json::UInt64>(lag.buckets[i]);
+    }
+    return json;
+}
+
+Json::Value InvalidationBus::stats() const {
+    Json::Value json;
+    json["enabled"] = enabled_;
+    json["node_id"] = nodeId_;
+    json["channel"] = channel_;
+    json["connected"] = connected_.load();
+    json["connects"] = static_cast<Json::UInt64>(connects_.load());
+    json["full_flushes"] = static_cast<Json::UInt64>(fullFlushes_.load());
+    json["published"] = static_cast<Json::UInt64>(published_.load());
+    json["send_errors"] = static_cast<Json::UInt64>(sendErrors_.load());
+    json["received"] = static_cast<Json::UInt64>(received_.load());
+    json["applied"] = static_cast<Json::UInt64>(applied_.load());
+    json["malformed"] = static_cast<Json::UInt64>(malformed_.load());
+    std::lock_guard<std::mutex> lock(lagMutex_);
+    json["lag_self"] = lagJson(selfLag_);
+    json["lag_remote"] = lagJson(remoteLag_);
+    return json;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Сброс кешей в памяти на всех экземплярах сервера.
+// Запись, после которой кеш устарел, сбрасывает ключ у себя и публикует его:
+// публикации копятся в пределах одного прохода цикла событий и уходят одним
+// pg_notify по каналу custom_config.invalidation.channel. Каждый экземпляр
+// держит отдельное соединение libpq с LISTEN в своём потоке и сбрасывает
+// пришедшие ключи у подписчиков. Пока соединения нет, уведомления теряются,
+// поэтому после каждого (пере)подключения кеши сбрасываются целиком.
+// Задержка доставки считается по метке времени отправителя: отдельно для
+// своих уведомлений (те же часы) и для чужих (включает расхождение часов).
+class InvalidationBus {
+public:
+    static InvalidationBus& instance() {
+        static InvalidationBus instance;
+        return instance;
+    }
+
+    // Обработчики вызываются в потоке слушателя и должны быть потокобезопасны
+    using KeyHandler = std::function<void(const std::string& key)>;
+    using FlushHandler = std::function<void()>;
+
+    // Регистрация вида ключей ("profile", "feed"); вызывается из start() кешей до start() шины
+    void subscribe(const std::string& kind, KeyHandler onKey, FlushHandler onFlush);
+
+    // Поток слушателя (вызывается из main до app().run(), после start() кешей)
+    void start();
+    void shutdown();
+
+    // Сообщить остальным экземплярам, что ключ устарел. Свой кеш вызывающий сбрасывает сам
+    void publish(const std::string& kind, const std::string& key);
+
+    // Счётчики и задержки доставки с момента запуска
+    Json::Value stats() const;
+
+private:
+    InvalidationBus();
+
+    struct Subscriber {
+        KeyHandler onKey;
+        FlushHandler onFlush;
+    };
+
+    struct Lag {
+        uint64_t count = 0;
+        double sumMs = 0;
+        double maxMs = 0;
+        double lastMs = 0;
+        std::array<uint64_t, 5> buckets{};  // <1, <10, <100, <1000, >=1000 мс
+    };
+
+    void listen();  // поток listener_
+    void dispatch(const std::string& payload);
+    void flushAll();
+    void sendPending();
+    void recordLag(Lag& lag, double ms);
+    bool waitForStop(std::chrono::milliseconds delay);
+
+    static Json::Value lagJson(const Lag& lag);
+
+    std::unordered_map<std::string, Subscriber> subscribers_;
+    std::string nodeId_;
+
+    bool enabled_ = false;
+    std::string channel_ = "cache_invalidation";
+    std::string connectionString_;
+    std::chrono::milliseconds reconnectDelay_{1000};
+    std::chrono::seconds keepalive_{30};
+
+    std::thread listener_;
+    std::atomic<bool> stopping_{false};
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+
+    std::mutex pendingMutex_;
+    std::vector<std::string> pending_;  // kind|key
+
+    std::atomic<bool> connected_{false};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> sendErrors_{0};
+    std::atomic<uint64_t> received_{0};
+    std::atomic<uint64_t> applied_{0};
+    std::atomic<uint64_t> malformed_{0};
+    std::atomic<uint64_t> connects_{0};
+    std::atomic<uint64_t> fullFlushes_{0};
+
+    mutable std::mutex lagMutex_;
+    Lag selfLag_;
+    Lag remoteLag_;
+};
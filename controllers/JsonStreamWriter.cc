@@ -0,0 +1,479 @@
+#include "JsonStreamWriter.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+// Дописывает строку с экранированием JSON, безопасные участки копируются целиком
+void appendEscaped(std::string& out, std::string_view value) {
+    static const char kHex[] = "0123456789abcdef";
+
+    size_t start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        auto c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        out.append(value.data() + start, i - start);
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+            out += "\\u00";
+            out += kHex[c >> 4];
+            out += kHex[c & 0x0F];
+        }
+        start = i + 1;
+    }
+    out.append(value.data() + start, value.size() - start);
+}
+
+std::string_view fieldText(const Field& field) {
+    return std::string_view(field.c_str(), field.length());
+}
+
+// NUMERIC из PostgreSQL может быть NaN/Infinity, это не число JSON
+bool isJsonNumber(std::string_view text) {
+    if (text.empty()) {
+        return false;
+    }
+    size_t pos = (text[0] == '-') ? 1 : 0;
+    return pos < text.size() && text[pos] >= '0' && text[pos] <= '9';
+}
+
+bool parseDigits(std::string_view text, size_t pos, size_t count, int& value) {
+    if (pos + count > text.size()) {
+        return false;
+    }
+    value = 0;
+    for (size_t i = pos; i < pos + count; ++i) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// Дни от 1970-01-01 и обратно (пролептический григорианский календарь)
+int64_t daysFromCivil(int64_t year, int month, int day) {
+    year -= month <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+void civilFromDays(int64_t days, int64_t& year, int& month, int& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t mp = (5 * dayOfYear + 2) / 153;
+    day = static_cast<int>(dayOfYear - (153 * mp + 2) / 5 + 1);
+    month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    year = yearOfEra + era * 400 + (month <= 2);
+}
+
+// Смещение местного времени сервера от UTC в секундах для момента utcSeconds.
+// Смещение меняется не чаще раза в час, поэтому localtime_r вызывается
+// только при переходе к другому часу
+long localOffsetAt(int64_t utcSeconds) {
+    thread_local int64_t cachedHour = INT64_MIN;
+    thread_local long cachedOffset = 0;
+    int64_t hour = utcSeconds >= 0 ? utcSeconds / 3600 : (utcSeconds - 3599) / 3600;
+    if (hour != cachedHour) {
+        time_t moment = static_cast<time_t>(hour * 3600);
+        struct tm local {};
+        localtime_r(&moment, &local);
+        cachedOffset = local.tm_gmtoff;
+        cachedHour = hour;
+    }
+    return cachedOffset;
+}
+
+} // namespace
+
+JsonKey::JsonKey(std::string_view name)
+    : name_(name) {
+    encoded_.reserve(name.size() + 3);
+    encoded_ += '"';
+    appendEscaped(encoded_, name);
+    encoded_ += "\":";
+}
+
+JsonStreamWriter::JsonStreamWriter(size_t reserveBytes) {
+    buffer_.reserve(reserveBytes);
+}
+
+void JsonStreamWriter::separator() {
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (!first_.empty()) {
+        if (first_.back()) {
+            first_.back() = false;
+        } else {
+            buffer_ += ',';
+        }
+    }
+}
+
+void JsonStreamWriter::beginObject() {
+    separator();
+    buffer_ += '{';
+    first_.push_back(true);
+}
+
+void JsonStreamWriter::endObject() {
+    buffer_ += '}';
+    first_.pop_back();
+}
+
+void JsonStreamWriter::beginArray() {
+    separator();
+    buffer_ += '[';
+    first_.push_back(true);
+}
+
+void JsonStreamWriter::endArray() {
+    buffer_ += ']';
+    first_.pop_back();
+}
+
+void JsonStreamWriter::key(const JsonKey& key) {
+    separator();
+    buffer_ += key.encoded();
+    afterKey_ = true;
+}
+
+void JsonStreamWriter::key(std::string_view name) {
+    separator();
+    buffer_ += '"';
+    appendEscaped(buffer_, name);
+    buffer_ += "\":";
+    afterKey_ = true;
+}
+
+void JsonStreamWriter::stringValue(std::string_view value) {
+    separator();
+    buffer_ += '"';
+    appendEscaped(buffer_, value);
+    buffer_ += '"';
+}
+
+void JsonStreamWriter::intValue(int64_t value) {
+    separator();
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer_.append(digits, result.ptr - digits);
+}
+
+void JsonStreamWriter::boolValue(bool value) {
+    separator();
+    buffer_ += value ? "true" : "false";
+}
+
+void JsonStreamWriter::nullValue() {
+    separator();
+    buffer_ += "null";
+}
+
+void JsonStreamWriter::rawValue(std::string_view json) {
+    separator();
+    buffer_.append(json.data(), json.size());
+}
+
+void JsonStreamWriter::timestampValue(std::string_view dbText) {
+    // PostgreSQL: "2024-05-01 10:11:12.5+03", toDbStringLocal: "2024-05-01 10:11:12.500000".
+    // Смещение сессии БД переводится в местное время сервера; если пояса совпадают
+    // (обычный случай), суффикс просто отбрасывается
+    constexpr size_t kSecondsEnd = 19;
+    int year = 0, month = 0, day = 0, hours = 0, minutes = 0, seconds = 0;
+    bool parsed = dbText.size() >= kSecondsEnd && dbText[4] == '-' && dbText[7] == '-' && dbText[10] == ' ' &&
+                  dbText[13] == ':' && dbText[16] == ':' && parseDigits(dbText, 0, 4, year) &&
+                  parseDigits(dbText, 5, 2, month) && parseDigits(dbText, 8, 2, day) &&
+                  parseDigits(dbText, 11, 2, hours) && parseDigits(dbText, 14, 2, minutes) &&
+                  parseDigits(dbText, 17, 2, seconds);
+    if (!parsed) {
+        // infinity, годы до н.э. и прочее - как есть
+        stringValue(dbText);
+        return;
+    }
+
+    size_t fractionEnd = kSecondsEnd;
+    if (fractionEnd < dbText.size() && dbText[fractionEnd] == '.') {
+        ++fractionEnd;
+        while (fractionEnd < dbText.size() && dbText[fractionEnd] >= '0' && dbText[fractionEnd] <= '9') {
+            ++fractionEnd;
+        }
+    }
+    std::string_view fraction = dbText.substr(kSecondsEnd, fractionEnd - kSecondsEnd);
+
+    // Смещение: +HH, +HH:MM или +HH:MM:SS
+    std::string_view zone = dbText.substr(fractionEnd);
+    bool converted = false;
+    int64_t localSeconds = 0;
+    if (zone.size() >= 3 && (zone[0] == '+' || zone[0] == '-')) {
+        int zoneHours = 0, zoneMinutes = 0, zoneSeconds = 0;
+        bool zoneParsed = parseDigits(zone, 1, 2, zoneHours) &&
+                          (zone.size() == 3 || (zone[3] == ':' && parseDigits(zone, 4, 2, zoneMinutes) &&
+                                                (zone.size() == 6 || (zone[6] == ':' && zone.size() == 9 &&
+                                                                      parseDigits(zone, 7, 2, zoneSeconds)))));
+        if (zoneParsed) {
+            long zoneOffset = (zoneHours * 3600L + zoneMinutes * 60L + zoneSeconds) * (zone[0] == '-' ? -1 : 1);
+            int64_t utcSeconds = daysFromCivil(year, month, day) * 86400 + hours * 3600 + minutes * 60 + seconds -
+                                 zoneOffset;
+            long localOffset = localOffsetAt(utcSeconds);
+            if (localOffset != zoneOffset) {
+                localSeconds = utcSeconds + localOffset;
+                converted = true;
+            }
+        }
+    }
+
+    separator();
+    buffer_ += '"';
+    if (converted) {
+        int64_t days = localSeconds >= 0 ? localSeconds / 86400 : (localSeconds - 86399) / 86400;
+        int64_t secondsOfDay = localSeconds - days * 86400;
+        int64_t localYear = 0;
+        int localMonth = 0, localDay = 0;
+        civilFromDays(days, localYear, localMonth, localDay);
+        char text[32];
+        int length = std::snprintf(text, sizeof(text), "%04lld-%02d-%02d %02d:%02d:%02d",
+                                   static_cast<long long>(localYear), localMonth, localDay,
+                                   static_cast<int>(secondsOfDay / 3600), static_cast<int>(secondsOfDay / 60 % 60),
+                                   static_cast<int>(secondsOfDay % 60));
+        buffer_.append(text, static_cast<size_t>(length));
+    } else {
+        buffer_.append(dbText.data(), kSecondsEnd);
+    }
+    buffer_.append(fraction.data(), fraction.size());
+    if (!fraction.empty()) {
+        // Дробная часть всегда из шести цифр, как в trantor::Date
+        size_t digits = fraction.size() - 1;
+        if (digits < 6) {
+            buffer_.append(6 - digits, '0');
+        }
+    }
+    buffer_ += '"';
+}
+
+void JsonStreamWriter::jsonValue(const Json::Value& value) {
+    switch (value.type()) {
+    case Json::nullValue:
+        nullValue();
+        break;
+    case Json::intValue:
+        intValue(value.asInt64());
+        break;
+    case Json::uintValue:
+        rawValue(std::to_string(value.asUInt64()));
+        break;
+    case Json::realValue:
+        rawValue(Json::valueToString(value.asDouble()));
+        break;
+    case Json::stringValue: {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        value.getString(&begin, &end);
+        stringValue(std::string_view(begin, end - begin));
+        break;
+    }
+    case Json::booleanValue:
+        boolValue(value.asBool());
+        break;
+    case Json::arrayValue:
+        beginArray();
+        for (const auto& item : value) {
+            jsonValue(item);
+        }
+        endArray();
+        break;
+    case Json::objectValue:
+        beginObject();
+        for (auto it = value.begin(); it != value.end(); ++it) {
+            key(it.name());
+            jsonValue(*it);
+        }
+        endObject();
+        break;
+    }
+}
+
+HttpResponsePtr JsonStreamWriter::toResponse(HttpStatusCode code) {
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setStatusCode(code);
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    resp->setBody(std::move(buffer_));
+    return resp;
+}
+
+JsonRowLayout::JsonRowLayout(std::vector<JsonColumn> columns)
+    : columns_(std::move(columns)) {}
+
+JsonRowLayout::Binding JsonRowLayout::bind(const Result& result) const {
+    Binding binding(columns_.size(), -1);
+    auto count = result.columns();
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        for (decltype(count) c = 0; c < count; ++c) {
+            if (columns_[i].column == result.columnName(c)) {
+                binding[i] = static_cast<long>(c);
+                break;
+            }
+        }
+    }
+    return binding;
+}
+
+size_t JsonRowLayout::estimateSize(const Result& result, const Binding& binding) const {
+    // Вычисляемые поля (URL вариантов и т.п.) оцениваем грубо
+    constexpr size_t kCustomFieldBytes = 192;
+    constexpr size_t kFieldOverhead = 8;  // кавычки, запятая, запас на экранирование
+
+    size_t keysSize = 2;
+    for (const auto& column : columns_) {
+        keysSize += column.key.encoded().size() + kFieldOverhead;
+        if (column.kind == JsonColumnKind::Custom) {
+            keysSize += kCustomFieldBytes;
+        }
+    }
+
+    size_t total = keysSize * result.size();
+    for (const auto& row : result) {
+        for (long index : binding) {
+            if (index >= 0) {
+                total += row[static_cast<size_t>(index)].length();
+            }
+        }
+    }
+    return total + total / 16;
+}
+
+void JsonRowLayout::writeField(JsonStreamWriter& writer, const JsonColumn& column, const Field& field) {
+    if (column.kind == JsonColumnKind::Custom) {
+        column.custom(writer, field);
+        return;
+    }
+    if (field.isNull()) {
+        writeMissing(writer, column);
+        return;
+    }
+
+    auto text = fieldText(field);
+    switch (column.kind) {
+    case JsonColumnKind::String:
+    case JsonColumnKind::DecimalString:
+        writer.stringValue(text);
+        break;
+    case JsonColumnKind::NullableString:
+        if (text.empty()) {
+            writer.nullValue();
+        } else {
+            writer.stringValue(text);
+        }
+        break;
+    case JsonColumnKind::Integer:
+        // Текстовое представление целых PostgreSQL уже валидный JSON
+        writer.rawValue(text);
+        break;
+    case JsonColumnKind::Boolean:
+        writer.boolValue(!text.empty() && text[0] == 't');
+        break;
+    case JsonColumnKind::DecimalNumber:
+        if (isJsonNumber(text)) {
+            writer.rawValue(text);
+        } else {
+            writer.nullValue();
+        }
+        break;
+    case JsonColumnKind::Timestamp:
+        writer.timestampValue(text);
+        break;
+    case JsonColumnKind::JsonArray:
+        if (text.empty()) {
+            writer.rawValue("[]");
+        } else {
+            writer.rawValue(text);
+        }
+        break;
+    case JsonColumnKind::Custom:
+        break;
+    }
+}
+
+void JsonRowLayout::writeMissing(JsonStreamWriter& writer, const JsonColumn& column) {
+    switch (column.kind) {
+    case JsonColumnKind::String:
+    case JsonColumnKind::DecimalString:
+        writer.stringValue("");
+        break;
+    case JsonColumnKind::Integer:
+    case JsonColumnKind::DecimalNumber:
+        writer.rawValue("0");
+        break;
+    case JsonColumnKind::Boolean:
+        writer.boolValue(false);
+        break;
+    case JsonColumnKind::JsonArray:
+        writer.rawValue("[]");
+        break;
+    case JsonColumnKind::NullableString:
+    case JsonColumnKind::Timestamp:
+    case JsonColumnKind::Custom:
+        writer.nullValue();
+        break;
+    }
+}
+
+void JsonRowLayout::writeFields(JsonStreamWriter& writer, const Row& row, const Binding& binding) const {
+    for (size_t i = 0; i < columns_.size(); ++i) {
+        writer.key(columns_[i].key);
+        if (binding[i] < 0) {
+            writeMissing(writer, columns_[i]);
+        } else {
+            writeField(writer, columns_[i], row[static_cast<size_t>(binding[i])]);
+        }
+    }
+}
+
+void JsonRowLayout::writeObject(JsonStreamWriter& writer, const Row& row, const Binding& binding) const {
+    writer.beginObject();
+    writeFields(writer, row, binding);
+    writer.endObject();
+}
+
+void JsonRowLayout::writeArray(JsonStreamWriter& writer, const Result& result, const Binding& binding) const {
+    writer.beginArray();
+    for (const auto& row : result) {
+        writeObject(writer, row, binding);
+    }
+    writer.endArray();
+}
+
+JsonRowLayout JsonRowLayout::project(const std::vector<std::string>& keys) const {
+    std::vector<JsonColumn> selected;
+    selected.reserve(keys.size());
+    for (const auto& column : columns_) {
+        if (std::find(keys.begin(), keys.end(), column.key.name()) != keys.end()) {
+            selected.push_back(column);
+        }
+    }
+    return JsonRowLayout(std::move(selected));
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <drogon/HttpResponse.h>
+#include <drogon/orm/Result.h>
+#include <drogon/orm/Row.h>
+#include <drogon/orm/Field.h>
+#include <json/json.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Ключ JSON, экранированный один раз при создании: "name":
+class JsonKey {
+public:
+    explicit JsonKey(std::string_view name);
+
+    const std::string& name() const { return name_; }
+    const std::string& encoded() const { return encoded_; }
+
+private:
+    std::string name_;
+    std::string encoded_;
+};
+
+// Потоковая запись JSON в один строковый буфер без промежуточного Json::Value.
+// Запятые и вложенность отслеживаются сами, вызывающий код пишет только
+// ключи и значения в нужном порядке.
+class JsonStreamWriter {
+public:
+    explicit JsonStreamWriter(size_t reserveBytes = 256);
+
+    void reserve(size_t bytes) { buffer_.reserve(bytes); }
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    void key(const JsonKey& key);
+    void key(std::string_view name);
+
+    void stringValue(std::string_view value);
+    void intValue(int64_t value);
+    void boolValue(bool value);
+    void nullValue();
+    // Уже готовый JSON: JSONB из БД, числа в текстовом виде
+    void rawValue(std::string_view json);
+    // Метка времени из БД в формате toDbStringLocal (местное время сервера, без пояса);
+    // смещение сессии БД переводится в местное время
+    void timestampValue(std::string_view dbText);
+    // Для редких вычисляемых полей, которые и так собраны в Json::Value
+    void jsonValue(const Json::Value& value);
+
+    const std::string& buffer() const { return buffer_; }
+    std::string release() { return std::move(buffer_); }
+
+    // Ответ application/json, тело забирается из буфера без копирования
+    drogon::HttpResponsePtr toResponse(drogon::HttpStatusCode code = drogon::k200OK);
+
+private:
+    void separator();
+
+    std::string buffer_;
+    std::vector<bool> first_;  // на каждый открытый контейнер: элементов ещё не было
+    bool afterKey_ = false;
+};
+
+// Как значение колонки попадает в JSON
+enum class JsonColumnKind {
+    String,          // NULL -> ""
+    NullableString,  // NULL и "" -> null
+    Integer,         // NULL -> 0
+    Boolean,         // NULL -> false
+    DecimalString,   // NUMERIC строкой, NULL -> ""
+    DecimalNumber,   // NUMERIC числом, NULL -> 0
+    Timestamp,       // NULL -> null
+    JsonArray,       // JSONB как есть, NULL -> []
+    Custom           // значение пишет переданная функция
+};
+
+using JsonFieldWriter = void (*)(JsonStreamWriter& writer, const drogon::orm::Field& field);
+
+struct JsonColumn {
+    JsonColumn(std::string_view name, JsonColumnKind kind)
+        : key(name), column(name), kind(kind) {}
+
+    // Вычисляемое поле под своим ключом на основе колонки column
+    JsonColumn(std::string_view keyName, std::string_view columnName, JsonFieldWriter writer)
+        : key(keyName), column(columnName), kind(JsonColumnKind::Custom), custom(writer) {}
+
+    JsonKey key;
+    std::string column;
+    JsonColumnKind kind;
+    JsonFieldWriter custom = nullptr;
+};
+
+// Описание объекта JSON для строки результата: какие колонки, под какими
+// ключами и в каком виде. Создаётся один раз (static) на тип ответа.
+class JsonRowLayout {
+public:
+    explicit JsonRowLayout(std::vector<JsonColumn> columns);
+
+    // Номера колонок в конкретном Result; -1 если колонки нет в выборке
+    using Binding = std::vector<long>;
+    Binding bind(const drogon::orm::Result& result) const;
+
+    // Размер JSON всех строк по длинам полей, чтобы выделить буфер один раз
+    size_t estimateSize(const drogon::orm::Result& result, const Binding& binding) const;
+
+    void writeFields(JsonStreamWriter& writer, const drogon::orm::Row& row, const Binding& binding) const;
+    void writeObject(JsonStreamWriter& writer, const drogon::orm::Row& row, const Binding& binding) const;
+    void writeArray(JsonStreamWriter& writer, const drogon::orm::Result& result, const Binding& binding) const;
+
+    // Подмножество полей по ключам ответа, порядок описания сохраняется
+    JsonRowLayout project(const std::vector<std::string>& keys) const;
+
+    const std::vector<JsonColumn>& columns() const { return columns_; }
+
+private:
+    static void writeField(JsonStreamWriter& writer, const JsonColumn& column, const drogon::orm::Field& field);
+    static void writeMissing(JsonStreamWriter& writer, const JsonColumn& column);
+
+    std::vector<JsonColumn> columns_;
+};
@@ -0,0 +1,55 @@
+#include "LibavUtils.h"
+#include <algorithm>
+#include <stdexcept>
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+namespace libav {
+
+std::string encodeFrame(AVFrame* frame, const AVCodec* encoder, int quality) {
+    CodecContextPtr ctx(avcodec_alloc_context3(encoder));
+    if (!ctx) {
+        throw std::runtime_error("Out of memory");
+    }
+
+    ctx->width = frame->width;
+    ctx->height = frame->height;
+    ctx->pix_fmt = static_cast<AVPixelFormat>(frame->format);
+    ctx->time_base = AVRational{1, 25};
+
+    if (encoder->id == AV_CODEC_ID_MJPEG) {
+        // quality 0..100 переводим в qscale 2..31
+        int qscale = std::clamp(31 - quality * 29 / 100, 2, 31);
+        ctx->flags |= AV_CODEC_FLAG_QSCALE;
+        ctx->global_quality = FF_QP2LAMBDA * qscale;
+        ctx->color_range = AVCOL_RANGE_JPEG;
+        frame->quality = ctx->global_quality;
+    } else {
+        av_opt_set_double(ctx->priv_data, "quality", quality, 0);
+    }
+
+    if (avcodec_open2(ctx.get(), encoder, nullptr) < 0) {
+        throw std::runtime_error("Failed to open image encoder");
+    }
+
+    if (avcodec_send_frame(ctx.get(), frame) < 0) {
+        throw std::runtime_error("Failed to encode image");
+    }
+    avcodec_send_frame(ctx.get(), nullptr);
+
+    std::string output;
+    PacketPtr packet(av_packet_alloc());
+    while (avcodec_receive_packet(ctx.get(), packet.get()) == 0) {
+        output.append(reinterpret_cast<const char*>(packet->data), packet->size);
+        av_packet_unref(packet.get());
+    }
+
+    if (output.empty()) {
+        throw std::runtime_error("Encoder produced no data");
+    }
+    return output;
+}
+
+} // namespace libav
@@ -0,0 +1,260 @@
+#include "LogPartitionManager.h"
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+const char* const kPartitionPrefix = "server_logs_p";
+
+// Обслуживание секций выполняет один экземпляр: транзакционная блокировка
+const int64_t kMaintenanceLockKey = 0x6c6f6773;  // "logs"
+
+// Имена секций подставляются в DDL как есть, поэтому трогаем только свои
+bool isManagedName(const std::string& name) {
+    if (name.rfind(kPartitionPrefix, 0) != 0 || name.size() == std::char_traits<char>::length(kPartitionPrefix)) {
+        return false;
+    }
+    return std::all_of(name.begin() + std::char_traits<char>::length(kPartitionPrefix), name.end(),
+                       [](char c) { return c >= '0' && c <= '9'; });
+}
+
+std::string utcBound(const std::string& date) {
+    return date + " 00:00:00+00";
+}
+
+int64_t nowSeconds() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+LogPartitionManager::LogPartitionManager()
+    : queue_(1, "LogPartitionManager") {}
+
+void LogPartitionManager::start() {
+    const auto& config = app().getCustomConfig()["logs"];
+    monthly_ = config.get("partition_by", "day").asString() == "month";
+    premake_ = std::max(1, config.get("premake", monthly_ ? 2 : 7).asInt());
+    retentionDays_ = std::max(1, config.get("retention_days", 90).asInt());
+    detachExpired_ = config.get("retention_action", "drop").asString() == "detach";
+    checkIntervalSeconds_ = std::max(60.0, config.get("check_interval_seconds", 3600).asDouble());
+
+    app().getLoop()->queueInLoop([this]() {
+        queue_.runTaskInQueue([this]() {
+            maintain();
+        });
+    });
+    app().getLoop()->runEvery(checkIntervalSeconds_, [this]() {
+        queue_.runTaskInQueue([this]() {
+            maintain();
+        });
+    });
+}
+
+void LogPartitionManager::maintain() {
+    if (running_.exchange(true)) {
+        return;
+    }
+
+    uint64_t created = 0, expired = 0, errors = 0;
+    bool skipped = false;
+    std::vector<std::string> names;
+    std::vector<std::string> done;  // в журнал только после фиксации
+    try {
+        auto trans = app().getDbClient()->newTransaction();
+
+        // Вся проверка - одна транзакция под блокировкой: экземпляры не выполняют
+        // DDL одновременно, остальные пропускают тик. Ошибка любого шага откатывает
+        // проверку целиком, она повторится через check_interval_seconds
+        auto locked = trans->execSqlSync("SELECT pg_try_advisory_xact_lock($1) AS locked", kMaintenanceLockKey);
+        if (!locked[0]["locked"].as<bool>()) {
+            skipped = true;
+        } else {
+            // DDL над server_logs не должен надолго задерживать вставки журнала
+            trans->execSqlSync("SET LOCAL lock_timeout = '5s'");
+
+            std::unordered_set<std::string> existing;
+            std::vector<std::string> stale;
+            for (const auto& partition : listPartitions(trans)) {
+                existing.insert(partition.name);
+                if (partition.expired) {
+                    stale.push_back(partition.name);
+                }
+            }
+
+            for (const auto& range : wantedRanges(trans)) {
+                if (existing.count(range.name)) {
+                    continue;
+                }
+                createPartition(trans, range);
+                ++created;
+                done.push_back("Created log partition " + range.name);
+            }
+
+            for (const auto& name : stale) {
+                expirePartition(trans, name);
+                ++expired;
+                done.push_back(std::string(detachExpired_ ? "Detached" : "Dropped") + " expired log partition " + name);
+            }
+
+            // Строки без своей секции (например, записанные до первого запуска) стареют там же
+            trans->execSqlSync(
+                "DELETE FROM server_logs_default WHERE created_at < NOW() - $1::integer * INTERVAL '1 day'",
+                retentionDays_);
+
+            for (const auto& partition : listPartitions(trans)) {
+                names.push_back(partition.name);
+            }
+
+            auto committed = std::make_shared<std::promise<bool>>();
+            auto committedFuture = committed->get_future();
+            trans->setCommitCallback([committed](bool ok) {
+                committed->set_value(ok);
+            });
+            trans.reset();
+            if (!committedFuture.get()) {
+                throw std::runtime_error("transaction was not committed");
+            }
+        }
+    } catch (const DrogonDbException& e) {
+        ++errors;
+        LOG_ERROR << "Log partition maintenance failed: " << e.base().what();
+    } catch (const std::exception& e) {
+        ++errors;
+        LOG_ERROR << "Log partition maintenance failed: " << e.what();
+    }
+
+    if (errors > 0) {
+        // Транзакция откатилась: ничего из сделанного не осталось
+        created = expired = 0;
+        names.clear();
+    } else {
+        for (const auto& message : done) {
+            LOG_INFO << message;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        if (!names.empty()) {
+            partitions_ = std::move(names);
+        }
+        lastCheckAt_ = nowSeconds();
+        created_ += created;
+        expired_ += expired;
+        errors_ += errors;
+        skipped_ += skipped ? 1 : 0;
+    }
+    running_ = false;
+}
+
+// Границы считает БД: календарь и длина месяцев - её забота
+std::vector<LogPartitionManager::Range> LogPartitionManager::wantedRanges(const TransactionPtr& trans) {
+    auto result = trans->execSqlSync(
+        "SELECT to_char(s, $1) AS suffix, "
+        "to_char(s, 'YYYY-MM-DD') AS lower_bound, "
+        "to_char(s + $2::interval, 'YYYY-MM-DD') AS upper_bound "
+        "FROM generate_series(date_trunc($3, NOW() AT TIME ZONE 'UTC'), "
+        "date_trunc($3, NOW() AT TIME ZONE 'UTC') + $4::integer * $2::interval, "
+        "$2::interval) s",
+        std::string(monthly_ ? "YYYYMM" : "YYYYMMDD"),
+        std::string(monthly_ ? "1 month" : "1 day"),
+        std::string(monthly_ ? "month" : "day"),
+        premake_);
+
+    std::vector<Range> ranges;
+    ranges.reserve(result.size());
+    for (const auto& row : result) {
+        ranges.push_back(Range{kPartitionPrefix + row["suffix"].as<std::string>(),
+                               row["lower_bound"].as<std::string>(),
+                               row["upper_bound"].as<std::string>()});
+    }
+    return ranges;
+}
+
+// Верхняя граница берётся из описания секции; у секции по умолчанию её нет
+std::vector<LogPartitionManager::Partition> LogPartitionManager::listPartitions(const TransactionPtr& trans) {
+    auto result = trans->execSqlSync(
+        R"(SELECT p.relname,
+                  COALESCE(p.upper_bound <= NOW() - $1::integer * INTERVAL '1 day', false) AS expired
+           FROM (
+               SELECT c.relname,
+                      (regexp_match(pg_get_expr(c.relpartbound, c.oid), 'TO \(''([^'']+)''\)'))[1]::timestamptz
+                          AS upper_bound
+               FROM pg_inherits i
+               JOIN pg_class c ON c.oid = i.inhrelid
+               WHERE i.inhparent = 'server_logs'::regclass
+           ) p
+           ORDER BY p.relname)",
+        retentionDays_);
+
+    std::vector<Partition> partitions;
+    partitions.reserve(result.size());
+    for (const auto& row : result) {
+        auto name = row["relname"].as<std::string>();
+        bool expired = row["expired"].as<bool>() && isManagedName(name);
+        partitions.push_back(Partition{std::move(name), expired});
+    }
+    return partitions;
+}
+
+void LogPartitionManager::createPartition(const TransactionPtr& trans, const Range& range) {
+    std::string bounds = "FOR VALUES FROM ('" + utcBound(range.from) + "') TO ('" + utcBound(range.to) + "')";
+
+    auto pending = trans->execSqlSync(
+        "SELECT EXISTS (SELECT 1 FROM server_logs_default "
+        "WHERE created_at >= $1::timestamptz AND created_at < $2::timestamptz) AS pending",
+        utcBound(range.from), utcBound(range.to));
+    if (!pending[0]["pending"].as<bool>()) {
+        trans->execSqlSync("CREATE TABLE IF NOT EXISTS " + range.name + " PARTITION OF server_logs " + bounds);
+        return;
+    }
+
+    // В секции по умолчанию уже есть строки этого периода: PARTITION OF не пройдёт
+    // проверку, поэтому секция создаётся отдельно, строки переносятся и она
+    // присоединяется. Вставки в секцию по умолчанию ждут конца транзакции проверки
+    trans->execSqlSync("LOCK TABLE server_logs_default IN EXCLUSIVE MODE");
+    trans->execSqlSync("CREATE TABLE " + range.name +
+                       " (LIKE server_logs INCLUDING DEFAULTS INCLUDING CONSTRAINTS)");
+    auto moved = trans->execSqlSync(
+        "WITH moved AS (DELETE FROM server_logs_default "
+        "WHERE created_at >= $1::timestamptz AND created_at < $2::timestamptz RETURNING *) "
+        "INSERT INTO " + range.name + " SELECT * FROM moved",
+        utcBound(range.from), utcBound(range.to));
+    trans->execSqlSync("ALTER TABLE server_logs ATTACH PARTITION " + range.name + " " + bounds);
+    LOG_INFO << "Moved " << moved.affectedRows() << " rows from server_logs_default to " << range.name;
+}
+
+void LogPartitionManager::expirePartition(const TransactionPtr& trans, const std::string& name) {
+    if (detachExpired_) {
+        // Отцепленная таблица остаётся для архивации и больше не видна в server_logs
+        trans->execSqlSync("ALTER TABLE server_logs DETACH PARTITION " + name);
+    } else {
+        trans->execSqlSync("DROP TABLE " + name);
+    }
+}
+
+Json::Value LogPartitionManager::stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    Json::Value json;
+    json["partition_by"] = monthly_ ? "month" : "day";
+    json["retention_days"] = retentionDays_;
+    json["retention_action"] = detachExpired_ ? "detach" : "drop";
+    json["last_check_at"] = static_cast<Json::Int64>(lastCheckAt_);
+    json["created"] = static_cast<Json::UInt64>(created_);
+    json["expired"] = static_cast<Json::UInt64>(expired_);
+    json["errors"] = static_cast<Json::UInt64>(errors_);
+    json["skipped"] = static_cast<Json::UInt64>(skipped_);
+    json["partitions"] = Json::arrayValue;
+    for (const auto& name : partitions_) {
+        json["partitions"].append(name);
+    }
+    return json;
+}
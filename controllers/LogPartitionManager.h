@@ -0,0 +1,71 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Секции server_logs по времени.
+// Раз в check_interval_seconds в своём потоке создаёт секции на premake вперёд
+// (server_logs_pYYYYMMDD по дням или server_logs_pYYYYMM по месяцам, границы в UTC)
+// и отцепляет или удаляет секции, целиком вышедшие за retention_days. Удаление
+// секции - мгновенный DROP вместо DELETE по всей таблице. Строки, попавшие в
+// секцию по умолчанию раньше, чем создана их секция, переносятся в неё
+// одной транзакцией. Проверка целиком - одна транзакция под
+// pg_try_advisory_xact_lock: при нескольких экземплярах DDL выполняет один.
+class LogPartitionManager {
+public:
+    static LogPartitionManager& instance() {
+        static LogPartitionManager instance;
+        return instance;
+    }
+
+    // Первая проверка и таймер по custom_config.logs (вызывается из main до app().run())
+    void start();
+
+    // Текущие секции и итоги последней проверки
+    Json::Value stats() const;
+
+private:
+    LogPartitionManager();
+
+    struct Range {
+        std::string name;
+        std::string from;  // 'YYYY-MM-DD', включительно
+        std::string to;    // 'YYYY-MM-DD', не включительно
+    };
+
+    struct Partition {
+        std::string name;
+        bool expired = false;  // верхняя граница старше retention_days
+    };
+
+    using TransactionPtr = std::shared_ptr<drogon::orm::Transaction>;
+
+    // Всё ниже выполняется в потоке queue_, в одной транзакции проверки
+    void maintain();
+    std::vector<Range> wantedRanges(const TransactionPtr& trans);
+    std::vector<Partition> listPartitions(const TransactionPtr& trans);
+    void createPartition(const TransactionPtr& trans, const Range& range);
+    void expirePartition(const TransactionPtr& trans, const std::string& name);
+
+    trantor::ConcurrentTaskQueue queue_;
+    std::atomic<bool> running_{false};
+
+    mutable std::mutex statsMutex_;
+    std::vector<std::string> partitions_;
+    int64_t lastCheckAt_ = 0;
+    uint64_t created_ = 0;
+    uint64_t expired_ = 0;
+    uint64_t errors_ = 0;
+    uint64_t skipped_ = 0;  // проверку выполнял другой экземпляр
+
+    bool monthly_ = false;
+    int premake_ = 7;
+    int retentionDays_ = 90;
+    bool detachExpired_ = false;
+    double checkIntervalSeconds_ = 3600.0;
+};
@@ -0,0 +1,103 @@
+#include "MediaController.h"
+#include "ImageService.h"
+#include "VideoPreviewService.h"
+#include <drogon/HttpResponse.h>
+#include <algorithm>
+#include <cctype>
+
+using namespace drogon;
+using namespace std;
+
+bool MediaController::isValidFileName(const string& fileName) {
+    if (fileName.empty() || fileName.size() > 128) {
+        return false;
+    }
+
+    // Только имена вида <тип>_<хеш>_<вариант>.<расширение>, без выхода из каталога
+    bool charsOk = all_of(fileName.begin(), fileName.end(), [](unsigned char c) {
+        return isalnum(c) || c == '_' || c == '.';
+    });
+    if (!charsOk || fileName.find("..") != string::npos) {
+        return false;
+    }
+
+    auto dot = fileName.rfind('.');
+    if (dot == string::npos) {
+        return false;
+    }
+    string extension = fileName.substr(dot + 1);
+    return extension == "webp" || extension == "jpg";
+}
+
+void MediaController::getImage(const HttpRequestPtr& req,
+                               function<void(const HttpResponsePtr&)>&& callback,
+                               const string& fileName) {
+    if (!isValidFileName(fileName)) {
+        auto resp = HttpResponse::newNotFoundResponse();
+        callback(resp);
+        return;
+    }
+
+    auto resp = HttpResponse::newFileResponse(ImageService::variantsDirectory() + "/" + fileName);
+    if (resp->statusCode() == k200OK) {
+        // Содержимое по этому URL никогда не меняется
+        resp->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+    }
+    callback(resp);
+}
+
+bool MediaController::isSafeSegment(const string& segment) {
+    if (segment.empty() || segment.size() > 128 || segment.find("..") != string::npos) {
+        return false;
+    }
+    return all_of(segment.begin(), segment.end(), [](unsigned char c) {
+        return isalnum(c) || c == '_' || c == '-' || c == '.';
+    });
+}
+
+void MediaController::sendPreviewFile(const string& path,
+                                      const string& fileName,
+                                      function<void(const HttpResponsePtr&)>&& callback) {
+    auto resp = HttpResponse::newFileResponse(path);
+    if (resp->statusCode() == k200OK) {
+        if (fileName == VideoPreviewService::vttFileName()) {
+            resp->setContentTypeString("text/vtt; charset=utf-8");
+        }
+        resp->addHeader("Cache-Control", "public, max-age=31536000, immutable");
+    }
+    callback(resp);
+}
+
+void MediaController::getCoursePreview(const HttpRequestPtr& req,
+                                       function<void(const HttpResponsePtr&)>&& callback,
+                                       const string& courseId,
+                                       const string& previewDir,
+                                       const string& fileName) {
+    bool valid = isSafeSegment(courseId) && isSafeSegment(previewDir) && isSafeSegment(fileName) &&
+                 previewDir.size() > 8 && previewDir.compare(previewDir.size() - 8, 8, ".preview") == 0;
+    if (!valid) {
+        callback(HttpResponse::newNotFoundResponse());
+        return;
+    }
+
+    sendPreviewFile("uploads/courses/" + courseId + "/videos/" + previewDir + "/" + fileName,
+                    fileName, std::move(callback));
+}
+
+void MediaController::getChapterPreview(const HttpRequestPtr& req,
+                                        function<void(const HttpResponsePtr&)>&& callback,
+                                        const string& courseId,
+                                        const string& chapterId,
+                                        const string& previewDir,
+                                        const string& fileName) {
+    bool valid = isSafeSegment(courseId) && isSafeSegment(chapterId) &&
+                 isSafeSegment(previewDir) && isSafeSegment(fileName) &&
+                 previewDir.size() > 8 && previewDir.compare(previewDir.size() - 8, 8, ".preview") == 0;
+    if (!valid) {
+        callback(HttpResponse::newNotFoundResponse());
+        return;
+    }
+
+    sendPreviewFile("uploads/courses/" + courseId + "/chapters/" + chapterId + "/videos/" + previewDir + "/" + fileName,
+                    fileName, std::move(callback));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+
+using namespace drogon;
+
+// Раздача обработанных изображений и превью видео.
+// Имена файлов содержат хеш содержимого (или привязаны к неизменяемому видео),
+// поэтому ответы кешируются навсегда.
+class MediaController : public drogon::HttpController<MediaController>
+{
+public:
+    METHOD_LIST_BEGIN
+        ADD_METHOD_TO(MediaController::getImage, "/media/images/{1}", Get);
+    ADD_METHOD_TO(MediaController::getCoursePreview, "/media/courses/{1}/videos/{2}/{3}", Get);
+    ADD_METHOD_TO(MediaController::getChapterPreview, "/media/courses/{1}/chapters/{2}/videos/{3}/{4}", Get);
+    METHOD_LIST_END
+
+        void getImage(const HttpRequestPtr& req,
+                  std::function<void(const HttpResponsePtr&)>&& callback,
+                  const std::string& fileName);
+
+    // Спрайты и WebVTT индекс превью, лежащие рядом с видео
+    void getCoursePreview(const HttpRequestPtr& req,
+                          std::function<void(const HttpResponsePtr&)>&& callback,
+                          const std::string& courseId,
+                          const std::string& previewDir,
+                          const std::string& fileName);
+    void getChapterPreview(const HttpRequestPtr& req,
+                           std::function<void(const HttpResponsePtr&)>&& callback,
+                           const std::string& courseId,
+                           const std::string& chapterId,
+                           const std::string& previewDir,
+                           const std::string& fileName);
+
+private:
+    bool isValidFileName(const std::string& fileName);
+    bool isSafeSegment(const std::string& segment);
+    void sendPreviewFile(const std::string& path,
+                         const std::string& fileName,
+                         std::function<void(const HttpResponsePtr&)>&& callback);
+};
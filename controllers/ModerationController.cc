@@ -0,0 +1,354 @@
+#include "ModerationController.h"
+#include "AuditLogger.h"
+#include "AuthContext.h"
+#include "JsonStreamWriter.h"
+#include "ModerationTemplateCache.h"
+#include "PgArray.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <unordered_set>
+
+using namespace drogon;
+using namespace drogon::orm;
+using namespace std;
+
+namespace {
+
+const Json::Value& moderationConfig() {
+    return app().getCustomConfig()["moderation"];
+}
+
+int leaseSeconds() {
+    static const int seconds = max(30, moderationConfig().get("lease_seconds", 600).asInt());
+    return seconds;
+}
+
+int defaultClaimBatch() {
+    static const int batch = max(1, moderationConfig().get("claim_batch", 10).asInt());
+    return batch;
+}
+
+int maxClaimBatch() {
+    static const int batch = max(defaultClaimBatch(), moderationConfig().get("max_claim_batch", 50).asInt());
+    return batch;
+}
+
+size_t maxDecisions() {
+    static const size_t limit = max(1u, moderationConfig().get("max_decisions", 100).asUInt());
+    return limit;
+}
+
+} // namespace
+
+string ModerationController::reviewerId(const HttpRequestPtr& req) {
+    AuthContext::Identity identity;
+    if (auto attached = AuthContext::attached(req)) {
+        identity = *attached;
+    } else if (!AuthContext::verifyBearer(req->getHeader("Authorization"), identity)) {
+        return "";
+    }
+    if (identity.role != "проверяющий" && identity.role != "админ" && identity.role != "основатель") {
+        return "";
+    }
+    return identity.userId;
+}
+
+Json::Value ModerationController::createJsonResponse(const string& key, const string& value) {
+    Json::Value json;
+    json[key] = value;
+    return json;
+}
+
+void ModerationController::claim(const HttpRequestPtr& req,
+                                 function<void(const HttpResponsePtr&)>&& callback) {
+    string userId = reviewerId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    int limit = defaultClaimBatch();
+    auto limitStr = req->getParameter("limit");
+    if (!limitStr.empty()) {
+        try {
+            limit = stoi(limitStr);
+        } catch (const exception&) {
+            limit = 0;
+        }
+        if (limit < 1 || limit > maxClaimBatch()) {
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid limit"));
+            resp->setStatusCode(k400BadRequest);
+            callback(resp);
+            return;
+        }
+    }
+
+    // Строки, которые сейчас берёт другой проверяющий, пропускаются, а не ждут его коммита.
+    // Свободными считаются и запросы с истёкшей арендой; свои запросы выдаются снова
+    // с продлённой арендой. Запросы на удалённые видео не выдаются вовсе
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        "WITH picked AS ("
+        "  SELECT mr.id FROM moderation_requests mr "
+        "  WHERE mr.status = 'на_модерации' "
+        "    AND (mr.claimed_by IS NULL OR mr.claimed_by = $1 OR mr.claim_expires_at < NOW()) "
+        "    AND EXISTS (SELECT 1 FROM course_videos cv WHERE cv.id = mr.content_id) "
+        "  ORDER BY mr.submitted_at, mr.id "
+        "  LIMIT $2 "
+        "  FOR UPDATE OF mr SKIP LOCKED), "
+        "claimed AS ("
+        "  UPDATE moderation_requests mr "
+        "  SET claimed_by = $1, claim_expires_at = NOW() + $3::integer * INTERVAL '1 second' "
+        "  FROM picked WHERE mr.id = picked.id "
+        "  RETURNING mr.id, mr.content_id, mr.submitted_by, mr.submitted_at, mr.claim_expires_at) "
+        "SELECT cl.id, cl.content_id, cl.submitted_by, cl.submitted_at, cl.claim_expires_at, "
+        "cv.title AS video_title, cv.description AS video_description, cv.duration, "
+        "cv.video_path, cv.cover_path AS video_cover, u.username AS video_author, "
+        "c.id AS course_id, c.title AS course_title "
+        "FROM claimed cl "
+        "JOIN course_videos cv ON cv.id = cl.content_id "
+        "JOIN users u ON u.id = cv.author_id "
+        "JOIN courses c ON c.id = cv.course_id "
+        "ORDER BY cl.submitted_at, cl.id",
+        [callback](const Result& result) {
+            JsonStreamWriter writer(64 + result.size() * 512);
+            writer.beginObject();
+            writer.key("requests");
+            writer.beginArray();
+            for (const auto& row : result) {
+                writer.beginObject();
+                writer.key("id");
+                writer.stringValue(row["id"].as<string>());
+                writer.key("video_id");
+                writer.stringValue(row["content_id"].as<string>());
+                writer.key("submitted_by");
+                if (row["submitted_by"].isNull()) {
+                    writer.nullValue();
+                } else {
+                    writer.stringValue(row["submitted_by"].as<string>());
+                }
+                writer.key("submitted_at");
+                writer.timestampValue(row["submitted_at"].as<string>());
+                writer.key("claim_expires_at");
+                writer.timestampValue(row["claim_expires_at"].as<string>());
+                writer.key("video_title");
+                writer.stringValue(row["video_title"].as<string>());
+                writer.key("video_description");
+                writer.stringValue(row["video_description"].isNull() ? "" : row["video_description"].as<string>());
+                writer.key("duration");
+                writer.stringValue(row["duration"].isNull() ? "" : row["duration"].as<string>());
+                writer.key("video_path");
+                writer.stringValue(row["video_path"].as<string>());
+                writer.key("video_cover");
+                if (row["video_cover"].isNull()) {
+                    writer.nullValue();
+                } else {
+                    writer.stringValue(row["video_cover"].as<string>());
+                }
+                writer.key("video_author");
+                writer.stringValue(row["video_author"].as<string>());
+                writer.key("course_id");
+                writer.stringValue(row["course_id"].as<string>());
+                writer.key("course_title");
+                writer.stringValue(row["course_title"].as<string>());
+                writer.endObject();
+            }
+            writer.endArray();
+            writer.key("lease_seconds");
+            writer.intValue(leaseSeconds());
+            writer.endObject();
+            callback(writer.toResponse());
+        },
+        [callback, this](const DrogonDbException& e) {
+            LOG_ERROR << "Database error claiming moderation requests: " << e.base().what();
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+            resp->setStatusCode(k500InternalServerError);
+            callback(resp);
+        },
+        userId, limit, leaseSeconds());
+}
+
+void ModerationController::release(const HttpRequestPtr& req,
+                                   function<void(const HttpResponsePtr&)>&& callback) {
+    string userId = reviewerId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        "UPDATE moderation_requests SET claimed_by = NULL, claim_expires_at = NULL "
+        "WHERE claimed_by = $1 AND status = 'на_модерации'",
+        [callback](const Result& result) {
+            Json::Value json;
+            json["released"] = static_cast<Json::UInt64>(result.affectedRows());
+            callback(HttpResponse::newHttpJsonResponse(json));
+        },
+        [callback, this](const DrogonDbException& e) {
+            LOG_ERROR << "Database error releasing moderation requests: " << e.base().what();
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+            resp->setStatusCode(k500InternalServerError);
+            callback(resp);
+        },
+        userId);
+}
+
+void ModerationController::decide(const HttpRequestPtr& req,
+                                  function<void(const HttpResponsePtr&)>&& callback) {
+    string userId = reviewerId(req);
+    if (userId.empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    auto json = req->getJsonObject();
+    if (!json || !(*json)["decisions"].isArray() || (*json)["decisions"].empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Field 'decisions' must be a non-empty array"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    const auto& decisions = (*json)["decisions"];
+    if (decisions.size() > maxDecisions()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Too many decisions"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    // Текст шаблона подставляется здесь, из снимка в памяти, а не соединением в запросе
+    auto templates = ModerationTemplateCache::instance().snapshot();
+    vector<string> ids, statuses, templateIds, notes;
+    unordered_set<string> seen;
+    for (const auto& item : decisions) {
+        string id = item.get("id", "").asString();
+        string decision = item.get("decision", "").asString();
+        string templateId = item.get("template_id", "").asString();
+        string note = item.get("notes", "").asString();
+
+        string error;
+        if (id.empty()) {
+            error = "Decision without id";
+        } else if (!seen.insert(id).second) {
+            error = "Duplicate decision for request " + id;
+        } else if (decision != "approve" && decision != "reject") {
+            error = "Decision must be 'approve' or 'reject'";
+        } else if (!templateId.empty() && !templates->byId.count(templateId)) {
+            error = "Unknown template " + templateId;
+        }
+
+        if (error.empty() && note.empty() && !templateId.empty()) {
+            note = templates->byId.at(templateId).text;
+        }
+        if (error.empty() && decision == "reject" && note.empty()) {
+            error = "Rejection requires notes or template_id";
+        }
+
+        if (!error.empty()) {
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", error));
+            resp->setStatusCode(k400BadRequest);
+            callback(resp);
+            return;
+        }
+
+        ids.push_back(std::move(id));
+        statuses.push_back(decision == "approve" ? "одобрено" : "отклонено");
+        templateIds.push_back(std::move(templateId));
+        notes.push_back(std::move(note));
+    }
+
+    // Решение применяется, только если аренда запроса всё ещё у этого проверяющего;
+    // одобренные видео публикуются тем же запросом
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        "WITH input AS ("
+        "  SELECT * FROM unnest($2::text[], $3::text[], $4::text[], $5::text[]) "
+        "  AS d(id, status, template_id, notes)), "
+        "decided AS ("
+        "  UPDATE moderation_requests mr "
+        "  SET status = d.status, reviewed_by = $1, reviewed_at = NOW(), "
+        "      review_notes = NULLIF(d.notes, ''), used_template_id = NULLIF(d.template_id, ''), "
+        "      claimed_by = NULL, claim_expires_at = NULL "
+        "  FROM input d "
+        "  WHERE mr.id = d.id AND mr.status = 'на_модерации' "
+        "    AND mr.claimed_by = $1 AND mr.claim_expires_at > NOW() "
+        "  RETURNING mr.id, mr.content_id, mr.status), "
+        "approved AS ("
+        "  UPDATE course_videos cv "
+        "  SET is_approved = true, approved_by = $1, approved_at = NOW() "
+        "  FROM decided WHERE decided.status = 'одобрено' "
+        "    AND cv.id = decided.content_id AND NOT cv.is_approved) "
+        "SELECT id, content_id, status FROM decided",
+        [req, userId, callback, ids](const Result& result) {
+            Json::Value response;
+            response["applied"] = Json::arrayValue;
+            unordered_set<string> applied;
+            for (const auto& row : result) {
+                Json::Value item;
+                item["id"] = row["id"].as<string>();
+                item["status"] = row["status"].as<string>();
+                applied.insert(item["id"].asString());
+
+                Json::Value details;
+                details["video_id"] = row["content_id"].as<string>();
+                AuditLogger::instance().record(req, userId,
+                                               item["status"].asString() == "одобрено" ? "moderation_approved" : "moderation_rejected",
+                                               "moderation_request", item["id"].asString(), details);
+                response["applied"].append(item);
+            }
+            // Аренда истекла, запрос взят другим или уже решён
+            response["skipped"] = Json::arrayValue;
+            for (const auto& id : ids) {
+                if (!applied.count(id)) {
+                    response["skipped"].append(id);
+                }
+            }
+            callback(HttpResponse::newHttpJsonResponse(response));
+        },
+        [callback, this](const DrogonDbException& e) {
+            LOG_ERROR << "Database error applying moderation decisions: " << e.base().what();
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
+            resp->setStatusCode(k500InternalServerError);
+            callback(resp);
+        },
+        userId, pg::textArray(ids), pg::textArray(statuses), pg::textArray(templateIds), pg::textArray(notes));
+}
+
+void ModerationController::getTemplates(const HttpRequestPtr& req,
+                                        function<void(const HttpResponsePtr&)>&& callback) {
+    if (reviewerId(req).empty()) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Forbidden"));
+        resp->setStatusCode(k403Forbidden);
+        callback(resp);
+        return;
+    }
+
+    auto templates = ModerationTemplateCache::instance().snapshot();
+    auto body = templates->bodies.find(req->getParameter("category"));
+    if (body == templates->bodies.end()) {
+        // До первой загрузки снимок пуст и в нём нет даже общего списка
+        if (templates->bodies.empty()) {
+            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Templates are not loaded yet"));
+            resp->setStatusCode(k503ServiceUnavailable);
+            callback(resp);
+            return;
+        }
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid category"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
+
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    resp->setBody(body->second);
+    callback(resp);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <drogon/HttpController.h>
+#include <json/json.h>
+
+using namespace drogon;
+
+// Очередь модерации видео для ролей "проверяющий", "админ" и "основатель".
+// Проверяющий берёт пачку запросов в аренду (FOR UPDATE SKIP LOCKED), поэтому
+// несколько проверяющих не получают одни и те же запросы и не ждут друг друга.
+// Аренда истекает через lease_seconds, и невзятые решения снова попадают в очередь.
+// Решения по пачке применяются одним запросом.
+class ModerationController : public drogon::HttpController<ModerationController>
+{
+public:
+    METHOD_LIST_BEGIN
+        ADD_METHOD_TO(ModerationController::claim, "/moderation/claim", Post);
+    ADD_METHOD_TO(ModerationController::release, "/moderation/claim", Delete);
+    ADD_METHOD_TO(ModerationController::decide, "/moderation/decisions", Post);
+    ADD_METHOD_TO(ModerationController::getTemplates, "/moderation/templates", Get);
+    METHOD_LIST_END
+
+        // Взять в работу до ?limit= запросов (вместе с уже взятыми своими, аренда продлевается)
+        void claim(const HttpRequestPtr& req,
+               std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Вернуть в очередь все свои незавершённые запросы
+    void release(const HttpRequestPtr& req,
+                 std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Решения по взятым запросам:
+    // {"decisions": [{"id": "...", "decision": "approve"|"reject", "template_id": "...", "notes": "..."}]}
+    void decide(const HttpRequestPtr& req,
+                std::function<void(const HttpResponsePtr&)>&& callback);
+
+    // Активные шаблоны комментариев, ?category= - только одной категории
+    void getTemplates(const HttpRequestPtr& req,
+                      std::function<void(const HttpResponsePtr&)>&& callback);
+
+private:
+    // userId проверяющего, пусто - нет доступа
+    std::string reviewerId(const HttpRequestPtr& req);
+    Json::Value createJsonResponse(const std::string& key, const std::string& value);
+};
@@ -0,0 +1,101 @@
+#include "ModerationTemplateCache.h"
+#include "JsonStreamWriter.h"
+#include <algorithm>
+#include <vector>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+const char* const kCategories[] = {"отклонение", "одобрение", "замечания"};
+
+std::string listBody(const std::vector<const ModerationTemplateCache::Template*>& templates) {
+    JsonStreamWriter writer(64 + templates.size() * 192);
+    writer.beginObject();
+    writer.key("templates");
+    writer.beginArray();
+    for (const auto* item : templates) {
+        writer.beginObject();
+        writer.key("id");
+        writer.stringValue(item->id);
+        writer.key("category");
+        writer.stringValue(item->category);
+        writer.key("title");
+        writer.stringValue(item->title);
+        writer.key("template_text");
+        writer.stringValue(item->text);
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    return writer.release();
+}
+
+} // namespace
+
+ModerationTemplateCache::ModerationTemplateCache()
+    : snapshot_(std::make_shared<Snapshot>()) {}
+
+void ModerationTemplateCache::start() {
+    const auto& config = app().getCustomConfig()["moderation"];
+    double interval = std::max(5.0, config.get("template_refresh_seconds", 300.0).asDouble());
+
+    app().getLoop()->queueInLoop([this]() {
+        refresh();
+    });
+    app().getLoop()->runEvery(interval, [this]() {
+        refresh();
+    });
+}
+
+ModerationTemplateCache::SnapshotPtr ModerationTemplateCache::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return snapshot_;
+}
+
+void ModerationTemplateCache::refresh() {
+    if (refreshing_.exchange(true)) {
+        return;
+    }
+
+    app().getDbClient()->execSqlAsync(
+        "SELECT id, category, title, template_text FROM moderation_templates "
+        "WHERE is_active = true ORDER BY category, title",
+        [this](const Result& result) {
+            auto next = std::make_shared<Snapshot>();
+            std::vector<const Template*> ordered;
+            ordered.reserve(result.size());
+            for (const auto& row : result) {
+                Template item;
+                item.id = row["id"].as<std::string>();
+                item.category = row["category"].as<std::string>();
+                item.title = row["title"].as<std::string>();
+                item.text = row["template_text"].as<std::string>();
+                auto inserted = next->byId.emplace(item.id, std::move(item));
+                ordered.push_back(&inserted.first->second);
+            }
+
+            next->bodies[""] = listBody(ordered);
+            for (const char* category : kCategories) {
+                std::vector<const Template*> filtered;
+                for (const auto* item : ordered) {
+                    if (item->category == category) {
+                        filtered.push_back(item);
+                    }
+                }
+                next->bodies[category] = listBody(filtered);
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                snapshot_ = std::move(next);
+            }
+            refreshing_ = false;
+        },
+        [this](const DrogonDbException& e) {
+            // Остаётся прежний снимок, следующая попытка - по таймеру
+            LOG_ERROR << "Failed to load moderation templates: " << e.base().what();
+            refreshing_ = false;
+        });
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Активные шаблоны комментариев модерации в памяти.
+// Таблица маленькая и почти не меняется, а читается при каждом решении
+// проверяющего, поэтому она целиком перечитывается раз в refresh_seconds,
+// а запросы берут готовый снимок: тексты для подстановки и тела ответов
+// GET /moderation/templates по категориям.
+class ModerationTemplateCache {
+public:
+    static ModerationTemplateCache& instance() {
+        static ModerationTemplateCache instance;
+        return instance;
+    }
+
+    struct Template {
+        std::string id;
+        std::string category;  // отклонение / одобрение / замечания
+        std::string title;
+        std::string text;
+    };
+
+    struct Snapshot {
+        std::unordered_map<std::string, Template> byId;
+        // Готовые JSON-тела списка: "" - все категории
+        std::unordered_map<std::string, std::string> bodies;
+    };
+    using SnapshotPtr = std::shared_ptr<const Snapshot>;
+
+    // Первая загрузка и таймер обновления (вызывается из main до app().run())
+    void start();
+
+    // Текущий снимок; до первой загрузки - пустой
+    SnapshotPtr snapshot() const;
+
+    // Перечитать шаблоны вне очереди
+    void refresh();
+
+private:
+    ModerationTemplateCache();
+
+    mutable std::mutex mutex_;
+    SnapshotPtr snapshot_;
+    std::atomic<bool> refreshing_{false};
+};
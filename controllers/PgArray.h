@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Литералы массивов PostgreSQL для пакетных запросов вида
+// "... FROM unnest($1::text[], $2::integer[]) ..." — один параметр на колонку
+// вместо отдельного запроса на каждую строку.
+namespace pg {
+
+inline std::string textArray(const std::vector<std::string>& values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += '"';
+        for (char c : values[i]) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        out += '"';
+    }
+    out += '}';
+    return out;
+}
+
+inline std::string intArray(const std::vector<int64_t>& values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += std::to_string(values[i]);
+    }
+    out += '}';
+    return out;
+}
+
+// Полная точность double, чтобы значение не менялось при сохранении и чтении
+inline std::string doubleArray(const std::vector<double>& values) {
+    std::string out = "{";
+    char buffer[32];
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        int length = std::snprintf(buffer, sizeof(buffer), "%.17g", values[i]);
+        out.append(buffer, length);
+    }
+    out += '}';
+    return out;
+}
+
+inline std::string boolArray(const std::vector<bool>& values) {
+    std::string out = "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += values[i] ? 't' : 'f';
+    }
+    out += '}';
+    return out;
+}
+
+} // namespace pg
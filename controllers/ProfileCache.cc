@@ -0,0 +1,152 @@
+#include "ProfileCache.h"
+#include "HttpCache.h"
+#include "InvalidationBus.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+
+using namespace drogon;
+
+void ProfileCache::start() {
+    const auto& config = app().getCustomConfig()["profile_cache"];
+    maxUsersPerShard_ = std::max<size_t>(1, config.get("max_users", 50000).asUInt() / kShardCount);
+    profileTtl_ = std::chrono::seconds(std::max(1u, config.get("profile_ttl_seconds", 300).asUInt()));
+    channelTtl_ = std::chrono::seconds(std::max(1u, config.get("channel_ttl_seconds", 30).asUInt()));
+
+    InvalidationBus::instance().subscribe(
+        "profile",
+        [this](const std::string& userId) { evict(userId); },
+        [this]() { clear(); });
+}
+
+ProfileCache::Shard& ProfileCache::shardFor(const std::string& userId) const {
+    return shards_[std::hash<std::string>{}(userId) % kShardCount];
+}
+
+ProfileCache::Clock::duration ProfileCache::ttlFor(View view) const {
+    // Страницы курсов перед выдачей сверяются с отпечатком курсов канала,
+    // срок только ограничивает память
+    return view == View::Owner ? profileTtl_ : channelTtl_;
+}
+
+ProfileCache::EntryPtr ProfileCache::find(View view, const std::string& userId, const std::string& variant) const {
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.users.find(userId);
+    if (it == shard.users.end()) {
+        return nullptr;
+    }
+
+    auto& views = it->second;
+    const Cached* cached = nullptr;
+    switch (view) {
+    case View::Owner:
+        cached = &views.owner;
+        break;
+    case View::Channel:
+        cached = &views.channel;
+        break;
+    case View::ChannelCourses: {
+        auto page = views.coursePages.find(variant);
+        if (page == views.coursePages.end()) {
+            return nullptr;
+        }
+        cached = &page->second;
+        break;
+    }
+    }
+
+    if (!cached->entry || cached->expiresAt <= Clock::now()) {
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, views.lru);
+    return cached->entry;
+}
+
+uint64_t ProfileCache::ticket(const std::string& userId) const {
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.generation;
+}
+
+void ProfileCache::store(View view, const std::string& userId, const std::string& variant,
+                         uint64_t ticket, Entry entry) {
+    auto cached = Cached{std::make_shared<const Entry>(std::move(entry)), Clock::now() + ttlFor(view)};
+
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.generation != ticket) {
+        return;
+    }
+
+    auto it = shard.users.find(userId);
+    if (it == shard.users.end()) {
+        if (shard.users.size() >= maxUsersPerShard_) {
+            shard.users.erase(shard.lru.back());
+            shard.lru.pop_back();
+        }
+        shard.lru.push_front(userId);
+        it = shard.users.emplace(userId, UserViews{}).first;
+        it->second.lru = shard.lru.begin();
+    } else {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru);
+    }
+
+    auto& views = it->second;
+    switch (view) {
+    case View::Owner:
+        views.owner = std::move(cached);
+        break;
+    case View::Channel:
+        views.channel = std::move(cached);
+        break;
+    case View::ChannelCourses:
+        if (views.coursePages.size() >= kMaxCoursePages && !views.coursePages.count(variant)) {
+            views.coursePages.clear();
+        }
+        views.coursePages[variant] = std::move(cached);
+        break;
+    }
+}
+
+void ProfileCache::invalidate(const std::string& userId) {
+    evict(userId);
+    InvalidationBus::instance().publish("profile", userId);
+}
+
+void ProfileCache::evict(const std::string& userId) {
+    auto& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    ++shard.generation;
+
+    auto it = shard.users.find(userId);
+    if (it != shard.users.end()) {
+        shard.lru.erase(it->second.lru);
+        shard.users.erase(it);
+    }
+}
+
+void ProfileCache::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        ++shard.generation;
+        shard.users.clear();
+        shard.lru.clear();
+    }
+}
+
+HttpResponsePtr ProfileCache::respond(const HttpRequestPtr& req,
+                                      const Entry& entry,
+                                      std::string_view kind,
+                                      const std::string& viewerId) {
+    auto validator = HttpCache::versioned(req, kind, entry.version, entry.modifiedAt, viewerId);
+    if (HttpCache::isNotModified(req, validator)) {
+        return HttpCache::notModified(validator);
+    }
+
+    auto resp = HttpResponse::newHttpResponse();
+    resp->setContentTypeCode(CT_APPLICATION_JSON);
+    resp->setBody(entry.body);
+    HttpCache::apply(resp, validator);
+    return resp;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Готовые тела ответов профиля и канала: вид владельца (/users/me),
+// публичная карточка канала (/channels/{id}) и страницы курсов канала.
+// Карточки рисуются на каждом экране профиля, а меняются редко, поэтому
+// чтение берёт сериализованный JSON из памяти. Запись профиля (поля, аватар,
+// обложка, контакты, информация) сбрасывает все виды пользователя сразу;
+// срок жизни нужен только для статистики канала, которую двигают триггеры.
+class ProfileCache {
+public:
+    static ProfileCache& instance() {
+        static ProfileCache instance;
+        return instance;
+    }
+
+    // Настройки из custom_config.profile_cache (вызывается из main до app().run())
+    void start();
+
+    struct Entry {
+        std::string body;          // JSON ответа
+        std::string version;       // версия ресурса для ETag
+        int64_t modifiedAt = 0;    // для Last-Modified
+        bool isPublic = true;      // карточка канала: profile_is_public
+    };
+    using EntryPtr = std::shared_ptr<const Entry>;
+
+    enum class View {
+        Owner,          // свой профиль целиком
+        Channel,        // публичная карточка канала со статистикой
+        ChannelCourses  // страница курсов канала, variant - параметры страницы
+    };
+
+    // nullptr - нет в кеше или срок истёк
+    EntryPtr find(View view, const std::string& userId, const std::string& variant = {}) const;
+
+    // Берётся до запроса в БД и передаётся в store: если профиль успели
+    // изменить, пока шёл запрос, устаревший ответ не сохраняется
+    uint64_t ticket(const std::string& userId) const;
+    void store(View view, const std::string& userId, const std::string& variant,
+               uint64_t ticket, Entry entry);
+
+    // Все виды пользователя: после любой записи в его профиль.
+    // Сбрасывает и на остальных экземплярах (InvalidationBus, вид "profile")
+    void invalidate(const std::string& userId);
+
+    // Ответ из готового тела с ETag/Last-Modified по версии (kind - как в
+    // HttpCache::versioned); 304, если у клиента та же версия
+    static drogon::HttpResponsePtr respond(const drogon::HttpRequestPtr& req,
+                                           const Entry& entry,
+                                           std::string_view kind,
+                                           const std::string& viewerId);
+
+private:
+    ProfileCache() = default;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Cached {
+        EntryPtr entry;
+        Clock::time_point expiresAt;
+    };
+
+    struct UserViews {
+        Cached owner;
+        Cached channel;
+        std::unordered_map<std::string, Cached> coursePages;
+        std::list<std::string>::iterator lru;
+    };
+
+    // Поколение шарда растёт при каждом сбросе: ticket сравнивается с ним
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, UserViews> users;
+        std::list<std::string> lru;  // в начале - последние прочитанные
+        uint64_t generation = 0;
+    };
+
+    static constexpr size_t kShardCount = 32;
+    // Страниц курсов одного канала (фильтры, сортировки, страницы)
+    static constexpr size_t kMaxCoursePages = 32;
+
+    Shard& shardFor(const std::string& userId) const;
+    Clock::duration ttlFor(View view) const;
+
+    // Только здесь: по ключу из InvalidationBus и при полном сбросе
+    void evict(const std::string& userId);
+    void clear();
+
+    mutable std::array<Shard, kShardCount> shards_;
+
+    size_t maxUsersPerShard_ = 50000 / kShardCount;
+    Clock::duration profileTtl_ = std::chrono::seconds(300);
+    Clock::duration channelTtl_ = std::chrono::seconds(30);
+};
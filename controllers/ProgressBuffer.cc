@@ -0,0 +1,340 @@
+#include "ProgressBuffer.h"
+#include "DbRouter.h"
+#include "PgArray.h"
+#include "TrendingService.h"
+#include <drogon/drogon.h>
+#include <drogon/orm/DbClient.h>
+#include <algorithm>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+struct FlushParams {
+    std::vector<std::string> userIds;
+    std::vector<std::string> videoIds;
+    std::vector<int64_t> watchedSeconds;
+    std::vector<bool> completed;
+    std::vector<bool> insertable;
+};
+
+template <typename RowList>
+FlushParams buildFlushParams(const RowList& rows) {
+    FlushParams params;
+    for (const auto& row : rows) {
+        params.userIds.push_back(row.userId);
+        params.videoIds.push_back(row.videoId);
+        params.watchedSeconds.push_back(row.entry.watchedSeconds);
+        params.completed.push_back(row.entry.completed);
+        params.insertable.push_back(row.entry.insertable);
+    }
+    return params;
+}
+
+// Курсы уроков, завершённых этим сбросом (для TrendingService)
+void reportCompletions(const Result& result) {
+    for (const auto& row : result) {
+        TrendingService::instance().record(row["course_id"].as<std::string>(),
+                                           TrendingService::Signal::Completion);
+    }
+}
+
+} // namespace
+
+void ProgressBuffer::start() {
+    const auto& config = app().getCustomConfig()["progress"];
+    flushIntervalSeconds_ = std::max(0.5, config.get("flush_interval_seconds", 5.0).asDouble());
+    maxPendingEntries_ = std::max(1u, config.get("max_pending_entries", 100000).asUInt());
+    maxFlushAttempts_ = std::max(1, config.get("max_flush_attempts", 3).asInt());
+
+    app().getLoop()->runEvery(flushIntervalSeconds_, [this]() {
+        flush();
+    });
+}
+
+ProgressBuffer::Shard& ProgressBuffer::shardFor(const std::string& userId) const {
+    return shards_[std::hash<std::string>{}(userId) % kShardCount];
+}
+
+void ProgressBuffer::mergeEntry(Entry& target, const Entry& update) {
+    target.watchedSeconds = std::max(target.watchedSeconds, update.watchedSeconds);
+    target.completed = target.completed || update.completed;
+    target.insertable = target.insertable || update.insertable;
+    target.failedAttempts = std::max(target.failedAttempts, update.failedAttempts);
+}
+
+void ProgressBuffer::merge(const std::string& userId, const std::string& videoId, const Entry& update) {
+    bool added = false;
+    {
+        auto& shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto& videos = shard.pending[userId];
+        auto [it, inserted] = videos.emplace(videoId, update);
+        if (!inserted) {
+            mergeEntry(it->second, update);
+        }
+        added = inserted;
+    }
+
+    // Слишком много разных пар - не ждём таймера
+    if (added && ++pendingEntries_ >= maxPendingEntries_) {
+        app().getLoop()->queueInLoop([this]() {
+            flush();
+        });
+    }
+}
+
+void ProgressBuffer::record(const std::string& userId, const std::string& videoId, int watchedSeconds, bool completed) {
+    merge(userId, videoId, Entry{std::clamp(watchedSeconds, 0, kMaxWatchedSeconds), completed, true});
+}
+
+void ProgressBuffer::recordDuration(const std::string& userId, const std::string& videoId, int watchedSeconds) {
+    merge(userId, videoId, Entry{std::clamp(watchedSeconds, 0, kMaxWatchedSeconds), false, false});
+}
+
+std::vector<ProgressBuffer::Pending> ProgressBuffer::pendingFor(const std::string& userId) const {
+    std::unordered_map<std::string, Entry> merged;
+
+    std::shared_ptr<const Batch> inflight;
+    {
+        std::lock_guard<std::mutex> lock(inflightMutex_);
+        inflight = inflight_;
+    }
+    if (inflight) {
+        auto it = inflight->find(userId);
+        if (it != inflight->end()) {
+            merged = it->second;
+        }
+    }
+
+    {
+        auto& shard = shardFor(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.pending.find(userId);
+        if (it != shard.pending.end()) {
+            for (const auto& [videoId, entry] : it->second) {
+                auto [target, inserted] = merged.emplace(videoId, entry);
+                if (!inserted) {
+                    mergeEntry(target->second, entry);
+                }
+            }
+        }
+    }
+
+    std::vector<Pending> result;
+    result.reserve(merged.size());
+    for (const auto& [videoId, entry] : merged) {
+        result.push_back({videoId, entry.watchedSeconds, entry.completed});
+    }
+    return result;
+}
+
+ProgressBuffer::Batch ProgressBuffer::drainShards() {
+    Batch batch;
+    for (auto& shard : shards_) {
+        Batch drained;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            std::swap(drained, shard.pending);
+        }
+        for (auto& [userId, videos] : drained) {
+            batch[userId] = std::move(videos);  // пользователь живёт в одном шарде
+        }
+    }
+    pendingEntries_ = 0;
+    return batch;
+}
+
+ProgressBuffer::Rows ProgressBuffer::toRows(const Batch& batch) {
+    Rows rows;
+    for (const auto& [userId, videos] : batch) {
+        for (const auto& [videoId, entry] : videos) {
+            rows.push_back({userId, videoId, entry});
+        }
+    }
+    return rows;
+}
+
+void ProgressBuffer::requeue(const Rows& rows) {
+    for (const auto& row : rows) {
+        merge(row.userId, row.videoId, row.entry);
+    }
+}
+
+void ProgressBuffer::rejectRow(const Row& row, const std::string& error) {
+    if (row.entry.failedAttempts + 1 >= maxFlushAttempts_) {
+        LOG_ERROR << "Progress entry dropped after " << maxFlushAttempts_ << " failed writes (user " << row.userId
+                  << ", video " << row.videoId << "): " << error;
+        return;
+    }
+    Row retry = row;
+    ++retry.entry.failedAttempts;
+    merge(retry.userId, retry.videoId, retry.entry);
+}
+
+// Один запрос на пакет: длительность видео берётся одним JOIN вместо трёх
+// подзапросов на строку. POST создаёт строку, PUT меняет только существующую.
+// Завершение не сбрасывается, watched_seconds не больше длительности видео и не
+// уменьшается (как и в mergeEntry), процент считается в bigint из того же
+// итогового значения; в ответе - курсы впервые завершённых уроков
+std::string ProgressBuffer::flushSql() {
+    return R"(
+        WITH input AS (
+            SELECT * FROM unnest($1::text[], $2::text[], $3::integer[], $4::boolean[], $5::boolean[])
+                AS t(user_id, video_id, watched_seconds, completed, insertable)
+        ),
+        src AS (
+            SELECT i.user_id, i.video_id, cv.course_id, i.completed, i.insertable, cv.duration_seconds,
+                   CASE WHEN cv.duration_seconds > 0
+                        THEN LEAST(GREATEST(i.watched_seconds, 0), cv.duration_seconds)
+                        ELSE GREATEST(i.watched_seconds, 0)
+                   END AS watched_seconds
+            FROM input i
+            JOIN course_videos cv ON cv.id = i.video_id
+            JOIN users u ON u.id = i.user_id
+        ),
+        previous AS (
+            SELECT up.user_id, up.video_id, COALESCE(up.completed, false) AS completed
+            FROM user_progress up
+            JOIN src s ON s.user_id = up.user_id AND s.video_id = up.video_id
+        ),
+        updated AS (
+            UPDATE user_progress up
+            SET watched_seconds = GREATEST(up.watched_seconds, s.watched_seconds),
+                progress_percentage = LEAST((GREATEST(up.watched_seconds, s.watched_seconds)::bigint * 100)
+                                            / NULLIF(s.duration_seconds, 0), 100)::integer,
+                last_watched_at = NOW(),
+                updated_at = NOW()
+            FROM src s
+            WHERE NOT s.insertable AND up.user_id = s.user_id AND up.video_id = s.video_id
+            RETURNING up.user_id, up.video_id, up.course_id, up.completed
+        ),
+        upserted AS (
+            INSERT INTO user_progress (user_id, course_id, video_id, completed, watched_seconds,
+                                       progress_percentage, last_watched_at, completed_at)
+            SELECT user_id, course_id, video_id, completed, watched_seconds,
+                   LEAST((watched_seconds::bigint * 100) / NULLIF(duration_seconds, 0), 100)::integer,
+                   NOW(), CASE WHEN completed THEN NOW() END
+            FROM src
+            WHERE insertable
+            ORDER BY user_id, video_id
+            ON CONFLICT (user_id, video_id) DO UPDATE SET
+                completed = COALESCE(user_progress.completed, false) OR EXCLUDED.completed,
+                completed_at = CASE
+                    WHEN EXCLUDED.completed AND NOT COALESCE(user_progress.completed, false) THEN NOW()
+                    ELSE user_progress.completed_at
+                END,
+                watched_seconds = GREATEST(user_progress.watched_seconds, EXCLUDED.watched_seconds),
+                -- В EXCLUDED нет длительности: она берётся по первичному ключу видео
+                progress_percentage = LEAST((GREATEST(user_progress.watched_seconds, EXCLUDED.watched_seconds)::bigint * 100)
+                                            / NULLIF((SELECT cv.duration_seconds FROM course_videos cv
+                                                      WHERE cv.id = EXCLUDED.video_id), 0), 100)::integer,
+                last_watched_at = NOW(),
+                updated_at = NOW()
+            RETURNING user_id, video_id, course_id, completed
+        )
+        SELECT w.course_id
+        FROM (SELECT * FROM updated UNION ALL SELECT * FROM upserted) w
+        LEFT JOIN previous p ON p.user_id = w.user_id AND p.video_id = w.video_id
+        WHERE w.completed AND NOT COALESCE(p.completed, false) AND w.course_id IS NOT NULL
+    )";
+}
+
+void ProgressBuffer::flush() {
+    // Предыдущий сброс ещё идёт - записи накопятся до следующего тика
+    if (flushing_.exchange(true)) {
+        return;
+    }
+
+    auto batch = std::make_shared<const Batch>(drainShards());
+    if (batch->empty()) {
+        flushing_ = false;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(inflightMutex_);
+        inflight_ = batch;
+    }
+
+    writeRows(std::make_shared<const Rows>(toRows(*batch)), [this]() {
+        {
+            std::lock_guard<std::mutex> lock(inflightMutex_);
+            inflight_.reset();
+        }
+        flushing_ = false;
+    });
+}
+
+void ProgressBuffer::writeRows(std::shared_ptr<const Rows> rows, std::function<void()> done) {
+    auto params = buildFlushParams(*rows);
+    app().getDbClient()->execSqlAsync(
+        flushSql(),
+        [rows, done](const Result& result) {
+            reportCompletions(result);
+            // Буфер больше не накладывается на чтение - прогресс читается с основного сервера
+            for (const auto& row : *rows) {
+                DbRouter::instance().pin(row.userId);
+            }
+            done();
+        },
+        [this, rows, done](const DrogonDbException& e) {
+            // Обрыв соединения или таймаут - данные не виноваты, пакет ждёт следующего сброса
+            if (!dynamic_cast<const SqlError*>(&e)) {
+                LOG_ERROR << "Progress flush failed, entries are kept for the next attempt: " << e.base().what();
+                requeue(*rows);
+                done();
+                return;
+            }
+            if (rows->size() == 1) {
+                rejectRow(rows->front(), e.base().what());
+                done();
+                return;
+            }
+
+            // Ошибка в данных: половины пишутся по очереди, пока виновная строка не останется одна
+            auto middle = rows->begin() + static_cast<std::ptrdiff_t>(rows->size() / 2);
+            auto first = std::make_shared<const Rows>(rows->begin(), middle);
+            auto second = std::make_shared<const Rows>(middle, rows->end());
+            writeRows(first, [this, second, done]() {
+                writeRows(second, done);
+            });
+        },
+        pg::textArray(params.userIds), pg::textArray(params.videoIds), pg::intArray(params.watchedSeconds),
+        pg::boolArray(params.completed), pg::boolArray(params.insertable));
+}
+
+void ProgressBuffer::shutdown() {
+    auto batch = drainShards();
+    {
+        // Незавершённый асинхронный сброс уже не подтвердится - пишем и его
+        std::lock_guard<std::mutex> lock(inflightMutex_);
+        if (inflight_) {
+            for (const auto& [userId, videos] : *inflight_) {
+                auto& target = batch[userId];
+                for (const auto& [videoId, entry] : videos) {
+                    auto [it, inserted] = target.emplace(videoId, entry);
+                    if (!inserted) {
+                        mergeEntry(it->second, entry);
+                    }
+                }
+            }
+        }
+    }
+    if (batch.empty()) {
+        return;
+    }
+
+    try {
+        auto params = buildFlushParams(toRows(batch));
+        auto result = app().getDbClient()->execSqlSync(
+            flushSql(),
+            pg::textArray(params.userIds), pg::textArray(params.videoIds), pg::intArray(params.watchedSeconds),
+            pg::boolArray(params.completed), pg::boolArray(params.insertable));
+        reportCompletions(result);
+        LOG_INFO << "Progress flushed on shutdown: " << params.userIds.size() << " entries";
+    } catch (const DrogonDbException& e) {
+        LOG_ERROR << "Progress flush on shutdown failed, " << batch.size() << " users lost updates: "
+                  << e.base().what();
+    }
+}
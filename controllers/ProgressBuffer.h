@@ -0,0 +1,107 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Отложенная запись прогресса уроков.
+// Плеер присылает прогресс каждые несколько секунд; в памяти остаётся одна
+// запись на пару пользователь-видео (максимум watched_seconds, завершение
+// не сбрасывается), раз в интервал всё пишется одним многострочным upsert.
+// Чтения своего прогресса накладывают ещё не записанные значения (pendingFor).
+// Если пакет отклонён из-за данных, он делится пополам, пока ошибочная строка
+// не останется одна; она повторяется не больше max_flush_attempts раз.
+class ProgressBuffer {
+public:
+    static ProgressBuffer& instance() {
+        static ProgressBuffer instance;
+        return instance;
+    }
+
+    // Верхняя граница watched_seconds от клиента (сутки); при записи значение
+    // ещё ограничивается длительностью видео
+    static constexpr int kMaxWatchedSeconds = 24 * 60 * 60;
+
+    // Запуск периодического сброса (вызывается из main до app().run())
+    void start();
+
+    // Синхронный сброс остатков при остановке сервера
+    void shutdown();
+
+    // POST /users/me/progress/lessons: создаёт запись, если её нет
+    void record(const std::string& userId, const std::string& videoId, int watchedSeconds, bool completed);
+
+    // PUT /users/me/progress/lessons/{id}: меняет только существующую запись
+    void recordDuration(const std::string& userId, const std::string& videoId, int watchedSeconds);
+
+    struct Pending {
+        std::string videoId;
+        int watchedSeconds;
+        bool completed;
+    };
+
+    // Значения пользователя, ещё не подтверждённые БД (включая пишущиеся сейчас)
+    std::vector<Pending> pendingFor(const std::string& userId) const;
+
+private:
+    ProgressBuffer() = default;
+
+    struct Entry {
+        int watchedSeconds = 0;
+        bool completed = false;
+        bool insertable = false;  // был POST: строку можно создать
+        int failedAttempts = 0;   // отказы БД именно по этой строке
+    };
+
+    struct Row {
+        std::string userId;
+        std::string videoId;
+        Entry entry;
+    };
+    using Rows = std::vector<Row>;
+
+    // userId -> videoId -> Entry
+    using Batch = std::unordered_map<std::string, std::unordered_map<std::string, Entry>>;
+
+    // Шард по пользователю: все его записи в одном месте для pendingFor
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        Batch pending;
+    };
+
+    static constexpr size_t kShardCount = 64;
+
+    Shard& shardFor(const std::string& userId) const;
+    void merge(const std::string& userId, const std::string& videoId, const Entry& update);
+    static void mergeEntry(Entry& target, const Entry& update);
+
+    Batch drainShards();
+    static Rows toRows(const Batch& batch);
+    void requeue(const Rows& rows);
+    void flush();
+    // Пишет строки одним запросом; при ошибке данных делит их пополам.
+    // done вызывается, когда все части записаны или возвращены в буфер
+    void writeRows(std::shared_ptr<const Rows> rows, std::function<void()> done);
+    // Отказ по единственной строке: повтор или отбрасывание после max_flush_attempts
+    void rejectRow(const Row& row, const std::string& error);
+
+    static std::string flushSql();
+
+    mutable std::array<Shard, kShardCount> shards_;
+
+    // Пакет, который пишется сейчас: виден в pendingFor до подтверждения
+    mutable std::mutex inflightMutex_;
+    std::shared_ptr<const Batch> inflight_;
+
+    std::atomic<bool> flushing_{false};
+    std::atomic<size_t> pendingEntries_{0};
+    size_t maxPendingEntries_ = 100000;
+    int maxFlushAttempts_ = 3;
+    double flushIntervalSeconds_ = 5.0;
+};
@@ -0,0 +1,225 @@
+#include "ProgressWebSocket.h"
+#include "AuthContext.h"
+#include "CborTranscoder.h"
+#include "ProgressBuffer.h"
+#include <drogon/drogon.h>
+#include <json/json.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <unordered_set>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+struct Session {
+    AuthContext::Identity identity;
+    std::unordered_set<std::string> completedVideos;  // о завершении уже сообщили
+    bool binary = false;                               // клиент пишет CBOR - отвечаем так же
+    std::chrono::steady_clock::time_point windowStart = std::chrono::steady_clock::now();
+    unsigned framesInWindow = 0;
+};
+
+unsigned maxFramesPerSecond() {
+    static const unsigned limit =
+        app().getCustomConfig()["progress"].get("socket_max_frames_per_second", 4).asUInt();
+    return limit;
+}
+
+// Следующий урок в порядке структуры курса: сначала видео без глав, затем главы по порядку
+const char* const kNextLessonSql = R"(
+    WITH ordered AS (
+        SELECT cv.id, cv.course_id, cv.title, cv.chapter_id,
+               ROW_NUMBER() OVER (ORDER BY cv.chapter_id IS NOT NULL, ch."order", cv."order") AS position
+        FROM course_videos cv
+        LEFT JOIN course_chapters ch ON ch.id = cv.chapter_id
+        WHERE cv.course_id = (SELECT course_id FROM course_videos WHERE id = $1)
+          AND cv.is_approved = true
+    )
+    SELECT n.id, n.course_id, n.title, n.chapter_id
+    FROM ordered c
+    JOIN ordered n ON n.position = c.position + 1
+    WHERE c.id = $1
+)";
+
+void sendEvent(const WebSocketConnectionPtr& conn, const Json::Value& event, bool binary) {
+    if (!conn->connected()) {
+        return;
+    }
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    std::string json = Json::writeString(builder, event);
+    if (!binary) {
+        conn->send(json, WebSocketMessageType::Text);
+        return;
+    }
+    std::string cbor;
+    if (CborTranscoder::fromJson(json, cbor)) {
+        conn->send(cbor, WebSocketMessageType::Binary);
+    }
+}
+
+void sendError(const WebSocketConnectionPtr& conn, const std::string& error, bool binary) {
+    Json::Value event;
+    event["type"] = "error";
+    event["error"] = error;
+    sendEvent(conn, event, binary);
+}
+
+bool parseFrame(const std::string& message, bool binary, Json::Value& frame) {
+    if (binary) {
+        return CborTranscoder::toJsonValue(message, frame);
+    }
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string errors;
+    return reader->parse(message.data(), message.data() + message.size(), &frame, &errors);
+}
+
+const Json::Value& field(const Json::Value& frame, const char* shortName, const char* longName) {
+    return frame.isMember(shortName) ? frame[shortName] : frame[longName];
+}
+
+bool tokenExpired(const Session& session) {
+    return std::chrono::system_clock::now() >= session.identity.expiresAt;
+}
+
+void closeExpired(const WebSocketConnectionPtr& conn, bool binary) {
+    sendError(conn, "Token expired", binary);
+    conn->shutdown(CloseCode::kViolation, "Token expired");
+}
+
+void notifyCompleted(const WebSocketConnectionPtr& conn, const std::string& videoId, bool binary) {
+    app().getDbClient()->execSqlAsync(
+        kNextLessonSql,
+        [conn, videoId, binary](const Result& result) {
+            Json::Value event;
+            event["type"] = "completed";
+            event["video_id"] = videoId;
+            event["next"] = Json::nullValue;
+            if (!result.empty()) {
+                const auto& row = result[0];
+                Json::Value next;
+                next["id"] = row["id"].as<std::string>();
+                next["course_id"] = row["course_id"].as<std::string>();
+                next["title"] = row["title"].as<std::string>();
+                next["chapter_id"] = row["chapter_id"].isNull() ? Json::Value() : Json::Value(row["chapter_id"].as<std::string>());
+                event["next"] = next;
+            }
+            sendEvent(conn, event, binary);
+        },
+        [conn, videoId, binary](const DrogonDbException& e) {
+            LOG_ERROR << "Database error finding next lesson: " << e.base().what();
+            Json::Value event;
+            event["type"] = "completed";
+            event["video_id"] = videoId;
+            event["next"] = Json::nullValue;
+            sendEvent(conn, event, binary);
+        },
+        videoId);
+}
+
+} // namespace
+
+void ProgressWebSocket::handleNewConnection(const HttpRequestPtr& req,
+                                            const WebSocketConnectionPtr& conn) {
+    std::string authHeader = req->getHeader("Authorization");
+    if (authHeader.empty() && !req->getParameter("token").empty()) {
+        authHeader = "Bearer " + req->getParameter("token");
+    }
+
+    auto session = std::make_shared<Session>();
+    if (!AuthContext::verifyBearer(authHeader, session->identity)) {
+        sendError(conn, "Unauthorized", false);
+        conn->shutdown(CloseCode::kViolation, "Unauthorized");
+        return;
+    }
+    conn->setContext(session);
+
+    // Токен проверяется один раз - соединение закрывается, когда его срок выходит;
+    // клиент переподключается с обновлённым токеном
+    if (session->identity.expiresAt != std::chrono::system_clock::time_point::max()) {
+        double ttl = std::chrono::duration<double>(session->identity.expiresAt - std::chrono::system_clock::now()).count();
+        std::weak_ptr<WebSocketConnection> weakConn = conn;
+        app().getLoop()->runAfter(std::max(0.0, ttl), [weakConn]() {
+            auto conn = weakConn.lock();
+            if (!conn || !conn->connected()) {
+                return;
+            }
+            auto session = conn->getContext<Session>();
+            closeExpired(conn, session && session->binary);
+        });
+    }
+
+    // Не даём NAT и прокси закрыть соединение на паузе видео
+    double pingInterval = app().getCustomConfig()["progress"].get("socket_ping_interval_seconds", 30.0).asDouble();
+    if (pingInterval > 0) {
+        conn->setPingMessage("", std::chrono::duration<double>(pingInterval));
+    }
+}
+
+void ProgressWebSocket::handleNewMessage(const WebSocketConnectionPtr& conn,
+                                         std::string&& message,
+                                         const WebSocketMessageType& type) {
+    if (type != WebSocketMessageType::Text && type != WebSocketMessageType::Binary) {
+        return;
+    }
+    auto session = conn->getContext<Session>();
+    if (!session) {
+        return;
+    }
+    session->binary = type == WebSocketMessageType::Binary;
+    if (tokenExpired(*session)) {
+        closeExpired(conn, session->binary);
+        return;
+    }
+
+    // Плееру хватает кадра раз в несколько секунд, лишние отбрасываются
+    auto now = std::chrono::steady_clock::now();
+    if (now - session->windowStart >= std::chrono::seconds(1)) {
+        session->windowStart = now;
+        session->framesInWindow = 0;
+    }
+    if (++session->framesInWindow > maxFramesPerSecond()) {
+        return;
+    }
+
+    Json::Value frame;
+    if (!parseFrame(message, session->binary, frame) || !frame.isObject()) {
+        sendError(conn, "Invalid frame", session->binary);
+        return;
+    }
+
+    const auto& videoValue = field(frame, "v", "video_id");
+    const auto& positionValue = field(frame, "p", "position");
+    const auto& completedValue = field(frame, "c", "completed");
+    if (!videoValue.isString() || !positionValue.isNumeric() || !std::isfinite(positionValue.asDouble()) ||
+        (!completedValue.isNull() && !completedValue.isBool())) {
+        sendError(conn, "Invalid frame", session->binary);
+        return;
+    }
+
+    std::string videoId = videoValue.asString();
+    if (videoId.empty() || videoId.size() > 64) {
+        sendError(conn, "Invalid video_id", session->binary);
+        return;
+    }
+    // Дальше позиция ограничивается длительностью видео при записи в БД
+    int position = static_cast<int>(
+        std::clamp(positionValue.asDouble(), 0.0, static_cast<double>(ProgressBuffer::kMaxWatchedSeconds)));
+    bool completed = completedValue.isBool() && completedValue.asBool();
+
+    ProgressBuffer::instance().record(session->identity.userId, videoId, position, completed);
+
+    if (completed && session->completedVideos.insert(videoId).second) {
+        notifyCompleted(conn, videoId, session->binary);
+    }
+}
+
+void ProgressWebSocket::handleConnectionClosed(const WebSocketConnectionPtr& conn) {
+    // Прогресс уже в ProgressBuffer и будет записан со следующим сбросом
+    conn->clearContext();
+}
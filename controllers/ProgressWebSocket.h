@@ -0,0 +1,27 @@
+#pragma once
+
+#include <drogon/WebSocketController.h>
+
+using namespace drogon;
+
+// Прогресс просмотра по одному долгоживущему WebSocket вместо HTTP-запроса
+// каждые несколько секунд. JWT проверяется один раз при подключении
+// (заголовок Authorization или параметр ?token=, если клиент не умеет заголовки).
+// Кадр: {"v":"<video_id>","p":<секунды>,"c":true|false} текстом (JSON) или
+// двоично (CBOR); полные имена video_id/position/completed тоже принимаются.
+// Кадры идут в ProgressBuffer, в ответ на завершение урока приходит
+// {"type":"completed","video_id":...,"next":{...}|null}.
+class ProgressWebSocket : public drogon::WebSocketController<ProgressWebSocket>
+{
+public:
+    WS_PATH_LIST_BEGIN
+    WS_PATH_ADD("/ws/progress");
+    WS_PATH_LIST_END
+
+    void handleNewConnection(const HttpRequestPtr& req,
+                             const WebSocketConnectionPtr& conn) override;
+    void handleNewMessage(const WebSocketConnectionPtr& conn,
+                          std::string&& message,
+                          const WebSocketMessageType& type) override;
+    void handleConnectionClosed(const WebSocketConnectionPtr& conn) override;
+};
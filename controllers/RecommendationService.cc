@@ -0,0 +1,390 @@
+#include "RecommendationService.h"
+#include <drogon/drogon.h>
+#include <drogon/orm/DbClient.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+// Пары пользователь-курс: запись на курс или начатый прогресс.
+// Только опубликованные публичные курсы могут попасть в выдачу
+const char* const kPairsSql = R"(
+    SELECT s.user_id, s.course_id
+    FROM (
+        SELECT user_id, course_id FROM course_enrollments
+        UNION
+        SELECT user_id, course_id FROM user_progress WHERE course_id IS NOT NULL
+    ) s
+    JOIN courses c ON c.id = s.course_id
+    WHERE c.is_published = true AND c.is_public = true
+    ORDER BY s.user_id
+)";
+
+constexpr size_t kPopularCount = 200;
+
+} // namespace
+
+RecommendationService::RecommendationService()
+    : queue_(1, "recommendations") {
+}
+
+void RecommendationService::start() {
+    const auto& config = app().getCustomConfig()["recommendations"];
+    neighboursPerCourse_ = std::max(1u, config.get("neighbours_per_course", 50).asUInt());
+    minCoEnrollments_ = std::max(1u, config.get("min_co_enrollments", 2).asUInt());
+    maxUserHistory_ = std::max(1u, config.get("max_user_history", 200).asUInt());
+    publishIntervalSeconds_ = std::max(0.5, config.get("publish_interval_seconds", 2.0).asDouble());
+    rebuildIntervalSeconds_ = config.get("rebuild_interval_seconds", 3600.0).asDouble();
+
+    // Первая сборка после запуска цикла: до этого нет клиента БД
+    app().getLoop()->queueInLoop([this]() {
+        rebuilding_ = true;
+        queue_.runTaskInQueue([this]() {
+            rebuild();
+        });
+    });
+
+    app().getLoop()->runEvery(publishIntervalSeconds_, [this]() {
+        queue_.runTaskInQueue([this]() {
+            applyEvents();
+            if (!dirty_.empty()) {
+                publish(false);
+            }
+        });
+    });
+
+    // Полная пересборка уточняет веса курсов, которые инкрементально не пересчитывались
+    if (rebuildIntervalSeconds_ > 0) {
+        app().getLoop()->runEvery(rebuildIntervalSeconds_, [this]() {
+            if (rebuilding_.exchange(true)) {
+                return;
+            }
+            queue_.runTaskInQueue([this]() {
+                rebuild();
+            });
+        });
+    }
+}
+
+bool RecommendationService::ready() const {
+    return std::atomic_load(&snapshot_) != nullptr;
+}
+
+RecommendationService::HistoryShard& RecommendationService::historyShard(const std::string& userId) const {
+    return history_[std::hash<std::string>{}(userId) % kHistoryShards];
+}
+
+void RecommendationService::setHistory(const std::string& userId, const std::string& courseId, bool enrolled) {
+    auto& shard = historyShard(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto& courses = shard.courses[userId];
+    auto it = std::find(courses.begin(), courses.end(), courseId);
+    if (enrolled && it == courses.end()) {
+        courses.push_back(courseId);
+    } else if (!enrolled && it != courses.end()) {
+        courses.erase(it);
+    }
+}
+
+void RecommendationService::recordEnrollment(const std::string& userId, const std::string& courseId) {
+    // Сразу исключаем курс из выдачи и учитываем его как источник соседей
+    setHistory(userId, courseId, true);
+    std::lock_guard<std::mutex> lock(eventsMutex_);
+    events_.push_back({userId, courseId, true});
+}
+
+void RecommendationService::recordUnenrollment(const std::string& userId, const std::string& courseId) {
+    setHistory(userId, courseId, false);
+    std::lock_guard<std::mutex> lock(eventsMutex_);
+    events_.push_back({userId, courseId, false});
+}
+
+void RecommendationService::rebuild() {
+    Result pairs(nullptr);
+    try {
+        pairs = app().getDbClient()->execSqlSync(kPairsSql);
+    } catch (const DrogonDbException& e) {
+        LOG_ERROR << "Failed to load enrollments for recommendations: " << e.base().what();
+        rebuilding_ = false;
+        return;
+    }
+
+    std::vector<std::string> courseIds;
+    std::unordered_map<std::string, uint32_t> courseIndex;
+    std::unordered_map<std::string, std::vector<uint32_t>> userCourses;
+    std::array<std::unordered_map<std::string, std::vector<std::string>>, kHistoryShards> history;
+
+    for (const auto& row : pairs) {
+        auto userId = row["user_id"].as<std::string>();
+        auto courseId = row["course_id"].as<std::string>();
+
+        auto [it, inserted] = courseIndex.emplace(courseId, static_cast<uint32_t>(courseIds.size()));
+        if (inserted) {
+            courseIds.push_back(courseId);
+        }
+        auto& courses = userCourses[userId];
+        if (courses.size() < maxUserHistory_) {
+            courses.push_back(it->second);
+        }
+        history[std::hash<std::string>{}(userId) % kHistoryShards][userId].push_back(std::move(courseId));
+    }
+
+    // Пары (i, j) каждого пользователя; история ограничена, так что O(k^2) на пользователя
+    std::vector<uint32_t> courseUsers(courseIds.size(), 0);
+    std::vector<std::unordered_map<uint32_t, uint32_t>> coCounts(courseIds.size());
+    for (const auto& [userId, courses] : userCourses) {
+        for (size_t a = 0; a < courses.size(); ++a) {
+            ++courseUsers[courses[a]];
+            for (size_t b = a + 1; b < courses.size(); ++b) {
+                ++coCounts[courses[a]][courses[b]];
+                ++coCounts[courses[b]][courses[a]];
+            }
+        }
+    }
+
+    courseIds_ = std::move(courseIds);
+    courseIndex_ = std::move(courseIndex);
+    courseUsers_ = std::move(courseUsers);
+    coCounts_ = std::move(coCounts);
+    userCourses_ = std::move(userCourses);
+    dirty_.clear();
+
+    for (size_t i = 0; i < kHistoryShards; ++i) {
+        std::lock_guard<std::mutex> lock(history_[i].mutex);
+        history_[i].courses = std::move(history[i]);
+    }
+    // События, пришедшие во время выборки, применяются повторно: они идемпотентны,
+    // а история выдачи после подмены шардов снова их учитывает
+    applyEvents();
+    publish(true);
+
+    LOG_INFO << "Recommendations rebuilt: " << courseIds_.size() << " courses, "
+             << userCourses_.size() << " users";
+    rebuilding_ = false;
+}
+
+void RecommendationService::applyEvents() {
+    std::vector<Event> events;
+    {
+        std::lock_guard<std::mutex> lock(eventsMutex_);
+        events.swap(events_);
+    }
+    for (const auto& event : events) {
+        applyEvent(event);
+        setHistory(event.userId, event.courseId, event.enrolled);
+    }
+}
+
+void RecommendationService::applyEvent(const Event& event) {
+    // Курс, которого не было при сборке, появится в матрице после следующей пересборки
+    auto indexIt = courseIndex_.find(event.courseId);
+    if (indexIt == courseIndex_.end()) {
+        return;
+    }
+    uint32_t course = indexIt->second;
+    auto& courses = userCourses_[event.userId];
+    auto it = std::find(courses.begin(), courses.end(), course);
+
+    if (event.enrolled) {
+        if (it != courses.end() || courses.size() >= maxUserHistory_) {
+            return;
+        }
+        for (uint32_t other : courses) {
+            ++coCounts_[course][other];
+            ++coCounts_[other][course];
+            dirty_.insert(other);
+        }
+        ++courseUsers_[course];
+        dirty_.insert(course);
+        courses.push_back(course);
+        return;
+    }
+
+    if (it == courses.end()) {
+        return;
+    }
+    courses.erase(it);
+    for (uint32_t other : courses) {
+        if (--coCounts_[course][other] == 0) {
+            coCounts_[course].erase(other);
+        }
+        if (--coCounts_[other][course] == 0) {
+            coCounts_[other].erase(course);
+        }
+        dirty_.insert(other);
+    }
+    --courseUsers_[course];
+    dirty_.insert(course);
+}
+
+std::shared_ptr<const RecommendationService::Neighbours>
+RecommendationService::computeNeighbours(uint32_t course) const {
+    const auto& row = coCounts_[course];
+
+    std::vector<uint32_t> candidates;
+    std::vector<float> co;
+    std::vector<float> otherUsers;
+    candidates.reserve(row.size());
+    co.reserve(row.size());
+    otherUsers.reserve(row.size());
+    for (const auto& [other, count] : row) {
+        if (count >= minCoEnrollments_) {
+            candidates.push_back(other);
+            co.push_back(static_cast<float>(count));
+            otherUsers.push_back(static_cast<float>(courseUsers_[other]));
+        }
+    }
+
+    // Косинус по бинарным векторам пользователей: co(i, j) / sqrt(n_i * n_j).
+    // Плоские массивы без ветвлений - цикл векторизуется компилятором
+    const size_t count = candidates.size();
+    std::vector<float> weights(count);
+    const float selfUsers = static_cast<float>(std::max<uint32_t>(courseUsers_[course], 1));
+    const float* coData = co.data();
+    const float* usersData = otherUsers.data();
+    float* weightsData = weights.data();
+    for (size_t k = 0; k < count; ++k) {
+        weightsData[k] = coData[k] / std::sqrt(selfUsers * std::max(usersData[k], 1.0f));
+    }
+
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0u);
+    size_t keep = std::min(neighboursPerCourse_, count);
+    std::partial_sort(order.begin(), order.begin() + keep, order.end(), [&](uint32_t a, uint32_t b) {
+        return weights[a] > weights[b];
+    });
+
+    auto result = std::make_shared<Neighbours>();
+    result->courses.reserve(keep);
+    result->weights.reserve(keep);
+    for (size_t k = 0; k < keep; ++k) {
+        result->courses.push_back(candidates[order[k]]);
+        result->weights.push_back(weights[order[k]]);
+    }
+    return result;
+}
+
+void RecommendationService::publish(bool full) {
+    auto current = std::atomic_load(&snapshot_);
+    auto next = std::make_shared<Snapshot>();
+
+    if (full || !current) {
+        next->catalog = std::make_shared<Catalog>(Catalog{courseIds_, courseIndex_});
+        next->neighbours.resize(courseIds_.size());
+        for (uint32_t course = 0; course < courseIds_.size(); ++course) {
+            next->neighbours[course] = computeNeighbours(course);
+        }
+    } else {
+        // Неизменённые списки соседей общие со старым снимком
+        next->catalog = current->catalog;
+        next->neighbours = current->neighbours;
+        for (uint32_t course : dirty_) {
+            next->neighbours[course] = computeNeighbours(course);
+        }
+    }
+    dirty_.clear();
+
+    std::vector<uint32_t> popular(courseIds_.size());
+    std::iota(popular.begin(), popular.end(), 0u);
+    size_t keep = std::min(kPopularCount, popular.size());
+    std::partial_sort(popular.begin(), popular.begin() + keep, popular.end(), [this](uint32_t a, uint32_t b) {
+        return courseUsers_[a] > courseUsers_[b];
+    });
+    popular.resize(keep);
+    next->popular = std::move(popular);
+
+    std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(std::move(next)));
+}
+
+std::vector<RecommendationService::Scored>
+RecommendationService::recommend(const std::string& userId, size_t limit) const {
+    std::vector<Scored> result;
+    auto snapshot = std::atomic_load(&snapshot_);
+    if (!snapshot || limit == 0) {
+        return result;
+    }
+    const auto& catalog = *snapshot->catalog;
+
+    std::vector<std::string> history;
+    if (!userId.empty()) {
+        auto& shard = historyShard(userId);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.courses.find(userId);
+        if (it != shard.courses.end()) {
+            history = it->second;
+        }
+    }
+
+    std::vector<uint32_t> seeds;
+    seeds.reserve(history.size());
+    for (const auto& courseId : history) {
+        auto it = catalog.courseIndex.find(courseId);
+        if (it != catalog.courseIndex.end()) {
+            seeds.push_back(it->second);
+        }
+    }
+
+    // Плотный буфер оценок на поток, обнуляются только затронутые ячейки
+    thread_local std::vector<float> scores;
+    thread_local std::vector<uint32_t> touched;
+    if (scores.size() < catalog.courseIds.size()) {
+        scores.assign(catalog.courseIds.size(), 0.0f);
+    }
+
+    for (uint32_t seed : seeds) {
+        const auto& neighbours = *snapshot->neighbours[seed];
+        const uint32_t* courses = neighbours.courses.data();
+        const float* weights = neighbours.weights.data();
+        const size_t count = neighbours.courses.size();
+        for (size_t k = 0; k < count; ++k) {
+            float& score = scores[courses[k]];
+            if (score == 0.0f) {
+                touched.push_back(courses[k]);
+            }
+            score += weights[k];
+        }
+    }
+    // Курсы пользователя не рекомендуются
+    for (uint32_t seed : seeds) {
+        scores[seed] = 0.0f;
+    }
+
+    std::vector<uint32_t> candidates;
+    candidates.reserve(touched.size());
+    for (uint32_t course : touched) {
+        if (scores[course] > 0.0f) {
+            candidates.push_back(course);
+        }
+    }
+    size_t keep = std::min(limit, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end(), [](uint32_t a, uint32_t b) {
+        return scores[a] > scores[b];
+    });
+
+    result.reserve(limit);
+    for (size_t k = 0; k < keep; ++k) {
+        result.push_back({catalog.courseIds[candidates[k]], scores[candidates[k]]});
+    }
+    for (uint32_t course : touched) {
+        scores[course] = 0.0f;
+    }
+    touched.clear();
+
+    // Добор популярными: новый пользователь или мало пересечений
+    for (uint32_t course : snapshot->popular) {
+        if (result.size() >= limit) {
+            break;
+        }
+        const auto& courseId = catalog.courseIds[course];
+        bool taken = std::find(seeds.begin(), seeds.end(), course) != seeds.end() ||
+                     std::any_of(result.begin(), result.end(), [&](const Scored& s) { return s.courseId == courseId; });
+        if (!taken) {
+            result.push_back({courseId, 0.0f});
+        }
+    }
+    return result;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Рекомендации курсов по совместным записям (item-item).
+// Из course_enrollments и user_progress строится разреженная матрица
+// совместной встречаемости, для каждого курса хранится top-N соседей
+// по косинусной близости. Выдача для пользователя - сумма весов соседей
+// его курсов, считается в памяти по неизменяемому снимку.
+// Полная пересборка и применение новых записей идут в отдельном потоке,
+// готовый снимок подменяется атомарно.
+class RecommendationService {
+public:
+    static RecommendationService& instance() {
+        static RecommendationService instance;
+        return instance;
+    }
+
+    // Первая сборка и таймеры (вызывается из main до app().run())
+    void start();
+
+    // Новая запись или отписка: история пользователя меняется сразу,
+    // соседи затронутых курсов пересчитываются при следующей публикации
+    void recordEnrollment(const std::string& userId, const std::string& courseId);
+    void recordUnenrollment(const std::string& userId, const std::string& courseId);
+
+    struct Scored {
+        std::string courseId;
+        float score;
+    };
+
+    // До limit курсов, на которые пользователь ещё не записан.
+    // Без истории (или если соседей не хватило) добор идёт популярными курсами
+    std::vector<Scored> recommend(const std::string& userId, size_t limit) const;
+
+    // Готов ли хотя бы один снимок
+    bool ready() const;
+
+private:
+    RecommendationService();
+
+    // Соседи курса: индексы и веса отдельными массивами
+    struct Neighbours {
+        std::vector<uint32_t> courses;
+        std::vector<float> weights;
+    };
+
+    // Меняется только при полной пересборке
+    struct Catalog {
+        std::vector<std::string> courseIds;
+        std::unordered_map<std::string, uint32_t> courseIndex;
+    };
+
+    struct Snapshot {
+        std::shared_ptr<const Catalog> catalog;
+        std::vector<std::shared_ptr<const Neighbours>> neighbours;
+        std::vector<uint32_t> popular;  // по числу записей, по убыванию
+    };
+
+    // История для выдачи, читается из IO-потоков
+    struct alignas(64) HistoryShard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::vector<std::string>> courses;
+    };
+
+    static constexpr size_t kHistoryShards = 32;
+
+    // Всё ниже до snapshot_ принадлежит потоку queue_
+    struct Event {
+        std::string userId;
+        std::string courseId;
+        bool enrolled;
+    };
+
+    void rebuild();
+    void applyEvents();
+    void applyEvent(const Event& event);
+    void publish(bool full);
+    std::shared_ptr<const Neighbours> computeNeighbours(uint32_t course) const;
+
+    HistoryShard& historyShard(const std::string& userId) const;
+    void setHistory(const std::string& userId, const std::string& courseId, bool enrolled);
+
+    trantor::ConcurrentTaskQueue queue_;
+
+    std::mutex eventsMutex_;
+    std::vector<Event> events_;
+
+    std::vector<std::string> courseIds_;
+    std::unordered_map<std::string, uint32_t> courseIndex_;
+    std::vector<uint32_t> courseUsers_;                               // n_i
+    std::vector<std::unordered_map<uint32_t, uint32_t>> coCounts_;   // co(i, j)
+    std::unordered_map<std::string, std::vector<uint32_t>> userCourses_;
+    std::unordered_set<uint32_t> dirty_;
+
+    std::shared_ptr<const Snapshot> snapshot_;  // std::atomic_load / atomic_store
+    mutable std::array<HistoryShard, kHistoryShards> history_;
+
+    std::atomic<bool> rebuilding_{false};
+    size_t neighboursPerCourse_ = 50;
+    uint32_t minCoEnrollments_ = 2;
+    size_t maxUserHistory_ = 200;
+    double publishIntervalSeconds_ = 2.0;
+    double rebuildIntervalSeconds_ = 3600.0;
+};
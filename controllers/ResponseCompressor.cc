@@ -0,0 +1,372 @@
+#include "ResponseCompressor.h"
+#include <zlib.h>
+#ifdef HAS_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+using namespace drogon;
+
+namespace {
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+               return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+           });
+}
+
+// q из параметров элемента Accept-Encoding; без q - 1
+double qualityOf(std::string_view params) {
+    while (!params.empty()) {
+        size_t semicolon = params.find(';');
+        std::string_view param = trim(params.substr(0, semicolon));
+        if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+            return std::strtod(std::string(param.substr(2)).c_str(), nullptr);
+        }
+        if (semicolon == std::string_view::npos) {
+            break;
+        }
+        params.remove_prefix(semicolon + 1);
+    }
+    return 1.0;
+}
+
+std::string gzipCompress(std::string_view body, int level) {
+    z_stream stream{};
+    // 15 + 16: окно 32К с заголовком gzip
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return {};
+    }
+
+    std::string out;
+    out.resize(deflateBound(&stream, body.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body.data()));
+    stream.avail_in = static_cast<uInt>(body.size());
+    stream.next_out = reinterpret_cast<Bytef*>(out.data());
+    stream.avail_out = static_cast<uInt>(out.size());
+
+    int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END ? out : std::string();
+}
+
+#ifdef HAS_BROTLI
+std::string brotliCompress(std::string_view body, int level) {
+    size_t size = BrotliEncoderMaxCompressedSize(body.size());
+    if (size == 0) {
+        return {};
+    }
+    std::string out;
+    out.resize(size);
+    // MODE_TEXT: у нас JSON и текст
+    if (!BrotliEncoderCompress(level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                               body.size(), reinterpret_cast<const uint8_t*>(body.data()),
+                               &size, reinterpret_cast<uint8_t*>(out.data()))) {
+        return {};
+    }
+    out.resize(size);
+    return out;
+}
+#endif
+
+#ifdef HAS_ZSTD
+std::string zstdCompress(std::string_view body, int level) {
+    std::string out;
+    out.resize(ZSTD_compressBound(body.size()));
+    size_t size = ZSTD_compress(out.data(), out.size(), body.data(), body.size(), level);
+    if (ZSTD_isError(size)) {
+        return {};
+    }
+    out.resize(size);
+    return out;
+}
+#endif
+
+} // namespace
+
+ResponseCompressor::ResponseCompressor() {
+    const auto& config = app().getCustomConfig()["compression"];
+
+    defaultPolicy_.enabled = config.get("enabled", true).asBool();
+    defaultPolicy_.minSize = config.get("min_size", 1024).asUInt();
+    defaultPolicy_.gzipLevel = std::clamp(config.get("gzip_level", 6).asInt(), 1, 9);
+    defaultPolicy_.brotliLevel = std::clamp(config.get("br_level", 5).asInt(), 0, 11);
+    defaultPolicy_.zstdLevel = std::clamp(config.get("zstd_level", 3).asInt(), 1, 19);
+    cacheMaxBytes_ = config.get("cache_max_bytes", 64 * 1024 * 1024).asUInt64();
+
+    for (const auto& route : config["routes"]) {
+        RoutePolicy policy = defaultPolicy_;
+        policy.prefix = route.get("prefix", "").asString();
+        policy.enabled = route.get("enabled", defaultPolicy_.enabled).asBool();
+        policy.minSize = route.get("min_size", static_cast<Json::UInt>(defaultPolicy_.minSize)).asUInt();
+        policy.gzipLevel = std::clamp(route.get("gzip_level", defaultPolicy_.gzipLevel).asInt(), 1, 9);
+        policy.brotliLevel = std::clamp(route.get("br_level", defaultPolicy_.brotliLevel).asInt(), 0, 11);
+        policy.zstdLevel = std::clamp(route.get("zstd_level", defaultPolicy_.zstdLevel).asInt(), 1, 19);
+        policy.cache = route.get("cache", true).asBool();
+        if (!policy.prefix.empty()) {
+            routes_.push_back(std::move(policy));
+        }
+    }
+    // Длинные префиксы проверяются первыми
+    std::sort(routes_.begin(), routes_.end(), [](const RoutePolicy& a, const RoutePolicy& b) {
+        return a.prefix.size() > b.prefix.size();
+    });
+
+    Json::Value encodings = config.get("encodings", Json::Value(Json::arrayValue));
+    if (encodings.empty()) {
+        encodings.append("zstd");
+        encodings.append("br");
+        encodings.append("gzip");
+    }
+    for (const auto& name : encodings) {
+        std::string value = name.asString();
+        if (value == "gzip") {
+            preference_.push_back(Encoding::Gzip);
+        }
+#ifdef HAS_BROTLI
+        if (value == "br") {
+            preference_.push_back(Encoding::Brotli);
+        }
+#endif
+#ifdef HAS_ZSTD
+        if (value == "zstd") {
+            preference_.push_back(Encoding::Zstd);
+        }
+#endif
+    }
+}
+
+void ResponseCompressor::start() {
+    app().registerPostHandlingAdvice([this](const HttpRequestPtr& req, const HttpResponsePtr& resp) {
+        process(req, resp);
+    });
+    LOG_INFO << "Response compression enabled, encodings available: " << preference_.size();
+}
+
+const char* ResponseCompressor::encodingName(Encoding encoding) {
+    switch (encoding) {
+    case Encoding::Gzip:
+        return "gzip";
+    case Encoding::Brotli:
+        return "br";
+    case Encoding::Zstd:
+        return "zstd";
+    default:
+        return "identity";
+    }
+}
+
+ResponseCompressor::Encoding ResponseCompressor::negotiate(std::string_view acceptEncoding) const {
+    // q для каждой кодировки из списка предпочтения; -1 - клиент её не назвал
+    std::vector<double> quality(preference_.size(), -1.0);
+    double wildcard = -1.0;
+
+    size_t pos = 0;
+    while (pos < acceptEncoding.size()) {
+        size_t end = acceptEncoding.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = acceptEncoding.size();
+        }
+        std::string_view item = trim(acceptEncoding.substr(pos, end - pos));
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semicolon = item.find(';');
+        std::string_view coding = trim(item.substr(0, semicolon));
+        if (semicolon != std::string_view::npos) {
+            q = qualityOf(item.substr(semicolon + 1));
+        }
+
+        if (coding == "*") {
+            wildcard = q;
+            continue;
+        }
+        for (size_t i = 0; i < preference_.size(); ++i) {
+            if (equalsIgnoreCase(coding, encodingName(preference_[i]))) {
+                quality[i] = q;
+            }
+        }
+    }
+
+    Encoding best = Encoding::Identity;
+    double bestQuality = 0.0;
+    for (size_t i = 0; i < preference_.size(); ++i) {
+        double q = quality[i] >= 0.0 ? quality[i] : wildcard;
+        // При равных q побеждает кодировка, что раньше в списке сервера
+        if (q > bestQuality) {
+            best = preference_[i];
+            bestQuality = q;
+        }
+    }
+    return best;
+}
+
+std::string ResponseCompressor::compress(std::string_view body, Encoding encoding, int level) {
+    switch (encoding) {
+    case Encoding::Gzip:
+        return gzipCompress(body, level);
+#ifdef HAS_BROTLI
+    case Encoding::Brotli:
+        return brotliCompress(body, level);
+#endif
+#ifdef HAS_ZSTD
+    case Encoding::Zstd:
+        return zstdCompress(body, level);
+#endif
+    default:
+        return {};
+    }
+}
+
+const ResponseCompressor::RoutePolicy& ResponseCompressor::policyFor(const std::string& path) const {
+    for (const auto& route : routes_) {
+        if (path.compare(0, route.prefix.size(), route.prefix) == 0) {
+            return route;
+        }
+    }
+    return defaultPolicy_;
+}
+
+bool ResponseCompressor::isCompressible(const HttpResponsePtr& resp) {
+    switch (resp->contentType()) {
+    case CT_APPLICATION_JSON:
+    case CT_TEXT_PLAIN:
+    case CT_TEXT_HTML:
+    case CT_TEXT_CSS:
+    case CT_TEXT_XML:
+    case CT_APPLICATION_XML:
+    case CT_APPLICATION_X_JAVASCRIPT:
+    case CT_IMAGE_SVG_XML:
+        return true;
+    default:
+        // WebVTT и прочие text/* без собственного кода типа, CBOR из ResponseFormat
+        return resp->contentTypeString().compare(0, 5, "text/") == 0 ||
+               resp->contentTypeString().compare(0, 16, "application/cbor") == 0;
+    }
+}
+
+int ResponseCompressor::levelFor(const RoutePolicy& policy, Encoding encoding) {
+    switch (encoding) {
+    case Encoding::Brotli:
+        return policy.brotliLevel;
+    case Encoding::Zstd:
+        return policy.zstdLevel;
+    default:
+        return policy.gzipLevel;
+    }
+}
+
+void ResponseCompressor::process(const HttpRequestPtr& req, const HttpResponsePtr& resp) {
+    if (preference_.empty() || !resp->getHeader("Content-Encoding").empty()) {
+        return;
+    }
+
+    const auto& policy = policyFor(req->path());
+    auto body = resp->body();
+    if (!policy.enabled || body.size() < policy.minSize || !isCompressible(resp)) {
+        return;
+    }
+
+    const auto& vary = resp->getHeader("Vary");
+    resp->addHeader("Vary", vary.empty() ? std::string("Accept-Encoding") : vary + ", Accept-Encoding");
+    Encoding encoding = negotiate(req->getHeader("Accept-Encoding"));
+    if (encoding == Encoding::Identity) {
+        return;
+    }
+
+    // Кешируем только представления с валидатором (повторяемые GET), но ключ -
+    // md5 несжатого тела: тег версии не различает, например, fields= и формат
+    // одного ресурса. Тег md5-* из registerDigestFallback уже и есть md5 тела
+    const auto& etag = resp->getHeader("ETag");
+    bool cacheable = policy.cache && cacheMaxBytes_ > 0 && !etag.empty() && req->method() == Get;
+
+    std::string cacheKey;
+    std::string compressed;
+    bool hit = false;
+    if (cacheable) {
+        cacheKey.reserve(64);
+        cacheKey += encodingName(encoding);
+        cacheKey += '|';
+        if (etag.compare(0, 5, "\"md5-") == 0) {
+            cacheKey += etag;
+        } else {
+            cacheKey += utils::getMd5(body.data(), body.size());
+        }
+        hit = cacheGet(cacheKey, compressed);
+    }
+
+    if (!hit) {
+        compressed = compress(body, encoding, levelFor(policy, encoding));
+        if (compressed.empty()) {
+            return;
+        }
+        if (cacheable) {
+            cachePut(cacheKey, compressed);
+        }
+    }
+
+    // Несжимаемые данные отдаём как есть
+    if (compressed.size() >= body.size()) {
+        return;
+    }
+
+    resp->setBody(std::move(compressed));
+    resp->addHeader("Content-Encoding", encodingName(encoding));
+    // Сжатое тело - другое представление, ETag становится слабым (как в nginx);
+    // HttpCache сравнивает If-None-Match без учёта W/, так что 304 продолжают работать,
+    // а If-Match принимает W/ для своих тегов с версией (412 только при чужой версии)
+    if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        resp->addHeader("ETag", "W/" + etag);
+    }
+}
+
+bool ResponseCompressor::cacheGet(const std::string& key, std::string& body) {
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    body = it->second->second;
+    return true;
+}
+
+void ResponseCompressor::cachePut(const std::string& key, const std::string& body) {
+    size_t entryBytes = key.size() + body.size();
+    if (entryBytes > cacheMaxBytes_ / 8) {
+        // Одно тело не должно вытеснять весь кеш
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(cacheMutex_);
+    if (index_.count(key)) {
+        return;
+    }
+    lru_.emplace_front(key, body);
+    index_[key] = lru_.begin();
+    cacheBytes_ += entryBytes;
+
+    while (cacheBytes_ > cacheMaxBytes_ && !lru_.empty()) {
+        auto& last = lru_.back();
+        cacheBytes_ -= last.first.size() + last.second.size();
+        index_.erase(last.first);
+        lru_.pop_back();
+    }
+}
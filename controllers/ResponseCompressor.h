@@ -0,0 +1,77 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Сжатие динамических ответов по Accept-Encoding: zstd, br, gzip.
+// Встроенное сжатие drogon (use_gzip/use_brotli) выключено в config.json,
+// вместо него post-handling advice из start().
+// Ответы с ETag сжимаются один раз на кодировку и хранятся в LRU-кеше
+// (ключ - md5 несжатого тела + кодировка, ограничение по суммарному размеру).
+// brotli и zstd доступны, если найдены при сборке (HAS_BROTLI, HAS_ZSTD).
+class ResponseCompressor {
+public:
+    static ResponseCompressor& instance() {
+        static ResponseCompressor instance;
+        return instance;
+    }
+
+    enum class Encoding {
+        Identity,
+        Gzip,
+        Brotli,
+        Zstd
+    };
+
+    // Регистрирует advice. Вызывать после HttpCache::registerDigestFallback,
+    // чтобы ETag считался по несжатому телу
+    void start();
+
+    // Выбор кодировки по Accept-Encoding с учётом q и порядка предпочтения сервера
+    Encoding negotiate(std::string_view acceptEncoding) const;
+
+    static const char* encodingName(Encoding encoding);
+
+    // Пустая строка при ошибке или если кодировка не собрана
+    static std::string compress(std::string_view body, Encoding encoding, int level);
+
+private:
+    ResponseCompressor();
+
+    // Политика для префикса пути; самый длинный подходящий префикс выигрывает
+    struct RoutePolicy {
+        std::string prefix;
+        size_t minSize = 1024;
+        int gzipLevel = 6;
+        int brotliLevel = 5;
+        int zstdLevel = 3;
+        bool cache = true;
+        bool enabled = true;
+    };
+
+    const RoutePolicy& policyFor(const std::string& path) const;
+    static bool isCompressible(const drogon::HttpResponsePtr& resp);
+    static int levelFor(const RoutePolicy& policy, Encoding encoding);
+
+    void process(const drogon::HttpRequestPtr& req, const drogon::HttpResponsePtr& resp);
+
+    // LRU кеш сжатых тел
+    bool cacheGet(const std::string& key, std::string& body);
+    void cachePut(const std::string& key, const std::string& body);
+
+    RoutePolicy defaultPolicy_;
+    std::vector<RoutePolicy> routes_;
+    std::vector<Encoding> preference_;
+
+    using LruList = std::list<std::pair<std::string, std::string>>;
+    std::mutex cacheMutex_;
+    LruList lru_;
+    std::unordered_map<std::string, LruList::iterator> index_;
+    size_t cacheBytes_ = 0;
+    size_t cacheMaxBytes_ = 0;
+};
@@ -0,0 +1,104 @@
+#include "ResponseFormat.h"
+#include "CborTranscoder.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <cstdlib>
+#include <string_view>
+
+using namespace drogon;
+
+namespace {
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && value.front() == ' ') {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && value.back() == ' ') {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// q из параметров элемента Accept (";level=1;q=0.5"); без q - 1.
+// Сравнивается имя параметра целиком: "q=" внутри других параметров не в счёт
+double qualityOf(std::string_view params) {
+    while (!params.empty()) {
+        size_t semicolon = params.find(';');
+        std::string_view param = trim(params.substr(0, semicolon));
+        if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+            return std::strtod(std::string(param.substr(2)).c_str(), nullptr);
+        }
+        if (semicolon == std::string_view::npos) {
+            break;
+        }
+        params.remove_prefix(semicolon + 1);
+    }
+    return 1.0;
+}
+
+void addVary(const HttpResponsePtr& resp, const char* field) {
+    const auto& vary = resp->getHeader("Vary");
+    resp->addHeader("Vary", vary.empty() ? std::string(field) : vary + ", " + field);
+}
+
+} // namespace
+
+bool ResponseFormat::prefersCbor(const HttpRequestPtr& req) {
+    const auto& accept = req->getHeader("Accept");
+    if (accept.empty() || accept.find("cbor") == std::string::npos) {
+        return false;
+    }
+
+    double cborQuality = 0.0;
+    double jsonQuality = -1.0;
+    double wildcardQuality = -1.0;
+
+    std::string_view header(accept);
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == std::string_view::npos) {
+            end = header.size();
+        }
+        std::string_view item = trim(header.substr(pos, end - pos));
+        pos = end + 1;
+
+        double q = 1.0;
+        size_t semicolon = item.find(';');
+        std::string_view type = trim(item.substr(0, semicolon));
+        if (semicolon != std::string_view::npos) {
+            q = qualityOf(item.substr(semicolon + 1));
+        }
+
+        if (type == "application/cbor") {
+            cborQuality = q;
+        } else if (type == "application/json") {
+            jsonQuality = q;
+        } else if (type == "*/*" || type == "application/*") {
+            wildcardQuality = std::max(wildcardQuality, q);
+        }
+    }
+
+    double jsonEffective = jsonQuality >= 0.0 ? jsonQuality : std::max(wildcardQuality, 0.0);
+    return cborQuality > 0.0 && cborQuality >= jsonEffective;
+}
+
+void ResponseFormat::registerAdvice() {
+    app().registerPostHandlingAdvice([](const HttpRequestPtr& req, const HttpResponsePtr& resp) {
+        if (resp->contentType() != CT_APPLICATION_JSON) {
+            return;
+        }
+        addVary(resp, "Accept");
+        if (resp->body().empty() || !prefersCbor(req)) {
+            return;
+        }
+
+        std::string cbor;
+        if (!CborTranscoder::fromJson(resp->body(), cbor)) {
+            LOG_ERROR << "Failed to transcode JSON response to CBOR for " << req->path();
+            return;
+        }
+        resp->setBody(std::move(cbor));
+        resp->setContentTypeString("application/cbor");
+    });
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <drogon/HttpRequest.h>
+#include <drogon/HttpResponse.h>
+
+// Формат тела ответа по заголовку Accept. Обработчики всегда строят JSON,
+// а общий advice перекодирует его в CBOR (CborTranscoder), если клиент
+// предпочитает application/cbor. Так формат поддерживают все JSON-эндпоинты.
+class ResponseFormat {
+public:
+    // application/cbor с q > 0 и не ниже, чем у application/json (или */*)
+    static bool prefersCbor(const drogon::HttpRequestPtr& req);
+
+    // Вызывать после HttpCache::registerDigestFallback и до ResponseCompressor
+    static void registerAdvice();
+};
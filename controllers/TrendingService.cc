@@ -0,0 +1,312 @@
+#include "TrendingService.h"
+#include "PgArray.h"
+#include <drogon/drogon.h>
+#include <drogon/orm/DbClient.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace drogon;
+using namespace drogon::orm;
+
+namespace {
+
+// При таком показателе оценки переводятся в масштаб текущего момента,
+// чтобы e^(rate * (t - epoch)) не терял точность
+constexpr double kMaxExponent = 50.0;
+
+} // namespace
+
+double TrendingService::now() {
+    using namespace std::chrono;
+    return duration<double>(system_clock::now().time_since_epoch()).count();
+}
+
+void TrendingService::start() {
+    const auto& config = app().getCustomConfig()["trending"];
+    double halfLifeHours = std::max(0.1, config.get("half_life_hours", 24.0).asDouble());
+    decayRate_ = std::log(2.0) / (halfLifeHours * 3600.0);
+    viewWeight_ = config.get("view_weight", 1.0).asDouble();
+    enrollmentWeight_ = config.get("enrollment_weight", 5.0).asDouble();
+    completionWeight_ = config.get("completion_weight", 3.0).asDouble();
+    minScore_ = config.get("min_score", 0.05).asDouble();
+    loadRetrySeconds_ = std::max(1.0, config.get("load_retry_seconds", 10.0).asDouble());
+    epoch_ = now();
+
+    app().getLoop()->queueInLoop([this]() {
+        loadState();
+    });
+
+    double catalogInterval = std::max(5.0, config.get("catalog_refresh_seconds", 60.0).asDouble());
+    app().getLoop()->runEvery(catalogInterval, [this]() {
+        refreshCatalog();
+    });
+
+    double snapshotInterval = std::max(5.0, config.get("snapshot_interval_seconds", 60.0).asDouble());
+    app().getLoop()->runEvery(snapshotInterval, [this]() {
+        saveSnapshot();
+    });
+}
+
+void TrendingService::loadState() {
+    auto retry = [this]() {
+        app().getLoop()->runAfter(loadRetrySeconds_, [this]() {
+            loadState();
+        });
+    };
+
+    // Каталог нужен до снимка: оценки курсов вне каталога отбрасываются
+    refreshCatalog([this, retry](bool catalogOk) {
+        if (!catalogOk) {
+            retry();
+            return;
+        }
+        loadSnapshot([this, retry](bool snapshotOk) {
+            if (snapshotOk) {
+                loaded_ = true;
+            } else {
+                retry();
+            }
+        });
+    });
+}
+
+void TrendingService::record(const std::string& courseId, Signal signal, int64_t count) {
+    double weight = viewWeight_;
+    if (signal == Signal::Enrollment) {
+        weight = enrollmentWeight_;
+    } else if (signal == Signal::Completion) {
+        weight = completionWeight_;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (categories_.find(courseId) == categories_.end()) {
+        return;
+    }
+    addLocked(courseId, weight * static_cast<double>(count), now());
+}
+
+void TrendingService::addLocked(const std::string& courseId, double weight, double at) {
+    if (decayRate_ * (at - epoch_) > kMaxExponent) {
+        rebaseLocked(at);
+    }
+
+    const auto& category = categories_[courseId];
+    auto [it, inserted] = scores_.emplace(courseId, 0.0);
+    if (!inserted) {
+        eraseRankLocked(courseId, category, it->second);
+    }
+    it->second += weight * std::exp(decayRate_ * (at - epoch_));
+    insertRankLocked(courseId, category, it->second);
+}
+
+void TrendingService::insertRankLocked(const std::string& courseId, const std::string& category, double score) {
+    global_.emplace(score, courseId);
+    byCategory_[category].emplace(score, courseId);
+}
+
+void TrendingService::eraseRankLocked(const std::string& courseId, const std::string& category, double score) {
+    global_.erase({score, courseId});
+    auto it = byCategory_.find(category);
+    if (it != byCategory_.end()) {
+        it->second.erase({score, courseId});
+        if (it->second.empty()) {
+            byCategory_.erase(it);
+        }
+    }
+}
+
+void TrendingService::rebaseLocked(double at) {
+    double factor = std::exp(-decayRate_ * (at - epoch_));
+    epoch_ = at;
+
+    global_.clear();
+    byCategory_.clear();
+    for (auto it = scores_.begin(); it != scores_.end();) {
+        it->second *= factor;
+        if (it->second < minScore_) {
+            it = scores_.erase(it);
+            continue;
+        }
+        insertRankLocked(it->first, categories_[it->first], it->second);
+        ++it;
+    }
+}
+
+std::vector<TrendingService::Entry> TrendingService::top(const std::string& category, size_t limit) const {
+    std::vector<Entry> result;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const Ranking* ranking = &global_;
+    if (!category.empty()) {
+        auto it = byCategory_.find(category);
+        if (it == byCategory_.end()) {
+            return result;
+        }
+        ranking = &it->second;
+    }
+
+    double factor = std::exp(-decayRate_ * (now() - epoch_));
+    result.reserve(std::min(limit, ranking->size()));
+    for (const auto& [score, courseId] : *ranking) {
+        if (result.size() >= limit) {
+            break;
+        }
+        result.push_back({courseId, score * factor});
+    }
+    return result;
+}
+
+void TrendingService::refreshCatalog(std::function<void(bool ok)> next) {
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        "SELECT id, category FROM courses WHERE is_published = true AND is_public = true",
+        [this, next](const Result& result) {
+            std::unordered_map<std::string, std::string> catalog;
+            catalog.reserve(result.size());
+            for (const auto& row : result) {
+                catalog.emplace(row["id"].as<std::string>(), row["category"].as<std::string>());
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                // Курсы, снятые с публикации или сменившие категорию
+                for (auto it = scores_.begin(); it != scores_.end();) {
+                    const auto& oldCategory = categories_[it->first];
+                    auto fresh = catalog.find(it->first);
+                    if (fresh != catalog.end() && fresh->second == oldCategory) {
+                        ++it;
+                        continue;
+                    }
+                    eraseRankLocked(it->first, oldCategory, it->second);
+                    if (fresh == catalog.end()) {
+                        it = scores_.erase(it);
+                        continue;
+                    }
+                    insertRankLocked(it->first, fresh->second, it->second);
+                    ++it;
+                }
+                categories_ = std::move(catalog);
+            }
+
+            if (next) {
+                next(true);
+            }
+        },
+        [next](const DrogonDbException& e) {
+            LOG_ERROR << "Failed to load courses for trending: " << e.base().what();
+            if (next) {
+                next(false);
+            }
+        });
+}
+
+void TrendingService::loadSnapshot(std::function<void(bool ok)> next) {
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        "SELECT course_id, score, EXTRACT(EPOCH FROM scored_at)::float8 AS scored_at FROM course_trending",
+        [this, next](const Result& result) {
+            double at = now();
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (const auto& row : result) {
+                auto courseId = row["course_id"].as<std::string>();
+                if (categories_.find(courseId) == categories_.end()) {
+                    continue;
+                }
+                // Затухание за время, пока сервер был остановлен
+                double elapsed = std::max(0.0, at - row["scored_at"].as<double>());
+                double score = row["score"].as<double>() * std::exp(-decayRate_ * elapsed);
+                if (score >= minScore_) {
+                    addLocked(courseId, score, at);
+                }
+            }
+            LOG_INFO << "Trending snapshot loaded: " << scores_.size() << " courses";
+            lock.unlock();
+            next(true);
+        },
+        [next](const DrogonDbException& e) {
+            LOG_ERROR << "Failed to load trending snapshot: " << e.base().what();
+            next(false);
+        });
+}
+
+void TrendingService::collectSnapshotLocked(std::vector<std::string>& ids, std::vector<double>& scores) {
+    double factor = std::exp(-decayRate_ * (now() - epoch_));
+    ids.reserve(scores_.size());
+    scores.reserve(scores_.size());
+    for (auto it = scores_.begin(); it != scores_.end();) {
+        double current = it->second * factor;
+        if (current < minScore_) {
+            eraseRankLocked(it->first, categories_[it->first], it->second);
+            it = scores_.erase(it);
+            continue;
+        }
+        ids.push_back(it->first);
+        scores.push_back(current);
+        ++it;
+    }
+}
+
+// Снимок заменяет таблицу целиком: новые и изменённые строки upsert,
+// остальные удаляются. Курсы, удалённые после обновления каталога, пропускаются
+std::string TrendingService::snapshotSql() {
+    return R"(
+        WITH input AS (
+            SELECT t.course_id, t.score
+            FROM unnest($1::text[], $2::float8[]) AS t(course_id, score)
+            JOIN courses c ON c.id = t.course_id
+        ),
+        removed AS (
+            DELETE FROM course_trending ct
+            WHERE NOT EXISTS (SELECT 1 FROM input i WHERE i.course_id = ct.course_id)
+        )
+        INSERT INTO course_trending (course_id, score, scored_at)
+        SELECT course_id, score, NOW() FROM input
+        ON CONFLICT (course_id) DO UPDATE SET score = EXCLUDED.score, scored_at = EXCLUDED.scored_at
+    )";
+}
+
+void TrendingService::saveSnapshot() {
+    // Пока прошлый снимок не прочитан, запись затёрла бы его неполными данными
+    if (!loaded_ || snapshotting_.exchange(true)) {
+        return;
+    }
+
+    std::vector<std::string> ids;
+    std::vector<double> scores;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectSnapshotLocked(ids, scores);
+    }
+
+    auto dbClient = app().getDbClient();
+    dbClient->execSqlAsync(
+        snapshotSql(),
+        [this](const Result&) {
+            snapshotting_ = false;
+        },
+        [this](const DrogonDbException& e) {
+            LOG_ERROR << "Failed to save trending snapshot: " << e.base().what();
+            snapshotting_ = false;
+        },
+        pg::textArray(ids), pg::doubleArray(scores));
+}
+
+void TrendingService::shutdown() {
+    if (!loaded_) {
+        return;
+    }
+
+    std::vector<std::string> ids;
+    std::vector<double> scores;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectSnapshotLocked(ids, scores);
+    }
+
+    try {
+        app().getDbClient()->execSqlSync(snapshotSql(), pg::textArray(ids), pg::doubleArray(scores));
+    } catch (const DrogonDbException& e) {
+        LOG_ERROR << "Failed to save trending snapshot on shutdown: " << e.base().what();
+    }
+}
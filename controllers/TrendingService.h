@@ -0,0 +1,93 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Рейтинг "в тренде": у каждого курса экспоненциально затухающая оценка
+// из просмотров, записей и завершённых уроков.
+// Оценки хранятся в масштабе момента epoch_ (вклад события умножается на
+// e^(rate * (t - epoch_))), поэтому затухание одинаково для всех курсов и не
+// меняет порядок: упорядоченные множества обновляются за O(log n) на событие
+// без периодического пересчёта. Снимок пишется в course_trending.
+class TrendingService {
+public:
+    static TrendingService& instance() {
+        static TrendingService instance;
+        return instance;
+    }
+
+    enum class Signal {
+        View,
+        Enrollment,
+        Completion
+    };
+
+    // Загрузка каталога и снимка, таймеры (вызывается из main до app().run())
+    void start();
+
+    // Синхронная запись снимка при остановке сервера
+    void shutdown();
+
+    // События курсов вне каталога (не опубликован, не существует) не учитываются.
+    // Просмотры приходят из CounterService после записи: уже без повторов и
+    // только для видео, принадлежащих курсу; count - сколько их в пакете
+    void record(const std::string& courseId, Signal signal, int64_t count = 1);
+
+    struct Entry {
+        std::string courseId;
+        double score;  // текущая оценка с учётом затухания
+    };
+
+    // Пустая категория - общий рейтинг
+    std::vector<Entry> top(const std::string& category, size_t limit) const;
+
+private:
+    TrendingService() = default;
+
+    using Ranking = std::set<std::pair<double, std::string>, std::greater<>>;
+
+    static double now();
+
+    void addLocked(const std::string& courseId, double weight, double at);
+    void insertRankLocked(const std::string& courseId, const std::string& category, double score);
+    void eraseRankLocked(const std::string& courseId, const std::string& category, double score);
+    void rebaseLocked(double at);
+
+    // Каталог, затем снимок; при ошибке повтор через load_retry_seconds
+    void loadState();
+    // next получает true, если запрос выполнен
+    void refreshCatalog(std::function<void(bool ok)> next = nullptr);
+    void loadSnapshot(std::function<void(bool ok)> next);
+    // Текущие оценки для записи; заодно выбрасывает затухшие курсы
+    void collectSnapshotLocked(std::vector<std::string>& ids, std::vector<double>& scores);
+    void saveSnapshot();
+
+    static std::string snapshotSql();
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::string> categories_;  // опубликованные публичные курсы
+    std::unordered_map<std::string, double> scores_;           // в масштабе epoch_
+    Ranking global_;
+    std::unordered_map<std::string, Ranking> byCategory_;
+    double epoch_ = 0.0;
+
+    double decayRate_ = 0.0;  // ln 2 / период полураспада, 1/с
+    double viewWeight_ = 1.0;
+    double enrollmentWeight_ = 5.0;
+    double completionWeight_ = 3.0;
+    double minScore_ = 0.05;
+    double loadRetrySeconds_ = 10.0;
+
+    // Каталог и прошлый снимок прочитаны: до этого снимок не пишется, иначе
+    // course_trending была бы затёрта неполными данными
+    std::atomic<bool> loaded_{false};
+    std::atomic<bool> snapshotting_{false};
+};
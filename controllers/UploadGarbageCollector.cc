@@ -0,0 +1,358 @@
+#include "UploadGarbageCollector.h"
+#include "ImageService.h"
+#include "VideoPreviewService.h"
+#include "PgArray.h"
+#include <drogon/drogon.h>
+#include <algorithm>
+#include <ctime>
+#include <thread>
+
+using namespace drogon;
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::string kUploadsRoot = "uploads";
+const std::string kPreviewSuffix = ".preview";
+
+// Обходятся только каталоги, куда пишет сервер: видео и обложки курсов и варианты изображений
+const char* const kManagedDirectories[] = {"uploads/courses", "uploads/images"};
+
+// Каждое условие - отдельный EXISTS, чтобы у каждого был свой индекс (раздел 7 BD-Server.txt)
+const char* const kReferencedSql = R"(
+    SELECT k FROM unnest($1::text[]) AS k
+    WHERE EXISTS (SELECT 1 FROM course_videos WHERE video_path = k)
+       OR EXISTS (SELECT 1 FROM course_videos WHERE cover_path = k)
+       OR EXISTS (SELECT 1 FROM courses WHERE cover_path = k)
+       OR EXISTS (SELECT 1 FROM courses WHERE icon_path = k)
+       OR EXISTS (SELECT 1 FROM users WHERE avatar_path = k)
+       OR EXISTS (SELECT 1 FROM users WHERE cover_path = k)
+)";
+
+bool endsWith(const std::string& value, const std::string& suffix) {
+    return value.size() >= suffix.size() &&
+           value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// video_path и cover_path видео хранятся без корня, изображения - с "uploads/"
+std::string withoutRoot(const std::string& path) {
+    if (path.size() > kUploadsRoot.size() && path.compare(0, kUploadsRoot.size(), kUploadsRoot) == 0 &&
+        path[kUploadsRoot.size()] == '/') {
+        return path.substr(kUploadsRoot.size() + 1);
+    }
+    return path;
+}
+
+uint64_t directorySize(const fs::path& directory) {
+    uint64_t total = 0;
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code sizeError;
+        if (it->is_regular_file(sizeError)) {
+            auto size = it->file_size(sizeError);
+            if (!sizeError) {
+                total += size;
+            }
+        }
+    }
+    return total;
+}
+
+} // namespace
+
+UploadGarbageCollector::UploadGarbageCollector()
+    : queue_(1, "UploadGarbageCollector") {
+}
+
+void UploadGarbageCollector::start() {
+    const auto& config = app().getCustomConfig()["upload_gc"];
+    enabled_ = config.get("enabled", true).asBool();
+    intervalSeconds_ = std::max(60.0, config.get("interval_seconds", 3600).asDouble());
+    grace_ = std::chrono::seconds(std::max(60u, config.get("grace_seconds", 86400).asUInt()));
+    lookupBatch_ = std::max(1u, config.get("lookup_batch", 500).asUInt());
+    deleteBatch_ = std::max(1u, config.get("delete_batch", 100).asUInt());
+    deletePause_ = std::chrono::milliseconds(config.get("delete_pause_ms", 200).asUInt());
+
+    if (!enabled_) {
+        LOG_INFO << "Upload garbage collector is disabled";
+        return;
+    }
+
+    // Первый проход - через интервал, а не при старте
+    app().getLoop()->runEvery(intervalSeconds_, [this]() {
+        runNow(false);
+    });
+}
+
+bool UploadGarbageCollector::runNow(bool dryRun) {
+    if (running_.exchange(true)) {
+        return false;
+    }
+
+    queue_.runTaskInQueue([this, dryRun]() {
+        try {
+            runPass(dryRun);
+        } catch (const orm::DrogonDbException& e) {
+            // Без ответа БД нельзя отличить сироту от живого файла: проход прерывается
+            LOG_ERROR << "Upload GC pass aborted, reference lookup failed: " << e.base().what();
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Upload GC pass aborted: " << e.what();
+        }
+        running_ = false;
+    });
+    return true;
+}
+
+void UploadGarbageCollector::runPass(bool dryRun) {
+    PassStats pass;
+    pass.startedAt = std::time(nullptr);
+    pass.dryRun = dryRun;
+
+    std::vector<Candidate> batch;
+    std::vector<std::string> previews;
+    // Файлы курсов без расширения: по ним каталог превью находит своё видео
+    std::unordered_set<std::string> stems;
+    bool complete = true;
+
+    for (const char* root : kManagedDirectories) {
+        std::error_code ec;
+        if (!fs::is_directory(root, ec)) {
+            continue;
+        }
+
+        fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec);
+        for (fs::recursive_directory_iterator end; !ec && it != end; it.increment(ec)) {
+            std::string path = it->path().generic_string();
+            std::error_code typeError;
+
+            if (it->is_directory(typeError)) {
+                // Каталог превью проверяется целиком, .preview.tmp - генерация идёт сейчас
+                if (endsWith(path, kPreviewSuffix)) {
+                    previews.push_back(path);
+                    it.disable_recursion_pending();
+                } else if (path.find(kPreviewSuffix + ".") != std::string::npos) {
+                    it.disable_recursion_pending();
+                }
+                continue;
+            }
+            if (!it->is_regular_file(typeError)) {
+                continue;
+            }
+
+            ++pass.filesScanned;
+            if (it->path().parent_path().filename() == "videos") {
+                stems.insert(fs::path(path).replace_extension().generic_string());
+            }
+            if (!oldEnough(it->path())) {
+                continue;
+            }
+
+            std::error_code sizeError;
+            auto size = it->file_size(sizeError);
+            batch.push_back(Candidate{path, referenceKey(path), sizeError ? 0 : size});
+            if (batch.size() >= lookupBatch_) {
+                checkBatch(batch, pass);
+                batch.clear();
+            }
+        }
+
+        if (ec) {
+            LOG_ERROR << "Upload GC failed to walk " << root << ": " << ec.message();
+            ++pass.errors;
+            complete = false;
+        }
+    }
+
+    if (!batch.empty()) {
+        checkBatch(batch, pass);
+    }
+    // По неполному обходу нельзя утверждать, что видео каталога превью нет
+    if (complete) {
+        removeOrphanPreviews(previews, stems, pass);
+    }
+
+    pass.finishedAt = std::time(nullptr);
+    LOG_INFO << "Upload GC" << (dryRun ? " (dry run)" : "") << ": scanned " << pass.filesScanned
+             << ", orphans " << pass.orphansFound << ", deleted " << pass.filesDeleted
+             << ", reclaimed " << pass.bytesReclaimed << " bytes";
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    ++passes_;
+    if (!dryRun) {
+        totalFilesDeleted_ += pass.filesDeleted;
+        totalBytesReclaimed_ += pass.bytesReclaimed;
+    }
+    lastPass_ = std::move(pass);
+}
+
+void UploadGarbageCollector::checkBatch(std::vector<Candidate>& batch, PassStats& pass) {
+    // Каждый путь проверяется в обеих формах: с корнем uploads/ и без него
+    std::vector<std::string> keys;
+    keys.reserve(batch.size() * 2);
+    for (const auto& candidate : batch) {
+        if (!candidate.key.empty()) {
+            keys.push_back(candidate.key);
+            keys.push_back(withoutRoot(candidate.key));
+        }
+    }
+
+    std::unordered_set<std::string> referenced;
+    if (!keys.empty()) {
+        auto result = app().getDbClient()->execSqlSync(kReferencedSql, pg::textArray(keys));
+        for (const auto& row : result) {
+            referenced.insert(row["k"].as<std::string>());
+        }
+    }
+
+    std::vector<Candidate> orphans;
+    for (auto& candidate : batch) {
+        // Пустой ключ - брошенный временный файл
+        if (!candidate.key.empty() &&
+            (referenced.count(candidate.key) || referenced.count(withoutRoot(candidate.key)))) {
+            continue;
+        }
+        ++pass.orphansFound;
+        if (pass.sample.size() < sampleSize_) {
+            pass.sample.push_back(candidate.path);
+        }
+        if (pass.dryRun) {
+            pass.bytesReclaimed += candidate.size;
+        } else {
+            orphans.push_back(std::move(candidate));
+        }
+    }
+
+    removeOrphans(orphans, pass);
+}
+
+void UploadGarbageCollector::removeOrphans(const std::vector<Candidate>& orphans, PassStats& pass) {
+    for (size_t i = 0; i < orphans.size(); ++i) {
+        if (i > 0 && i % deleteBatch_ == 0) {
+            pause();
+        }
+
+        const auto& orphan = orphans[i];
+        // Повторная загрузка того же изображения освежает дату файла
+        // (ImageService), такой файл мог снова стать нужным
+        if (!oldEnough(orphan.path)) {
+            continue;
+        }
+
+        std::error_code ec;
+        if (!fs::remove(orphan.path, ec)) {
+            if (ec) {
+                LOG_ERROR << "Upload GC failed to delete " << orphan.path << ": " << ec.message();
+                ++pass.errors;
+            }
+            continue;
+        }
+        ++pass.filesDeleted;
+        pass.bytesReclaimed += orphan.size;
+
+        if (fs::path(orphan.path).parent_path().filename() == "videos") {
+            VideoPreviewService::instance().removePreviews(orphan.path);
+        }
+    }
+
+    if (!orphans.empty()) {
+        pause();
+    }
+}
+
+void UploadGarbageCollector::removeOrphanPreviews(const std::vector<std::string>& previews,
+                                                  const std::unordered_set<std::string>& stems,
+                                                  PassStats& pass) {
+    size_t removed = 0;
+    for (const auto& preview : previews) {
+        std::string stem = preview.substr(0, preview.size() - kPreviewSuffix.size());
+        if (stems.count(stem) || !oldEnough(preview)) {
+            continue;
+        }
+
+        ++pass.orphansFound;
+        if (pass.sample.size() < sampleSize_) {
+            pass.sample.push_back(preview);
+        }
+        uint64_t size = directorySize(preview);
+        pass.bytesReclaimed += size;
+        if (pass.dryRun) {
+            continue;
+        }
+
+        if (removed > 0 && removed % deleteBatch_ == 0) {
+            pause();
+        }
+        // removePreviews заменяет расширение пути на .preview, так что каталог
+        // превью подходит вместо пути к видео; удаление идёт в очереди превью
+        VideoPreviewService::instance().removePreviews(preview);
+        ++removed;
+        ++pass.filesDeleted;
+    }
+}
+
+bool UploadGarbageCollector::oldEnough(const fs::path& path) const {
+    std::error_code ec;
+    auto modified = fs::last_write_time(path, ec);
+    return !ec && modified < Clock::now() - grace_;
+}
+
+void UploadGarbageCollector::pause() const {
+    if (deletePause_.count() > 0) {
+        std::this_thread::sleep_for(deletePause_);
+    }
+}
+
+std::string UploadGarbageCollector::referenceKey(const std::string& path) {
+    if (path.compare(0, ImageService::variantsDirectory().size(), ImageService::variantsDirectory()) != 0) {
+        return path;
+    }
+
+    // Временный файл записи варианта: ссылок на него не бывает
+    if (endsWith(path, ".tmp")) {
+        return "";
+    }
+
+    // В БД хранится вариант full, thumb и card живут и удаляются вместе с ним
+    for (const char* variant : {"_thumb.", "_card."}) {
+        auto pos = path.rfind(variant);
+        if (pos != std::string::npos) {
+            return path.substr(0, pos) + "_full." + path.substr(pos + std::char_traits<char>::length(variant));
+        }
+    }
+    return path;
+}
+
+Json::Value UploadGarbageCollector::stats() const {
+    Json::Value json;
+    json["enabled"] = enabled_;
+    json["running"] = running_.load();
+    json["interval_seconds"] = intervalSeconds_;
+    json["grace_seconds"] = static_cast<Json::Int64>(grace_.count());
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    json["passes"] = static_cast<Json::UInt64>(passes_);
+    json["total_files_deleted"] = static_cast<Json::UInt64>(totalFilesDeleted_);
+    json["total_bytes_reclaimed"] = static_cast<Json::UInt64>(totalBytesReclaimed_);
+
+    if (passes_ == 0) {
+        json["last_pass"] = Json::nullValue;
+        return json;
+    }
+
+    Json::Value last;
+    last["started_at"] = static_cast<Json::Int64>(lastPass_.startedAt);
+    last["finished_at"] = static_cast<Json::Int64>(lastPass_.finishedAt);
+    last["dry_run"] = lastPass_.dryRun;
+    last["files_scanned"] = static_cast<Json::UInt64>(lastPass_.filesScanned);
+    last["orphans_found"] = static_cast<Json::UInt64>(lastPass_.orphansFound);
+    last["files_deleted"] = static_cast<Json::UInt64>(lastPass_.filesDeleted);
+    // При dry_run - сколько освободил бы проход
+    last["bytes_reclaimed"] = static_cast<Json::UInt64>(lastPass_.bytesReclaimed);
+    last["errors"] = static_cast<Json::UInt64>(lastPass_.errors);
+    last["sample"] = Json::arrayValue;
+    for (const auto& path : lastPass_.sample) {
+        last["sample"].append(path);
+    }
+    json["last_pass"] = last;
+    return json;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Сверка файлов в uploads/ со ссылками из БД.
+// Курсы, главы и видео удаляются каскадом в БД, а их файлы остаются на диске;
+// сирот оставляют и загрузки, после которых вставка в БД не удалась.
+// Сборщик обходит дерево порциями в своём потоке: для порции одним запросом
+// выясняет, какие пути упомянуты в course_videos, courses и users, остальное
+// удаляет пачками с паузой между ними. Файлы моложе grace_seconds не трогаются:
+// загрузка пишет файл раньше, чем ссылку на него.
+class UploadGarbageCollector {
+public:
+    static UploadGarbageCollector& instance() {
+        static UploadGarbageCollector instance;
+        return instance;
+    }
+
+    // Таймер проходов по custom_config.upload_gc (вызывается из main до app().run())
+    void start();
+
+    // Внеочередной проход; false, если проход уже идёт.
+    // dryRun - только посчитать сирот, ничего не удаляя
+    bool runNow(bool dryRun);
+
+    // Итоги последнего прохода и счётчики с момента запуска
+    Json::Value stats() const;
+
+private:
+    UploadGarbageCollector();
+
+    using Clock = std::filesystem::file_time_type::clock;
+
+    struct Candidate {
+        std::string path;   // путь на диске: uploads/...
+        std::string key;    // под каким путём файл упоминается в БД
+        uint64_t size = 0;
+    };
+
+    struct PassStats {
+        int64_t startedAt = 0;
+        int64_t finishedAt = 0;
+        bool dryRun = false;
+        uint64_t filesScanned = 0;
+        uint64_t orphansFound = 0;
+        uint64_t filesDeleted = 0;
+        uint64_t bytesReclaimed = 0;
+        uint64_t errors = 0;
+        std::vector<std::string> sample;  // первые найденные сироты
+    };
+
+    // Всё ниже выполняется в потоке queue_
+    void runPass(bool dryRun);
+    void checkBatch(std::vector<Candidate>& batch, PassStats& pass);
+    void removeOrphans(const std::vector<Candidate>& orphans, PassStats& pass);
+    void removeOrphanPreviews(const std::vector<std::string>& previews,
+                              const std::unordered_set<std::string>& stems,
+                              PassStats& pass);
+    bool oldEnough(const std::filesystem::path& path) const;
+    void pause() const;
+
+    // Путь, которым на файл ссылается БД: для вариантов изображения - вариант full
+    static std::string referenceKey(const std::string& path);
+
+    trantor::ConcurrentTaskQueue queue_;
+    std::atomic<bool> running_{false};
+
+    mutable std::mutex statsMutex_;
+    PassStats lastPass_;
+    uint64_t passes_ = 0;
+    uint64_t totalFilesDeleted_ = 0;
+    uint64_t totalBytesReclaimed_ = 0;
+
+    bool enabled_ = true;
+    double intervalSeconds_ = 3600.0;
+    std::chrono::seconds grace_{86400};
+    size_t lookupBatch_ = 500;
+    size_t deleteBatch_ = 100;
+    std::chrono::milliseconds deletePause_{200};
+    size_t sampleSize_ = 20;
+};
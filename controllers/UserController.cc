@@ -1,15 +1,163 @@
 #include "UserController.h"
+#include "AuditLogger.h"
+#include "AuthContext.h"
+#include "DbRouter.h"
+#include "ImageService.h"
+#include "HttpCache.h"
+#include "JsonStreamWriter.h"
+#include "ProfileCache.h"
+#include "ProgressBuffer.h"
+#include "PgArray.h"
 #include <drogon/HttpResponse.h>
 #include <drogon/utils/Utilities.h>
 #include <drogon/drogon.h>
 #include <algorithm>
 #include <filesystem>
+#include <unordered_map>
 #include <bcrypt/BCrypt.hpp>
 
 using namespace drogon;
 using namespace drogon::orm;
 using namespace std;
 
+namespace {
+
+// Колонки версии профиля: users.updated_at обновляется триггером при любом изменении
+const string kProfileVersionColumns =
+    "(EXTRACT(EPOCH FROM updated_at) * 1000000)::bigint AS etag_version, "
+    "EXTRACT(EPOCH FROM updated_at)::bigint AS etag_modified_at";
+
+HttpCache::Validator profileValidator(const HttpRequestPtr& req, const Row& row, const string& userId) {
+    return HttpCache::versioned(req, "profile",
+                                row["etag_version"].as<string>(),
+                                row["etag_modified_at"].as<int64_t>(),
+                                userId);
+}
+
+// Свой профиль целиком: contacts и information пишутся из JSONB как есть
+const JsonRowLayout& ownerProfileLayout() {
+    static const JsonRowLayout layout({
+        {"id", JsonColumnKind::String},
+        {"username", JsonColumnKind::String},
+        {"email", JsonColumnKind::String},
+        {"role", JsonColumnKind::String},
+        {"profile_is_public", JsonColumnKind::Boolean},
+        {"avatar_path", JsonColumnKind::NullableString},
+        {"avatar_variants", "avatar_path", ImageService::writeVariants},
+        {"cover_path", JsonColumnKind::NullableString},
+        {"cover_variants", "cover_path", ImageService::writeVariants},
+        {"contacts", JsonColumnKind::JsonArray},
+        {"information", JsonColumnKind::JsonArray},
+        {"created_at", JsonColumnKind::Timestamp},
+        {"updated_at", JsonColumnKind::Timestamp},
+        {"last_login_at", JsonColumnKind::Timestamp},
+    });
+    return layout;
+}
+
+// Правки JSONB-массивов профиля (information, contacts) одним запросом.
+// Новое значение считается из текущего значения строки прямо в UPDATE, поэтому
+// параллельные правки не теряются, а результат возвращается через RETURNING.
+// $1 - пользователь, $2 - версия из If-Match (-1 - без проверки);
+// target отличает "нет пользователя" (нет строк) от "версия устарела" (items = NULL)
+enum class ProfileArrayEdit {
+    Append,      // $3 - элемент, $4 - новый id
+    Replace,     // $3 - элемент, $4 - id (нет такого - в конец)
+    Remove,      // $3 - id
+    ReplaceAll   // $3 - весь массив
+};
+
+// Элемент или массив для параметра $3 - компактный JSON без отступов
+string compactJson(const Json::Value& value) {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    return Json::writeString(builder, value);
+}
+
+string profileArrayEditSql(const string& column, ProfileArrayEdit edit) {
+    const string items = "COALESCE(" + column + ", '[]'::jsonb)";
+    const string newItem = "($3::jsonb || jsonb_build_object('id', $4::text))";
+
+    string value;
+    switch (edit) {
+    case ProfileArrayEdit::Append:
+        value = items + " || jsonb_build_array" + newItem;
+        break;
+    case ProfileArrayEdit::Replace:
+        value = "CASE WHEN " + items + " @> jsonb_build_array(jsonb_build_object('id', $4::text)) "
+                "THEN (SELECT jsonb_agg(CASE WHEN item->>'id' = $4::text THEN " + newItem + " ELSE item END ORDER BY n) "
+                "      FROM jsonb_array_elements(" + items + ") WITH ORDINALITY AS a(item, n)) "
+                "ELSE " + items + " || jsonb_build_array" + newItem + " END";
+        break;
+    case ProfileArrayEdit::Remove:
+        value = "COALESCE((SELECT jsonb_agg(item ORDER BY n) "
+                "          FROM jsonb_array_elements(" + items + ") WITH ORDINALITY AS a(item, n) "
+                "          WHERE item->>'id' IS DISTINCT FROM $3::text), '[]'::jsonb)";
+        break;
+    case ProfileArrayEdit::ReplaceAll:
+        value = "$3::jsonb";
+        break;
+    }
+
+    return "WITH target AS ("
+           "    SELECT (EXTRACT(EPOCH FROM updated_at) * 1000000)::bigint AS version FROM users WHERE id = $1"
+           "), edited AS ("
+           "    UPDATE users SET " + column + " = " + value + ", updated_at = NOW() "
+           "    WHERE id = $1 AND ($2::bigint < 0 OR (EXTRACT(EPOCH FROM updated_at) * 1000000)::bigint = $2::bigint) "
+           "    RETURNING " + column + " AS items, (EXTRACT(EPOCH FROM updated_at) * 1000000)::bigint AS version"
+           ") "
+           "SELECT t.version AS current_version, e.items, e.version "
+           "FROM target t LEFT JOIN edited e ON true";
+}
+
+// Ответ на правку: сообщение обработчика + итоговый массив и новая версия профиля
+function<void(const Result&)> profileArrayEdited(const string& userId,
+                                                 const string& column,
+                                                 Json::Value response,
+                                                 function<void(const HttpResponsePtr&)> callback) {
+    return [userId, column, response = std::move(response), callback = std::move(callback)](const Result& result) {
+        if (result.empty()) {
+            Json::Value error;
+            error["error"] = "User not found";
+            auto resp = HttpResponse::newHttpJsonResponse(error);
+            resp->setStatusCode(k404NotFound);
+            callback(resp);
+            return;
+        }
+
+        if (result[0]["items"].isNull()) {
+            Json::Value error;
+            error["error"] = "Profile was modified";
+            error["version"] = result[0]["current_version"].as<string>();
+            auto resp = HttpResponse::newHttpJsonResponse(error);
+            resp->setStatusCode(k412PreconditionFailed);
+            callback(resp);
+            return;
+        }
+
+        ProfileCache::instance().invalidate(userId);
+
+        // Массив из RETURNING - уже готовый JSON, пишется как есть
+        string itemsJson = result[0]["items"].as<string>();
+        JsonStreamWriter writer(itemsJson.size() + 128);
+        writer.beginObject();
+        for (const auto& name : response.getMemberNames()) {
+            writer.key(name);
+            writer.jsonValue(response[name]);
+        }
+        writer.key(column);
+        writer.rawValue(itemsJson);
+        writer.key("version");
+        writer.stringValue(result[0]["version"].as<string>());
+        writer.key("success");
+        writer.boolValue(true);
+        writer.endObject();
+        callback(writer.toResponse());
+    };
+}
+
+} // namespace
+
 // Вспомогательная функция для создания JSON ответов
 Json::Value UserController::createJsonResponse(const string& key, const string& value) {
     Json::Value json;
@@ -19,6 +167,11 @@ Json::Value UserController::createJsonResponse(const string& key, const string&
 
 // JWT аутентификация
 string UserController::getCurrentUserId(const HttpRequestPtr& req) {
+    // Подзапрос /batch: токен уже проверен
+    if (auto identity = AuthContext::attached(req)) {
+        return identity->userId;
+    }
+
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
         return "";
@@ -103,6 +256,10 @@ string UserController::getRoleFromToken(const string& token) {
 }
 
 bool UserController::hasPermission(const HttpRequestPtr& req, const vector<string>& allowedRoles) {
+    if (auto identity = AuthContext::attached(req)) {
+        return find(allowedRoles.begin(), allowedRoles.end(), identity->role) != allowedRoles.end();
+    }
+
     auto authHeader = req->getHeader("Authorization");
     if (authHeader.empty() || authHeader.find("Bearer ") != 0) {
         return false;
@@ -129,99 +286,11 @@ bool UserController::isValidContactItem(const Json::Value& item) {
 }
 
 bool UserController::isValidProgressData(const Json::Value& data) {
-    return data.isMember("video_id") && data.isMember("completed") && data.isMember("watched_seconds");
-}
-
-// Работа с файлами
-string UserController::saveUploadedFile(const HttpRequestPtr& req, const string& uploadPath) {
-    MultiPartParser parser;
-    if (parser.parse(req) != 0) {
-        return "";
-    }
-
-    auto files = parser.getFiles();
-    if (files.empty()) {
-        return "";
-    }
-
-    auto& file = files[0];
-    string fileName = utils::getUuid() + filesystem::path(file.getFileName()).extension().string();
-    string fullPath = uploadPath + fileName;
-
-    filesystem::create_directories(uploadPath);
-    file.saveAs(fullPath);
-
-    return fullPath;
+    return data.isMember("video_id") && data.isMember("completed") && isValidWatchedSeconds(data["watched_seconds"]);
 }
 
-bool UserController::deleteFile(const string& filePath) {
-    try {
-        if (filePath.empty()) {
-            LOG_DEBUG << "File path is empty";
-            return true;
-        }
-
-        filesystem::path path(filePath);
-
-        LOG_DEBUG << "Attempting to delete file: " << filePath;
-        LOG_DEBUG << "Absolute path: " << filesystem::absolute(path).string();
-        LOG_DEBUG << "Current working directory: " << filesystem::current_path().string();
-
-        if (!filesystem::exists(path)) {
-            LOG_DEBUG << "File does not exist: " << filePath;
-            return true; // Файл уже удален
-        }
-
-        if (filesystem::is_directory(path)) {
-            LOG_ERROR << "Path is a directory, not a file: " << filePath;
-            return false;
-        }
-
-        // Получаем информацию о файле перед удалением
-        auto fileSize = filesystem::file_size(path);
-        auto permissions = filesystem::status(path).permissions();
-
-        LOG_DEBUG << "File size: " << fileSize << " bytes";
-        LOG_DEBUG << "File permissions: " << static_cast<int>(permissions);
-
-        // Пытаемся удалить файл
-        bool removed = filesystem::remove(path);
-
-        if (removed) {
-            LOG_DEBUG << "Successfully deleted file: " << filePath << " (size: " << fileSize << " bytes)";
-
-            // Проверяем, что файл действительно удален
-            if (filesystem::exists(path)) {
-                LOG_ERROR << "File still exists after deletion: " << filePath;
-                return false;
-            }
-            return true;
-        } else {
-            LOG_ERROR << "Failed to delete file (filesystem::remove returned false): " << filePath;
-
-            // Пробуем альтернативные методы удаления
-            try {
-                // Пробуем изменить права и удалить снова
-                filesystem::permissions(path, filesystem::perms::all);
-                removed = filesystem::remove(path);
-
-                if (removed) {
-                    LOG_DEBUG << "Successfully deleted file after permission change: " << filePath;
-                    return true;
-                }
-            } catch (const exception& e) {
-                LOG_ERROR << "Alternative deletion failed: " << e.what();
-            }
-
-            return false;
-        }
-    } catch (const filesystem::filesystem_error& e) {
-        LOG_ERROR << "File system error deleting " << filePath << ": " << e.what();
-        return false;
-    } catch (const exception& e) {
-        LOG_ERROR << "Unexpected error deleting " << filePath << ": " << e.what();
-        return false;
-    }
+bool UserController::isValidWatchedSeconds(const Json::Value& value) {
+    return value.isNumeric() && value.asDouble() >= 0 && value.asDouble() <= ProgressBuffer::kMaxWatchedSeconds;
 }
 
 // JSON обработка
@@ -263,94 +332,6 @@ Json::Value UserController::removeFromJsonArray(const Json::Value& originalArray
     return updatedArray;
 }
 
-// Вспомогательный метод для создания JSON ответа пользователя
-Json::Value UserController::getUserJsonResponse(const Users& user) {
-    Json::Value userJson;
-
-    try {
-        userJson["id"] = user.getValueOfId();
-        userJson["username"] = user.getValueOfUsername();
-        userJson["email"] = user.getValueOfEmail();
-        userJson["role"] = user.getValueOfRole();
-        userJson["profile_is_public"] = user.getValueOfProfileIsPublic();
-
-        // Обработка nullable полей
-        try {
-            if (!user.getValueOfAvatarPath().empty()) {
-                userJson["avatar_path"] = user.getValueOfAvatarPath();
-            } else {
-                userJson["avatar_path"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            userJson["avatar_path"] = Json::nullValue;
-        }
-
-        try {
-            if (!user.getValueOfCoverPath().empty()) {
-                userJson["cover_path"] = user.getValueOfCoverPath();
-            } else {
-                userJson["cover_path"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            userJson["cover_path"] = Json::nullValue;
-        }
-
-        // Парсим JSON поля
-        try {
-            string contactsStr = user.getValueOfContacts();
-            if (!contactsStr.empty()) {
-                Json::Value contacts;
-                Json::Reader reader;
-                if (reader.parse(contactsStr, contacts)) {
-                    userJson["contacts"] = contacts;
-                } else {
-                    userJson["contacts"] = Json::arrayValue;
-                }
-            } else {
-                userJson["contacts"] = Json::arrayValue;
-            }
-        } catch (const exception& e) {
-            userJson["contacts"] = Json::arrayValue;
-        }
-
-        try {
-            string informationStr = user.getValueOfInformation();
-            if (!informationStr.empty()) {
-                Json::Value information;
-                Json::Reader reader;
-                if (reader.parse(informationStr, information)) {
-                    userJson["information"] = information;
-                } else {
-                    userJson["information"] = Json::arrayValue;
-                }
-            } else {
-                userJson["information"] = Json::arrayValue;
-            }
-        } catch (const exception& e) {
-            userJson["information"] = Json::arrayValue;
-        }
-
-        userJson["created_at"] = user.getValueOfCreatedAt().toDbStringLocal();
-        userJson["updated_at"] = user.getValueOfUpdatedAt().toDbStringLocal();
-
-        try {
-            auto lastLogin = user.getValueOfLastLoginAt();
-            if (lastLogin != trantor::Date()) {
-                userJson["last_login_at"] = lastLogin.toDbStringLocal();
-            } else {
-                userJson["last_login_at"] = Json::nullValue;
-            }
-        } catch (const exception& e) {
-            userJson["last_login_at"] = Json::nullValue;
-        }
-
-    } catch (const exception& e) {
-        LOG_ERROR << "Error creating user JSON response: " << e.what();
-    }
-
-    return userJson;
-}
-
 // Основные операции с профилем
 void UserController::getMyProfile(const HttpRequestPtr& req,
                                   function<void(const HttpResponsePtr&)>&& callback) {
@@ -362,11 +343,20 @@ void UserController::getMyProfile(const HttpRequestPtr& req,
         return;
     }
 
+    auto& cache = ProfileCache::instance();
+    if (auto cached = cache.find(ProfileCache::View::Owner, userId)) {
+        callback(ProfileCache::respond(req, *cached, "profile", userId));
+        return;
+    }
+
+    auto ticket = cache.ticket(userId);
     auto dbClient = app().getDbClient();
 
     dbClient->execSqlAsync(
-        "SELECT * FROM users WHERE id = $1",
-        [callback, this](const Result& result) {
+        "SELECT id, username, email, role, profile_is_public, avatar_path, cover_path, "
+        "contacts, information, created_at, updated_at, last_login_at, " + kProfileVersionColumns + " "
+        "FROM users WHERE id = $1",
+        [req, userId, ticket, callback, this](const Result& result) {
             if (result.empty()) {
                 auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
                 resp->setStatusCode(k404NotFound);
@@ -375,10 +365,19 @@ void UserController::getMyProfile(const HttpRequestPtr& req,
             }
 
             try {
-                auto user = Users(result[0]);
-                auto userJson = getUserJsonResponse(user);
-                auto resp = HttpResponse::newHttpJsonResponse(userJson);
-                callback(resp);
+                const auto& layout = ownerProfileLayout();
+                auto binding = layout.bind(result);
+
+                JsonStreamWriter writer(layout.estimateSize(result, binding) + 64);
+                layout.writeObject(writer, result[0], binding);
+
+                ProfileCache::Entry entry;
+                entry.body = writer.release();
+                entry.version = result[0]["etag_version"].as<string>();
+                entry.modifiedAt = result[0]["etag_modified_at"].as<int64_t>();
+
+                callback(ProfileCache::respond(req, entry, "profile", userId));
+                ProfileCache::instance().store(ProfileCache::View::Owner, userId, {}, ticket, std::move(entry));
             } catch (const exception& e) {
                 LOG_ERROR << "Error processing user data: " << e.what();
                 auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Error processing user data"));
@@ -479,7 +478,9 @@ void UserController::updateMyProfile(const HttpRequestPtr& req,
     case 2:
         dbClient->execSqlAsync(
             sql,
-            [callback](const Result& result) {
+            [callback, userId](const Result& result) {
+                ProfileCache::instance().invalidate(userId);
+
                 Json::Value response;
                 response["message"] = "Profile updated successfully";
                 response["success"] = true;
@@ -501,7 +502,9 @@ void UserController::updateMyProfile(const HttpRequestPtr& req,
     case 3:
         dbClient->execSqlAsync(
             sql,
-            [callback](const Result& result) {
+            [callback, userId](const Result& result) {
+                ProfileCache::instance().invalidate(userId);
+
                 Json::Value response;
                 response["message"] = "Profile updated successfully";
                 response["success"] = true;
@@ -550,11 +553,12 @@ void UserController::changeUserRole(const HttpRequestPtr& req,
     }
 
     string newRole = (*json)["role"].asString();
+    string actorId = getCurrentUserId(req);
     auto dbClient = app().getDbClient();
 
     dbClient->execSqlAsync(
         "UPDATE users SET role = $1, updated_at = NOW() WHERE id = $2",
-        [callback, userId, newRole, this](const Result& result) {
+        [req, actorId, callback, userId, newRole, this](const Result& result) {
             if (result.affectedRows() == 0) {
                 auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
                 resp->setStatusCode(k404NotFound);
@@ -562,6 +566,12 @@ void UserController::changeUserRole(const HttpRequestPtr& req,
                 return;
             }
 
+            ProfileCache::instance().invalidate(userId);
+
+            Json::Value details;
+            details["role"] = newRole;
+            AuditLogger::instance().record(req, actorId, "user_role_changed", "user", userId, details);
+
             Json::Value response;
             response["message"] = "User role updated successfully";
             response["user_id"] = userId;
@@ -591,36 +601,69 @@ void UserController::uploadAvatar(const HttpRequestPtr& req,
         return;
     }
 
-    string fullPath = saveUploadedFile(req, "uploads/avatars/");
-    if (fullPath.empty()) {
+    MultiPartParser parser;
+    if (parser.parse(req) != 0 || parser.getFiles().empty()) {
         auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "No file uploaded"));
         resp->setStatusCode(k400BadRequest);
         callback(resp);
         return;
     }
 
-    auto dbClient = app().getDbClient();
+    // Декодирование, ресайз и WebP выполняются в очереди ImageService, а не в IO-потоке
+    ImageService::instance().processUpload(
+        parser.getFiles()[0], ImageService::ImageKind::Avatar, userId,
+        [callback, userId, this](const ImageService::ImageVariants& variants, const string& error) {
+            if (!error.empty()) {
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid image: " + error));
+                resp->setStatusCode(k400BadRequest);
+                callback(resp);
+                return;
+            }
 
-    dbClient->execSqlAsync(
-        "UPDATE users SET avatar_path = $1, updated_at = NOW() WHERE id = $2",
-        [callback, fullPath](const Result& result) {
-            Json::Value response;
-            response["message"] = "Avatar uploaded successfully";
-            response["avatar_path"] = fullPath;
-            response["success"] = true;
-            auto resp = HttpResponse::newHttpJsonResponse(response);
-            callback(resp);
-        },
-        [callback, fullPath, this](const DrogonDbException& e) {
-            // Удаляем файл в случае ошибки
-            filesystem::remove(fullPath);
-            LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to update avatar"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
-        },
-        fullPath, userId
-        );
+            auto dbClient = app().getDbClient();
+
+            dbClient->execSqlAsync(
+                // Старый путь читается под блокировкой строки в том же запросе:
+                // его варианты удаляются только после записи нового пути
+                "WITH old AS (SELECT avatar_path FROM users WHERE id = $2 FOR UPDATE) "
+                "UPDATE users SET avatar_path = $1, updated_at = NOW() WHERE id = $2 "
+                "RETURNING (SELECT avatar_path FROM old) AS old_path",
+                [callback, userId, variants, this](const Result& result) {
+                    if (result.empty()) {
+                        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
+                        resp->setStatusCode(k404NotFound);
+                        callback(resp);
+                        return;
+                    }
+                    ProfileCache::instance().invalidate(userId);
+
+                    // Та же картинка даёт тот же путь - тогда удалять нечего
+                    if (!result[0]["old_path"].isNull()) {
+                        string oldPath = result[0]["old_path"].as<string>();
+                        if (!oldPath.empty() && oldPath != variants.full) {
+                            ImageService::instance().deleteVariants(oldPath);
+                        }
+                    }
+
+                    Json::Value response;
+                    response["message"] = "Avatar uploaded successfully";
+                    response["avatar_path"] = variants.full;
+                    response["avatar_variants"] = ImageService::variantsJson(variants.full);
+                    response["success"] = true;
+                    auto resp = HttpResponse::newHttpJsonResponse(response);
+                    callback(resp);
+                },
+                [callback, this](const DrogonDbException& e) {
+                    // Файлы не удаляем: при повторной загрузке той же картинки
+                    // они совпадают с уже сохранёнными в профиле
+                    LOG_ERROR << "Database error: " << e.base().what();
+                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to update avatar"));
+                    resp->setStatusCode(k500InternalServerError);
+                    callback(resp);
+                },
+                variants.full, userId
+                );
+        });
 }
 
 void UserController::updateAvatar(const HttpRequestPtr& req,
@@ -633,41 +676,8 @@ void UserController::updateAvatar(const HttpRequestPtr& req,
         return;
     }
 
-    // Сначала получаем текущий аватар
-    auto dbClient = app().getDbClient();
-
-    dbClient->execSqlAsync(
-        "SELECT avatar_path FROM users WHERE id = $1",
-        [req, callback, userId, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
-
-            // Удаляем старый аватар
-            if (!result[0]["avatar_path"].isNull()) {
-                string oldAvatarPath = result[0]["avatar_path"].as<string>();
-                if (!oldAvatarPath.empty()) {
-                    deleteFile(oldAvatarPath);
-                }
-            }
-
-            // Загружаем новый с новым callback
-            auto uploadCallback = [callback](const HttpResponsePtr& resp) {
-                callback(resp);
-            };
-            uploadAvatar(req, std::move(uploadCallback));
-        },
-        [callback, this](const DrogonDbException& e) {
-            LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
-        },
-        userId
-        );
+    // Старые варианты удаляет uploadAvatar после записи нового пути
+    uploadAvatar(req, std::move(callback));
 }
 
 void UserController::deleteAvatar(const HttpRequestPtr& req,
@@ -705,15 +715,9 @@ void UserController::deleteAvatar(const HttpRequestPtr& req,
             }
         }
 
-        // Удаляем файл аватара если он существует
-        bool fileDeleted = true;
+        // Удаляем файл аватара если он существует (в фоне)
         if (hasAvatar) {
-            fileDeleted = deleteFile(avatarPath);
-            if (!fileDeleted) {
-                LOG_ERROR << "Failed to delete avatar file: " << avatarPath;
-            } else {
-                LOG_DEBUG << "Successfully deleted avatar file: " << avatarPath;
-            }
+            ImageService::instance().deleteVariants(avatarPath);
         }
 
         // Синхронно обновляем базу данных
@@ -721,14 +725,12 @@ void UserController::deleteAvatar(const HttpRequestPtr& req,
             "UPDATE users SET avatar_path = NULL, updated_at = NOW() WHERE id = $1",
             userId
             );
+        ProfileCache::instance().invalidate(userId);
 
         Json::Value response;
         if (updateResult.affectedRows() > 0) {
             response["message"] = "Avatar deleted successfully";
             response["success"] = true;
-            if (hasAvatar && !fileDeleted) {
-                response["warning"] = "Avatar removed from database but file deletion failed";
-            }
         } else {
             response["error"] = "Failed to update database";
             response["success"] = false;
@@ -785,15 +787,9 @@ void UserController::deleteCover(const HttpRequestPtr& req,
             }
         }
 
-        // Удаляем файл обложки если он существует
-        bool fileDeleted = true;
+        // Удаляем файл обложки если он существует (в фоне)
         if (hasCover) {
-            fileDeleted = deleteFile(coverPath);
-            if (!fileDeleted) {
-                LOG_ERROR << "Failed to delete cover file: " << coverPath;
-            } else {
-                LOG_DEBUG << "Successfully deleted cover file: " << coverPath;
-            }
+            ImageService::instance().deleteVariants(coverPath);
         }
 
         // Синхронно обновляем базу данных
@@ -801,14 +797,12 @@ void UserController::deleteCover(const HttpRequestPtr& req,
             "UPDATE users SET cover_path = NULL, updated_at = NOW() WHERE id = $1",
             userId
             );
+        ProfileCache::instance().invalidate(userId);
 
         Json::Value response;
         if (updateResult.affectedRows() > 0) {
             response["message"] = "Cover deleted successfully";
             response["success"] = true;
-            if (hasCover && !fileDeleted) {
-                response["warning"] = "Cover removed from database but file deletion failed";
-            }
         } else {
             response["error"] = "Failed to update database";
             response["success"] = false;
@@ -841,35 +835,69 @@ void UserController::uploadCover(const HttpRequestPtr& req,
         return;
     }
 
-    string fullPath = saveUploadedFile(req, "uploads/covers/");
-    if (fullPath.empty()) {
+    MultiPartParser parser;
+    if (parser.parse(req) != 0 || parser.getFiles().empty()) {
         auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "No file uploaded"));
         resp->setStatusCode(k400BadRequest);
         callback(resp);
         return;
     }
 
-    auto dbClient = app().getDbClient();
+    // Декодирование, ресайз и WebP выполняются в очереди ImageService, а не в IO-потоке
+    ImageService::instance().processUpload(
+        parser.getFiles()[0], ImageService::ImageKind::ProfileCover, userId,
+        [callback, userId, this](const ImageService::ImageVariants& variants, const string& error) {
+            if (!error.empty()) {
+                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid image: " + error));
+                resp->setStatusCode(k400BadRequest);
+                callback(resp);
+                return;
+            }
 
-    dbClient->execSqlAsync(
-        "UPDATE users SET cover_path = $1, updated_at = NOW() WHERE id = $2",
-        [callback, fullPath](const Result& result) {
-            Json::Value response;
-            response["message"] = "Cover uploaded successfully";
-            response["cover_path"] = fullPath;
-            response["success"] = true;
-            auto resp = HttpResponse::newHttpJsonResponse(response);
-            callback(resp);
-        },
-        [callback, fullPath, this](const DrogonDbException& e) {
-            filesystem::remove(fullPath);
-            LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to update cover"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
-        },
-        fullPath, userId
-        );
+            auto dbClient = app().getDbClient();
+
+            dbClient->execSqlAsync(
+                // Старый путь читается под блокировкой строки в том же запросе:
+                // его варианты удаляются только после записи нового пути
+                "WITH old AS (SELECT cover_path FROM users WHERE id = $2 FOR UPDATE) "
+                "UPDATE users SET cover_path = $1, updated_at = NOW() WHERE id = $2 "
+                "RETURNING (SELECT cover_path FROM old) AS old_path",
+                [callback, userId, variants, this](const Result& result) {
+                    if (result.empty()) {
+                        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
+                        resp->setStatusCode(k404NotFound);
+                        callback(resp);
+                        return;
+                    }
+                    ProfileCache::instance().invalidate(userId);
+
+                    // Та же картинка даёт тот же путь - тогда удалять нечего
+                    if (!result[0]["old_path"].isNull()) {
+                        string oldPath = result[0]["old_path"].as<string>();
+                        if (!oldPath.empty() && oldPath != variants.full) {
+                            ImageService::instance().deleteVariants(oldPath);
+                        }
+                    }
+
+                    Json::Value response;
+                    response["message"] = "Cover uploaded successfully";
+                    response["cover_path"] = variants.full;
+                    response["cover_variants"] = ImageService::variantsJson(variants.full);
+                    response["success"] = true;
+                    auto resp = HttpResponse::newHttpJsonResponse(response);
+                    callback(resp);
+                },
+                [callback, this](const DrogonDbException& e) {
+                    // Файлы не удаляем: при повторной загрузке той же картинки
+                    // они совпадают с уже сохранёнными в профиле
+                    LOG_ERROR << "Database error: " << e.base().what();
+                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Failed to update cover"));
+                    resp->setStatusCode(k500InternalServerError);
+                    callback(resp);
+                },
+                variants.full, userId
+                );
+        });
 }
 
 void UserController::updateCover(const HttpRequestPtr& req,
@@ -882,38 +910,8 @@ void UserController::updateCover(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
-
-    dbClient->execSqlAsync(
-        "SELECT cover_path FROM users WHERE id = $1",
-        [req, callback, userId, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
-
-            if (!result[0]["cover_path"].isNull()) {
-                string oldCoverPath = result[0]["cover_path"].as<string>();
-                if (!oldCoverPath.empty()) {
-                    deleteFile(oldCoverPath);
-                }
-            }
-
-            auto uploadCallback = [callback](const HttpResponsePtr& resp) {
-                callback(resp);
-            };
-            uploadCover(req, std::move(uploadCallback));
-        },
-        [callback, this](const DrogonDbException& e) {
-            LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
-        },
-        userId
-        );
+    // Старые варианты удаляет uploadCover после записи нового пути
+    uploadCover(req, std::move(callback));
 }
 
 // Информация
@@ -930,8 +928,8 @@ void UserController::getInformation(const HttpRequestPtr& req,
     auto dbClient = app().getDbClient();
 
     dbClient->execSqlAsync(
-        "SELECT information FROM users WHERE id = $1",
-        [callback, this](const Result& result) {
+        "SELECT information, " + kProfileVersionColumns + " FROM users WHERE id = $1",
+        [req, userId, callback, this](const Result& result) {
             if (result.empty()) {
                 auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
                 resp->setStatusCode(k404NotFound);
@@ -939,6 +937,12 @@ void UserController::getInformation(const HttpRequestPtr& req,
                 return;
             }
 
+            auto validator = profileValidator(req, result[0], userId);
+            if (HttpCache::isNotModified(req, validator)) {
+                callback(HttpCache::notModified(validator));
+                return;
+            }
+
             Json::Value information;
             if (!result[0]["information"].isNull()) {
                 string informationStr = result[0]["information"].as<string>();
@@ -955,6 +959,7 @@ void UserController::getInformation(const HttpRequestPtr& req,
             }
 
             auto resp = HttpResponse::newHttpJsonResponse(information);
+            HttpCache::apply(resp, validator);
             callback(resp);
         },
         [callback, this](const DrogonDbException& e) {
@@ -985,63 +990,25 @@ void UserController::addInformation(const HttpRequestPtr& req,
         return;
     }
 
+    static const string sql = profileArrayEditSql("information", ProfileArrayEdit::Append);
+    string newId = utils::getUuid();
+
+    Json::Value response;
+    response["message"] = "Information added successfully";
+    response["id"] = newId;
+
     auto dbClient = app().getDbClient();
 
     dbClient->execSqlAsync(
-        "SELECT information FROM users WHERE id = $1",
-        [callback, userId, json, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
-
-            Json::Value informationArray;
-            if (!result[0]["information"].isNull()) {
-                string informationStr = result[0]["information"].as<string>();
-                if (!informationStr.empty()) {
-                    Json::Reader reader;
-                    reader.parse(informationStr, informationArray);
-                }
-            }
-
-            // Добавляем новый элемент
-            string newId = utils::getUuid();
-            (*json)["id"] = newId;
-            informationArray.append(*json);
-
-            // Обновляем базу данных
-            Json::FastWriter writer;
-            string informationStr = writer.write(informationArray);
-
-            auto dbClient = app().getDbClient();
-            dbClient->execSqlAsync(
-                "UPDATE users SET information = $1, updated_at = NOW() WHERE id = $2",
-                [callback, newId](const Result& result) {
-                    Json::Value response;
-                    response["message"] = "Information added successfully";
-                    response["id"] = newId;
-                    response["success"] = true;
-                    auto resp = HttpResponse::newHttpJsonResponse(response);
-                    callback(resp);
-                },
-                [callback, this](const DrogonDbException& e) {
-                    LOG_ERROR << "Database error: " << e.base().what();
-                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-                    resp->setStatusCode(k500InternalServerError);
-                    callback(resp);
-                },
-                informationStr, userId
-                );
-        },
+        sql,
+        profileArrayEdited(userId, "information", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        userId
+        userId, HttpCache::expectedVersion(req, "profile"), compactJson(*json), newId
         );
 }
 
@@ -1073,27 +1040,23 @@ void UserController::updateAllInformation(const HttpRequestPtr& req,
         }
     }
 
-    Json::FastWriter writer;
-    string informationStr = writer.write(*json);
+    static const string sql = profileArrayEditSql("information", ProfileArrayEdit::ReplaceAll);
+
+    Json::Value response;
+    response["message"] = "All information updated successfully";
 
     auto dbClient = app().getDbClient();
 
     dbClient->execSqlAsync(
-        "UPDATE users SET information = $1, updated_at = NOW() WHERE id = $2",
-        [callback](const Result& result) {
-            Json::Value response;
-            response["message"] = "All information updated successfully";
-            response["success"] = true;
-            auto resp = HttpResponse::newHttpJsonResponse(response);
-            callback(resp);
-        },
+        sql,
+        profileArrayEdited(userId, "information", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        informationStr, userId
+        userId, HttpCache::expectedVersion(req, "profile"), compactJson(*json)
         );
 }
 
@@ -1116,77 +1079,24 @@ void UserController::updateInformationItem(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
-
-    dbClient->execSqlAsync(
-        "SELECT information FROM users WHERE id = $1",
-        [callback, userId, infoId, json, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
-
-            Json::Value informationArray;
-            if (!result[0]["information"].isNull()) {
-                string informationStr = result[0]["information"].as<string>();
-                if (!informationStr.empty()) {
-                    Json::Reader reader;
-                    reader.parse(informationStr, informationArray);
-                }
-            }
-
-            // Обновляем конкретный элемент
-            Json::Value updatedArray = Json::arrayValue;
-            bool found = false;
+    // Элемента с таким id нет - добавляется в конец, как и раньше
+    static const string sql = profileArrayEditSql("information", ProfileArrayEdit::Replace);
 
-            for (const auto& item : informationArray) {
-                if (item["id"].asString() == infoId) {
-                    Json::Value updatedItem = *json;
-                    updatedItem["id"] = infoId;
-                    updatedArray.append(updatedItem);
-                    found = true;
-                } else {
-                    updatedArray.append(item);
-                }
-            }
+    Json::Value response;
+    response["message"] = "Information item updated successfully";
 
-            if (!found) {
-                Json::Value newItem = *json;
-                newItem["id"] = infoId;
-                updatedArray.append(newItem);
-            }
-
-            Json::FastWriter writer;
-            string informationStr = writer.write(updatedArray);
+    auto dbClient = app().getDbClient();
 
-            auto dbClient = app().getDbClient();
-            dbClient->execSqlAsync(
-                "UPDATE users SET information = $1, updated_at = NOW() WHERE id = $2",
-                [callback](const Result& result) {
-                    Json::Value response;
-                    response["message"] = "Information item updated successfully";
-                    response["success"] = true;
-                    auto resp = HttpResponse::newHttpJsonResponse(response);
-                    callback(resp);
-                },
-                [callback, this](const DrogonDbException& e) {
-                    LOG_ERROR << "Database error: " << e.base().what();
-                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-                    resp->setStatusCode(k500InternalServerError);
-                    callback(resp);
-                },
-                informationStr, userId
-                );
-        },
+    dbClient->execSqlAsync(
+        sql,
+        profileArrayEdited(userId, "information", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        userId
+        userId, HttpCache::expectedVersion(req, "profile"), compactJson(*json), infoId
         );
 }
 
@@ -1201,64 +1111,23 @@ void UserController::deleteInformationItem(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
+    static const string sql = profileArrayEditSql("information", ProfileArrayEdit::Remove);
 
-    dbClient->execSqlAsync(
-        "SELECT information FROM users WHERE id = $1",
-        [callback, userId, infoId, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
+    Json::Value response;
+    response["message"] = "Information item deleted successfully";
 
-            Json::Value informationArray;
-            if (!result[0]["information"].isNull()) {
-                string informationStr = result[0]["information"].as<string>();
-                if (!informationStr.empty()) {
-                    Json::Reader reader;
-                    reader.parse(informationStr, informationArray);
-                }
-            }
-
-            // Удаляем элемент
-            Json::Value updatedArray = Json::arrayValue;
-            for (const auto& item : informationArray) {
-                if (item["id"].asString() != infoId) {
-                    updatedArray.append(item);
-                }
-            }
-
-            Json::FastWriter writer;
-            string informationStr = writer.write(updatedArray);
+    auto dbClient = app().getDbClient();
 
-            auto dbClient = app().getDbClient();
-            dbClient->execSqlAsync(
-                "UPDATE users SET information = $1, updated_at = NOW() WHERE id = $2",
-                [callback](const Result& result) {
-                    Json::Value response;
-                    response["message"] = "Information item deleted successfully";
-                    response["success"] = true;
-                    auto resp = HttpResponse::newHttpJsonResponse(response);
-                    callback(resp);
-                },
-                [callback, this](const DrogonDbException& e) {
-                    LOG_ERROR << "Database error: " << e.base().what();
-                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-                    resp->setStatusCode(k500InternalServerError);
-                    callback(resp);
-                },
-                informationStr, userId
-                );
-        },
+    dbClient->execSqlAsync(
+        sql,
+        profileArrayEdited(userId, "information", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        userId
+        userId, HttpCache::expectedVersion(req, "profile"), infoId
         );
 }
 
@@ -1276,8 +1145,8 @@ void UserController::getContacts(const HttpRequestPtr& req,
     auto dbClient = app().getDbClient();
 
     dbClient->execSqlAsync(
-        "SELECT contacts FROM users WHERE id = $1",
-        [callback, this](const Result& result) {
+        "SELECT contacts, " + kProfileVersionColumns + " FROM users WHERE id = $1",
+        [req, userId, callback, this](const Result& result) {
             if (result.empty()) {
                 auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
                 resp->setStatusCode(k404NotFound);
@@ -1285,6 +1154,12 @@ void UserController::getContacts(const HttpRequestPtr& req,
                 return;
             }
 
+            auto validator = profileValidator(req, result[0], userId);
+            if (HttpCache::isNotModified(req, validator)) {
+                callback(HttpCache::notModified(validator));
+                return;
+            }
+
             Json::Value contacts;
             if (!result[0]["contacts"].isNull()) {
                 string contactsStr = result[0]["contacts"].as<string>();
@@ -1301,6 +1176,7 @@ void UserController::getContacts(const HttpRequestPtr& req,
             }
 
             auto resp = HttpResponse::newHttpJsonResponse(contacts);
+            HttpCache::apply(resp, validator);
             callback(resp);
         },
         [callback, this](const DrogonDbException& e) {
@@ -1331,61 +1207,25 @@ void UserController::addContact(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
-
-    dbClient->execSqlAsync(
-        "SELECT contacts FROM users WHERE id = $1",
-        [callback, userId, json, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
-
-            Json::Value contactsArray;
-            if (!result[0]["contacts"].isNull()) {
-                string contactsStr = result[0]["contacts"].as<string>();
-                if (!contactsStr.empty()) {
-                    Json::Reader reader;
-                    reader.parse(contactsStr, contactsArray);
-                }
-            }
+    static const string sql = profileArrayEditSql("contacts", ProfileArrayEdit::Append);
+    string newId = utils::getUuid();
 
-            string newId = utils::getUuid();
-            (*json)["id"] = newId;
-            contactsArray.append(*json);
+    Json::Value response;
+    response["message"] = "Contact added successfully";
+    response["id"] = newId;
 
-            Json::FastWriter writer;
-            string contactsStr = writer.write(contactsArray);
+    auto dbClient = app().getDbClient();
 
-            auto dbClient = app().getDbClient();
-            dbClient->execSqlAsync(
-                "UPDATE users SET contacts = $1, updated_at = NOW() WHERE id = $2",
-                [callback, newId](const Result& result) {
-                    Json::Value response;
-                    response["message"] = "Contact added successfully";
-                    response["id"] = newId;
-                    response["success"] = true;
-                    auto resp = HttpResponse::newHttpJsonResponse(response);
-                    callback(resp);
-                },
-                [callback, this](const DrogonDbException& e) {
-                    LOG_ERROR << "Database error: " << e.base().what();
-                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-                    resp->setStatusCode(k500InternalServerError);
-                    callback(resp);
-                },
-                contactsStr, userId
-                );
-        },
+    dbClient->execSqlAsync(
+        sql,
+        profileArrayEdited(userId, "contacts", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        userId
+        userId, HttpCache::expectedVersion(req, "profile"), compactJson(*json), newId
         );
 }
 
@@ -1416,27 +1256,23 @@ void UserController::updateAllContacts(const HttpRequestPtr& req,
         }
     }
 
-    Json::FastWriter writer;
-    string contactsStr = writer.write(*json);
+    static const string sql = profileArrayEditSql("contacts", ProfileArrayEdit::ReplaceAll);
+
+    Json::Value response;
+    response["message"] = "All contacts updated successfully";
 
     auto dbClient = app().getDbClient();
 
     dbClient->execSqlAsync(
-        "UPDATE users SET contacts = $1, updated_at = NOW() WHERE id = $2",
-        [callback](const Result& result) {
-            Json::Value response;
-            response["message"] = "All contacts updated successfully";
-            response["success"] = true;
-            auto resp = HttpResponse::newHttpJsonResponse(response);
-            callback(resp);
-        },
+        sql,
+        profileArrayEdited(userId, "contacts", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        contactsStr, userId
+        userId, HttpCache::expectedVersion(req, "profile"), compactJson(*json)
         );
 }
 
@@ -1459,76 +1295,24 @@ void UserController::updateContactItem(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
+    // Элемента с таким id нет - добавляется в конец, как и раньше
+    static const string sql = profileArrayEditSql("contacts", ProfileArrayEdit::Replace);
 
-    dbClient->execSqlAsync(
-        "SELECT contacts FROM users WHERE id = $1",
-        [callback, userId, contactId, json, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
+    Json::Value response;
+    response["message"] = "Contact item updated successfully";
 
-            Json::Value contactsArray;
-            if (!result[0]["contacts"].isNull()) {
-                string contactsStr = result[0]["contacts"].as<string>();
-                if (!contactsStr.empty()) {
-                    Json::Reader reader;
-                    reader.parse(contactsStr, contactsArray);
-                }
-            }
-
-            Json::Value updatedArray = Json::arrayValue;
-            bool found = false;
-
-            for (const auto& item : contactsArray) {
-                if (item["id"].asString() == contactId) {
-                    Json::Value updatedItem = *json;
-                    updatedItem["id"] = contactId;
-                    updatedArray.append(updatedItem);
-                    found = true;
-                } else {
-                    updatedArray.append(item);
-                }
-            }
-
-            if (!found) {
-                Json::Value newItem = *json;
-                newItem["id"] = contactId;
-                updatedArray.append(newItem);
-            }
-
-            Json::FastWriter writer;
-            string contactsStr = writer.write(updatedArray);
+    auto dbClient = app().getDbClient();
 
-            auto dbClient = app().getDbClient();
-            dbClient->execSqlAsync(
-                "UPDATE users SET contacts = $1, updated_at = NOW() WHERE id = $2",
-                [callback](const Result& result) {
-                    Json::Value response;
-                    response["message"] = "Contact item updated successfully";
-                    response["success"] = true;
-                    auto resp = HttpResponse::newHttpJsonResponse(response);
-                    callback(resp);
-                },
-                [callback, this](const DrogonDbException& e) {
-                    LOG_ERROR << "Database error: " << e.base().what();
-                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-                    resp->setStatusCode(k500InternalServerError);
-                    callback(resp);
-                },
-                contactsStr, userId
-                );
-        },
+    dbClient->execSqlAsync(
+        sql,
+        profileArrayEdited(userId, "contacts", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        userId
+        userId, HttpCache::expectedVersion(req, "profile"), compactJson(*json), contactId
         );
 }
 
@@ -1543,63 +1327,23 @@ void UserController::deleteContactItem(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
-
-    dbClient->execSqlAsync(
-        "SELECT contacts FROM users WHERE id = $1",
-        [callback, userId, contactId, this](const Result& result) {
-            if (result.empty()) {
-                auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "User not found"));
-                resp->setStatusCode(k404NotFound);
-                callback(resp);
-                return;
-            }
-
-            Json::Value contactsArray;
-            if (!result[0]["contacts"].isNull()) {
-                string contactsStr = result[0]["contacts"].as<string>();
-                if (!contactsStr.empty()) {
-                    Json::Reader reader;
-                    reader.parse(contactsStr, contactsArray);
-                }
-            }
+    static const string sql = profileArrayEditSql("contacts", ProfileArrayEdit::Remove);
 
-            Json::Value updatedArray = Json::arrayValue;
-            for (const auto& item : contactsArray) {
-                if (item["id"].asString() != contactId) {
-                    updatedArray.append(item);
-                }
-            }
+    Json::Value response;
+    response["message"] = "Contact item deleted successfully";
 
-            Json::FastWriter writer;
-            string contactsStr = writer.write(updatedArray);
+    auto dbClient = app().getDbClient();
 
-            auto dbClient = app().getDbClient();
-            dbClient->execSqlAsync(
-                "UPDATE users SET contacts = $1, updated_at = NOW() WHERE id = $2",
-                [callback](const Result& result) {
-                    Json::Value response;
-                    response["message"] = "Contact item deleted successfully";
-                    response["success"] = true;
-                    auto resp = HttpResponse::newHttpJsonResponse(response);
-                    callback(resp);
-                },
-                [callback, this](const DrogonDbException& e) {
-                    LOG_ERROR << "Database error: " << e.base().what();
-                    auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-                    resp->setStatusCode(k500InternalServerError);
-                    callback(resp);
-                },
-                contactsStr, userId
-                );
-        },
+    dbClient->execSqlAsync(
+        sql,
+        profileArrayEdited(userId, "contacts", std::move(response), callback),
         [callback, this](const DrogonDbException& e) {
             LOG_ERROR << "Database error: " << e.base().what();
             auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        userId
+        userId, HttpCache::expectedVersion(req, "profile"), contactId
         );
 }
 
@@ -1614,30 +1358,58 @@ void UserController::getAllCoursesProgress(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
+    // Завершённые, но ещё не записанные уроки (ProgressBuffer) тоже учитываются
+    vector<string> pendingCompleted;
+    for (const auto& item : ProgressBuffer::instance().pendingFor(userId)) {
+        if (item.completed) {
+            pendingCompleted.push_back(item.videoId);
+        }
+    }
+
+    auto dbClient = DbRouter::instance().reader(req, userId);
 
+    // Счётчики завершённых и одобренных видео поддерживаются триггерами
+    // (course_enrollments.completed_videos, courses.videos_count) - одно чтение
+    // по индексу user_id; подзапрос pending считает только уроки из буфера
     dbClient->execSqlAsync(
         "SELECT ce.course_id, c.title as course_title, ce.completion_percentage, "
         "ce.is_completed, ce.last_accessed_at, "
-        "(SELECT COUNT(*) FROM user_progress up "
-        "JOIN course_videos cv ON up.video_id = cv.id "
-        "WHERE up.user_id = ce.user_id AND up.course_id = ce.course_id AND up.completed = true AND cv.is_approved = true) as videos_completed, "
-        "(SELECT COUNT(*) FROM course_videos WHERE course_id = ce.course_id AND is_approved = true) as total_videos "
+        "ce.completed_videos as videos_completed, c.videos_count as total_videos, "
+        "COALESCE(p.pending, 0) as pending_completed "
         "FROM course_enrollments ce "
         "JOIN courses c ON ce.course_id = c.id "
+        "LEFT JOIN ("
+        "    SELECT cv.course_id, COUNT(*) AS pending "
+        "    FROM course_videos cv "
+        "    LEFT JOIN user_progress up ON up.video_id = cv.id AND up.user_id = $1 "
+        "    WHERE cv.id = ANY($2::text[]) AND cv.is_approved = true AND NOT COALESCE(up.completed, false) "
+        "    GROUP BY cv.course_id"
+        ") p ON p.course_id = ce.course_id "
         "WHERE ce.user_id = $1",
         [callback](const Result& result) {
             Json::Value progressArray(Json::arrayValue);
 
             for (const auto& row : result) {
+                int totalVideos = row["total_videos"].as<int>();
+                int videosCompleted = row["videos_completed"].as<int>();
+                int pendingCompleted = row["pending_completed"].as<int>();
+
                 Json::Value progress;
                 progress["course_id"] = row["course_id"].as<string>();
                 progress["course_title"] = row["course_title"].as<string>();
                 progress["completion_percentage"] = row["completion_percentage"].as<int>();
                 progress["is_completed"] = row["is_completed"].as<bool>();
                 progress["last_accessed_at"] = row["last_accessed_at"].as<string>();
-                progress["videos_completed"] = row["videos_completed"].as<int>();
-                progress["total_videos"] = row["total_videos"].as<int>();
+                progress["videos_completed"] = videosCompleted;
+                progress["total_videos"] = totalVideos;
+
+                if (pendingCompleted > 0) {
+                    videosCompleted = min(videosCompleted + pendingCompleted, totalVideos);
+                    int percentage = totalVideos > 0 ? min(videosCompleted * 100 / totalVideos, 100) : 0;
+                    progress["videos_completed"] = videosCompleted;
+                    progress["completion_percentage"] = percentage;
+                    progress["is_completed"] = percentage == 100;
+                }
 
                 progressArray.append(progress);
             }
@@ -1651,7 +1423,7 @@ void UserController::getAllCoursesProgress(const HttpRequestPtr& req,
             resp->setStatusCode(k500InternalServerError);
             callback(resp);
         },
-        userId
+        userId, pg::textArray(pendingCompleted)
         );
 }
 
@@ -1666,7 +1438,7 @@ void UserController::getCourseProgress(const HttpRequestPtr& req,
         return;
     }
 
-    auto dbClient = app().getDbClient();
+    auto dbClient = DbRouter::instance().reader(req, userId);
 
     // Сначала проверяем существует ли курс и запись о прогрессе
     dbClient->execSqlAsync(
@@ -1679,15 +1451,26 @@ void UserController::getCourseProgress(const HttpRequestPtr& req,
                 return;
             }
 
+            // Ещё не записанный прогресс (ProgressBuffer) накладывается поверх БД:
+            // пользователь видит свои последние изменения сразу
+            auto pending = make_shared<unordered_map<string, ProgressBuffer::Pending>>();
+            vector<string> pendingIds;
+            for (auto& item : ProgressBuffer::instance().pendingFor(userId)) {
+                pendingIds.push_back(item.videoId);
+                pending->emplace(item.videoId, move(item));
+            }
+
             // Если курс существует, получаем прогресс
             dbClient->execSqlAsync(
-                "SELECT up.video_id, cv.title as video_title, up.completed, "
-                "up.watched_seconds, up.total_seconds, up.progress_percentage, "
+                "SELECT cv.id AS video_id, cv.title as video_title, COALESCE(up.completed, false) AS completed, "
+                "COALESCE(up.watched_seconds, 0) AS watched_seconds, up.total_seconds, "
+                "COALESCE(up.progress_percentage, 0) AS progress_percentage, "
                 "up.last_watched_at, cv.duration, cv.duration_seconds "
-                "FROM user_progress up "
-                "JOIN course_videos cv ON up.video_id = cv.id "
-                "WHERE up.user_id = $1 AND up.course_id = $2 AND cv.is_approved = true",
-                [callback, courseId, userId](const Result& result) {
+                "FROM course_videos cv "
+                "LEFT JOIN user_progress up ON up.video_id = cv.id AND up.user_id = $1 "
+                "WHERE cv.course_id = $2 AND cv.is_approved = true "
+                "AND (up.id IS NOT NULL OR cv.id = ANY($3::text[]))",
+                [callback, courseId, userId, pending](const Result& result) {
                     Json::Value progress;
                     progress["course_id"] = courseId;
                     progress["user_id"] = userId;
@@ -1705,6 +1488,20 @@ void UserController::getCourseProgress(const HttpRequestPtr& req,
                         videoProgress["duration"] = row["duration"].as<string>();
                         videoProgress["duration_seconds"] = row["duration_seconds"].as<int>();
 
+                        auto overlay = pending->find(videoProgress["video_id"].asString());
+                        if (overlay != pending->end()) {
+                            int duration = row["duration_seconds"].as<int>();
+                            const auto& item = overlay->second;
+                            videoProgress["completed"] = videoProgress["completed"].asBool() || item.completed;
+                            videoProgress["watched_seconds"] = item.watchedSeconds;
+                            if (duration > 0) {
+                                int64_t watched = std::clamp<int64_t>(item.watchedSeconds, 0, duration);
+                                videoProgress["watched_seconds"] = static_cast<Json::Int64>(watched);
+                                videoProgress["progress_percentage"] = static_cast<int>(watched * 100 / duration);
+                            }
+                            videoProgress["last_watched_at"] = trantor::Date::now().toDbStringLocal();
+                        }
+
                         videosProgress.append(videoProgress);
                     }
 
@@ -1724,7 +1521,7 @@ void UserController::getCourseProgress(const HttpRequestPtr& req,
                     resp->setStatusCode(k500InternalServerError);
                     callback(resp);
                 },
-                userId, courseId
+                userId, courseId, pg::textArray(pendingIds)
                 );
         },
         [callback, this](const DrogonDbException& e) {
@@ -1758,32 +1555,23 @@ void UserController::updateLessonProgress(const HttpRequestPtr& req,
     string videoId = (*json)["video_id"].asString();
     bool completed = (*json)["completed"].asBool();
     int watchedSeconds = (*json)["watched_seconds"].asInt();
+    // Несуществующие видео отсеиваются при записи, здесь только ограничиваем размер ключа
+    if (videoId.empty() || videoId.size() > 64) {
+        auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid progress data"));
+        resp->setStatusCode(k400BadRequest);
+        callback(resp);
+        return;
+    }
 
-    auto dbClient = app().getDbClient();
+    // Запись в БД пакетом раз в несколько секунд; повторные сообщения плеера
+    // по тому же видео схлопываются в одну строку
+    ProgressBuffer::instance().record(userId, videoId, watchedSeconds, completed);
 
-    dbClient->execSqlAsync(
-        "INSERT INTO user_progress (user_id, course_id, video_id, completed, watched_seconds, progress_percentage, last_watched_at) "
-        "VALUES ($1, (SELECT course_id FROM course_videos WHERE id = $2), $2, $3, $4, "
-        "LEAST(($4 * 100) / NULLIF((SELECT duration_seconds FROM course_videos WHERE id = $2), 0), 100), NOW()) "
-        "ON CONFLICT (user_id, video_id) DO UPDATE SET "
-        "completed = $3, watched_seconds = $4, progress_percentage = "
-        "LEAST(($4 * 100) / NULLIF((SELECT duration_seconds FROM course_videos WHERE id = $2), 0), 100), "
-        "last_watched_at = NOW(), updated_at = NOW()",
-        [callback, videoId](const Result& result) {
-            Json::Value response;
-            response["message"] = "Lesson progress updated successfully";
-            response["success"] = true;
-            auto resp = HttpResponse::newHttpJsonResponse(response);
-            callback(resp);
-        },
-        [callback, this](const DrogonDbException& e) {
-            LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
-        },
-        userId, videoId, completed, watchedSeconds
-        );
+    Json::Value response;
+    response["message"] = "Lesson progress updated successfully";
+    response["success"] = true;
+    auto resp = HttpResponse::newHttpJsonResponse(response);
+    callback(resp);
 }
 
 void UserController::updateLessonProgressDuration(const HttpRequestPtr& req,
@@ -1798,7 +1586,7 @@ void UserController::updateLessonProgressDuration(const HttpRequestPtr& req,
     }
 
     auto json = req->getJsonObject();
-    if (!json || !json->isMember("watched_seconds")) {
+    if (!json || !isValidWatchedSeconds((*json)["watched_seconds"]) || lessonId.empty() || lessonId.size() > 64) {
         auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Invalid data"));
         resp->setStatusCode(k400BadRequest);
         callback(resp);
@@ -1807,26 +1595,11 @@ void UserController::updateLessonProgressDuration(const HttpRequestPtr& req,
 
     int watchedSeconds = (*json)["watched_seconds"].asInt();
 
-    auto dbClient = app().getDbClient();
+    ProgressBuffer::instance().recordDuration(userId, lessonId, watchedSeconds);
 
-    dbClient->execSqlAsync(
-        "UPDATE user_progress SET watched_seconds = $1, "
-        "progress_percentage = LEAST(($1 * 100) / NULLIF((SELECT duration_seconds FROM course_videos WHERE id = $2), 0), 100), "
-        "last_watched_at = NOW(), updated_at = NOW() "
-        "WHERE user_id = $3 AND video_id = $2",
-        [callback, lessonId](const Result& result) {
-            Json::Value response;
-            response["message"] = "Lesson progress duration updated successfully";
-            response["success"] = true;
-            auto resp = HttpResponse::newHttpJsonResponse(response);
-            callback(resp);
-        },
-        [callback, this](const DrogonDbException& e) {
-            LOG_ERROR << "Database error: " << e.base().what();
-            auto resp = HttpResponse::newHttpJsonResponse(createJsonResponse("error", "Database error"));
-            resp->setStatusCode(k500InternalServerError);
-            callback(resp);
-        },
-        watchedSeconds, lessonId, userId
-        );
+    Json::Value response;
+    response["message"] = "Lesson progress duration updated successfully";
+    response["success"] = true;
+    auto resp = HttpResponse::newHttpJsonResponse(response);
+    callback(resp);
 }
@@ -133,11 +133,8 @@ private:
     bool isValidInformationItem(const Json::Value& item);
     bool isValidContactItem(const Json::Value& item);
     bool isValidProgressData(const Json::Value& data);
-
-    // Работа с файлами
-    std::string saveUploadedFile(const HttpRequestPtr& req,
-                                 const std::string& uploadPath);
-    bool deleteFile(const std::string& filePath);
+    // 0..ProgressBuffer::kMaxWatchedSeconds, длительность видео проверяется при записи
+    bool isValidWatchedSeconds(const Json::Value& value);
 
     // JSON обработка
     Json::Value updateJsonArray(const Json::Value& originalArray,
@@ -148,7 +145,6 @@ private:
 
     // Вспомогательные методы
     Json::Value createJsonResponse(const std::string& key, const std::string& value);
-    Json::Value getUserJsonResponse(const Users& user);
 
     const std::string JWT_SECRET = "your-super-secret-jwt-key-change-in-production";
 };
@@ -0,0 +1,273 @@
+#include "VideoPreviewService.h"
+#include "LibavUtils.h"
+#include <drogon/drogon.h>
+#include <filesystem>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+using namespace drogon;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Время для WebVTT: HH:MM:SS.mmm
+std::string formatVttTime(double seconds) {
+    auto totalMs = static_cast<long long>(std::llround(seconds * 1000.0));
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%02lld:%02lld:%02lld.%03lld",
+                  totalMs / 3600000, (totalMs / 60000) % 60, (totalMs / 1000) % 60, totalMs % 1000);
+    return buffer;
+}
+
+// Читаем пакеты до первого декодированного кадра после seek
+bool decodeNextFrame(AVFormatContext* fmt, AVCodecContext* ctx, int streamIndex, AVFrame* frame) {
+    libav::PacketPtr packet(av_packet_alloc());
+    while (av_read_frame(fmt, packet.get()) >= 0) {
+        if (packet->stream_index == streamIndex) {
+            int ret = avcodec_send_packet(ctx, packet.get());
+            av_packet_unref(packet.get());
+            if (ret < 0 && ret != AVERROR(EAGAIN)) {
+                continue;
+            }
+            if (avcodec_receive_frame(ctx, frame) == 0) {
+                return true;
+            }
+        } else {
+            av_packet_unref(packet.get());
+        }
+    }
+
+    // Конец файла: забираем то, что осталось в декодере
+    avcodec_send_packet(ctx, nullptr);
+    return avcodec_receive_frame(ctx, frame) == 0;
+}
+
+libav::FramePtr allocateSheet(int width, int height) {
+    libav::FramePtr sheet(av_frame_alloc());
+    if (!sheet) {
+        throw std::runtime_error("Out of memory");
+    }
+    sheet->width = width;
+    sheet->height = height;
+    sheet->format = AV_PIX_FMT_YUVJ420P;
+    if (av_frame_get_buffer(sheet.get(), 0) < 0) {
+        throw std::runtime_error("Failed to allocate sprite sheet");
+    }
+
+    // Чёрный фон для пустых ячеек
+    std::memset(sheet->data[0], 0, static_cast<size_t>(sheet->linesize[0]) * height);
+    std::memset(sheet->data[1], 128, static_cast<size_t>(sheet->linesize[1]) * (height / 2));
+    std::memset(sheet->data[2], 128, static_cast<size_t>(sheet->linesize[2]) * (height / 2));
+    return sheet;
+}
+
+bool writeFile(const std::string& path, const std::string& data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+VideoPreviewService::VideoPreviewService()
+    : queue_(1, "VideoPreviewService") {
+    const auto& config = app().getCustomConfig()["video_previews"];
+    intervalSeconds_ = std::max(1.0, config.get("interval_seconds", 5.0).asDouble());
+    tileWidth_ = std::max(32, config.get("tile_width", 160).asInt()) & ~1;
+    columns_ = std::max(1, config.get("columns", 10).asInt());
+    rows_ = std::max(1, config.get("rows", 10).asInt());
+    maxFrames_ = std::max(1, config.get("max_frames", 1000).asInt());
+    quality_ = config.get("quality", 70).asInt();
+}
+
+const std::string& VideoPreviewService::vttFileName() {
+    static const std::string name = "thumbnails.vtt";
+    return name;
+}
+
+std::string VideoPreviewService::previewDirectory(const std::string& videoPath) {
+    return fs::path(videoPath).replace_extension(".preview").string();
+}
+
+std::string VideoPreviewService::previewUrl(const std::string& videoPath) {
+    return "/media/" + previewDirectory(videoPath) + "/" + vttFileName();
+}
+
+void VideoPreviewService::enqueue(const std::string& videoFullPath, const std::string& videoPath,
+                                  const std::string& videoId) {
+    queue_.runTaskInQueue([this, videoFullPath, videoPath, videoId]() {
+        try {
+            generate(videoFullPath);
+        } catch (const std::exception& e) {
+            LOG_ERROR << "Failed to generate previews for " << videoFullPath << ": " << e.what();
+            return;
+        }
+
+        // Списки видео читают готовность из БД, а не с диска. Путь сверяется,
+        // чтобы не отметить видео, файл которого за это время заменили
+        app().getDbClient()->execSqlAsync(
+            "WITH video AS ("
+            "    UPDATE course_videos SET preview_vtt = $1 WHERE id = $2 AND video_path = $3 "
+            "    RETURNING course_id"
+            ") "
+            "UPDATE courses SET content_updated_at = NOW() WHERE id IN (SELECT course_id FROM video)",
+            [](const orm::Result&) {},
+            [videoId](const orm::DrogonDbException& e) {
+                LOG_ERROR << "Failed to store previews of video " << videoId << ": " << e.base().what();
+            },
+            previewUrl(videoPath), videoId, videoPath);
+    });
+}
+
+void VideoPreviewService::removePreviews(const std::string& videoFullPath) {
+    // Через ту же очередь, чтобы не удалить каталог посреди генерации
+    queue_.runTaskInQueue([videoFullPath]() {
+        std::error_code ec;
+        fs::remove_all(previewDirectory(videoFullPath), ec);
+        if (ec) {
+            LOG_ERROR << "Failed to delete previews for " << videoFullPath << ": " << ec.message();
+        }
+    });
+}
+
+void VideoPreviewService::generate(const std::string& videoFullPath) {
+    AVFormatContext* rawFormat = nullptr;
+    if (avformat_open_input(&rawFormat, videoFullPath.c_str(), nullptr, nullptr) < 0) {
+        throw std::runtime_error("Failed to open video");
+    }
+    libav::FormatContextPtr format(rawFormat);
+
+    if (avformat_find_stream_info(format.get(), nullptr) < 0) {
+        throw std::runtime_error("Failed to read stream info");
+    }
+
+    int streamIndex = av_find_best_stream(format.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIndex < 0) {
+        throw std::runtime_error("No video stream");
+    }
+    AVStream* stream = format->streams[streamIndex];
+
+    const AVCodec* decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!decoder) {
+        throw std::runtime_error("Video decoder is not available");
+    }
+
+    libav::CodecContextPtr ctx(avcodec_alloc_context3(decoder));
+    if (!ctx || avcodec_parameters_to_context(ctx.get(), stream->codecpar) < 0) {
+        throw std::runtime_error("Failed to configure decoder");
+    }
+    // Для превью достаточно ключевых кадров, остальные не декодируем
+    ctx->skip_frame = AVDISCARD_NONKEY;
+    if (avcodec_open2(ctx.get(), decoder, nullptr) < 0) {
+        throw std::runtime_error("Failed to open decoder");
+    }
+
+    if (format->duration <= 0 || ctx->width <= 0 || ctx->height <= 0) {
+        throw std::runtime_error("Unknown video duration or size");
+    }
+
+    double duration = static_cast<double>(format->duration) / AV_TIME_BASE;
+    double interval = std::max(intervalSeconds_, duration / maxFrames_);
+    int frameCount = std::max(1, static_cast<int>(std::ceil(duration / interval)));
+
+    int tileWidth = std::min(tileWidth_, ctx->width & ~1);
+    int tileHeight = std::max(2, static_cast<int>(static_cast<int64_t>(tileWidth) * ctx->height / ctx->width) & ~1);
+    int perSheet = columns_ * rows_;
+
+    const AVCodec* encoder = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+    if (!encoder) {
+        throw std::runtime_error("JPEG encoder is not available");
+    }
+
+    // Всё пишем во временный каталог и переименовываем целиком
+    std::string finalDir = previewDirectory(videoFullPath);
+    std::string tmpDir = finalDir + ".tmp";
+    std::error_code ec;
+    fs::remove_all(tmpDir, ec);
+    fs::create_directories(tmpDir);
+
+    libav::FramePtr frame(av_frame_alloc());
+    libav::SwsContextPtr sws;
+    std::string vtt = "WEBVTT\n\n";
+
+    try {
+        for (int sheetIndex = 0; sheetIndex * perSheet < frameCount; ++sheetIndex) {
+            int framesInSheet = std::min(perSheet, frameCount - sheetIndex * perSheet);
+            int rowsInSheet = (framesInSheet + columns_ - 1) / columns_;
+            int columnsInSheet = std::min(columns_, framesInSheet);
+            auto sheet = allocateSheet(columnsInSheet * tileWidth, rowsInSheet * tileHeight);
+            std::string sheetName = "sheet_" + std::to_string(sheetIndex) + ".jpg";
+
+            for (int i = 0; i < framesInSheet; ++i) {
+                int index = sheetIndex * perSheet + i;
+                double start = index * interval;
+                double end = std::min(duration, start + interval);
+                int x = (i % columns_) * tileWidth;
+                int y = (i / columns_) * tileHeight;
+
+                int64_t timestamp = static_cast<int64_t>(start / av_q2d(stream->time_base));
+                if (stream->start_time != AV_NOPTS_VALUE) {
+                    timestamp += stream->start_time;
+                }
+
+                if (av_seek_frame(format.get(), streamIndex, timestamp, AVSEEK_FLAG_BACKWARD) >= 0) {
+                    avcodec_flush_buffers(ctx.get());
+                }
+
+                if (decodeNextFrame(format.get(), ctx.get(), streamIndex, frame.get())) {
+                    // sws_getCachedContext сам освобождает старый контекст, если
+                    // создаёт новый или возвращает ошибку
+                    sws.reset(sws_getCachedContext(sws.release(), frame->width, frame->height,
+                                                   static_cast<AVPixelFormat>(frame->format),
+                                                   tileWidth, tileHeight, AV_PIX_FMT_YUVJ420P,
+                                                   SWS_BILINEAR, nullptr, nullptr, nullptr));
+                    if (!sws) {
+                        throw std::runtime_error("Failed to create scaler");
+                    }
+
+                    // Масштабируем кадр сразу в нужную ячейку спрайта
+                    uint8_t* dstData[4] = {
+                        sheet->data[0] + y * sheet->linesize[0] + x,
+                        sheet->data[1] + (y / 2) * sheet->linesize[1] + x / 2,
+                        sheet->data[2] + (y / 2) * sheet->linesize[2] + x / 2,
+                        nullptr
+                    };
+                    int dstLinesize[4] = {sheet->linesize[0], sheet->linesize[1], sheet->linesize[2], 0};
+                    sws_scale(sws.get(), frame->data, frame->linesize, 0, frame->height, dstData, dstLinesize);
+                    av_frame_unref(frame.get());
+                }
+
+                vtt += formatVttTime(start) + " --> " + formatVttTime(end) + "\n";
+                vtt += sheetName + "#xywh=" + std::to_string(x) + "," + std::to_string(y) + "," +
+                       std::to_string(tileWidth) + "," + std::to_string(tileHeight) + "\n\n";
+            }
+
+            std::string encoded = libav::encodeFrame(sheet.get(), encoder, quality_);
+            if (!writeFile(tmpDir + "/" + sheetName, encoded)) {
+                throw std::runtime_error("Failed to write " + sheetName);
+            }
+        }
+
+        if (!writeFile(tmpDir + "/" + vttFileName(), vtt)) {
+            throw std::runtime_error("Failed to write WebVTT index");
+        }
+    } catch (...) {
+        fs::remove_all(tmpDir, ec);
+        throw;
+    }
+
+    fs::remove_all(finalDir, ec);
+    fs::rename(tmpDir, finalDir, ec);
+    if (ec) {
+        fs::remove_all(tmpDir, ec);
+        throw std::runtime_error("Failed to move previews into place");
+    }
+
+    LOG_DEBUG << "Generated " << frameCount << " preview frames for " << videoFullPath;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <drogon/drogon.h>
+#include <trantor/utils/ConcurrentTaskQueue.h>
+#include <json/json.h>
+#include <string>
+
+// Превью для перемотки: кадры через фиксированный интервал собираются
+// в несколько JPEG спрайтов, рядом пишется WebVTT индекс вида
+// "sheet_0.jpg#xywh=x,y,w,h" для каждого отрезка времени.
+// Результат лежит рядом с видео в каталоге <имя видео>.preview/,
+// URL индекса записывается в course_videos.preview_vtt.
+class VideoPreviewService {
+public:
+    static VideoPreviewService& instance() {
+        static VideoPreviewService instance;
+        return instance;
+    }
+
+    // Поставить видео (полный путь на диске и video_path из БД) в очередь на
+    // генерацию превью. Когда превью готово, у видео videoId заполняется
+    // preview_vtt, а у его курса обновляется content_updated_at, чтобы ETag
+    // списков видео сменился вместе с появлением превью
+    void enqueue(const std::string& videoFullPath, const std::string& videoPath, const std::string& videoId);
+
+    // Удалить превью вместе с видео
+    void removePreviews(const std::string& videoFullPath);
+
+    // URL WebVTT индекса по относительному пути видео (video_path)
+    static std::string previewUrl(const std::string& videoPath);
+
+    // Каталог превью для видео
+    static std::string previewDirectory(const std::string& videoPath);
+
+    static const std::string& vttFileName();
+
+private:
+    VideoPreviewService();
+
+    void generate(const std::string& videoFullPath);
+
+    trantor::ConcurrentTaskQueue queue_;
+    double intervalSeconds_;
+    int tileWidth_;
+    int columns_;
+    int rows_;
+    int maxFrames_;
+    int quality_;
+};
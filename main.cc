@@ -1,10 +1,61 @@
 #include "controllers/UserController.h"
+#include "controllers/CounterService.h"
+#include "controllers/ProgressBuffer.h"
+#include "controllers/ProfileCache.h"
+#include "controllers/FileIoExecutor.h"
+#include "controllers/UploadGarbageCollector.h"
+#include "controllers/FeedService.h"
+#include "controllers/ModerationTemplateCache.h"
+#include "controllers/AuditLogger.h"
+#include "controllers/LogPartitionManager.h"
+#include "controllers/InvalidationBus.h"
+#include "controllers/DbRouter.h"
+#include "controllers/RecommendationService.h"
+#include "controllers/TrendingService.h"
+#include "controllers/HttpCache.h"
+#include "controllers/ResponseCompressor.h"
+#include "controllers/ResponseFormat.h"
 #include <drogon/drogon.h>
 #include <filesystem>
 #include <string>
 
 int main() {
     drogon::app().loadConfigFile("../../config/config.json");
+
+    // Пакетная запись просмотров и лайков
+    CounterService::instance().start();
+    // Пакетная запись прогресса уроков
+    ProgressBuffer::instance().start();
+    // Готовые ответы профилей и каналов
+    ProfileCache::instance().start();
+    // Запись загруженных файлов: io_uring или пул потоков
+    FileIoExecutor::instance().start();
+    // Периодическое удаление файлов без ссылок из БД
+    UploadGarbageCollector::instance().start();
+    // Разнос событий каналов по лентам подписчиков
+    FeedService::instance().start();
+    // Шаблоны комментариев модерации в памяти
+    ModerationTemplateCache::instance().start();
+    // Журнал действий в server_logs пишется пачками в фоне
+    AuditLogger::instance().start();
+    // Секции server_logs: создание заранее и удаление по сроку хранения
+    LogPartitionManager::instance().start();
+    // Матрица похожих курсов строится в фоне после запуска
+    RecommendationService::instance().start();
+    // Затухающий рейтинг "в тренде", продолжает с последнего снимка
+    TrendingService::instance().start();
+    // Чтения с реплик и закрепление за основным сервером после записи
+    DbRouter::instance().start();
+    // Сброс кэшей на всех экземплярах: после подписки ProfileCache, FeedService и DbRouter
+    InvalidationBus::instance().start();
+
+    // ETag по содержимому для GET без собственного валидатора
+    HttpCache::registerDigestFallback();
+    // Advice выполняются в порядке регистрации: ETag по JSON, затем CBOR
+    // по Accept, затем сжатие уже готового тела
+    ResponseFormat::registerAdvice();
+    ResponseCompressor::instance().start();
+
     drogon::app().registerHandler("/test",
                                   [](const drogon::HttpRequestPtr &req,
                                      std::function<void(const drogon::HttpResponsePtr &)> &&callback) {
@@ -13,5 +64,14 @@ int main() {
                                       callback(resp);
                                   });
     drogon::app().run();
+
+    // Дописываем в БД то, что накопилось в памяти с последнего сброса
+    CounterService::instance().shutdown();
+    ProgressBuffer::instance().shutdown();
+    TrendingService::instance().shutdown();
+    AuditLogger::instance().shutdown();
+    InvalidationBus::instance().shutdown();
+    // Дожидаемся записи и удаления файлов, уже поставленных в очередь
+    FileIoExecutor::instance().shutdown();
     return 0;
 }
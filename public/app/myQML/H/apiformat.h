@@ -0,0 +1,57 @@
+#ifndef APIFORMAT_H
+#define APIFORMAT_H
+
+#include <QByteArray>
+#include <QCborValue>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QString>
+#include <QVariant>
+
+// Общий разбор ответов сервера для CourseManager, ChannelManager и ProfileManager.
+// Сервер отдаёт CBOR вместо JSON, если клиент его предпочитает в Accept;
+// CBOR разбирается быстрее и меньше по размеру, что заметно на слабых телефонах.
+// Результат в обоих случаях одинаковый: QVariantMap / QVariantList для QML.
+namespace ApiFormat {
+
+// Вызывать для каждого запроса к API перед QNetworkAccessManager::get/post
+inline void prepareRequest(QNetworkRequest &request)
+{
+    request.setRawHeader("Accept", "application/cbor, application/json;q=0.9");
+}
+
+// Тело ответа по его Content-Type. При ошибке разбора возвращает пустой QVariant
+// и пишет причину в error (если передан)
+inline QVariant readBody(QNetworkReply *reply, QString *error = nullptr)
+{
+    const QByteArray body = reply->readAll();
+    const QString contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString();
+
+    if (contentType.startsWith(QLatin1String("application/cbor"))) {
+        QCborParserError parseError;
+        QCborValue value = QCborValue::fromCbor(body, &parseError);
+        if (parseError.error != QCborError::NoError) {
+            if (error) {
+                *error = parseError.errorString();
+            }
+            return {};
+        }
+        return value.toVariant();
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(body, &parseError);
+    if (parseError.error != QJsonParseError::NoError) {
+        if (error) {
+            *error = parseError.errorString();
+        }
+        return {};
+    }
+    return document.toVariant();
+}
+
+} // namespace ApiFormat
+
+#endif // APIFORMAT_H
@@ -0,0 +1,152 @@
+// Журнал действий: кольцо MpmcQueue и очистка текста перед записью в БД
+#include <drogon/drogon_test.h>
+#include "../controllers/AuditLogger.h"
+#include "../controllers/MpmcQueue.h"
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const std::string kReplacement = "\xEF\xBF\xBD";
+
+} // namespace
+
+DROGON_TEST(MpmcQueueFullAndEmpty)
+{
+    MpmcQueue<int> queue(3);
+    REQUIRE(queue.capacity() == 4);
+    CHECK(!queue.tryPop().has_value());
+
+    // Несколько оборотов кольца: позиции переходят через конец массива ячеек
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            CHECK(queue.tryPush(round * 10 + i));
+        }
+        CHECK(!queue.tryPush(-1));
+
+        for (int i = 0; i < 4; ++i) {
+            auto value = queue.tryPop();
+            REQUIRE(value.has_value());
+            CHECK(*value == round * 10 + i);
+        }
+        CHECK(!queue.tryPop().has_value());
+    }
+
+    // Освободившаяся ячейка снова принимает запись
+    for (int i = 0; i < 4; ++i) {
+        CHECK(queue.tryPush(int(i)));
+    }
+    CHECK(queue.tryPop() == std::optional<int>(0));
+    CHECK(queue.tryPush(4));
+    CHECK(!queue.tryPush(5));
+}
+
+DROGON_TEST(MpmcQueueConcurrent)
+{
+    constexpr int kProducers = 4;
+    constexpr int kConsumers = 4;
+    constexpr int kPerProducer = 100000;
+    constexpr int kTotal = kProducers * kPerProducer;
+
+    // Маленькое кольцо, чтобы писатели часто упирались в заполненную очередь
+    MpmcQueue<int> queue(64);
+    std::vector<std::atomic<int>> seen(kTotal);
+    std::atomic<int> consumed{0};
+    std::atomic<int> outOfRange{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; ++p) {
+        threads.emplace_back([&queue, p]() {
+            for (int i = 0; i < kPerProducer; ++i) {
+                while (!queue.tryPush(p * kPerProducer + i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < kConsumers; ++c) {
+        threads.emplace_back([&]() {
+            while (consumed.load() < kTotal) {
+                auto value = queue.tryPop();
+                if (!value) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                if (*value < 0 || *value >= kTotal) {
+                    ++outOfRange;
+                } else {
+                    seen[*value].fetch_add(1);
+                }
+                ++consumed;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    CHECK(consumed.load() == kTotal);
+    CHECK(outOfRange.load() == 0);
+    int lost = 0;
+    int duplicated = 0;
+    for (const auto& count : seen) {
+        lost += count.load() == 0;
+        duplicated += count.load() > 1;
+    }
+    CHECK(lost == 0);
+    CHECK(duplicated == 0);
+    CHECK(!queue.tryPop().has_value());
+}
+
+DROGON_TEST(AuditSanitizeTruncation)
+{
+    // "Привет" - по 2 байта на букву, "€" - 3 байта, "😀" - 4 байта
+    const std::string hello = "Привет";
+    CHECK(AuditLogger::sanitizeText(hello) == hello);
+    CHECK(AuditLogger::sanitizeText(hello, 12) == hello);
+    CHECK(AuditLogger::sanitizeText(hello, 5) == "Пр");
+    CHECK(AuditLogger::sanitizeText(hello, 1).empty());
+    CHECK(AuditLogger::sanitizeText("a€", 3) == "a");
+    CHECK(AuditLogger::sanitizeText("a€", 4) == "a€");
+    CHECK(AuditLogger::sanitizeText("😀", 3).empty());
+    CHECK(AuditLogger::sanitizeText("x😀", 5) == "x😀");
+
+    // Замена тоже целиком укладывается в предел или не пишется вовсе
+    CHECK(AuditLogger::sanitizeText("ab\xFF", 4) == "ab");
+    CHECK(AuditLogger::sanitizeText("ab\xFF", 5) == "ab" + kReplacement);
+}
+
+DROGON_TEST(AuditSanitizeInvalidBytes)
+{
+    CHECK(AuditLogger::sanitizeText("\xFF") == kReplacement);
+    // Оборванная последовательность и лишний байт продолжения
+    CHECK(AuditLogger::sanitizeText("a\xD0") == "a" + kReplacement);
+    CHECK(AuditLogger::sanitizeText("\x80z") == kReplacement + "z");
+    // Избыточная запись "/" и суррогат U+D800
+    CHECK(AuditLogger::sanitizeText("\xC0\xAF") == kReplacement + kReplacement);
+    CHECK(AuditLogger::sanitizeText("\xED\xA0\x80") == kReplacement + kReplacement + kReplacement);
+    // Больше U+10FFFF
+    CHECK(AuditLogger::sanitizeText("\xF4\x90\x80\x80") ==
+          kReplacement + kReplacement + kReplacement + kReplacement);
+    // Нулевой байт выбрасывается
+    CHECK(AuditLogger::sanitizeText(std::string("a\0b", 3)) == "ab");
+
+    // Случайные байты: результат - корректный UTF-8 (повторная очистка его не меняет),
+    // без нулевых байтов и не длиннее предела
+    std::mt19937 random(20240501);
+    std::uniform_int_distribution<int> byteDistribution(0, 255);
+    std::uniform_int_distribution<size_t> lengthDistribution(0, 64);
+    for (int i = 0; i < 2000; ++i) {
+        std::string text(lengthDistribution(random), '\0');
+        for (auto& c : text) {
+            c = static_cast<char>(byteDistribution(random));
+        }
+        size_t maxBytes = lengthDistribution(random);
+        std::string sanitized = AuditLogger::sanitizeText(text, maxBytes);
+        CHECK(sanitized.size() <= maxBytes);
+        CHECK(sanitized.find('\0') == std::string::npos);
+        CHECK(AuditLogger::sanitizeText(sanitized) == sanitized);
+    }
+}
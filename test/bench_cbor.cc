@@ -0,0 +1,192 @@
+// Бенчмарк JSON против CBOR для списков курсов и структуры курса:
+// размер ответа и время разбора на стороне клиента.
+//
+// Сборка без сервера и drogon:
+//   g++ -O2 -std=c++17 -I/usr/include/jsoncpp test/bench_cbor.cc controllers/CborTranscoder.cc -ljsoncpp -o bench_cbor
+// С разбором через Qt (как в клиенте: QJsonDocument против QCborValue):
+//   добавить -DBENCH_WITH_QT и флаги из pkg-config Qt6Core
+//
+// Запуск на реальных ответах сервера:
+//   curl -s 'http://localhost:5555/courses?limit=100' > courses.json
+//   curl -s http://localhost:5555/courses/<id>/structure > structure.json
+//   ./bench_cbor courses.json structure.json
+// Без аргументов используется синтетический список из 100 курсов и структура
+// курса на 20 глав по 15 видео.
+
+#include "../controllers/CborTranscoder.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef BENCH_WITH_QT
+#include <QByteArray>
+#include <QCborValue>
+#include <QJsonDocument>
+#endif
+
+namespace {
+
+std::string readFile(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    return buffer.str();
+}
+
+std::string toJsonText(const Json::Value& value) {
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    // Сервер пишет кириллицу как есть, без экранирования
+    builder["emitUTF8"] = true;
+    return Json::writeString(builder, value);
+}
+
+Json::Value syntheticCourse(int i) {
+    Json::Value course;
+    course["id"] = "5f0c7a1e-2b3d-4c5e-8f90-" + std::to_string(100000000000 + i);
+    course["title"] = "Курс номер " + std::to_string(i) + ": основы программирования";
+    course["description"] = "Подробное описание курса с примерами, заданиями и \"цитатами\"";
+    course["category"] = "программирование";
+    course["level"] = "начинающий";
+    course["language"] = "ru";
+    course["author_id"] = "a1b2c3d4-e5f6-7a8b-9c0d-" + std::to_string(200000000000 + i % 7);
+    course["chapters_count"] = 12;
+    course["videos_count"] = 140 + i;
+    course["total_duration_minutes"] = 1260;
+    course["price"] = "0.00";
+    course["rating"] = 4.5;
+    course["is_published"] = true;
+    course["is_public"] = true;
+    course["cover_path"] = Json::nullValue;
+    course["total_views"] = 123456 + i;
+    course["total_likes"] = 4321;
+    course["created_at"] = "2025-03-14 09:26:53.589793";
+    course["updated_at"] = "2025-06-01 12:00:00.000000";
+    return course;
+}
+
+Json::Value syntheticVideo(int chapter, int i) {
+    Json::Value video;
+    video["id"] = "9e8d7c6b-5a49-3827-1605-" + std::to_string(300000000000 + chapter * 100 + i);
+    video["title"] = "Урок " + std::to_string(i + 1);
+    video["description"] = "Описание урока";
+    video["order"] = i + 1;
+    video["video_path"] = "courses/x/chapters/y/videos/lesson_" + std::to_string(i) + ".mp4";
+    video["duration"] = "00:12:30";
+    video["duration_seconds"] = 750;
+    video["has_subtitles"] = false;
+    video["has_notes"] = true;
+    video["views_count"] = 1000 + i;
+    video["likes_count"] = 50;
+    video["is_approved"] = true;
+    video["preview_vtt"] = Json::nullValue;
+    video["created_at"] = "2025-03-14 09:26:53.589793";
+    return video;
+}
+
+std::vector<std::pair<std::string, std::string>> syntheticInputs() {
+    Json::Value listing;
+    listing["courses"] = Json::Value(Json::arrayValue);
+    for (int i = 0; i < 100; ++i) {
+        listing["courses"].append(syntheticCourse(i));
+    }
+    listing["pagination"]["page"] = 1;
+    listing["pagination"]["limit"] = 100;
+    listing["pagination"]["total"] = 1000;
+    listing["pagination"]["pages"] = 10;
+
+    Json::Value structure;
+    structure["chapters"] = Json::Value(Json::arrayValue);
+    for (int c = 0; c < 20; ++c) {
+        Json::Value chapter;
+        chapter["id"] = "c0c0c0c0-0000-4000-8000-" + std::to_string(400000000000 + c);
+        chapter["title"] = "Глава " + std::to_string(c + 1);
+        chapter["order"] = c + 1;
+        chapter["videos"] = Json::Value(Json::arrayValue);
+        for (int v = 0; v < 15; ++v) {
+            chapter["videos"].append(syntheticVideo(c, v));
+        }
+        structure["chapters"].append(chapter);
+    }
+
+    return {{"courses (100)", toJsonText(listing)}, {"structure (20x15)", toJsonText(structure)}};
+}
+
+template <typename F>
+double microsecondsPerRun(int runs, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; ++i) {
+        body();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / runs;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::pair<std::string, std::string>> inputs;
+    for (int i = 1; i < argc; ++i) {
+        inputs.emplace_back(argv[i], readFile(argv[i]));
+    }
+    if (inputs.empty()) {
+        inputs = syntheticInputs();
+    }
+
+    const int runs = 200;
+    std::printf("%-20s %10s %10s %6s %12s %12s %12s\n",
+                "payload", "json B", "cbor B", "ratio", "encode us", "json us", "cbor us");
+
+    for (const auto& [name, json] : inputs) {
+        std::string cbor;
+        if (!CborTranscoder::fromJson(json, cbor)) {
+            std::fprintf(stderr, "%s: invalid JSON\n", name.c_str());
+            return 1;
+        }
+
+        // Проверка обратимости: дерево из CBOR совпадает с деревом из JSON
+        Json::Value fromJson;
+        Json::Value fromCbor;
+        Json::CharReaderBuilder readerBuilder;
+        std::unique_ptr<Json::CharReader> reader(readerBuilder.newCharReader());
+        std::string errors;
+        if (!reader->parse(json.data(), json.data() + json.size(), &fromJson, &errors) ||
+            !CborTranscoder::toJsonValue(cbor, fromCbor) || fromJson != fromCbor) {
+            std::fprintf(stderr, "%s: round trip mismatch\n", name.c_str());
+            return 1;
+        }
+
+        double encodeUs = microsecondsPerRun(runs, [&]() {
+            std::string out;
+            CborTranscoder::fromJson(json, out);
+        });
+        double jsonUs = microsecondsPerRun(runs, [&]() {
+            Json::Value value;
+            reader->parse(json.data(), json.data() + json.size(), &value, &errors);
+        });
+        double cborUs = microsecondsPerRun(runs, [&]() {
+            Json::Value value;
+            CborTranscoder::toJsonValue(cbor, value);
+        });
+
+        std::printf("%-20s %10zu %10zu %6.2f %12.1f %12.1f %12.1f\n",
+                    name.c_str(), json.size(), cbor.size(),
+                    static_cast<double>(cbor.size()) / json.size(), encodeUs, jsonUs, cborUs);
+
+#ifdef BENCH_WITH_QT
+        QByteArray jsonBytes = QByteArray::fromRawData(json.data(), static_cast<int>(json.size()));
+        QByteArray cborBytes = QByteArray::fromRawData(cbor.data(), static_cast<int>(cbor.size()));
+        double qtJsonUs = microsecondsPerRun(runs, [&]() {
+            QJsonDocument::fromJson(jsonBytes).toVariant();
+        });
+        double qtCborUs = microsecondsPerRun(runs, [&]() {
+            QCborValue::fromCbor(cborBytes).toVariant();
+        });
+        std::printf("%-20s %10s %10s %6s %12s %12.1f %12.1f  (Qt, toVariant)\n",
+                    "", "", "", "", "", qtJsonUs, qtCborUs);
+#endif
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+-- Бенчмарк стоимости записи в course_videos в зависимости от размера курса.
+-- Запуск на базе со схемой из BD-Server.txt:
+--   psql -d myserver -f test/bench_video_counts.sql
+-- Курс заполняется до 0, 100, 1000, 5000 видео; на каждом размере замеряется
+-- среднее время вставки, одобрения/снятия одобрения и изменения likes_count.
+-- При дельта-триггерах время должно оставаться примерно постоянным.
+-- Все изменения откатываются в конце.
+
+BEGIN;
+
+DO $$
+DECLARE
+    v_author CONSTANT TEXT := 'c0ffeeee-c0de-ed1f-c0de-badcafefaced';  -- основатель из раздела 11 схемы
+    v_samples CONSTANT INTEGER := 200;
+    v_sizes INTEGER[] := ARRAY[0, 100, 1000, 5000];
+    v_size INTEGER;
+    v_existing INTEGER := 0;
+    v_course TEXT;
+    v_chapter TEXT;
+    v_video TEXT;
+    v_start TIMESTAMPTZ;
+    v_insert_ms NUMERIC;
+    v_approve_ms NUMERIC;
+    v_like_ms NUMERIC;
+    i INTEGER;
+BEGIN
+    INSERT INTO courses (author_id, title, category, level)
+    VALUES (v_author, 'bench', 'bench', 'начинающий')
+    RETURNING id INTO v_course;
+
+    INSERT INTO course_chapters (course_id, title, "order")
+    VALUES (v_course, 'bench', 1)
+    RETURNING id INTO v_chapter;
+
+    FOREACH v_size IN ARRAY v_sizes LOOP
+        -- Доводим курс до нужного размера
+        INSERT INTO course_videos (course_id, chapter_id, author_id, title, "order",
+                                   video_filename, video_path, duration_seconds)
+        SELECT v_course, v_chapter, v_author, 'fill', g, 'fill.mp4', 'fill.mp4', 60
+        FROM generate_series(v_existing + 1, v_size) g;
+        v_existing := GREATEST(v_existing, v_size);
+
+        -- Вставка
+        v_start := clock_timestamp();
+        FOR i IN 1..v_samples LOOP
+            INSERT INTO course_videos (course_id, chapter_id, author_id, title, "order",
+                                       video_filename, video_path, duration_seconds)
+            VALUES (v_course, v_chapter, v_author, 'probe', v_existing + i, 'probe.mp4', 'probe.mp4', 60);
+        END LOOP;
+        v_insert_ms := EXTRACT(EPOCH FROM clock_timestamp() - v_start) * 1000 / v_samples;
+
+        SELECT id INTO v_video
+        FROM course_videos
+        WHERE course_id = v_course AND title = 'probe'
+        LIMIT 1;
+
+        -- Смена одобрения (пара UPDATE на итерацию)
+        v_start := clock_timestamp();
+        FOR i IN 1..v_samples LOOP
+            UPDATE course_videos SET is_approved = false WHERE id = v_video;
+            UPDATE course_videos SET is_approved = true WHERE id = v_video;
+        END LOOP;
+        v_approve_ms := EXTRACT(EPOCH FROM clock_timestamp() - v_start) * 1000 / (2 * v_samples);
+
+        -- Изменение лайков
+        v_start := clock_timestamp();
+        FOR i IN 1..v_samples LOOP
+            UPDATE course_videos SET likes_count = likes_count + 1 WHERE id = v_video;
+        END LOOP;
+        v_like_ms := EXTRACT(EPOCH FROM clock_timestamp() - v_start) * 1000 / v_samples;
+
+        -- Агрегаты курса по лайкам ведёт CounterService, а не триггер: возвращаем как было
+        UPDATE course_videos SET likes_count = 0 WHERE id = v_video;
+
+        DELETE FROM course_videos WHERE course_id = v_course AND title = 'probe';
+
+        RAISE NOTICE 'videos=% insert=% ms approve=% ms like=% ms',
+            v_existing, round(v_insert_ms, 3), round(v_approve_ms, 3), round(v_like_ms, 3);
+    END LOOP;
+
+    -- Дельты должны сойтись с полным пересчётом
+    PERFORM 1
+    FROM courses c
+    WHERE c.id = v_course
+      AND c.videos_count = (SELECT COUNT(*) FROM course_videos WHERE course_id = v_course AND is_approved);
+    IF NOT FOUND THEN
+        RAISE WARNING 'courses.videos_count diverged from COUNT(*)';
+    END IF;
+
+    PERFORM 1
+    FROM course_chapters ch
+    WHERE ch.id = v_chapter
+      AND ch.videos_count = (SELECT COUNT(*) FROM course_videos WHERE chapter_id = v_chapter AND is_approved)
+      AND ch.total_duration = (SELECT COALESCE(SUM(duration_seconds), 0) FROM course_videos
+                               WHERE chapter_id = v_chapter AND is_approved);
+    IF NOT FOUND THEN
+        RAISE WARNING 'course_chapters counters diverged from full recount';
+    END IF;
+END $$;
+
+-- Один проход сверки по всем курсам: на согласованных данных исправлений быть не должно
+SELECT * FROM reconcile_counters('', 100000);
+
+ROLLBACK;
@@ -0,0 +1,98 @@
+// Формат и сжатие ответов: CBOR, выбор по Accept и Accept-Encoding
+#include <drogon/drogon_test.h>
+#include <drogon/drogon.h>
+#include "../controllers/CborTranscoder.h"
+#include "../controllers/ResponseCompressor.h"
+#include "../controllers/ResponseFormat.h"
+
+using namespace drogon;
+
+namespace {
+
+Json::Value parseJson(const std::string& text) {
+    Json::Value value;
+    std::string errors;
+    std::unique_ptr<Json::CharReader> reader(Json::CharReaderBuilder().newCharReader());
+    reader->parse(text.data(), text.data() + text.size(), &value, &errors);
+    return value;
+}
+
+bool prefersCbor(const std::string& accept) {
+    auto req = HttpRequest::newHttpRequest();
+    req->addHeader("Accept", accept);
+    return ResponseFormat::prefersCbor(req);
+}
+
+} // namespace
+
+DROGON_TEST(CborTranscoderRoundTrip)
+{
+    const std::string json =
+        R"({"max":9223372036854775807,"min":-9223372036854775808,"unsigned":18446744073709551615,)"
+        R"("negative":-42,"half":1.5,"tenth":0.1,"whole":2.0,"huge":1e300,)"
+        R"("text":"Привет, \"мир\"\n\u0001","empty":"",)"
+        R"("nested":{"list":[1,[2,{"deep":[]}],{}],"flag":true,"none":null}})";
+
+    std::string cbor;
+    REQUIRE(CborTranscoder::fromJson(json, cbor));
+    Json::Value decoded;
+    REQUIRE(CborTranscoder::toJsonValue(cbor, decoded));
+    CHECK(decoded == parseJson(json));
+    CHECK(decoded["max"].asInt64() == INT64_MAX);
+    CHECK(decoded["min"].asInt64() == INT64_MIN);
+    CHECK(decoded["nested"]["list"][1][1]["deep"].isArray());
+
+    // Целые - major type 0/1, точно представимые дроби - float32, остальные - float64
+    CHECK(CborTranscoder::fromJson("-1", cbor));
+    CHECK(cbor == std::string("\x20", 1));
+    CHECK(CborTranscoder::fromJson("1.5", cbor));
+    CHECK(cbor == std::string("\xfa\x3f\xc0\x00\x00", 5));
+    CHECK(CborTranscoder::fromJson("0.1", cbor));
+    CHECK(cbor.size() == 9);
+    CHECK(static_cast<uint8_t>(cbor[0]) == 0xfb);
+
+    CHECK(!CborTranscoder::fromJson(R"({"a":)", cbor));
+    const size_t depth = CborTranscoder::kMaxDepth;
+    CHECK(CborTranscoder::fromJson(std::string(depth, '[') + std::string(depth, ']'), cbor));
+    CHECK(!CborTranscoder::fromJson(std::string(depth * 2, '[') + std::string(depth * 2, ']'), cbor));
+}
+
+DROGON_TEST(ResponseFormatPrefersCbor)
+{
+    CHECK(prefersCbor("application/cbor"));
+    CHECK(prefersCbor("application/cbor, application/json"));
+    CHECK(prefersCbor("application/json;q=0.5, application/cbor"));
+    CHECK(!prefersCbor("application/json"));
+    CHECK(!prefersCbor("application/cbor;q=0.5, application/json"));
+    CHECK(!prefersCbor("application/cbor;q=0"));
+    CHECK(!prefersCbor("application/cbor;q=0.5, */*"));
+    CHECK(prefersCbor("application/cbor, */*;q=0.8"));
+    CHECK(prefersCbor("application/cbor; level=1; q=0.9, application/json;q=0.8"));
+    CHECK(prefersCbor("application/cbor;Q=1, application/json;q=0.9"));
+
+    // "q=" внутри других параметров - не q элемента
+    CHECK(prefersCbor("application/cbor;profile=\"seq=0\""));
+    CHECK(prefersCbor("application/cbor;xq=0.1, application/json"));
+    CHECK(!prefersCbor("application/json;xq=0.1;q=1, application/cbor;seq=1;q=0.4"));
+}
+
+DROGON_TEST(ResponseCompressorNegotiate)
+{
+    using Encoding = ResponseCompressor::Encoding;
+    const auto& compressor = ResponseCompressor::instance();
+
+    CHECK(compressor.negotiate("") == Encoding::Identity);
+    CHECK(compressor.negotiate("identity") == Encoding::Identity);
+    CHECK(compressor.negotiate("gzip") == Encoding::Gzip);
+    CHECK(compressor.negotiate("GZIP;q=0.5") == Encoding::Gzip);
+    CHECK(compressor.negotiate("gzip;q=0") == Encoding::Identity);
+    CHECK(compressor.negotiate("gzip;q=0, identity") == Encoding::Identity);
+    CHECK(compressor.negotiate("identity;q=1, gzip;q=0.5") == Encoding::Gzip);
+    CHECK(compressor.negotiate("gzip;level=9;q=0") == Encoding::Identity);
+
+    // * - любая собранная кодировка, кроме явно запрещённых
+    CHECK(compressor.negotiate("*") != Encoding::Identity);
+    CHECK(compressor.negotiate("*;q=0") == Encoding::Identity);
+    CHECK(compressor.negotiate("*;q=0, gzip") == Encoding::Gzip);
+    CHECK(compressor.negotiate("gzip;q=0, *") != Encoding::Gzip);
+}